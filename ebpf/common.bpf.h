@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * SmartScheduler eBPF shared definitions
+ *
+ * The stats maps come in two flavours, picked at build time:
+ * - default: one BPF_MAP_TYPE_HASH value per PID, updated with atomics
+ * - SMARTSCHED_PERCPU: BPF_MAP_TYPE_PERCPU_HASH, each CPU updates its
+ *   own copy with plain stores and user space sums the copies on read
+ *
+ * The per-CPU build keeps hot tracepoints free of cross-CPU cache-line
+ * traffic at the price of nr_cpus copies of every map value. Maps with
+ * large values (io_hist_map, 512 B) stay shared in both builds, since
+ * 4096 x 512 B x nr_cpus would reach 256 MB on a 128-CPU host.
+ */
+
+#ifndef __SMARTSCHED_COMMON_BPF_H
+#define __SMARTSCHED_COMMON_BPF_H
+
+#ifdef SMARTSCHED_PERCPU
+
+#define STATS_MAP_TYPE BPF_MAP_TYPE_PERCPU_HASH
+
+/* Only this CPU writes its copy: no atomics needed */
+#define STAT_ADD(field, val)  ((field) += (val))
+
+#else
+
+#define STATS_MAP_TYPE BPF_MAP_TYPE_HASH
+
+#define STAT_ADD(field, val)  __sync_fetch_and_add(&(field), (val))
+
+#endif /* SMARTSCHED_PERCPU */
+
+#endif /* __SMARTSCHED_COMMON_BPF_H */
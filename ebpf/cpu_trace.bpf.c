@@ -15,6 +15,8 @@
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
 
+#include "common.bpf.h"
+
 char LICENSE[] SEC("license") = "GPL";
 
 /* Maximum number of processes to track */
@@ -32,7 +34,7 @@ struct cpu_stats {
 
 /* BPF map to store per-process CPU statistics */
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(type, STATS_MAP_TYPE);
     __uint(max_entries, MAX_ENTRIES);
     __type(key, u32);        /* PID */
     __type(value, struct cpu_stats);
@@ -82,15 +84,15 @@ int trace_sched_switch(struct trace_event_raw_sched_switch *ctx)
             /* Calculate runtime since last switch */
             if (stats->last_switch_time > 0) {
                 u64 runtime = now - stats->last_switch_time;
-                __sync_fetch_and_add(&stats->total_runtime_ns, runtime);
+                STAT_ADD(stats->total_runtime_ns, runtime);
             }
-            __sync_fetch_and_add(&stats->switch_count, 1);
+            STAT_ADD(stats->switch_count, 1);
             
             /* Check if voluntary (prev_state != TASK_RUNNING) */
             if (ctx->prev_state != 0) {
-                __sync_fetch_and_add(&stats->voluntary_switches, 1);
+                STAT_ADD(stats->voluntary_switches, 1);
             } else {
-                __sync_fetch_and_add(&stats->involuntary_switches, 1);
+                STAT_ADD(stats->involuntary_switches, 1);
             }
         }
     }
@@ -132,7 +134,7 @@ int trace_sched_wakeup(struct trace_event_raw_sched_wakeup_template *ctx)
         new_stats.last_switch_time = now;
         bpf_map_update_elem(&cpu_stats_map, &pid, &new_stats, BPF_ANY);
     } else {
-        __sync_fetch_and_add(&stats->wakeup_count, 1);
+        STAT_ADD(stats->wakeup_count, 1);
     }
 
     return 0;
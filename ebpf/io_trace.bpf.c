@@ -4,8 +4,9 @@
  *
  * Monitors I/O-related events:
  * - Block I/O requests
- * - Syscalls (read/write)
+ * - Syscalls (read/write), optionally filtered by PID allowlist or cgroup
  * - I/O completion latency
+ * - Per-PID log2 histograms of syscall size and latency
  */
 
 #include "vmlinux.h"
@@ -13,6 +14,8 @@
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
 
+#include "common.bpf.h"
+
 char LICENSE[] SEC("license") = "GPL";
 
 #define MAX_ENTRIES 10240
@@ -24,18 +27,74 @@ struct io_stats {
     u64 read_count;         /* Number of read operations */
     u64 write_count;        /* Number of write operations */
     u64 io_wait_ns;         /* Total I/O wait time */
-    u64 pending_io;         /* Currently pending I/O operations */
+    u64 syscall_ns;         /* Total time spent in read/write */
     u64 last_io_time;       /* Last I/O timestamp */
 };
 
+/* Syscall filter modes (io_filter_cfg.mode) */
+#define IO_FILTER_ALL     0   /* Trace every process */
+#define IO_FILTER_PID     1   /* Only PIDs present in pid_allowlist */
+#define IO_FILTER_CGROUP  2   /* Only tasks in cgroup_id (cgroup v2) */
+
+struct io_filter_cfg {
+    u32 mode;
+    u32 reserved;
+    u64 cgroup_id;
+};
+
+/* log2 buckets: slot n counts values in [2^n, 2^(n+1)) */
+#define IO_HIST_SLOTS 32
+#define IO_HIST_ENTRIES 4096
+
+struct io_hist {
+    u64 size[IO_HIST_SLOTS];      /* Bytes per read/write */
+    u64 latency[IO_HIST_SLOTS];   /* ns per read/write */
+};
+
 /* Map for I/O statistics */
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(type, STATS_MAP_TYPE);
     __uint(max_entries, MAX_ENTRIES);
     __type(key, u32);
     __type(value, struct io_stats);
 } io_stats_map SEC(".maps");
 
+/* Single-entry filter configuration */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, u32);
+    __type(value, struct io_filter_cfg);
+} io_filter_map SEC(".maps");
+
+/* PIDs traced in IO_FILTER_PID mode */
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 1024);
+    __type(key, u32);
+    __type(value, u8);
+} pid_allowlist SEC(".maps");
+
+/* Syscall start time per thread, for latency */
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, u32);   /* TID */
+    __type(value, u64);
+} io_start_map SEC(".maps");
+
+/*
+ * Size/latency histograms per PID; LRU so idle PIDs make room. Shared
+ * with atomic adds even in the per-CPU build: 2 MB here would be
+ * 2 MB x nr_cpus as a per-CPU map.
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, IO_HIST_ENTRIES);
+    __type(key, u32);
+    __type(value, struct io_hist);
+} io_hist_map SEC(".maps");
+
 /* Map to track pending I/O for latency calculation */
 struct {
     __uint(type, BPF_MAP_TYPE_HASH);
@@ -55,55 +114,144 @@ struct {
 #define IO_EVENT_SYNC   3
 
 /*
- * Tracepoint: syscalls/sys_enter_read
- * Track read syscall entry
+ * Syscall filter, set by user space before attaching
+ * Filtered-out tasks cost one array lookup per syscall and touch no
+ * hash map at all.
  */
-SEC("tracepoint/syscalls/sys_enter_read")
-int trace_read_enter(struct trace_event_raw_sys_enter *ctx)
+static __always_inline bool io_should_trace(u32 pid)
 {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
+    u32 zero = 0;
+    struct io_filter_cfg *cfg = bpf_map_lookup_elem(&io_filter_map, &zero);
+    
+    if (!cfg || cfg->mode == IO_FILTER_ALL)
+        return true;
+    if (cfg->mode == IO_FILTER_PID)
+        return bpf_map_lookup_elem(&pid_allowlist, &pid) != NULL;
+    if (cfg->mode == IO_FILTER_CGROUP)
+        return bpf_get_current_cgroup_id() == cfg->cgroup_id;
+    return false;
+}
+
+/* Branch-light log2 so the verifier sees a bounded result */
+static __always_inline u32 log2_u32(u32 v)
+{
+    u32 r, shift;
+    
+    r = (v > 0xFFFF) << 4; v >>= r;
+    shift = (v > 0xFF) << 3; v >>= shift; r |= shift;
+    shift = (v > 0xF) << 2; v >>= shift; r |= shift;
+    shift = (v > 0x3) << 1; v >>= shift; r |= shift;
+    r |= (v >> 1);
+    return r;
+}
+
+static __always_inline u32 io_hist_slot(u64 v)
+{
+    u32 hi = v >> 32;
+    u32 slot = hi ? log2_u32(hi) + 32 : log2_u32((u32)v);
+    
+    return slot < IO_HIST_SLOTS ? slot : IO_HIST_SLOTS - 1;
+}
+
+/* Common syscall entry: remember when this thread started the call */
+static __always_inline int io_syscall_enter(void)
+{
+    u64 id = bpf_get_current_pid_tgid();
+    u32 pid = id >> 32;
+    u32 tid = (u32)id;
+    u64 ts;
+    
+    if (pid == 0 || !io_should_trace(pid))
+        return 0;
+    
+    ts = bpf_ktime_get_ns();
+    bpf_map_update_elem(&io_start_map, &tid, &ts, BPF_ANY);
+    return 0;
+}
+
+/*
+ * Common syscall exit: fold the call into the per-PID totals and
+ * the size/latency histograms
+ */
+static __always_inline int io_syscall_exit(long ret, bool is_write)
+{
+    u64 id = bpf_get_current_pid_tgid();
+    u32 pid = id >> 32;
+    u32 tid = (u32)id;
+    u64 *start_ts, now, latency;
     struct io_stats *stats;
-    struct io_stats new_stats = {};
+    struct io_hist *hist;
+    
+    start_ts = bpf_map_lookup_elem(&io_start_map, &tid);
+    if (!start_ts)
+        return 0;   /* Filtered out, or entered before we attached */
     
-    if (pid == 0)
+    now = bpf_ktime_get_ns();
+    latency = now - *start_ts;
+    bpf_map_delete_elem(&io_start_map, &tid);
+    
+    if (ret < 0)
         return 0;
     
     stats = bpf_map_lookup_elem(&io_stats_map, &pid);
     if (!stats) {
-        new_stats.read_count = 1;
-        new_stats.last_io_time = bpf_ktime_get_ns();
-        bpf_map_update_elem(&io_stats_map, &pid, &new_stats, BPF_ANY);
+        struct io_stats new_stats = {};
+        
+        if (is_write) {
+            new_stats.write_count = 1;
+            new_stats.write_bytes = ret;
+        } else {
+            new_stats.read_count = 1;
+            new_stats.read_bytes = ret;
+        }
+        new_stats.syscall_ns = latency;
+        new_stats.last_io_time = now;
+        bpf_map_update_elem(&io_stats_map, &pid, &new_stats, BPF_NOEXIST);
     } else {
-        __sync_fetch_and_add(&stats->read_count, 1);
-        __sync_fetch_and_add(&stats->pending_io, 1);
-        stats->last_io_time = bpf_ktime_get_ns();
+        if (is_write) {
+            STAT_ADD(stats->write_count, 1);
+            STAT_ADD(stats->write_bytes, ret);
+        } else {
+            STAT_ADD(stats->read_count, 1);
+            STAT_ADD(stats->read_bytes, ret);
+        }
+        STAT_ADD(stats->syscall_ns, latency);
+        stats->last_io_time = now;
+    }
+    
+    hist = bpf_map_lookup_elem(&io_hist_map, &pid);
+    if (!hist) {
+        struct io_hist zero = {};
+        
+        bpf_map_update_elem(&io_hist_map, &pid, &zero, BPF_NOEXIST);
+        hist = bpf_map_lookup_elem(&io_hist_map, &pid);
+        if (!hist)
+            return 0;
     }
+    __sync_fetch_and_add(&hist->size[io_hist_slot(ret)], 1);
+    __sync_fetch_and_add(&hist->latency[io_hist_slot(latency)], 1);
     
     return 0;
 }
 
+/*
+ * Tracepoint: syscalls/sys_enter_read
+ * Track read syscall entry
+ */
+SEC("tracepoint/syscalls/sys_enter_read")
+int trace_read_enter(struct trace_event_raw_sys_enter *ctx)
+{
+    return io_syscall_enter();
+}
+
 /*
  * Tracepoint: syscalls/sys_exit_read
- * Track read syscall completion and bytes
+ * Track read syscall completion, bytes and latency
  */
 SEC("tracepoint/syscalls/sys_exit_read")
 int trace_read_exit(struct trace_event_raw_sys_exit *ctx)
 {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    struct io_stats *stats;
-    long ret = ctx->ret;
-    
-    if (pid == 0 || ret < 0)
-        return 0;
-    
-    stats = bpf_map_lookup_elem(&io_stats_map, &pid);
-    if (stats) {
-        __sync_fetch_and_add(&stats->read_bytes, ret);
-        if (stats->pending_io > 0)
-            __sync_fetch_and_sub(&stats->pending_io, 1);
-    }
-    
-    return 0;
+    return io_syscall_exit(ctx->ret, false);
 }
 
 /*
@@ -113,49 +261,17 @@ int trace_read_exit(struct trace_event_raw_sys_exit *ctx)
 SEC("tracepoint/syscalls/sys_enter_write")
 int trace_write_enter(struct trace_event_raw_sys_enter *ctx)
 {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    struct io_stats *stats;
-    struct io_stats new_stats = {};
-    
-    if (pid == 0)
-        return 0;
-    
-    stats = bpf_map_lookup_elem(&io_stats_map, &pid);
-    if (!stats) {
-        new_stats.write_count = 1;
-        new_stats.last_io_time = bpf_ktime_get_ns();
-        bpf_map_update_elem(&io_stats_map, &pid, &new_stats, BPF_ANY);
-    } else {
-        __sync_fetch_and_add(&stats->write_count, 1);
-        __sync_fetch_and_add(&stats->pending_io, 1);
-        stats->last_io_time = bpf_ktime_get_ns();
-    }
-    
-    return 0;
+    return io_syscall_enter();
 }
 
 /*
  * Tracepoint: syscalls/sys_exit_write
- * Track write syscall completion and bytes
+ * Track write syscall completion, bytes and latency
  */
 SEC("tracepoint/syscalls/sys_exit_write")
 int trace_write_exit(struct trace_event_raw_sys_exit *ctx)
 {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    struct io_stats *stats;
-    long ret = ctx->ret;
-    
-    if (pid == 0 || ret < 0)
-        return 0;
-    
-    stats = bpf_map_lookup_elem(&io_stats_map, &pid);
-    if (stats) {
-        __sync_fetch_and_add(&stats->write_bytes, ret);
-        if (stats->pending_io > 0)
-            __sync_fetch_and_sub(&stats->pending_io, 1);
-    }
-    
-    return 0;
+    return io_syscall_exit(ctx->ret, true);
 }
 
 /*
@@ -169,7 +285,7 @@ int trace_block_rq_issue(struct trace_event_raw_block_rq *ctx)
     u64 ts = bpf_ktime_get_ns();
     u64 key = (u64)ctx; /* Use context as unique key */
     
-    bpf_map_update_elem(&pending_io_map, &key, &ts, BPP_ANY);
+    bpf_map_update_elem(&pending_io_map, &key, &ts, BPF_ANY);
     
     return 0;
 }
@@ -193,7 +309,7 @@ int trace_block_rq_complete(struct trace_event_raw_block_rq *ctx)
         
         stats = bpf_map_lookup_elem(&io_stats_map, &pid);
         if (stats) {
-            __sync_fetch_and_add(&stats->io_wait_ns, latency);
+            STAT_ADD(stats->io_wait_ns, latency);
         }
         
         bpf_map_delete_elem(&pending_io_map, &key);
@@ -209,6 +325,8 @@ SEC("tracepoint/sched/sched_process_exit")
 int trace_io_process_exit(struct trace_event_raw_sched_process_template *ctx)
 {
     u32 pid = ctx->pid;
+    bpf_map_delete_elem(&io_start_map, &pid);
     bpf_map_delete_elem(&io_stats_map, &pid);
+    bpf_map_delete_elem(&io_hist_map, &pid);
     return 0;
 }
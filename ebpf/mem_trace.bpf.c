@@ -3,9 +3,9 @@
  * SmartScheduler eBPF Memory Tracing Program
  *
  * Monitors memory-related events:
- * - Page faults (minor and major)
+ * - Page faults: every user fault, and the major ones that needed I/O
  * - Memory allocations
- * - RSS changes
+ * - RSS changes, by kind (file / anon / swap / shmem)
  */
 
 #include "vmlinux.h"
@@ -13,13 +13,15 @@
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
 
+#include "common.bpf.h"
+
 char LICENSE[] SEC("license") = "GPL";
 
 #define MAX_ENTRIES 10240
 
 /* Memory statistics per process */
 struct mem_stats {
-    u64 minor_faults;       /* Minor page faults */
+    u64 minor_faults;       /* User page faults (includes major ones) */
     u64 major_faults;       /* Major page faults (disk I/O) */
     u64 alloc_count;        /* Memory allocation count */
     u64 alloc_bytes;        /* Total bytes allocated */
@@ -29,12 +31,43 @@ struct mem_stats {
 
 /* BPF map for memory statistics */
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(type, STATS_MAP_TYPE);
     __uint(max_entries, MAX_ENTRIES);
     __type(key, u32);
     __type(value, struct mem_stats);
 } mem_stats_map SEC(".maps");
 
+/*
+ * Resident memory per process in bytes, indexed by the kernel's mm
+ * counter (MM_FILEPAGES, MM_ANONPAGES, MM_SWAPENTS, MM_SHMEMPAGES).
+ * Values are absolute, so this is always a shared map: the latest
+ * writer wins. valid has a bit per counter reported since attach.
+ */
+#define RSS_MEMBERS 4
+
+struct rss_stats {
+    u64 bytes[RSS_MEMBERS];
+    u64 valid;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, u32);
+    __type(value, struct rss_stats);
+} rss_map SEC(".maps");
+
+/*
+ * mm_id -> owning process, learnt while the owner itself changes its
+ * RSS, so updates made from other contexts (reclaim) can be attributed
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, u32);
+    __type(value, u32);
+} mm_owner_map SEC(".maps");
+
 /* Ring buffer for memory events */
 struct {
     __uint(type, BPF_MAP_TYPE_RINGBUF);
@@ -77,7 +110,7 @@ int trace_page_fault(struct trace_event_raw_page_fault_user *ctx)
         new_stats.last_fault_time = now;
         bpf_map_update_elem(&mem_stats_map, &pid, &new_stats, BPF_ANY);
     } else {
-        __sync_fetch_and_add(&stats->minor_faults, 1);
+        STAT_ADD(stats->minor_faults, 1);
         
         /* Calculate fault rate (simple) */
         if (stats->last_fault_time > 0) {
@@ -92,32 +125,73 @@ int trace_page_fault(struct trace_event_raw_page_fault_user *ctx)
     return 0;
 }
 
+/* handle_mm_fault() result bit for a fault that needed I/O */
+#define VM_FAULT_MAJOR 0x000004
+
 /*
- * Kprobe: handle_mm_fault
- * Track all page fault handling
+ * Kretprobe: handle_mm_fault
+ * Count major faults from the fault result; the page_fault_user
+ * tracepoint already counts every fault
  */
-SEC("kprobe/handle_mm_fault")
-int BPF_KPROBE(trace_mm_fault, struct vm_area_struct *vma, 
-               unsigned long address, unsigned int flags)
+SEC("kretprobe/handle_mm_fault")
+int BPF_KRETPROBE(trace_mm_fault_ret, unsigned int ret)
 {
     u32 pid = bpf_get_current_pid_tgid() >> 32;
     struct mem_stats *stats;
     struct mem_stats new_stats = {};
     
-    if (pid == 0)
+    if (pid == 0 || !(ret & VM_FAULT_MAJOR))
         return 0;
     
     stats = bpf_map_lookup_elem(&mem_stats_map, &pid);
     if (!stats) {
-        new_stats.minor_faults = 1;
+        new_stats.major_faults = 1;
         bpf_map_update_elem(&mem_stats_map, &pid, &new_stats, BPF_ANY);
     } else {
-        /* Check if major fault (FAULT_FLAG_ALLOW_RETRY usually set) */
-        if (flags & 0x04) { /* FAULT_FLAG_ALLOW_RETRY */
-            __sync_fetch_and_add(&stats->major_faults, 1);
-        } else {
-            __sync_fetch_and_add(&stats->minor_faults, 1);
-        }
+        STAT_ADD(stats->major_faults, 1);
+    }
+    
+    return 0;
+}
+
+/*
+ * Tracepoint: kmem/rss_stat
+ * Fires when an mm's RSS counter moves, with its new value in bytes
+ */
+SEC("tracepoint/kmem/rss_stat")
+int trace_rss_stat(struct trace_event_raw_rss_stat *ctx)
+{
+    u32 mm_id = ctx->mm_id;
+    int member = ctx->member;
+    struct rss_stats *rss;
+    struct rss_stats new_rss = {};
+    u32 pid, *owner;
+    
+    if (member < 0 || member >= RSS_MEMBERS)
+        return 0;
+    
+    if (ctx->curr) {
+        pid = bpf_get_current_pid_tgid() >> 32;
+        if (pid == 0)
+            return 0;
+        owner = bpf_map_lookup_elem(&mm_owner_map, &mm_id);
+        if (!owner || *owner != pid)
+            bpf_map_update_elem(&mm_owner_map, &mm_id, &pid, BPF_ANY);
+    } else {
+        owner = bpf_map_lookup_elem(&mm_owner_map, &mm_id);
+        if (!owner)
+            return 0;
+        pid = *owner;
+    }
+    
+    rss = bpf_map_lookup_elem(&rss_map, &pid);
+    if (!rss) {
+        new_rss.bytes[member & (RSS_MEMBERS - 1)] = ctx->size;
+        new_rss.valid = 1ULL << member;
+        bpf_map_update_elem(&rss_map, &pid, &new_rss, BPF_ANY);
+    } else {
+        rss->bytes[member & (RSS_MEMBERS - 1)] = ctx->size;
+        __sync_fetch_and_or(&rss->valid, 1ULL << member);
     }
     
     return 0;
@@ -138,9 +212,9 @@ int trace_page_alloc(struct trace_event_raw_mm_page_alloc *ctx)
     
     stats = bpf_map_lookup_elem(&mem_stats_map, &pid);
     if (stats) {
-        __sync_fetch_and_add(&stats->alloc_count, 1);
+        STAT_ADD(stats->alloc_count, 1);
         /* order is log2 of pages, so bytes = PAGE_SIZE << order */
-        __sync_fetch_and_add(&stats->alloc_bytes, 4096ULL << ctx->order);
+        STAT_ADD(stats->alloc_bytes, 4096ULL << ctx->order);
     }
     
     return 0;
@@ -154,5 +228,6 @@ int trace_mem_process_exit(struct trace_event_raw_sched_process_template *ctx)
 {
     u32 pid = ctx->pid;
     bpf_map_delete_elem(&mem_stats_map, &pid);
+    bpf_map_delete_elem(&rss_map, &pid);
     return 0;
 }
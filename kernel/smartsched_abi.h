@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * SmartScheduler User-Space ABI
+ *
+ * Binary interfaces shared by the kernel module and the user-space
+ * tools. All layouts are fixed-size and versioned: any change to a
+ * structure below must bump SMARTSCHED_ABI_VERSION.
+ *
+ * Snapshot (/dev/smartsched, mmap read-only), column-major:
+ *   [struct smartsched_snapshot_header][column 0][column 1]...
+ *
+ * Each SMARTSCHED_COL_* column holds capacity elements of its type at
+ * header.columns[id].offset; row i of the snapshot is element i of
+ * every column. Rows are signature slots: only rows flagged
+ * SMARTSCHED_FLAG_ACTIVE hold a signature, and thread signatures
+ * (SMARTSCHED_FLAG_THREAD) are listed alongside processes.
+ *
+ * The module republishes the snapshot after every sampling tick under
+ * a sequence counter: readers copy the rows they need, then retry if
+ * the counter was odd or changed meanwhile.
+ *
+ * Events (/proc/smartscheduler/events, read + poll):
+ *   a stream of struct smartsched_event on spike flag edges: one
+ *   SPIKE when a resource's flag rises, one CLEAR when it drops, and
+ *   nothing while it is held (the snapshot's history and since_ns
+ *   columns say how long a held spike has lasted).
+ *   Reads return whole events only; each open file starts at the
+ *   newest event and sees everything published afterwards.
+ *
+ * Spike history: every signature keeps, per resource, a bitmap of its
+ * spike flag over the last SMARTSCHED_HISTORY_TICKS sampling ticks
+ * (bit 0 = latest) and the time the current run of flagged ticks
+ * began. Both are in the snapshot and in every event, so consumers
+ * judge persistence without polling and diffing themselves. Ticks a
+ * signature was not sampled in (adaptive sampling) count as unflagged
+ * and are shifted in when it is next sampled.
+ *
+ * Warm start (/dev/smartsched, write, CAP_SYS_ADMIN):
+ *   an array of struct smartsched_seed, whole records only, usually
+ *   saved from a snapshot before the module was reloaded. From the
+ *   next tick, and for SMARTSCHED_SEED_TTL_TICKS ticks, a signature
+ *   still in its first SMARTSCHED_SEED_TTL_TICKS samples whose pid,
+ *   kind and start time match a seed takes over its EMAs, spike
+ *   counts and history, and is flagged SMARTSCHED_FLAG_WARM. Each
+ *   write queues more seeds for the same tick.
+ */
+
+#ifndef _SMARTSCHED_ABI_H
+#define _SMARTSCHED_ABI_H
+
+#include <linux/types.h>
+
+#define SMARTSCHED_DEV_PATH        "/dev/smartsched"
+#define SMARTSCHED_SNAPSHOT_MAGIC  0x53534e50   /* "SSNP" */
+#define SMARTSCHED_ABI_VERSION     4
+
+#define SMARTSCHED_COMM_LEN        16
+
+/* Prediction flags (same bits as /proc/smartscheduler/predictions) */
+#define SMARTSCHED_FLAG_CPU_SPIKE  (1 << 0)
+#define SMARTSCHED_FLAG_MEM_SPIKE  (1 << 1)
+#define SMARTSCHED_FLAG_IO_SPIKE   (1 << 2)
+#define SMARTSCHED_FLAG_CPU_FORECAST (1 << 3)  /* Trend reaches a spike within the horizon */
+#define SMARTSCHED_FLAG_MEM_FORECAST (1 << 4)
+#define SMARTSCHED_FLAG_IO_FORECAST  (1 << 5)
+#define SMARTSCHED_FLAG_THREAD     (1 << 6)  /* Thread signature (thread_mode), pid is the TID */
+#define SMARTSCHED_FLAG_ACTIVE     (1 << 7)  /* Row holds a signature */
+#define SMARTSCHED_FLAG_SPLIT      (1 << 8)  /* Process whose CPU is tracked per thread */
+#define SMARTSCHED_FLAG_WARM       (1 << 9)  /* State restored from a struct smartsched_seed */
+
+/* Snapshot columns, in mapping order */
+enum {
+    SMARTSCHED_COL_PID,          /* __s32 */
+    SMARTSCHED_COL_FLAGS,        /* __u32, SMARTSCHED_FLAG_* */
+
+    /* __s32 by SMARTSCHED_RES_*, procfs scaling (x100) */
+    SMARTSCHED_COL_CPU_EMA,
+    SMARTSCHED_COL_MEM_EMA,
+    SMARTSCHED_COL_IO_EMA,
+    SMARTSCHED_COL_CPU_ROC,
+    SMARTSCHED_COL_MEM_ROC,
+    SMARTSCHED_COL_IO_ROC,
+
+    /*
+     * __s32, raw samples fed to the model on the last tick (mem:
+     * smartsched_mem_sample()), clamped to 0..INT_MAX / 100 so the
+     * EMA's x100 weighting cannot overflow (~21 TB of memory)
+     */
+    SMARTSCHED_COL_CPU_SAMPLE,
+    SMARTSCHED_COL_MEM_SAMPLE,
+    SMARTSCHED_COL_IO_SAMPLE,
+
+    SMARTSCHED_COL_HOT_TID,      /* __s32, busiest thread last tick (thread_mode), else 0 */
+
+    /* __u8, ticks to a forecast spike, 0 = none */
+    SMARTSCHED_COL_CPU_ETA,
+    SMARTSCHED_COL_MEM_ETA,
+    SMARTSCHED_COL_IO_ETA,
+
+    SMARTSCHED_COL_START_TIME,   /* __u64 ns, process start, tells reused PIDs apart */
+    SMARTSCHED_COL_TOTAL_SAMPLES, /* __u64 */
+
+    /* __u64, lifetime spikes predicted */
+    SMARTSCHED_COL_CPU_SPIKES,
+    SMARTSCHED_COL_MEM_SPIKES,
+    SMARTSCHED_COL_IO_SPIKES,
+
+    /* __u64, spike flag of the last SMARTSCHED_HISTORY_TICKS ticks, bit 0 = latest */
+    SMARTSCHED_COL_CPU_HISTORY,
+    SMARTSCHED_COL_MEM_HISTORY,
+    SMARTSCHED_COL_IO_HISTORY,
+
+    /* __u64 CLOCK_MONOTONIC ns, first tick of the current spike, 0 = none */
+    SMARTSCHED_COL_CPU_SINCE,
+    SMARTSCHED_COL_MEM_SINCE,
+    SMARTSCHED_COL_IO_SINCE,
+
+    SMARTSCHED_COL_COMM,         /* char[SMARTSCHED_COMM_LEN] */
+    SMARTSCHED_NR_COLUMNS
+};
+
+/* Per-resource columns are consecutive, indexed by SMARTSCHED_RES_* */
+#define SMARTSCHED_COL_EMA(res)    (SMARTSCHED_COL_CPU_EMA + (res))
+#define SMARTSCHED_COL_ROC(res)    (SMARTSCHED_COL_CPU_ROC + (res))
+#define SMARTSCHED_COL_SAMPLE(res) (SMARTSCHED_COL_CPU_SAMPLE + (res))
+#define SMARTSCHED_COL_ETA(res)    (SMARTSCHED_COL_CPU_ETA + (res))
+#define SMARTSCHED_COL_SPIKES(res) (SMARTSCHED_COL_CPU_SPIKES + (res))
+#define SMARTSCHED_COL_HISTORY(res) (SMARTSCHED_COL_CPU_HISTORY + (res))
+#define SMARTSCHED_COL_SINCE(res)  (SMARTSCHED_COL_CPU_SINCE + (res))
+
+#define SMARTSCHED_HISTORY_TICKS   64
+
+/* Ticks flagged within the history window */
+static inline unsigned int smartsched_history_ticks(__u64 history)
+{
+    return __builtin_popcountll(history);
+}
+
+/* Consecutive flagged ticks up to and including the latest */
+static inline unsigned int smartsched_history_streak(__u64 history)
+{
+    return ~history ? __builtin_ctzll(~history) : SMARTSCHED_HISTORY_TICKS;
+}
+
+/* Where one column lives in the mapping */
+struct smartsched_column {
+    __u32 offset;                /* From the start of the mapping, cache-line aligned */
+    __u32 size;                  /* Bytes per element */
+};
+
+/* Snapshot header at offset 0 of the mapping */
+struct smartsched_snapshot_header {
+    __u32 magic;                 /* SMARTSCHED_SNAPSHOT_MAGIC */
+    __u32 version;               /* SMARTSCHED_ABI_VERSION */
+    __u32 header_size;           /* Offset of the first column */
+    __u32 nr_columns;            /* SMARTSCHED_NR_COLUMNS */
+    __u32 capacity;              /* Rows each column can hold */
+    __u32 nr_records;            /* Rows valid in this snapshot, not all ACTIVE */
+    __u32 seq;                   /* Even = stable, odd = being rewritten */
+    __u32 sample_interval_ms;
+    __u64 generation;            /* Sampler tick that produced it */
+    __u64 timestamp_ns;          /* CLOCK_MONOTONIC when published */
+    __u64 map_size;              /* Bytes to map */
+    __u64 reserved;
+    struct smartsched_column columns[SMARTSCHED_NR_COLUMNS];
+};
+
+/*
+ * One row gathered from the columns, as ss_snapshot_read() returns it;
+ * EMA/RoC values use the procfs scaling (x100)
+ */
+struct smartsched_record {
+    __s32 pid;
+    __u32 flags;
+
+    __s32 cpu_ema;
+    __s32 mem_ema;
+    __s32 io_ema;
+
+    __s32 cpu_roc;
+    __s32 mem_roc;
+    __s32 io_roc;
+
+    __s32 cpu_sample;
+    __s32 mem_sample;
+    __s32 io_sample;
+    __s32 hot_tid;
+    __u8 forecast_eta[4];        /* By SMARTSCHED_RES_* */
+    __u32 reserved;
+
+    __u64 start_time_ns;
+    __u64 total_samples;
+    __u64 cpu_spikes;
+    __u64 mem_spikes;
+    __u64 io_spikes;
+
+    __u64 spike_history[3];      /* By SMARTSCHED_RES_* */
+    __u64 spike_since_ns[3];
+
+    char comm[SMARTSCHED_COMM_LEN];
+};
+
+#define SMARTSCHED_SEED_TTL_TICKS  16
+
+/* Saved state of one signature, written to /dev/smartsched */
+struct smartsched_seed {
+    __s32 pid;
+    __u32 flags;                 /* SMARTSCHED_FLAG_THREAD for a thread signature */
+    __u64 start_time_ns;         /* Must match the task's */
+    __u64 saved_ns;              /* CLOCK_MONOTONIC of the snapshot it was saved from */
+    __u32 interval_ms;           /* That snapshot's sample interval, ages the history */
+    __s32 ema[3];                /* By SMARTSCHED_RES_* */
+    __u64 total_samples;
+    __u64 spikes[3];
+    __u64 spike_history[3];
+};
+
+/* Event resources */
+#define SMARTSCHED_RES_CPU         0
+#define SMARTSCHED_RES_MEM         1
+#define SMARTSCHED_RES_IO          2
+
+/* Event types */
+#define SMARTSCHED_EVENT_SPIKE     1   /* Spike flag raised, once per spike */
+#define SMARTSCHED_EVENT_CLEAR     2   /* Spike flag dropped */
+#define SMARTSCHED_EVENT_OVERRUN   3   /* Reader fell behind; roc = events lost */
+
+#define SMARTSCHED_EVENTS_PATH     "/proc/smartscheduler/events"
+
+/* Spike notification pushed by the sampler */
+struct smartsched_event {
+    __u64 seq;                   /* Position in the stream, gaps mean loss */
+    __u64 timestamp_ns;          /* CLOCK_MONOTONIC of the sampling tick */
+    __s32 pid;
+    __u16 resource;              /* SMARTSCHED_RES_* */
+    __u16 type;                  /* SMARTSCHED_EVENT_* */
+    __s32 roc;                   /* Rate of change that caused it (x100) */
+    __s32 ema;                   /* EMA at that tick (x100) */
+    char comm[SMARTSCHED_COMM_LEN];
+    __u64 history;               /* The resource's spike history, bit 0 = this tick */
+    __u64 since_ns;              /* Start of the spike; for CLEAR, of the one that ended */
+};
+
+#endif /* _SMARTSCHED_ABI_H */
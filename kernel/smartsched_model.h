@@ -0,0 +1,288 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * SmartScheduler Prediction Model
+ *
+ * The EMA / rate-of-change / threshold logic applied to every sample,
+ * shared by the kernel module, the eBPF collector and the offline
+ * replay tool so all three make identical predictions. Integer math
+ * only, no allocation, and no kernel- or libc-specific calls.
+ *
+ * One resource is stepped at a time:
+ *
+ *   prev = ema
+ *   ema  = (alpha * sample + (100 - alpha) * ema) / 100
+ *   roc  = ema - prev
+ *   spike predicted if roc > threshold
+ *
+ * Resources are indexed by SMARTSCHED_RES_* and a resource's flag bit
+ * is (1 << res), matching SMARTSCHED_FLAG_*_SPIKE. The memory sample
+ * itself is built by smartsched_mem_sample() so every collector feeds
+ * the model the same signal.
+ *
+ * smartsched_model_step_batch() does the same for a whole array of
+ * signatures of one resource at a time.
+ *
+ * A signature's EMA starts out at its first valid sample of each
+ * resource, not at 0: every collector sets ema = sample just before
+ * that step, which then reads no change. Stepping up from 0 instead
+ * looks like a rise over the first few ticks (I/O counts are
+ * cumulative), so every process would be flagged when a collector
+ * starts.
+ *
+ * Alongside it, smartsched_forecast_step() runs a Holt (level + trend)
+ * predictor with an EWMA of its squared one-step error, and raises
+ * SMARTSCHED_FLAG_*_FORECAST when the trend reaches k sigma above the
+ * level within the horizon; see there.
+ */
+
+#ifndef _SMARTSCHED_MODEL_H
+#define _SMARTSCHED_MODEL_H
+
+#include "smartsched_abi.h"
+
+/*
+ * __s64 by 32-bit division: a plain '/' would pull in libgcc's
+ * __divdi3, which 32-bit kernels do not link against
+ */
+#ifdef __KERNEL__
+#include <linux/math64.h>
+#define smartsched_div_s64(a, b)        div_s64((a), (b))
+#else
+#define smartsched_div_s64(a, b)        ((__s64)(a) / (__s32)(b))
+#endif
+
+#define SMARTSCHED_NR_RES               3
+
+/* Defaults, scaled by 100 for integer math */
+#define SMARTSCHED_DEFAULT_ALPHA        30     /* alpha = 0.3 */
+#define SMARTSCHED_DEFAULT_CPU_THRESH   2000   /* 20% increase rate */
+#define SMARTSCHED_DEFAULT_MEM_THRESH   1500   /* 15% increase rate */
+#define SMARTSCHED_DEFAULT_IO_THRESH    1000   /* 10% increase rate */
+
+/* Forecast defaults */
+#define SMARTSCHED_DEFAULT_BETA         20     /* Trend smoothing, beta = 0.2 */
+#define SMARTSCHED_DEFAULT_SIGMA_K      300    /* Rise of 3 sigma, x100 */
+#define SMARTSCHED_DEFAULT_HORIZON      10     /* Ticks looked ahead, 0 = off */
+#define SMARTSCHED_MAX_HORIZON          255    /* ETAs fit a byte */
+
+/* Forecast flag of resource res is 1 << (res + SMARTSCHED_FORECAST_SHIFT) */
+#define SMARTSCHED_FORECAST_SHIFT       3
+
+/* Weight of a new squared error in the variance EWMA: 1 / 8 */
+#define SMARTSCHED_FORECAST_VAR_SHIFT   3
+
+/* Larger one-step errors count as this much, keeping var in 32 bits */
+#define SMARTSCHED_FORECAST_ERR_MAX     0xffff
+
+struct smartsched_model_params {
+    int alpha;                              /* 1..100 */
+    int threshold[SMARTSCHED_NR_RES];       /* Indexed by SMARTSCHED_RES_* */
+    int beta;                               /* 0..100, trend smoothing */
+    int sigma_k;                            /* Forecast rise in sigma, x100 */
+    int horizon;                            /* 0..SMARTSCHED_MAX_HORIZON ticks */
+};
+
+#define SMARTSCHED_MODEL_DEFAULTS {                         \
+    .alpha = SMARTSCHED_DEFAULT_ALPHA,                      \
+    .threshold = {                                          \
+        [SMARTSCHED_RES_CPU] = SMARTSCHED_DEFAULT_CPU_THRESH, \
+        [SMARTSCHED_RES_MEM] = SMARTSCHED_DEFAULT_MEM_THRESH, \
+        [SMARTSCHED_RES_IO]  = SMARTSCHED_DEFAULT_IO_THRESH,  \
+    },                                                      \
+    .beta = SMARTSCHED_DEFAULT_BETA,                        \
+    .sigma_k = SMARTSCHED_DEFAULT_SIGMA_K,                  \
+    .horizon = SMARTSCHED_DEFAULT_HORIZON,                  \
+}
+
+/* Per-resource forecaster state, 12 bytes; all zero = not started */
+struct smartsched_forecast {
+    int level;                              /* Same scale as the samples */
+    int trend;                              /* Level change per tick */
+    __u32 var;                              /* EWMA of squared one-step error */
+};
+
+/*
+ * Largest sample the EMA can weigh in int: alpha * sample +
+ * (100 - alpha) * ema stays within INT_MAX while both are at most this
+ */
+#define SMARTSCHED_SAMPLE_MAX           (0x7fffffff / 100)
+
+/* Memory sample weights, see smartsched_mem_sample() */
+#define SMARTSCHED_MEM_FILE_SHIFT       2      /* Page cache counts 1/4 */
+#define SMARTSCHED_MEM_MAJFLT_WEIGHT    10     /* Per major fault/s: 100/s ~ 10 MB */
+
+/*
+ * Memory sample, MB x100 like the other resources:
+ *
+ *   (anon + shmem + file / 4) in MB x100  +  10 x major faults per second
+ *
+ * Anonymous and shmem pages can only go to swap, so they count in
+ * full; page cache is reclaimable and counts a quarter. Major faults
+ * mean the working set no longer fits, and usually rise before an OOM,
+ * giving the spike flag lead time that RSS alone lacks. Reserved but
+ * untouched address space (total_vm) plays no part. Clamped to
+ * SMARTSCHED_SAMPLE_MAX.
+ */
+static inline int smartsched_mem_sample(__u64 anon_kb, __u64 file_kb, __u64 shmem_kb,
+                                        __u64 majflt_per_sec)
+{
+    __u64 kb = anon_kb + shmem_kb + (file_kb >> SMARTSCHED_MEM_FILE_SHIFT);
+    __u64 sample = ((kb * 100) >> 10) + majflt_per_sec * SMARTSCHED_MEM_MAJFLT_WEIGHT;
+    
+    return sample > SMARTSCHED_SAMPLE_MAX ? SMARTSCHED_SAMPLE_MAX : (int)sample;
+}
+
+/*
+ * Update Exponential Moving Average
+ * EMA = alpha * sample + (1-alpha) * old, alpha scaled by 100
+ */
+static inline int smartsched_update_ema(int alpha, int old_ema, int sample)
+{
+    return (alpha * sample + (100 - alpha) * old_ema) / 100;
+}
+
+/* Difference between the current EMA and the previous one */
+static inline int smartsched_rate_of_change(int current_val, int previous)
+{
+    return current_val - previous;
+}
+
+/* Compare rate-of-change against threshold */
+static inline int smartsched_spike_predicted(int roc, int threshold)
+{
+    return roc > threshold;
+}
+
+/*
+ * Feed one sample of resource res into its EMA / previous / RoC
+ * triple; returns the resource's flag bit if a spike is predicted,
+ * 0 otherwise.
+ */
+static inline unsigned int smartsched_model_step(const struct smartsched_model_params *p,
+                                                 int res, int *ema, int *prev,
+                                                 int *roc, int sample)
+{
+    *prev = *ema;
+    *ema = smartsched_update_ema(p->alpha, *ema, sample);
+    *roc = smartsched_rate_of_change(*ema, *prev);
+
+    return smartsched_spike_predicted(*roc, p->threshold[res]) ? 1u << res : 0;
+}
+
+/*
+ * Step n signatures of one resource at once: element i of each array
+ * is one signature, and flags[i] gets the resource's flag bit ORed in
+ * when a spike is predicted. Identical to n smartsched_model_step()
+ * calls, but branch free over contiguous arrays (the module's slot
+ * columns, or a tick's rows gathered by a collector) so compilers can
+ * vectorise it; user/model_simd.h has explicit AVX2 / NEON versions.
+ */
+static inline void smartsched_model_step_batch(const struct smartsched_model_params *p,
+                                               int res, int *__restrict ema,
+                                               int *__restrict prev, int *__restrict roc,
+                                               const int *__restrict sample,
+                                               __u32 *__restrict flags, unsigned int n)
+{
+    const int alpha = p->alpha, keep = 100 - p->alpha;
+    const int threshold = p->threshold[res];
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        int old = ema[i];
+        int cur = (alpha * sample[i] + keep * old) / 100;
+
+        prev[i] = old;
+        ema[i] = cur;
+        roc[i] = cur - old;
+        flags[i] |= (__u32)(cur - old > threshold) << res;
+    }
+}
+
+/* Integer square root, rounded down */
+static inline __u32 smartsched_isqrt(__u32 x)
+{
+    __u32 r = 0, bit = 1u << 30;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+static inline int smartsched_clamp_int(__s64 v)
+{
+    return v > 0x7fffffff ? 0x7fffffff : v < -0x7fffffff ? -0x7fffffff : (int)v;
+}
+
+/*
+ * Feed one sample of resource res into its forecaster:
+ *
+ *   pred  = level + trend                   (one-step forecast)
+ *   level = alpha * sample + (1 - alpha) * pred
+ *   trend = beta * (level - old level) + (1 - beta) * trend
+ *   var  += (min(|sample - pred|, ERR_MAX)^2 - var) / 8
+ *
+ * A spike is forecast when the level rises by more than
+ * rise = max(k * sqrt(var), threshold[res]) within the horizon:
+ * eta = rise / trend + 1 ticks <= horizon. The sigma term keeps a
+ * noisy process's jitter from counting; the threshold floor stops a
+ * quiet process with no variance from flagging on any upward drift.
+ * Slow ramps whose per-tick RoC never reaches the threshold are
+ * caught once the trend has accumulated.
+ *
+ * Returns the resource's forecast flag bit and sets *eta, or returns
+ * 0 with *eta = 0. The first sample only seeds the level.
+ */
+static inline unsigned int smartsched_forecast_step(const struct smartsched_model_params *p,
+                                                    int res, struct smartsched_forecast *f,
+                                                    int sample, unsigned int *eta)
+{
+    __s64 pred, level, err, rise, ticks;
+    __u64 var;
+
+    *eta = 0;
+    if (!f->level && !f->trend && !f->var) {
+        f->level = sample;
+        return 0;
+    }
+
+    pred = (__s64)f->level + f->trend;
+    level = smartsched_div_s64(p->alpha * (__s64)sample + (100 - p->alpha) * pred, 100);
+    f->trend = smartsched_clamp_int(smartsched_div_s64(p->beta * (level - f->level) +
+                                                       (100 - p->beta) * (__s64)f->trend,
+                                                       100));
+    f->level = smartsched_clamp_int(level);
+
+    err = sample - pred;
+    if (err < 0)
+        err = -err;
+    if (err > SMARTSCHED_FORECAST_ERR_MAX)
+        err = SMARTSCHED_FORECAST_ERR_MAX;
+    var = f->var;
+    var = var - (var >> SMARTSCHED_FORECAST_VAR_SHIFT) +
+          ((__u64)(err * err) >> SMARTSCHED_FORECAST_VAR_SHIFT);
+    f->var = (__u32)var;
+
+    if (p->horizon <= 0 || f->trend <= 0)
+        return 0;
+
+    rise = smartsched_div_s64((__s64)p->sigma_k * smartsched_isqrt(f->var), 100);
+    if (rise < p->threshold[res])
+        rise = p->threshold[res];
+    ticks = smartsched_div_s64(rise, f->trend) + 1;
+    if (ticks > p->horizon)
+        return 0;
+
+    *eta = (unsigned int)ticks;
+    return 1u << (res + SMARTSCHED_FORECAST_SHIFT);
+}
+
+#endif /* _SMARTSCHED_MODEL_H */
@@ -12,17 +12,43 @@
  */
 
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/task.h>
+#include <linux/sched/clock.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/hashtable.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
 #include <linux/spinlock.h>
-#include <linux/timer.h>
+#include <linux/rcupdate.h>
+#include <linux/rculist.h>
+#include <linux/workqueue.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/math64.h>
+#include <linux/ktime.h>
 #include <linux/jiffies.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/version.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
+#include <linux/cgroup.h>
+#include <linux/capability.h>
+#include <linux/sort.h>
+#include <linux/bsearch.h>
+
+#include "smartsched_abi.h"
+#include "smartsched_model.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("SmartScheduler Research Team");
@@ -33,23 +59,71 @@ MODULE_VERSION("1.0");
  * CONFIGURATION PARAMETERS
  * ============================================ */
 
-/* EMA smoothing factor: alpha = 30/100 = 0.3 */
-#define ALPHA 30
-#define ALPHA_COMPLEMENT (100 - ALPHA)
-
-/* Prediction thresholds (scaled by 100 for integer math) */
-#define CPU_SPIKE_THRESHOLD    2000   /* 20% increase rate */
-#define MEM_SPIKE_THRESHOLD    1500   /* 15% increase rate */
-#define IO_SPIKE_THRESHOLD     1000   /* 10% increase rate */
+/*
+ * EMA smoothing factor and prediction thresholds: see
+ * smartsched_model.h for the defaults and the update rule. These and
+ * the sampling interval can be changed at runtime, see RUNTIME
+ * CONFIGURATION below.
+ */
 
 /* Hash table size: 2^10 = 1024 buckets */
 #define PROC_HASH_BITS 10
 
-/* Sampling interval in milliseconds */
+/* Default sampling interval in milliseconds, and its tunable range */
 #define SAMPLE_INTERVAL_MS 100
+#define SAMPLE_INTERVAL_MIN_MS 10
+#define SAMPLE_INTERVAL_MAX_MS 60000
 
-/* Maximum tracked processes */
+/* Default maximum tracked processes, and its load-time range */
 #define MAX_TRACKED_PROCS 4096
+#define MAX_TRACKED_MIN 64
+#define MAX_TRACKED_MAX (1U << 20)
+
+/*
+ * Adaptive sampling: a signature whose rates of change stay at zero for
+ * idle_samples samples drops one tier; tier t is sampled every
+ * 1 << (t * ADAPT_TIER_SHIFT) ticks (1, 4, 16, 64 by default).
+ */
+#define ADAPT_IDLE_SAMPLES 10
+#define ADAPT_NR_TIERS 4
+#define ADAPT_TIER_SHIFT 2
+
+/* Cgroup signatures: hash size, table capacity, stored path length */
+#define CGROUP_HASH_BITS 8
+#define MAX_TRACKED_CGROUPS 1024
+#define CGROUP_PATH_LEN 128
+
+/* Longest write accepted by /proc/smartscheduler/config */
+#define CONFIG_WRITE_MAX 256
+
+/* Maximum number of sampling shards (must be a power of two) */
+#define SAMPLE_MAX_SHARDS 64
+
+/* Sweep for exited processes every N ticks */
+#define EVICT_SWEEP_TICKS 10
+
+/* LRU eviction when the table is full: victims per shard per tick */
+#define EVICT_LRU_BATCH 8
+
+/* Only evict signatures idle for at least this long */
+#define EVICT_LRU_MIN_IDLE_MS 5000
+
+/* Spike event ring size (power of two) */
+#define EVENT_RING_BITS 13
+#define EVENT_RING_SIZE (1U << EVENT_RING_BITS)
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
+/* Sampler instrumentation: log2 nanosecond histogram slots */
+#define PERF_HIST_SLOTS 32
+
+/* Rows kept per order by /proc/smartscheduler/top */
+#define TOP_K 100
+
+/* Signature table views: seq_file position is bucket << shift | slot */
+#define SIG_ITER_SHIFT 32
+
+/* Due slots stepped together by one model batch */
+#define SIG_BATCH 64
 
 /* ============================================
  * DATA STRUCTURES
@@ -59,424 +133,3540 @@ MODULE_VERSION("1.0");
 #define FLAG_CPU_SPIKE_PREDICTED  (1 << 0)
 #define FLAG_MEM_SPIKE_PREDICTED  (1 << 1)
 #define FLAG_IO_SPIKE_PREDICTED   (1 << 2)
+#define FLAG_CPU_SPIKE_FORECAST   (1 << 3)   /* Holt trend, see sig_cols.eta */
+#define FLAG_MEM_SPIKE_FORECAST   (1 << 4)
+#define FLAG_IO_SPIKE_FORECAST    (1 << 5)
+#define FLAG_THREAD               (1 << 6)   /* Thread signature */
 #define FLAG_ACTIVE               (1 << 7)
+#define FLAG_SPLIT                (1 << 8)   /* CPU events left to the threads */
+#define FLAG_WARM                 (1 << 9)   /* Seeded from a checkpoint */
+
+#define FLAG_SPIKE_PREDICTED  (FLAG_CPU_SPIKE_PREDICTED | FLAG_MEM_SPIKE_PREDICTED | \
+                               FLAG_IO_SPIKE_PREDICTED)
+#define FLAG_SPIKE_FORECAST   (FLAG_CPU_SPIKE_FORECAST | FLAG_MEM_SPIKE_FORECAST | \
+                               FLAG_IO_SPIKE_FORECAST)
 
 /*
- * Per-process behavioral signature
- * Stored in kernel memory, indexed by PID
+ * Per-process behavioral signature, cold half
+ * Identity, lookup linkage and the raw counters behind the samples,
+ * touched once per sample. The model state stepped every tick lives
+ * in sig_cols at the signature's slot, see sig_slot().
  */
 struct proc_signature {
-    pid_t pid;                    /* Process ID */
+    pid_t pid;                    /* Process ID, or TID of a thread signature */
+    pid_t tgid;                   /* Owning process */
+    bool thread;                  /* Per-thread signature (thread_mode) */
     char comm[TASK_COMM_LEN];     /* Process name */
     
-    /* Current EMA values (scaled by 100) */
+    /* Cumulative CPU runtime at the previous sample, for deltas */
+    u64 cpu_runtime_prev;         /* ns, summed over all threads */
+    u64 cpu_stamp;                /* ktime ns of that sample, 0 = none */
+    
+    /* Memory breakdown and major faults behind the last memory sample */
+    unsigned long rss_anon_kb;
+    unsigned long rss_file_kb;
+    unsigned long rss_shmem_kb;
+    unsigned long majflt_prev;    /* Cumulative, all threads */
+    unsigned int majflt_rate;     /* Per second */
+    
+    /* Timestamps */
+    unsigned long last_update;    /* jiffies */
+    unsigned long created;        /* jiffies */
+    u64 start_time;               /* task->start_time, detects PID reuse */
+    
+    /* Tick generation in which the process was last seen */
+    u32 seen_gen;
+    
+    /* Busiest thread of the last tick (process signatures, thread_mode) */
+    int hot_cpu;
+    u32 hot_gen;
+    
+    /* Adaptive sampling state; the tier itself is in sig_cols */
+    u32 sampled_gen;              /* Tick of the last real sample */
+    unsigned long wake_probe;     /* Cheap activity probe at that sample */
+    
+    /* Hash table linkage (RCU-protected) */
+    struct hlist_node hash_node;
+    struct rcu_head rcu;
+};
+
+/*
+ * Per-signature hot state, one cache-line-aligned array per field
+ * indexed by slot. A shard's slots are contiguous, so its per-tick
+ * update is a linear sweep over these arrays. The exported columns
+ * are the snapshot's layout (SMARTSCHED_COL_*) and are published by
+ * memcpy(); the rest is model state only the module reads.
+ */
+struct sig_columns {
+    /* Exported */
+    s32 *pid;
+    u32 *flags;
+    s32 *ema[SMARTSCHED_NR_RES];
+    s32 *roc[SMARTSCHED_NR_RES];
+    s32 *sample[SMARTSCHED_NR_RES];  /* Most recent raw samples */
+    s32 *hot_tid;
+    u8 *eta[SMARTSCHED_NR_RES];      /* Ticks to the forecast spike, 0 = none */
+    u64 *start_time;
+    u64 *total_samples;
+    u64 *spikes[SMARTSCHED_NR_RES];  /* Lifetime spikes predicted */
+    u64 *history[SMARTSCHED_NR_RES]; /* Spike flag per tick, bit 0 = last sample's */
+    u64 *since[SMARTSCHED_NR_RES];   /* ns, first tick of the current spike, 0 = none */
+    char (*comm)[SMARTSCHED_COMM_LEN];
+    
+    /* Module only */
+    s32 *prev[SMARTSCHED_NR_RES];    /* EMA before the last sample */
+    s32 *fc_level[SMARTSCHED_NR_RES];  /* Trend forecaster, see smartsched_forecast */
+    s32 *fc_trend[SMARTSCHED_NR_RES];
+    u32 *fc_var[SMARTSCHED_NR_RES];
+    unsigned long *last_active;      /* jiffies, last non-zero rate of change */
+    u8 *tier;                        /* Adaptive sampling tier, 0 = every tick */
+    u32 *stable;                     /* Consecutive samples with zero RoC */
+};
+
+/*
+ * Per-cgroup signature (cgroup v2 default hierarchy)
+ * Same model as a process signature, fed the sums of every member
+ * process's samples. Owned by the coordinator.
+ */
+struct cgroup_signature {
+    u64 id;                       /* cgroup_id() */
+    char path[CGROUP_PATH_LEN];   /* Relative to the cgroup2 mount */
+    
     int cpu_ema;
     int mem_ema;
     int io_ema;
-    
-    /* Previous samples for rate-of-change */
     int cpu_prev;
     int mem_prev;
     int io_prev;
-    
-    /* Rate of change values */
     int cpu_roc;
     int mem_roc;
     int io_roc;
     
-    /* Prediction flags */
-    unsigned int flags;
+    /* Trend forecasters, raising SMARTSCHED_FLAG_*_FORECAST in flags */
+    struct smartsched_forecast fc[SMARTSCHED_NR_RES];
     
-    /* Timestamps */
-    unsigned long last_update;    /* jiffies */
-    unsigned long created;        /* jiffies */
+    /* Summed samples and member count of the last tick */
+    int cpu_last;
+    int mem_last;
+    int io_last;
+    unsigned int nr_tasks;
     
-    /* Statistics counters */
-    unsigned long cpu_spikes_predicted;
-    unsigned long mem_spikes_predicted;
-    unsigned long io_spikes_predicted;
+    unsigned int flags;
+    unsigned long spikes_predicted;
     unsigned long total_samples;
     
-    /* Hash table linkage */
+    /* Sums being built this tick, valid while acc_gen == sample_gen */
+    u32 acc_gen;
+    unsigned int acc_tasks;
+    s64 acc_cpu;
+    s64 acc_mem;
+    s64 acc_io;
+    
     struct hlist_node hash_node;
+    struct rcu_head rcu;
+};
+
+/*
+ * Raw per-task sample gathered during the task walk.
+ * Applied later by the shard owning the task's hash bucket.
+ */
+struct proc_sample {
+    pid_t pid;                    /* TID for thread samples */
+    pid_t tgid;
+    bool thread;
+    bool split;                   /* Process sample whose threads are sampled too */
+    char comm[TASK_COMM_LEN];
+    u64 start_time;
+    u64 group_start;              /* Leader's start time, for thread samples */
+    u64 runtime;                  /* Cumulative CPU time (ns) */
+    unsigned long majflt;         /* Cumulative major faults */
+    unsigned long rss_anon;       /* Resident pages by kind */
+    unsigned long rss_file;
+    unsigned long rss_shmem;
+    unsigned long wake_probe;
+    struct cgroup_signature *cg;  /* Aggregate to feed, NULL if none */
+    int cpu;                      /* Filled in by the shard */
+    int mem;                      /* Filled in by the shard */
+    int io;
+};
+
+/* Top-K orders: total |RoC|, then each resource's rising RoC */
+enum {
+    TOP_SCORE,
+    TOP_CPU,
+    TOP_MEM,
+    TOP_IO,
+    TOP_NR_ORDERS
+};
+
+/*
+ * Top-K row: a copy of a process signature taken when it was ranked,
+ * so the row stays valid after the signature is evicted
+ */
+struct top_entry {
+    int key;                      /* Value ranked on */
+    pid_t pid;
+    unsigned int flags;
+    int ema[SMARTSCHED_NR_RES];
+    int roc[SMARTSCHED_NR_RES];
+    char comm[TASK_COMM_LEN];
+};
+
+/*
+ * Rows of one order. A min-heap of the TOP_K largest keys offered
+ * while it is being filled, sorted largest first once published.
+ */
+struct top_heap {
+    struct top_entry *e;          /* TOP_K slots in top_store */
+    unsigned int nr;
+};
+
+/*
+ * Sampling shard
+ * Owns a contiguous range of hash buckets and applies the samples
+ * that hash into it. Each shard runs as a work item on its own CPU,
+ * so shards never contend with each other on bucket locks. It also
+ * owns a contiguous range of signature slots, with its own free
+ * stack: the slots it sweeps are the signatures it created.
+ */
+struct sample_shard {
+    struct work_struct work;
+    struct proc_sample *samples;  /* Slice of sample_sorted */
+    unsigned int nr_samples;
+    unsigned int pool_misses;     /* New PIDs refused this tick */
+    struct top_heap top[TOP_NR_ORDERS];  /* Leaders among this tick's updates */
+    int cpu;
+    
+    /* Slots [slot_first, slot_first + slots_per_shard) */
+    unsigned int slot_first;
+    unsigned int slot_hwm;        /* Slots ever handed out, relative; the rest are unused */
+    unsigned int *slot_free;      /* Free stack, lowest slot on top at load */
+    unsigned int nr_free;
+    spinlock_t pool_lock;
+    unsigned long *due;           /* Slots sampled this tick, relative */
+};
+
+/*
+ * Event ring slot. seq is the stream position + 1 once the event is
+ * complete, 0 while a producer is filling it.
+ */
+struct event_slot {
+    u64 seq;
+    struct smartsched_event ev;
+};
+
+/*
+ * Latency histogram in log2 slots of nanoseconds: slot 0 holds 0,
+ * slot k holds [2^(k-1), 2^k), the last slot everything above. Each
+ * instance has one writer at a time; readers tolerate torn totals.
+ */
+struct perf_hist {
+    u64 count;
+    u64 sum_ns;
+    u64 max_ns;
+    u64 slot[PERF_HIST_SLOTS];
+};
+
+/* Bucket lock timing, per CPU, updated with the lock held */
+struct perf_lock_stats {
+    u64 contended;
+    struct perf_hist wait;        /* count = acquisitions */
+    struct perf_hist hold;
+};
+
+/* Cost of read() calls on one procfs view */
+struct perf_read_stats {
+    const char *name;
+    spinlock_t lock;
+    struct perf_hist hist;
+};
+
+/*
+ * Per-open-file cursor into the event stream
+ * Each reader brings its own waitqueue: epoll entries hang off it, and
+ * they must be detached (wake_up_pollfree()) when the file goes away,
+ * not left linked into module data that rmmod frees.
+ */
+struct event_reader {
+    struct mutex lock;
+    u64 cursor;
+    wait_queue_head_t wait;
+    struct list_head node;          /* In event_readers */
+    struct rcu_head rcu;
+};
+
+/*
+ * Runtime-tunable configuration
+ * Staged by module parameter and /proc/smartscheduler/config writes,
+ * copied as a whole by the coordinator at the start of a tick.
+ */
+struct sched_config {
+    struct smartsched_model_params model;
+    int sample_interval_ms;
+    int idle_samples;             /* 0 disables adaptive sampling */
+    int thread_mode;              /* Also track each thread of a process */
+};
+
+/* One named int field of struct sched_config and its valid range */
+struct config_param {
+    const char *name;
+    size_t offset;
+    int min;
+    int max;
 };
 
 /* ============================================
  * GLOBAL STATE
  * ============================================ */
 
+/* Configuration in force; written only by the coordinator, between ticks */
+static struct sched_config cfg = {
+    .model = SMARTSCHED_MODEL_DEFAULTS,
+    .sample_interval_ms = SAMPLE_INTERVAL_MS,
+    .idle_samples = ADAPT_IDLE_SAMPLES,
+    .thread_mode = 0,
+};
+
+/* Staged configuration, applied on the next tick when cfg_dirty is set */
+static struct sched_config cfg_pending = {
+    .model = SMARTSCHED_MODEL_DEFAULTS,
+    .sample_interval_ms = SAMPLE_INTERVAL_MS,
+    .idle_samples = ADAPT_IDLE_SAMPLES,
+    .thread_mode = 0,
+};
+static bool cfg_dirty;
+static bool cfg_running;          /* Coordinator armed, staging may re-arm it */
+static unsigned long cfg_applied;
+static DEFINE_SPINLOCK(cfg_lock);
+
+/* Signature pool and snapshot capacity, fixed at load time */
+static unsigned int max_tracked = MAX_TRACKED_PROCS;
+static size_t sig_pool_bytes;     /* Shown in status, the pool is not a slab cache */
+
 /* Hash table for process signatures */
 static DEFINE_HASHTABLE(proc_signatures, PROC_HASH_BITS);
 
-/* Spinlock for hash table access */
-static DEFINE_SPINLOCK(sig_lock);
+/*
+ * Per-bucket locks for the signature table
+ * Serialise list insertion/removal only. Readers walk the table under
+ * rcu_read_lock() and never take these.
+ */
+static spinlock_t sig_bucket_locks[1 << PROC_HASH_BITS];
+
+/* Sampling engine: coordinator work plus one work item per shard */
+static struct workqueue_struct *sample_wq;
+static struct delayed_work sample_work;
+static struct sample_shard sample_shards[SAMPLE_MAX_SHARDS];
+static unsigned int nr_shards;
+static unsigned int shard_shift;
+
+/*
+ * Signature allocator: max_tracked slots, each a cold object in
+ * sig_slots plus its elements of the sig_cols arrays, all allocated
+ * at load time and split evenly between the shards. Creating a
+ * signature is a pop from its shard's free stack, so the sampler
+ * never allocates and memory use is fixed.
+ */
+static struct proc_signature *sig_slots;
+static struct sig_columns sig_cols;
+static void *sig_col_store;           /* Backing memory of sig_cols */
+static unsigned int slots_per_shard;
+static unsigned int *sig_free_store;  /* Backing memory of the free stacks */
+static unsigned long *sig_due_store;  /* Backing memory of the due bitmaps */
+
+/* Exported columns by SMARTSCHED_COL_*, for publish_snapshot() */
+static struct {
+    const void *base;
+    unsigned int size;
+} sig_col_export[SMARTSCHED_NR_COLUMNS];
+
+/* Current tick generation, its timestamp, and whether it sweeps exited PIDs */
+static u32 sample_gen;
+static u64 sample_now;
+static bool sample_sweep;
+
+/* Per-tick sample buffers, grown between ticks when the walk overflows */
+static struct proc_sample *sample_buf;     /* Task walk order */
+static struct proc_sample *sample_sorted;  /* Grouped by shard */
+static unsigned int sample_buf_size;
+static unsigned int sample_buf_want;
+
+/* Procfs entries */
+static struct proc_dir_entry *proc_dir;
+static struct proc_dir_entry *proc_status;
+static struct proc_dir_entry *proc_predictions;
+static struct proc_dir_entry *proc_stats;
+static struct proc_dir_entry *proc_events;
+static struct proc_dir_entry *proc_config;
+static struct proc_dir_entry *proc_cgroups;
+static struct proc_dir_entry *proc_threads;
+static struct proc_dir_entry *proc_memory;
+static struct proc_dir_entry *proc_perf;
+static struct proc_dir_entry *proc_spiking;
+static struct proc_dir_entry *proc_top;
+static struct proc_dir_entry *proc_forecast;
+
+/* Module statistics */
+static atomic_t total_tracked = ATOMIC_INIT(0);
+static atomic_t total_predictions = ATOMIC_INIT(0);
+static atomic_t total_forecasts = ATOMIC_INIT(0);
+static atomic_long_t evicted_exited = ATOMIC_LONG_INIT(0);
+static atomic_long_t evicted_lru = ATOMIC_LONG_INIT(0);
+static atomic_long_t evicted_reused = ATOMIC_LONG_INIT(0);
+static atomic_long_t dropped_full = ATOMIC_LONG_INIT(0);
+
+/* Cgroup signatures: RCU hash table over a preallocated pool */
+static DEFINE_HASHTABLE(cgroup_signatures, CGROUP_HASH_BITS);
+static struct cgroup_signature *cg_slots;
+static struct cgroup_signature **cg_pool;
+static unsigned int cg_pool_free;
+static DEFINE_SPINLOCK(cg_pool_lock);
+static atomic_t cgroups_tracked = ATOMIC_INIT(0);
+static atomic_long_t cgroups_dropped = ATOMIC_LONG_INIT(0);
+
+/*
+ * Top-K tables: each shard ranks the signatures it updates, the
+ * coordinator merges the shards into top_stage and swaps it with
+ * top_pub under top_lock. Readers hold it only to copy top_pub out,
+ * never while printing, so a slow reader cannot stall the tick.
+ */
+static struct top_entry *top_store;
+static struct top_heap top_tables[2][TOP_NR_ORDERS];
+static struct top_heap *top_pub = top_tables[0];
+static struct top_heap *top_stage = top_tables[1];
+static DEFINE_MUTEX(top_lock);
+
+/* Task walk of the last tick: tasks sampled, and idle tasks skipped */
+static unsigned int tick_sampled;
+static unsigned int tick_skipped;
+
+/*
+ * Sampler instrumentation, written by the coordinator only. Phases
+ * partition a tick: walk, shards (sort, fan-out and flush) and publish
+ * (cgroups, snapshot, events). Drift is how late a tick started
+ * against the moment it was armed plus the interval.
+ */
+static struct {
+    struct perf_hist tick;
+    struct perf_hist walk;
+    struct perf_hist shards;
+    struct perf_hist publish;
+    struct perf_hist drift;
+    u64 due_ns;                   /* Expected start of the next tick, 0 = unknown */
+    u64 missed;                   /* Whole intervals lost to drift */
+    u64 deferred;                 /* Due tasks that did not fit the buffer */
+    u64 resize_failures;
+    u64 seen_total;
+    unsigned int seen, due, sampled;  /* Last tick */
+    unsigned int seen_max;
+} sampler_perf;
+
+static DEFINE_PER_CPU(struct perf_lock_stats, perf_locks);
+
+enum {
+    PERF_READ_STATUS,
+    PERF_READ_PREDICTIONS,
+    PERF_READ_STATS,
+    PERF_READ_MEMORY,
+    PERF_READ_THREADS,
+    PERF_READ_CGROUPS,
+    PERF_READ_CONFIG,
+    PERF_READ_PERF,
+    PERF_READ_SPIKING,
+    PERF_READ_TOP,
+    PERF_READ_FORECAST,
+    PERF_NR_READS
+};
+
+static struct perf_read_stats perf_reads[PERF_NR_READS] = {
+    [PERF_READ_STATUS]      = { .name = "status" },
+    [PERF_READ_PREDICTIONS] = { .name = "predictions" },
+    [PERF_READ_STATS]       = { .name = "stats" },
+    [PERF_READ_MEMORY]      = { .name = "memory" },
+    [PERF_READ_THREADS]     = { .name = "threads" },
+    [PERF_READ_CGROUPS]     = { .name = "cgroups" },
+    [PERF_READ_CONFIG]      = { .name = "config" },
+    [PERF_READ_PERF]        = { .name = "perf" },
+    [PERF_READ_SPIKING]     = { .name = "spiking" },
+    [PERF_READ_TOP]         = { .name = "top" },
+    [PERF_READ_FORECAST]    = { .name = "forecast" },
+};
+
+/* Binary snapshot shared with user space through /dev/smartsched */
+static void *snapshot_buf;
+static size_t snapshot_size;
+static bool snapshot_registered;
+
+/*
+ * Warm-start seeds: writes to /dev/smartsched queue them in
+ * seed_pending; the coordinator moves them, sorted by pid, to
+ * seed_active between ticks, where the shards look them up read-only
+ * until seed_expires.
+ */
+static DEFINE_MUTEX(seed_lock);
+static struct smartsched_seed *seed_pending;   /* max_tracked entries, under seed_lock */
+static unsigned int seed_pending_nr;
+static struct smartsched_seed *seed_active;
+static unsigned int seed_active_nr;
+static u32 seed_expires;
+static atomic_long_t seeds_applied = ATOMIC_LONG_INIT(0);
+
+/*
+ * Spike event stream: producers claim positions from event_head,
+ * the coordinator publishes complete ticks through event_published.
+ */
+static struct event_slot *event_ring;
+static atomic64_t event_head = ATOMIC64_INIT(0);
+static u64 event_published;
+static bool event_shutdown;
+static LIST_HEAD(event_readers);          /* RCU for waking, event_readers_lock to change */
+static DEFINE_SPINLOCK(event_readers_lock);
+static unsigned long module_start_time;
+
+/* ============================================
+ * RUNTIME CONFIGURATION
+ * ============================================ */
+
+enum {
+    CFG_ALPHA,
+    CFG_CPU_THRESHOLD,
+    CFG_MEM_THRESHOLD,
+    CFG_IO_THRESHOLD,
+    CFG_SAMPLE_INTERVAL,
+    CFG_IDLE_SAMPLES,
+    CFG_THREAD_MODE,
+    CFG_BETA,
+    CFG_SIGMA_K,
+    CFG_HORIZON,
+    CFG_NR_PARAMS,
+};
+
+static struct config_param config_params[CFG_NR_PARAMS] = {
+    [CFG_ALPHA] = {
+        "alpha", offsetof(struct sched_config, model.alpha), 1, 100 },
+    [CFG_CPU_THRESHOLD] = {
+        "cpu_threshold",
+        offsetof(struct sched_config, model.threshold[SMARTSCHED_RES_CPU]), 0, INT_MAX },
+    [CFG_MEM_THRESHOLD] = {
+        "mem_threshold",
+        offsetof(struct sched_config, model.threshold[SMARTSCHED_RES_MEM]), 0, INT_MAX },
+    [CFG_IO_THRESHOLD] = {
+        "io_threshold",
+        offsetof(struct sched_config, model.threshold[SMARTSCHED_RES_IO]), 0, INT_MAX },
+    [CFG_SAMPLE_INTERVAL] = {
+        "sample_interval_ms", offsetof(struct sched_config, sample_interval_ms),
+        SAMPLE_INTERVAL_MIN_MS, SAMPLE_INTERVAL_MAX_MS },
+    [CFG_IDLE_SAMPLES] = {
+        "idle_samples", offsetof(struct sched_config, idle_samples), 0, 100000 },
+    [CFG_THREAD_MODE] = {
+        "thread_mode", offsetof(struct sched_config, thread_mode), 0, 1 },
+    [CFG_BETA] = {
+        "beta", offsetof(struct sched_config, model.beta), 0, 100 },
+    [CFG_SIGMA_K] = {
+        "sigma_k", offsetof(struct sched_config, model.sigma_k), 0, 100000 },
+    [CFG_HORIZON] = {
+        "horizon", offsetof(struct sched_config, model.horizon), 0, SMARTSCHED_MAX_HORIZON },
+};
+
+static int *config_field(struct sched_config *c, const struct config_param *p)
+{
+    return (int *)((char *)c + p->offset);
+}
+
+static const struct config_param *config_lookup(const char *name)
+{
+    int i;
+    
+    for (i = 0; i < CFG_NR_PARAMS; i++)
+        if (!strcmp(config_params[i].name, name))
+            return &config_params[i];
+    return NULL;
+}
+
+/*
+ * Stage a complete configuration for the next tick (cfg_lock held)
+ * A new interval also moves the already-armed tick, so it takes effect
+ * one new period from now instead of after a full period at the old
+ * rate; the coordinator keeps running either way.
+ */
+static void config_stage_locked(const struct sched_config *next)
+{
+    bool rearm = next->sample_interval_ms != cfg_pending.sample_interval_ms;
+    
+    cfg_pending = *next;
+    WRITE_ONCE(cfg_dirty, true);
+    
+    if (rearm && cfg_running)
+        mod_delayed_work(sample_wq, &sample_work,
+                         msecs_to_jiffies(next->sample_interval_ms));
+}
+
+/*
+ * Put the staged configuration in force
+ * Called by the coordinator before it fans out, so every shard in a
+ * tick sees the same parameters.
+ */
+static void config_apply(void)
+{
+    if (!READ_ONCE(cfg_dirty))
+        return;
+    
+    spin_lock(&cfg_lock);
+    cfg = cfg_pending;
+    WRITE_ONCE(cfg_dirty, false);
+    spin_unlock(&cfg_lock);
+    
+    cfg_applied++;
+}
+
+/*
+ * Module parameters share the staging path with the config file:
+ * values given at load time are in force from the first tick, writes
+ * under /sys/module/smartscheduler/parameters/ apply on the next one.
+ */
+static int config_param_set(const char *val, const struct kernel_param *kp)
+{
+    const struct config_param *p = kp->arg;
+    struct sched_config next;
+    int v, ret;
+    
+    ret = kstrtoint(val, 0, &v);
+    if (ret)
+        return ret;
+    if (v < p->min || v > p->max)
+        return -EINVAL;
+    
+    spin_lock(&cfg_lock);
+    next = cfg_pending;
+    *config_field(&next, p) = v;
+    config_stage_locked(&next);
+    spin_unlock(&cfg_lock);
+    
+    return 0;
+}
+
+static int config_param_get(char *buf, const struct kernel_param *kp)
+{
+    const struct config_param *p = kp->arg;
+    
+    return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(*config_field(&cfg_pending, p)));
+}
+
+static const struct kernel_param_ops config_param_ops = {
+    .set = config_param_set,
+    .get = config_param_get,
+};
+
+module_param_cb(alpha, &config_param_ops, &config_params[CFG_ALPHA], 0644);
+MODULE_PARM_DESC(alpha, "EMA smoothing factor in percent, 1-100 (default 30)");
+module_param_cb(cpu_threshold, &config_param_ops, &config_params[CFG_CPU_THRESHOLD], 0644);
+MODULE_PARM_DESC(cpu_threshold, "CPU EMA rate of change that predicts a spike (default 2000)");
+module_param_cb(mem_threshold, &config_param_ops, &config_params[CFG_MEM_THRESHOLD], 0644);
+MODULE_PARM_DESC(mem_threshold, "Memory EMA rate of change that predicts a spike (default 1500)");
+module_param_cb(io_threshold, &config_param_ops, &config_params[CFG_IO_THRESHOLD], 0644);
+MODULE_PARM_DESC(io_threshold, "I/O EMA rate of change that predicts a spike (default 1000)");
+module_param_cb(sample_interval_ms, &config_param_ops, &config_params[CFG_SAMPLE_INTERVAL], 0644);
+MODULE_PARM_DESC(sample_interval_ms, "Sampling interval in ms, 10-60000 (default 100)");
+module_param_cb(idle_samples, &config_param_ops, &config_params[CFG_IDLE_SAMPLES], 0644);
+MODULE_PARM_DESC(idle_samples, "Zero-RoC samples before an idle task is sampled less often, 0 = off (default 10)");
+module_param_cb(thread_mode, &config_param_ops, &config_params[CFG_THREAD_MODE], 0644);
+MODULE_PARM_DESC(thread_mode, "Track threads of multi-threaded processes individually (default 0)");
+module_param_cb(beta, &config_param_ops, &config_params[CFG_BETA], 0644);
+MODULE_PARM_DESC(beta, "Forecast trend smoothing factor in percent, 0-100 (default 20)");
+module_param_cb(sigma_k, &config_param_ops, &config_params[CFG_SIGMA_K], 0644);
+MODULE_PARM_DESC(sigma_k, "Forecast rise in standard deviations x100 (default 300)");
+module_param_cb(horizon, &config_param_ops, &config_params[CFG_HORIZON], 0644);
+MODULE_PARM_DESC(horizon, "Ticks the forecast looks ahead, 0-255, 0 = off (default 10)");
+module_param(max_tracked, uint, 0444);
+MODULE_PARM_DESC(max_tracked, "Maximum tracked processes, load time only (default 4096)");
+
+/* ============================================
+ * SIGNATURE POOL
+ * ============================================ */
+
+/* Slot of a signature: its index in sig_slots and in every column */
+static inline unsigned int sig_slot(const struct proc_signature *sig)
+{
+    return sig - sig_slots;
+}
+
+/* A signature's element of column col, e.g. SIG_COL(sig, ema[SMARTSCHED_RES_CPU]) */
+#define SIG_COL(sig, col) (sig_cols.col[sig_slot(sig)])
+
+/*
+ * Take a slot from the shard's free stack
+ * Returns NULL when every slot of the shard is in use (table full)
+ */
+static struct proc_signature *sig_pool_pop(struct sample_shard *shard)
+{
+    struct proc_signature *sig = NULL;
+    unsigned int i;
+    
+    spin_lock_bh(&shard->pool_lock);
+    if (shard->nr_free) {
+        i = shard->slot_free[--shard->nr_free];
+        if (i >= shard->slot_hwm)
+            shard->slot_hwm = i + 1;
+        sig = &sig_slots[shard->slot_first + i];
+    }
+    spin_unlock_bh(&shard->pool_lock);
+    
+    return sig;
+}
+
+/* Return a slot to its shard (may run from RCU softirq context) */
+static void sig_pool_push(struct proc_signature *sig)
+{
+    unsigned int slot = sig_slot(sig);
+    struct sample_shard *shard = &sample_shards[slot / slots_per_shard];
+    
+    spin_lock_bh(&shard->pool_lock);
+    shard->slot_free[shard->nr_free++] = slot - shard->slot_first;
+    spin_unlock_bh(&shard->pool_lock);
+}
+
+/* RCU callback: recycle a removed signature once readers are done */
+static void sig_free_rcu(struct rcu_head *head)
+{
+    sig_pool_push(container_of(head, struct proc_signature, rcu));
+    atomic_dec(&total_tracked);
+}
+
+/*
+ * Point every column of c into the block at base, n elements each and
+ * cache-line aligned, and return the block's size. base = 0 only
+ * sizes the block.
+ */
+static size_t sig_columns_layout(struct sig_columns *c, unsigned long base, unsigned int n)
+{
+    size_t off = 0;
+    int r;
+    
+#define SIG_COL_CARVE(col) do {                                     \
+        (col) = (void *)(base + off);                               \
+        off += ALIGN((size_t)n * sizeof(*(col)), SMP_CACHE_BYTES);  \
+    } while (0)
+    
+    SIG_COL_CARVE(c->pid);
+    SIG_COL_CARVE(c->flags);
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        SIG_COL_CARVE(c->ema[r]);
+        SIG_COL_CARVE(c->roc[r]);
+        SIG_COL_CARVE(c->sample[r]);
+        SIG_COL_CARVE(c->eta[r]);
+        SIG_COL_CARVE(c->spikes[r]);
+        SIG_COL_CARVE(c->history[r]);
+        SIG_COL_CARVE(c->since[r]);
+        SIG_COL_CARVE(c->prev[r]);
+        SIG_COL_CARVE(c->fc_level[r]);
+        SIG_COL_CARVE(c->fc_trend[r]);
+        SIG_COL_CARVE(c->fc_var[r]);
+    }
+    SIG_COL_CARVE(c->hot_tid);
+    SIG_COL_CARVE(c->start_time);
+    SIG_COL_CARVE(c->total_samples);
+    SIG_COL_CARVE(c->comm);
+    SIG_COL_CARVE(c->last_active);
+    SIG_COL_CARVE(c->tier);
+    SIG_COL_CARVE(c->stable);
+    
+#undef SIG_COL_CARVE
+    return off;
+}
+
+/* Fill sig_col_export from sig_cols, in SMARTSCHED_COL_* order */
+static void sig_columns_export(void)
+{
+    int r;
+    
+#define SIG_COL_EXPORT(id, col) do {                        \
+        sig_col_export[id].base = (col);                    \
+        sig_col_export[id].size = sizeof(*(col));           \
+    } while (0)
+    
+    SIG_COL_EXPORT(SMARTSCHED_COL_PID, sig_cols.pid);
+    SIG_COL_EXPORT(SMARTSCHED_COL_FLAGS, sig_cols.flags);
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        SIG_COL_EXPORT(SMARTSCHED_COL_EMA(r), sig_cols.ema[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_ROC(r), sig_cols.roc[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_SAMPLE(r), sig_cols.sample[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_ETA(r), sig_cols.eta[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_SPIKES(r), sig_cols.spikes[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_HISTORY(r), sig_cols.history[r]);
+        SIG_COL_EXPORT(SMARTSCHED_COL_SINCE(r), sig_cols.since[r]);
+    }
+    SIG_COL_EXPORT(SMARTSCHED_COL_HOT_TID, sig_cols.hot_tid);
+    SIG_COL_EXPORT(SMARTSCHED_COL_START_TIME, sig_cols.start_time);
+    SIG_COL_EXPORT(SMARTSCHED_COL_TOTAL_SAMPLES, sig_cols.total_samples);
+    SIG_COL_EXPORT(SMARTSCHED_COL_COMM, sig_cols.comm);
+    
+#undef SIG_COL_EXPORT
+}
+
+/*
+ * Reset a freshly popped slot's columns for a new signature
+ * Done before the signature is hashed, so readers never see the old
+ * occupant's state under the new PID.
+ */
+static void sig_columns_init(unsigned int slot, const struct proc_sample *s)
+{
+    int r;
+    
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        sig_cols.ema[r][slot] = 0;
+        sig_cols.roc[r][slot] = 0;
+        sig_cols.sample[r][slot] = 0;
+        sig_cols.eta[r][slot] = 0;
+        sig_cols.spikes[r][slot] = 0;
+        sig_cols.history[r][slot] = 0;
+        sig_cols.since[r][slot] = 0;
+        sig_cols.prev[r][slot] = 0;
+        sig_cols.fc_level[r][slot] = 0;
+        sig_cols.fc_trend[r][slot] = 0;
+        sig_cols.fc_var[r][slot] = 0;
+    }
+    sig_cols.pid[slot] = s->pid;
+    sig_cols.hot_tid[slot] = 0;
+    sig_cols.start_time[slot] = s->start_time;
+    sig_cols.total_samples[slot] = 0;
+    strscpy_pad(sig_cols.comm[slot], s->comm, SMARTSCHED_COMM_LEN);
+    sig_cols.last_active[slot] = jiffies;
+    sig_cols.tier[slot] = 0;
+    sig_cols.stable[slot] = 0;
+    WRITE_ONCE(sig_cols.flags[slot], FLAG_ACTIVE | (s->thread ? FLAG_THREAD : 0));
+}
+
+/*
+ * Allocate the slots and split them between the shards
+ * Needs nr_shards, so runs after init_sampling_engine(). All
+ * allocation happens here, at load time, with GFP_KERNEL; max_tracked
+ * is rounded down to a multiple of nr_shards.
+ */
+static int init_sig_pool(void)
+{
+    unsigned int longs, i, j;
+    size_t bytes;
+    
+    slots_per_shard = max_tracked / nr_shards;
+    max_tracked = slots_per_shard * nr_shards;
+    longs = BITS_TO_LONGS(slots_per_shard);
+    
+    sig_slots = kvcalloc(max_tracked, sizeof(*sig_slots), GFP_KERNEL);
+    sig_free_store = kvmalloc_array(max_tracked, sizeof(*sig_free_store), GFP_KERNEL);
+    sig_due_store = kvcalloc((size_t)nr_shards * longs, sizeof(*sig_due_store), GFP_KERNEL);
+    bytes = sig_columns_layout(&sig_cols, 0, max_tracked);
+    sig_col_store = kvzalloc(bytes, GFP_KERNEL);
+    if (!sig_slots || !sig_free_store || !sig_due_store || !sig_col_store)
+        goto fail;
+    sig_pool_bytes = bytes + max_tracked * (sizeof(*sig_slots) + sizeof(*sig_free_store)) +
+                     (size_t)nr_shards * longs * sizeof(*sig_due_store);
+    
+    sig_columns_layout(&sig_cols, (unsigned long)sig_col_store, max_tracked);
+    sig_columns_export();
+    
+    /* Pops hand out the lowest slots first, keeping slot_hwm low */
+    for (i = 0; i < nr_shards; i++) {
+        struct sample_shard *shard = &sample_shards[i];
+        
+        shard->slot_first = i * slots_per_shard;
+        shard->slot_hwm = 0;
+        shard->slot_free = sig_free_store + shard->slot_first;
+        for (j = 0; j < slots_per_shard; j++)
+            shard->slot_free[j] = slots_per_shard - 1 - j;
+        shard->nr_free = slots_per_shard;
+        shard->due = sig_due_store + (size_t)i * longs;
+        spin_lock_init(&shard->pool_lock);
+    }
+    
+    return 0;
+
+fail:
+    kvfree(sig_col_store);
+    kvfree(sig_due_store);
+    kvfree(sig_free_store);
+    kvfree(sig_slots);
+    sig_col_store = NULL;
+    sig_due_store = NULL;
+    sig_free_store = NULL;
+    sig_slots = NULL;
+    return -ENOMEM;
+}
+
+/* Release the slots; no signature may be hashed or pending RCU */
+static void destroy_sig_pool(void)
+{
+    kvfree(sig_col_store);
+    kvfree(sig_due_store);
+    kvfree(sig_free_store);
+    kvfree(sig_slots);
+}
+
+/* ============================================
+ * SPIKE EVENT STREAM
+ * ============================================ */
+
+/*
+ * Append one event for a signature slot to the ring, with the
+ * resource's current RoC and EMA
+ * Lock-free: any number of shards may call this concurrently. Old
+ * events are overwritten; slow readers detect it through the ring
+ * slot's seq.
+ */
+static void emit_event(unsigned int slot, u16 resource, u16 type)
+{
+    u64 pos = atomic64_inc_return(&event_head) - 1;
+    struct event_slot *es = &event_ring[pos & EVENT_RING_MASK];
+    
+    WRITE_ONCE(es->seq, 0);
+    smp_wmb();
+    
+    es->ev.seq = pos;
+    es->ev.timestamp_ns = sample_now;
+    es->ev.pid = sig_cols.pid[slot];
+    es->ev.resource = resource;
+    es->ev.type = type;
+    es->ev.roc = sig_cols.roc[resource][slot];
+    es->ev.ema = sig_cols.ema[resource][slot];
+    memcpy(es->ev.comm, sig_cols.comm[slot], sizeof(es->ev.comm));
+    es->ev.history = sig_cols.history[resource][slot];
+    es->ev.since_ns = sig_cols.since[resource][slot];
+    
+    smp_wmb();
+    WRITE_ONCE(es->seq, pos + 1);
+}
+
+/*
+ * Emit events for one signature slot on flag edges only: a spike event
+ * for every flag raised since old_flags, a clear event for every flag
+ * dropped. A held spike stays quiet; its history and since_ns in the
+ * snapshot, and in the clear event, say how long it lasted.
+ */
+static void emit_spike_events(unsigned int slot, unsigned int old_flags,
+                              unsigned int new_flags)
+{
+    int res;
+    
+    /*
+     * A process whose threads are tracked leaves CPU events to them,
+     * so consumers see the TID responsible rather than the whole group.
+     * The split bit is already this tick's; emit_split_change() sent the
+     * CPU edge if it flipped.
+     */
+    if (sig_cols.flags[slot] & FLAG_SPLIT) {
+        old_flags &= ~FLAG_CPU_SPIKE_PREDICTED;
+        new_flags &= ~FLAG_CPU_SPIKE_PREDICTED;
+    }
+    
+    /* A resource's spike flag is 1 << res */
+    for (res = 0; res < SMARTSCHED_NR_RES; res++) {
+        if (new_flags & ~old_flags & (1U << res))
+            emit_event(slot, res, SMARTSCHED_EVENT_SPIKE);
+        else if (old_flags & ~new_flags & (1U << res))
+            emit_event(slot, res, SMARTSCHED_EVENT_CLEAR);
+    }
+}
+
+/*
+ * A process's CPU events move to its threads (split) or back: close or
+ * reopen its process-level CPU spike, so consumers that saw a SPIKE
+ * still get the CLEAR, and never get a CLEAR without a SPIKE
+ */
+static void emit_split_change(unsigned int slot, bool split)
+{
+    if (sig_cols.flags[slot] & FLAG_CPU_SPIKE_PREDICTED)
+        emit_event(slot, SMARTSCHED_RES_CPU,
+                   split ? SMARTSCHED_EVENT_CLEAR : SMARTSCHED_EVENT_SPIKE);
+}
+
+/*
+ * Make this tick's events visible and wake readers
+ * Called by the coordinator once every shard has finished, so all
+ * claimed slots are complete. Quiet ticks wake nobody.
+ */
+static void publish_events(void)
+{
+    u64 head = atomic64_read(&event_head);
+    struct event_reader *r;
+    
+    if (head == event_published)
+        return;
+    
+    smp_store_release(&event_published, head);
+    rcu_read_lock();
+    list_for_each_entry_rcu(r, &event_readers, node)
+        wake_up_interruptible(&r->wait);
+    rcu_read_unlock();
+}
+
+static inline bool event_pending(struct event_reader *r)
+{
+    return READ_ONCE(r->cursor) != smp_load_acquire(&event_published) ||
+           READ_ONCE(event_shutdown);
+}
+
+/*
+ * Fetch the reader's next event into ev
+ * Returns false when the reader has caught up. A reader lapped by the
+ * producers gets a single overrun event and resumes at the oldest
+ * event still in the ring.
+ */
+static bool event_fetch(struct event_reader *r, struct smartsched_event *ev)
+{
+    u64 pub = smp_load_acquire(&event_published);
+    struct event_slot *slot;
+    u64 resume;
+    
+    while (r->cursor != pub) {
+        if (pub - r->cursor <= EVENT_RING_SIZE) {
+            slot = &event_ring[r->cursor & EVENT_RING_MASK];
+            if (READ_ONCE(slot->seq) == r->cursor + 1) {
+                smp_rmb();
+                *ev = slot->ev;
+                smp_rmb();
+                if (READ_ONCE(slot->seq) == r->cursor + 1) {
+                    r->cursor++;
+                    return true;
+                }
+            }
+        }
+        
+        /* Overwritten: skip ahead, leaving producers half a ring of slack */
+        resume = min_t(u64, atomic64_read(&event_head) - EVENT_RING_SIZE / 2, pub);
+        memset(ev, 0, sizeof(*ev));
+        ev->seq = r->cursor;
+        ev->timestamp_ns = ktime_get_ns();
+        ev->type = SMARTSCHED_EVENT_OVERRUN;
+        ev->roc = min_t(u64, resume - r->cursor, INT_MAX);
+        r->cursor = resume;
+        return true;
+    }
+    
+    return false;
+}
+
+static int events_open(struct inode *inode, struct file *file)
+{
+    struct event_reader *r;
+    
+    r = kzalloc(sizeof(*r), GFP_KERNEL);
+    if (!r)
+        return -ENOMEM;
+    
+    mutex_init(&r->lock);
+    init_waitqueue_head(&r->wait);
+    r->cursor = smp_load_acquire(&event_published);
+    file->private_data = r;
+    
+    spin_lock(&event_readers_lock);
+    list_add_tail_rcu(&r->node, &event_readers);
+    spin_unlock(&event_readers_lock);
+    return nonseekable_open(inode, file);
+}
+
+/* Copy whole events to user space, blocking unless O_NONBLOCK */
+static ssize_t events_read(struct file *file, char __user *buf,
+                           size_t count, loff_t *ppos)
+{
+    struct event_reader *r = file->private_data;
+    struct smartsched_event ev;
+    ssize_t copied = 0;
+    int ret;
+    
+    if (count < sizeof(ev))
+        return -EINVAL;
+    
+    for (;;) {
+        if (mutex_lock_interruptible(&r->lock))
+            return -ERESTARTSYS;
+        while (copied + sizeof(ev) <= count && event_fetch(r, &ev)) {
+            if (copy_to_user(buf + copied, &ev, sizeof(ev))) {
+                mutex_unlock(&r->lock);
+                return copied ? copied : -EFAULT;
+            }
+            copied += sizeof(ev);
+        }
+        mutex_unlock(&r->lock);
+        
+        if (copied || READ_ONCE(event_shutdown))
+            return copied;
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        
+        ret = wait_event_interruptible(r->wait, event_pending(r));
+        if (ret)
+            return ret;
+    }
+}
+
+static __poll_t events_poll(struct file *file, poll_table *wait)
+{
+    struct event_reader *r = file->private_data;
+    
+    poll_wait(file, &r->wait, wait);
+    if (READ_ONCE(event_shutdown))
+        return EPOLLHUP;
+    return event_pending(r) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 16, 0)
+#define wake_up_pollfree(wq) wake_up_poll((wq), EPOLLHUP | POLLFREE)
+#endif
+
+/*
+ * Also runs from procfs rundown at rmmod for files still open, so any
+ * epoll entry on r->wait is unhooked here; wake_up_pollfree() needs the
+ * RCU-delayed free, as does publish_events()' walk
+ */
+static int events_release(struct inode *inode, struct file *file)
+{
+    struct event_reader *r = file->private_data;
+    
+    spin_lock(&event_readers_lock);
+    list_del_rcu(&r->node);
+    spin_unlock(&event_readers_lock);
+    
+    wake_up_pollfree(&r->wait);
+    kfree_rcu(r, rcu);
+    return 0;
+}
+
+static const struct proc_ops events_ops = {
+    .proc_open = events_open,
+    .proc_read = events_read,
+    .proc_poll = events_poll,
+    .proc_lseek = noop_llseek,
+    .proc_release = events_release,
+};
+
+/* Release blocked readers so procfs removal does not wait on them */
+static void shutdown_events(void)
+{
+    struct event_reader *r;
+    
+    WRITE_ONCE(event_shutdown, true);
+    spin_lock(&event_readers_lock);
+    list_for_each_entry(r, &event_readers, node)
+        wake_up_interruptible_all(&r->wait);
+    spin_unlock(&event_readers_lock);
+}
+
+/* ============================================
+ * SAMPLER INSTRUMENTATION
+ * ============================================ */
+
+static void perf_hist_add(struct perf_hist *h, u64 ns)
+{
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+    h->slot[min_t(unsigned int, fls64(ns), PERF_HIST_SLOTS - 1)]++;
+}
+
+static void perf_hist_merge(struct perf_hist *dst, const struct perf_hist *src)
+{
+    unsigned int k;
+    
+    dst->count += READ_ONCE(src->count);
+    dst->sum_ns += READ_ONCE(src->sum_ns);
+    dst->max_ns = max_t(u64, dst->max_ns, READ_ONCE(src->max_ns));
+    for (k = 0; k < PERF_HIST_SLOTS; k++)
+        dst->slot[k] += READ_ONCE(src->slot[k]);
+}
+
+/*
+ * Upper bound of the slot holding the pct-th percentile, capped at
+ * the recorded maximum
+ */
+static u64 perf_hist_pct(const struct perf_hist *h, unsigned int pct)
+{
+    u64 want, acc = 0;
+    unsigned int k;
+    
+    if (!h->count)
+        return 0;
+    
+    want = div64_u64(h->count * pct + 99, 100);
+    for (k = 0; k < PERF_HIST_SLOTS - 1; k++) {
+        acc += h->slot[k];
+        if (acc >= want)
+            return min_t(u64, k ? (1ULL << k) - 1 : 0, h->max_ns);
+    }
+    return h->max_ns;
+}
+
+/*
+ * Bucket lock with timing
+ * Returns the acquisition time to hand to sig_bucket_unlock(). An
+ * uncontended lock records a zero wait and costs one clock read.
+ */
+static inline u64 sig_bucket_lock(unsigned int bkt)
+{
+    spinlock_t *lock = &sig_bucket_locks[bkt];
+    struct perf_lock_stats *ls;
+    u64 start, now;
+    
+    if (spin_trylock(lock)) {
+        now = local_clock();
+        perf_hist_add(&this_cpu_ptr(&perf_locks)->wait, 0);
+        return now;
+    }
+    
+    start = local_clock();
+    spin_lock(lock);
+    now = local_clock();
+    ls = this_cpu_ptr(&perf_locks);
+    ls->contended++;
+    perf_hist_add(&ls->wait, now > start ? now - start : 0);
+    return now;
+}
+
+static inline void sig_bucket_unlock(unsigned int bkt, u64 locked)
+{
+    u64 now = local_clock();
+    
+    perf_hist_add(&this_cpu_ptr(&perf_locks)->hold, now > locked ? now - locked : 0);
+    spin_unlock(&sig_bucket_locks[bkt]);
+}
+
+/*
+ * Start-of-tick bookkeeping: drift against the expected start, unless
+ * this tick changed the interval (a config write re-armed the timer)
+ */
+static void perf_tick_start(u64 now, bool rearmed)
+{
+    u64 due = sampler_perf.due_ns;
+    u64 interval = (u64)cfg.sample_interval_ms * NSEC_PER_MSEC;
+    u64 drift;
+    
+    if (!due || rearmed)
+        return;
+    
+    drift = now > due ? now - due : 0;
+    perf_hist_add(&sampler_perf.drift, drift);
+    if (drift >= interval)
+        sampler_perf.missed += div64_u64(drift, interval);
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 17, 0)
+#define pde_data(inode) PDE_DATA(inode)
+#endif
+
+/*
+ * seq_read() charging each call to the view's perf_reads entry, which
+ * is the proc entry's data. With single_open() the first call renders
+ * the whole view, later ones only copy; the signature table views
+ * render one buffer per call.
+ */
+static ssize_t perf_seq_read(struct file *file, char __user *buf,
+                             size_t size, loff_t *ppos)
+{
+    struct perf_read_stats *st = pde_data(file_inode(file));
+    u64 start = ktime_get_ns();
+    ssize_t ret = seq_read(file, buf, size, ppos);
+    u64 ns = ktime_get_ns() - start;
+    
+    spin_lock(&st->lock);
+    perf_hist_add(&st->hist, ns);
+    spin_unlock(&st->lock);
+    
+    return ret;
+}
+
+/* ============================================
+ * PROCESS SIGNATURE MANAGEMENT
+ * ============================================ */
+
+/* Hash bucket holding a PID */
+static inline unsigned int sig_bucket(pid_t pid)
+{
+    return hash_min(pid, PROC_HASH_BITS);
+}
+
+/* Shard owning a PID's bucket */
+static inline unsigned int sig_shard(pid_t pid)
+{
+    return sig_bucket(pid) >> shard_shift;
+}
+
+/*
+ * Remove a process signature
+ * Must be called with the signature's bucket lock held. The object
+ * returns to the pool after a grace period so concurrent readers stay
+ * safe.
+ */
+static void remove_signature(struct proc_signature *sig)
+{
+    unsigned int slot = sig_slot(sig);
+    
+    /* Clearing FLAG_ACTIVE drops the slot from the snapshot at once */
+    emit_spike_events(slot, sig_cols.flags[slot], 0);
+    WRITE_ONCE(sig_cols.flags[slot], 0);
+    hash_del_rcu(&sig->hash_node);
+    call_rcu(&sig->rcu, sig_free_rcu);
+}
+
+/* Remove a signature, taking its bucket lock */
+static void evict_signature(struct proc_signature *sig)
+{
+    unsigned int bkt = sig_bucket(sig->pid);
+    u64 locked;
+    
+    locked = sig_bucket_lock(bkt);
+    remove_signature(sig);
+    sig_bucket_unlock(bkt, locked);
+}
+
+/*
+ * Find or create a signature for a process or thread
+ * Must be called from the shard owning the PID's bucket: only that
+ * shard inserts or removes entries there, so the lookup needs no lock.
+ * A signature whose start time differs belongs to an earlier process
+ * that reused the PID and is replaced. A leader thread's signature
+ * shares its ID with the process signature and is told apart by
+ * ->thread.
+ */
+static struct proc_signature *get_or_create_signature(struct sample_shard *shard,
+                                                      const struct proc_sample *s)
+{
+    struct proc_signature *sig;
+    pid_t pid = s->pid;
+    u64 start_time = s->start_time;
+    unsigned int bkt = sig_bucket(pid);
+    u64 locked;
+    
+    /* Search existing */
+    hash_for_each_possible(proc_signatures, sig, hash_node, pid) {
+        if (sig->pid == pid && sig->thread == s->thread) {
+            if (sig->start_time == start_time) {
+                return sig;
+            }
+            evict_signature(sig);
+            atomic_long_inc(&evicted_reused);
+            break;
+        }
+    }
+    
+    /* Create new signature; an empty pool means the table is full */
+    sig = sig_pool_pop(shard);
+    if (!sig) {
+        return NULL;
+    }
+    
+    memset(sig, 0, sizeof(*sig));
+    atomic_inc(&total_tracked);
+    
+    sig->pid = pid;
+    sig->tgid = s->tgid;
+    sig->thread = s->thread;
+    strncpy(sig->comm, s->comm, TASK_COMM_LEN - 1);
+    sig->created = jiffies;
+    sig->last_update = jiffies;
+    sig->start_time = start_time;
+    sig_columns_init(sig_slot(sig), s);
+    
+    locked = sig_bucket_lock(bkt);
+    hash_add_rcu(proc_signatures, &sig->hash_node, pid);
+    sig_bucket_unlock(bkt, locked);
+    
+    return sig;
+}
+
+/*
+ * Lockless lookup for the task walk (rcu_read_lock() held)
+ * Only the adaptive sampling state is read; a stale or just-evicted
+ * signature merely makes the task due for a sample.
+ */
+static struct proc_signature *find_signature_rcu(pid_t pid, u64 start_time, bool thread)
+{
+    struct proc_signature *sig;
+    
+    hash_for_each_possible_rcu(proc_signatures, sig, hash_node, pid) {
+        if (sig->pid == pid && sig->thread == thread)
+            return sig->start_time == start_time ? sig : NULL;
+    }
+    return NULL;
+}
+
+/*
+ * Offer one thread's CPU sample as its process's busiest this tick
+ * Coordinator only, with no shard running. The task walk clears the
+ * hot_tid column of every process first, so it only names threads
+ * seen in the current tick.
+ */
+static void note_hot_thread(struct proc_signature *psig, pid_t tid, int cpu)
+{
+    if (psig->hot_gen != sample_gen || cpu > psig->hot_cpu) {
+        psig->hot_gen = sample_gen;
+        psig->hot_cpu = cpu;
+        SIG_COL(psig, hot_tid) = tid;
+    }
+}
+
+/* ============================================
+ * TOP-K RANKING
+ * ============================================ */
+
+/*
+ * Sift a hole at i down a min-heap of nr entries to where key fits,
+ * moving smaller children up; returns the hole's final slot
+ */
+static unsigned int top_sift_down(struct top_entry *e, unsigned int nr,
+                                  unsigned int i, int key)
+{
+    for (;;) {
+        unsigned int c = 2 * i + 1;
+        
+        if (c >= nr)
+            break;
+        if (c + 1 < nr && e[c + 1].key < e[c].key)
+            c++;
+        if (e[c].key >= key)
+            break;
+        e[i] = e[c];
+        i = c;
+    }
+    return i;
+}
+
+/* Keep src if it is among the TOP_K largest keys offered so far */
+static void top_insert(struct top_heap *h, const struct top_entry *src)
+{
+    unsigned int i;
+    
+    if (h->nr < TOP_K) {
+        i = h->nr++;
+        while (i && h->e[(i - 1) / 2].key > src->key) {
+            h->e[i] = h->e[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else if (src->key > h->e[0].key) {
+        i = top_sift_down(h->e, h->nr, 0, src->key);
+    } else {
+        return;
+    }
+    h->e[i] = *src;
+}
+
+/*
+ * Offer a signature to one order. Only positive keys are ranked, and
+ * the common case, a key below a full heap's root, costs a compare.
+ */
+static void top_offer(struct top_heap *h, unsigned int slot, int key)
+{
+    struct top_entry e;
+    int r;
+    
+    if (key <= 0 || (h->nr == TOP_K && key <= h->e[0].key))
+        return;
+    
+    e.key = key;
+    e.pid = sig_cols.pid[slot];
+    e.flags = sig_cols.flags[slot];
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        e.ema[r] = sig_cols.ema[r][slot];
+        e.roc[r] = sig_cols.roc[r][slot];
+    }
+    memcpy(e.comm, sig_cols.comm[slot], sizeof(e.comm));
+    top_insert(h, &e);
+}
+
+/* Rank a freshly updated process signature in its shard's heaps */
+static void top_rank(struct sample_shard *shard, unsigned int slot)
+{
+    int cpu_roc = sig_cols.roc[SMARTSCHED_RES_CPU][slot];
+    int mem_roc = sig_cols.roc[SMARTSCHED_RES_MEM][slot];
+    int io_roc = sig_cols.roc[SMARTSCHED_RES_IO][slot];
+    
+    top_offer(&shard->top[TOP_SCORE], slot, abs(cpu_roc) + abs(mem_roc) + abs(io_roc));
+    top_offer(&shard->top[TOP_CPU], slot, cpu_roc);
+    top_offer(&shard->top[TOP_MEM], slot, mem_roc);
+    top_offer(&shard->top[TOP_IO], slot, io_roc);
+}
+
+/* Sort a heap largest key first, in place */
+static void top_sort(struct top_heap *h)
+{
+    unsigned int n = h->nr;
+    
+    while (n > 1) {
+        struct top_entry last = h->e[--n];
+        unsigned int i;
+        
+        h->e[n] = h->e[0];
+        i = top_sift_down(h->e, n, 0, last.key);
+        h->e[i] = last;
+    }
+}
+
+/*
+ * Merge the shards' heaps into the published top-K tables
+ * Called by the coordinator once the shards are flushed. The merge runs
+ * unlocked; the swap waits at most for a reader's copy of top_pub.
+ */
+static void publish_top(void)
+{
+    struct top_heap *t;
+    unsigned int i, j;
+    int o;
+    
+    for (o = 0; o < TOP_NR_ORDERS; o++) {
+        top_stage[o].nr = 0;
+        for (i = 0; i < nr_shards; i++) {
+            struct top_heap *h = &sample_shards[i].top[o];
+            
+            for (j = 0; j < h->nr; j++)
+                top_insert(&top_stage[o], &h->e[j]);
+        }
+        top_sort(&top_stage[o]);
+    }
+    
+    mutex_lock(&top_lock);
+    t = top_pub;
+    top_pub = top_stage;
+    top_stage = t;
+    mutex_unlock(&top_lock);
+}
+
+/* Step one resource's forecaster; returns its forecast flag, if any */
+static unsigned int update_forecast(unsigned int slot, int res, int sample)
+{
+    struct smartsched_forecast fc = {
+        .level = sig_cols.fc_level[res][slot],
+        .trend = sig_cols.fc_trend[res][slot],
+        .var = sig_cols.fc_var[res][slot],
+    };
+    unsigned int eta;
+    unsigned int flag = smartsched_forecast_step(&cfg.model, res, &fc, sample, &eta);
+    
+    sig_cols.fc_level[res][slot] = fc.level;
+    sig_cols.fc_trend[res][slot] = fc.trend;
+    sig_cols.fc_var[res][slot] = fc.var;
+    sig_cols.eta[res][slot] = eta;
+    return flag;
+}
+
+/*
+ * Shift a slot's spike histories by the ticks since its last sample
+ * Ticks skipped by adaptive sampling come in as unflagged: only a
+ * signature without flags is demoted to a slower tier.
+ */
+static void age_spike_history(unsigned int slot, u32 ticks)
+{
+    int r;
+    
+    for (r = 0; r < SMARTSCHED_NR_RES; r++)
+        sig_cols.history[r][slot] = ticks < SMARTSCHED_HISTORY_TICKS ?
+                                    sig_cols.history[r][slot] << ticks : 0;
+}
+
+/*
+ * Finish the tick of one slot whose EMA / RoC update_signatures() has
+ * already stepped, with model_flags the spike bits it predicted
+ * Runs the trend forecasts and sets the prediction flags. Called only
+ * by the shard owning the slot, which also ranks it; readers may
+ * observe a partially updated slot, which is acceptable for statistics
+ * output.
+ */
+static void update_signature(struct sample_shard *shard, unsigned int slot,
+                             unsigned int model_flags)
+{
+    unsigned int old_flags = sig_cols.flags[slot];
+    unsigned int new_flags = model_flags, flags;
+    bool active = false;
+    int r;
+    
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        new_flags |= update_forecast(slot, r, sig_cols.sample[r][slot]);
+        active |= sig_cols.roc[r][slot] != 0;
+        
+        if (new_flags & (1U << r)) {
+            sig_cols.spikes[r][slot]++;
+            sig_cols.history[r][slot] |= 1;
+            if (!sig_cols.since[r][slot])
+                sig_cols.since[r][slot] = sample_now;
+            atomic_inc(&total_predictions);
+        }
+    }
+    
+    flags = (old_flags & ~(FLAG_SPIKE_PREDICTED | FLAG_SPIKE_FORECAST)) | new_flags;
+    WRITE_ONCE(sig_cols.flags[slot], flags);
+    
+    /* Forecasts are counted once, when raised */
+    if (new_flags & ~old_flags & FLAG_SPIKE_FORECAST)
+        atomic_inc(&total_forecasts);
+    
+    emit_spike_events(slot, old_flags, flags);
+    
+    /* Clear events carried the start of the spike that ended */
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        if (!(flags & (1U << r)))
+            sig_cols.since[r][slot] = 0;
+    }
+    
+    if (active)
+        sig_cols.last_active[slot] = jiffies;
+    sig_cols.total_samples[slot]++;
+    
+    if (!(flags & FLAG_THREAD))
+        top_rank(shard, slot);
+}
+
+/*
+ * Move a slot between sampling tiers after a sample
+ * Any rate of change, spike or forecast flag promotes straight back to tier 0;
+ * idle_samples consecutive flat samples demote by one tier.
+ */
+static void update_sampling_tier(unsigned int slot)
+{
+    int idle_samples = cfg.idle_samples;
+    
+    if (!idle_samples || sig_cols.roc[SMARTSCHED_RES_CPU][slot] ||
+        sig_cols.roc[SMARTSCHED_RES_MEM][slot] || sig_cols.roc[SMARTSCHED_RES_IO][slot] ||
+        (sig_cols.flags[slot] & (FLAG_SPIKE_PREDICTED | FLAG_SPIKE_FORECAST))) {
+        sig_cols.tier[slot] = 0;
+        sig_cols.stable[slot] = 0;
+        return;
+    }
+    
+    if (++sig_cols.stable[slot] >= idle_samples && sig_cols.tier[slot] < ADAPT_NR_TIERS - 1) {
+        sig_cols.tier[slot]++;
+        sig_cols.stable[slot] = 0;
+    }
+}
+
+/*
+ * Step the n consecutive due slots from first on their stored samples
+ * The EMA / RoC / threshold step runs column-wise over the whole run,
+ * branch free on contiguous arrays the compiler can vectorise, before
+ * each slot is finished on its own. n <= SIG_BATCH.
+ */
+static void update_signatures(struct sample_shard *shard, unsigned int first,
+                              unsigned int n)
+{
+    u32 model_flags[SIG_BATCH];
+    unsigned int i;
+    int r;
+    
+    memset(model_flags, 0, n * sizeof(model_flags[0]));
+    for (r = 0; r < SMARTSCHED_NR_RES; r++)
+        smartsched_model_step_batch(&cfg.model, r, &sig_cols.ema[r][first],
+                                    &sig_cols.prev[r][first], &sig_cols.roc[r][first],
+                                    &sig_cols.sample[r][first], model_flags, n);
+    
+    for (i = 0; i < n; i++) {
+        update_signature(shard, first + i, model_flags[i]);
+        update_sampling_tier(first + i);
+    }
+}
+
+/* ============================================
+ * EVICTION
+ * ============================================ */
+
+/*
+ * Generation sweep: remove signatures of processes that were not seen
+ * by the task walk this tick (they have exited). Runs in the shard
+ * owning the bucket range [first, last).
+ */
+static void sweep_exited(unsigned int first, unsigned int last)
+{
+    struct proc_signature *sig;
+    struct hlist_node *tmp;
+    unsigned int bkt;
+    u64 locked;
+    
+    for (bkt = first; bkt < last; bkt++) {
+        locked = sig_bucket_lock(bkt);
+        hlist_for_each_entry_safe(sig, tmp, &proc_signatures[bkt], hash_node) {
+            if (sig->seen_gen != sample_gen) {
+                remove_signature(sig);
+                atomic_long_inc(&evicted_exited);
+            }
+        }
+        sig_bucket_unlock(bkt, locked);
+    }
+}
+
+/*
+ * LRU eviction: the table is full and new PIDs were refused, so free
+ * up to @want of the shard's least recently active signatures. Victims
+ * return to the pool after a grace period; refused PIDs are picked up
+ * again on a later tick.
+ */
+static void evict_lru(unsigned int first, unsigned int last, unsigned int want)
+{
+    struct proc_signature *victims[EVICT_LRU_BATCH];
+    struct proc_signature *sig;
+    unsigned long idle_cutoff = jiffies - msecs_to_jiffies(EVICT_LRU_MIN_IDLE_MS);
+    unsigned int nr = 0, bkt, i, j;
+    
+    want = min_t(unsigned int, want, EVICT_LRU_BATCH);
+    
+    /* Keep the @want oldest candidates, sorted by last_active */
+    for (bkt = first; bkt < last; bkt++) {
+        hlist_for_each_entry(sig, &proc_signatures[bkt], hash_node) {
+            unsigned long last_active = SIG_COL(sig, last_active);
+            
+            if (!time_before(last_active, idle_cutoff))
+                continue;
+            if (nr == want &&
+                !time_before(last_active, SIG_COL(victims[nr - 1], last_active)))
+                continue;
+            
+            i = (nr < want) ? nr++ : nr - 1;
+            while (i > 0 && time_before(last_active, SIG_COL(victims[i - 1], last_active))) {
+                victims[i] = victims[i - 1];
+                i--;
+            }
+            victims[i] = sig;
+        }
+    }
+    
+    for (j = 0; j < nr; j++) {
+        evict_signature(victims[j]);
+        atomic_long_inc(&evicted_lru);
+    }
+}
+
+/* ============================================
+ * CGROUP SIGNATURES
+ * ============================================ */
+
+/*
+ * A container's spike is often many member processes growing together,
+ * each under threshold on its own. The coordinator sums the samples of
+ * each cgroup's members during the tick and runs the model over the
+ * sums. Only the coordinator inserts, updates or removes cgroup
+ * signatures, so it needs no locks; readers walk the table under RCU.
+ */
+
+static struct cgroup_signature *cg_pool_pop(void)
+{
+    struct cgroup_signature *cg = NULL;
+    
+    spin_lock_bh(&cg_pool_lock);
+    if (cg_pool_free)
+        cg = cg_pool[--cg_pool_free];
+    spin_unlock_bh(&cg_pool_lock);
+    
+    return cg;
+}
+
+/* Return a cgroup signature to the pool (may run from RCU softirq context) */
+static void cg_pool_push(struct cgroup_signature *cg)
+{
+    spin_lock_bh(&cg_pool_lock);
+    cg_pool[cg_pool_free++] = cg;
+    spin_unlock_bh(&cg_pool_lock);
+}
+
+static void cg_free_rcu(struct rcu_head *head)
+{
+    cg_pool_push(container_of(head, struct cgroup_signature, rcu));
+    atomic_dec(&cgroups_tracked);
+}
+
+static int init_cg_pool(void)
+{
+    unsigned int i;
+    
+    cg_slots = kvcalloc(MAX_TRACKED_CGROUPS, sizeof(*cg_slots), GFP_KERNEL);
+    cg_pool = kvmalloc_array(MAX_TRACKED_CGROUPS, sizeof(*cg_pool), GFP_KERNEL);
+    if (!cg_slots || !cg_pool) {
+        kvfree(cg_slots);
+        kvfree(cg_pool);
+        cg_slots = NULL;
+        cg_pool = NULL;
+        return -ENOMEM;
+    }
+    
+    for (i = 0; i < MAX_TRACKED_CGROUPS; i++)
+        cg_pool[i] = &cg_slots[i];
+    cg_pool_free = MAX_TRACKED_CGROUPS;
+    return 0;
+}
+
+static void destroy_cg_pool(void)
+{
+    kvfree(cg_pool);
+    kvfree(cg_slots);
+}
+
+/*
+ * Find or create the signature of a task's cgroup
+ * Coordinator only, under rcu_read_lock(). Tasks in the root cgroup
+ * are not aggregated: it has no weights to adjust and would only
+ * duplicate the whole-system total.
+ */
+static struct cgroup_signature *get_cgroup_signature(struct task_struct *task)
+{
+#ifdef CONFIG_CGROUPS
+    struct cgroup *cgrp = task_dfl_cgroup(task);
+    struct cgroup_signature *cg;
+    u64 id;
+    
+    if (!cgrp || !cgroup_parent(cgrp))
+        return NULL;
+    
+    id = cgroup_id(cgrp);
+    hash_for_each_possible(cgroup_signatures, cg, hash_node, id) {
+        if (cg->id == id)
+            return cg;
+    }
+    
+    cg = cg_pool_pop();
+    if (!cg) {
+        atomic_long_inc(&cgroups_dropped);
+        return NULL;
+    }
+    
+    memset(cg, 0, sizeof(*cg));
+    cg->id = id;
+    if (cgroup_path(cgrp, cg->path, sizeof(cg->path)) < 0)
+        strscpy(cg->path, "?", sizeof(cg->path));
+    
+    atomic_inc(&cgroups_tracked);
+    hash_add_rcu(cgroup_signatures, &cg->hash_node, id);
+    return cg;
+#else
+    return NULL;
+#endif
+}
+
+/* Add one member process's samples to its cgroup's sums for this tick */
+static void cgroup_account(struct cgroup_signature *cg, int cpu, int mem, int io)
+{
+    if (!cg)
+        return;
+    
+    if (cg->acc_gen != sample_gen) {
+        cg->acc_gen = sample_gen;
+        cg->acc_tasks = 0;
+        cg->acc_cpu = 0;
+        cg->acc_mem = 0;
+        cg->acc_io = 0;
+    }
+    
+    cg->acc_tasks++;
+    cg->acc_cpu += cpu;
+    cg->acc_mem += mem;
+    cg->acc_io += io;
+}
+
+/* Count a member that was not sampled this tick with its last samples */
+static void cgroup_account_last(struct cgroup_signature *cg, struct proc_signature *sig)
+{
+    if (sig)
+        cgroup_account(cg, SIG_COL(sig, sample[SMARTSCHED_RES_CPU]),
+                       SIG_COL(sig, sample[SMARTSCHED_RES_MEM]),
+                       SIG_COL(sig, sample[SMARTSCHED_RES_IO]));
+    else
+        cgroup_account(cg, 0, 0, 0);
+}
+
+/* Sums are samples to the model: clamped so its int EMA cannot overflow */
+static inline int cgroup_sum(s64 acc)
+{
+    return (int)clamp_t(s64, acc, 0, SMARTSCHED_SAMPLE_MAX);
+}
+
+/*
+ * Step the model and forecasters of every cgroup that had members
+ * this tick and drop the ones that had none (emptied or removed).
+ * Idle and deferred members count too, so a cgroup under load is not
+ * mistaken for an empty one.
+ */
+static void update_cgroup_signatures(void)
+{
+    struct cgroup_signature *cg;
+    struct hlist_node *tmp;
+    int bkt;
+    
+    hash_for_each_safe(cgroup_signatures, bkt, tmp, cg, hash_node) {
+        unsigned int flags, eta;
+        
+        if (cg->acc_gen != sample_gen) {
+            hash_del_rcu(&cg->hash_node);
+            call_rcu(&cg->rcu, cg_free_rcu);
+            continue;
+        }
+        
+        cg->cpu_last = cgroup_sum(cg->acc_cpu);
+        cg->mem_last = cgroup_sum(cg->acc_mem);
+        cg->io_last = cgroup_sum(cg->acc_io);
+        cg->nr_tasks = cg->acc_tasks;
+        
+        /* Start at the first valid sums, as seed_first_samples() */
+        if (cg->total_samples == 0) {
+            cg->mem_ema = cg->mem_last;
+            cg->io_ema = cg->io_last;
+        } else if (cg->total_samples == 1) {
+            cg->cpu_ema = cg->cpu_last;
+        }
+        
+        flags = smartsched_model_step(&cfg.model, SMARTSCHED_RES_CPU,
+                                      &cg->cpu_ema, &cg->cpu_prev,
+                                      &cg->cpu_roc, cg->cpu_last) |
+                smartsched_model_step(&cfg.model, SMARTSCHED_RES_MEM,
+                                      &cg->mem_ema, &cg->mem_prev,
+                                      &cg->mem_roc, cg->mem_last) |
+                smartsched_model_step(&cfg.model, SMARTSCHED_RES_IO,
+                                      &cg->io_ema, &cg->io_prev,
+                                      &cg->io_roc, cg->io_last);
+        cg->spikes_predicted += hweight32(flags);
+        
+        flags |= smartsched_forecast_step(&cfg.model, SMARTSCHED_RES_CPU,
+                                          &cg->fc[SMARTSCHED_RES_CPU], cg->cpu_last, &eta) |
+                 smartsched_forecast_step(&cfg.model, SMARTSCHED_RES_MEM,
+                                          &cg->fc[SMARTSCHED_RES_MEM], cg->mem_last, &eta) |
+                 smartsched_forecast_step(&cfg.model, SMARTSCHED_RES_IO,
+                                          &cg->fc[SMARTSCHED_RES_IO], cg->io_last, &eta);
+        WRITE_ONCE(cg->flags, flags);
+        cg->total_samples++;
+    }
+}
+
+/* ============================================
+ * WARM START
+ * ============================================ */
+
+/* Seeds sort by pid, process before thread of the same id */
+static int seed_cmp(const void *a, const void *b)
+{
+    const struct smartsched_seed *x = a, *y = b;
+    
+    if (x->pid != y->pid)
+        return x->pid < y->pid ? -1 : 1;
+    return (int)(x->flags & FLAG_THREAD) - (int)(y->flags & FLAG_THREAD);
+}
+
+/*
+ * Queue seeds written to /dev/smartsched for the next tick
+ * Whole struct smartsched_seed records only, at most max_tracked
+ * pending at once; records without a pid or interval are dropped.
+ * Returns the bytes consumed, which may be short when the queue fills.
+ */
+static ssize_t seed_queue(const char __user *buf, size_t count)
+{
+    size_t n = count / sizeof(struct smartsched_seed);
+    unsigned int i, kept;
+    ssize_t ret;
+    
+    if (!n || count % sizeof(struct smartsched_seed))
+        return -EINVAL;
+    
+    mutex_lock(&seed_lock);
+    if (!seed_pending) {
+        seed_pending = kvmalloc_array(max_tracked, sizeof(*seed_pending), GFP_KERNEL);
+        if (!seed_pending) {
+            ret = -ENOMEM;
+            goto out;
+        }
+    }
+    
+    n = min_t(size_t, n, max_tracked - seed_pending_nr);
+    if (!n) {
+        ret = -ENOSPC;
+        goto out;
+    }
+    if (copy_from_user(seed_pending + seed_pending_nr, buf, n * sizeof(*seed_pending))) {
+        ret = -EFAULT;
+        goto out;
+    }
+    
+    for (i = 0, kept = seed_pending_nr; i < n; i++) {
+        struct smartsched_seed *seed = &seed_pending[seed_pending_nr + i];
+        
+        if (seed->pid <= 0 || !seed->interval_ms)
+            continue;
+        seed->flags &= FLAG_THREAD;
+        seed_pending[kept++] = *seed;
+    }
+    seed_pending_nr = kept;
+    ret = n * sizeof(*seed_pending);
+out:
+    mutex_unlock(&seed_lock);
+    return ret;
+}
+
+/*
+ * Retire an expired seed table and activate the seeds queued since
+ * the last tick for the next SMARTSCHED_SEED_TTL_TICKS ticks
+ * Called by the coordinator before the task walk, with no shard
+ * running; new seeds replace any still active.
+ */
+static void seed_install(void)
+{
+    struct smartsched_seed *seeds;
+    unsigned int nr;
+    
+    if (seed_active && (s32)(sample_gen - seed_expires) >= 0) {
+        kvfree(seed_active);
+        seed_active = NULL;
+        seed_active_nr = 0;
+    }
+    if (!READ_ONCE(seed_pending_nr))
+        return;
+    
+    mutex_lock(&seed_lock);
+    seeds = seed_pending;
+    nr = seed_pending_nr;
+    seed_pending = NULL;
+    seed_pending_nr = 0;
+    mutex_unlock(&seed_lock);
+    
+    sort(seeds, nr, sizeof(*seeds), seed_cmp, NULL);
+    kvfree(seed_active);
+    seed_active = seeds;
+    seed_active_nr = nr;
+    seed_expires = sample_gen + SMARTSCHED_SEED_TTL_TICKS;
+    pr_info("SmartScheduler: %u warm-start seeds active for %d ticks\n",
+            nr, SMARTSCHED_SEED_TTL_TICKS);
+}
+
+/*
+ * Restore a young signature's state from the seed saved for it
+ * The EMAs, spike counts and history carry on where the checkpoint
+ * left them, the history shifted by the ticks missed since; the
+ * forecasters restart level with the EMA. Called by the shard owning
+ * the slot before its samples are stored; the seed table is read-only
+ * while shards run.
+ */
+static void seed_apply(unsigned int slot)
+{
+    const struct smartsched_seed *seed;
+    struct smartsched_seed key;
+    u32 flags = sig_cols.flags[slot];
+    u64 ticks = 1;
+    int r;
+    
+    if ((flags & FLAG_WARM) || sig_cols.total_samples[slot] >= SMARTSCHED_SEED_TTL_TICKS)
+        return;
+    
+    key.pid = sig_cols.pid[slot];
+    key.flags = flags & FLAG_THREAD;
+    seed = bsearch(&key, seed_active, seed_active_nr, sizeof(*seed), seed_cmp);
+    if (!seed || seed->start_time_ns != sig_cols.start_time[slot])
+        return;
+    
+    /* Ticks missed read as unflagged, and this one starts a new bit */
+    if (sample_now > seed->saved_ns)
+        ticks = max_t(u64, div64_u64(sample_now - seed->saved_ns,
+                                     (u64)seed->interval_ms * NSEC_PER_MSEC), 1);
+    
+    for (r = 0; r < SMARTSCHED_NR_RES; r++) {
+        sig_cols.ema[r][slot] = seed->ema[r];
+        sig_cols.prev[r][slot] = seed->ema[r];
+        sig_cols.fc_level[r][slot] = seed->ema[r];
+        sig_cols.fc_trend[r][slot] = 0;
+        sig_cols.fc_var[r][slot] = 0;
+        sig_cols.spikes[r][slot] = seed->spikes[r];
+        sig_cols.history[r][slot] = ticks < SMARTSCHED_HISTORY_TICKS ?
+                                    seed->spike_history[r] << ticks : 0;
+        sig_cols.since[r][slot] = 0;
+    }
+    sig_cols.total_samples[slot] += seed->total_samples;
+    WRITE_ONCE(sig_cols.flags[slot], flags | FLAG_WARM);
+    atomic_long_inc(&seeds_applied);
+}
+
+/*
+ * Start a new signature's EMAs at its first valid samples (see
+ * smartsched_model.h): memory and I/O from the first sample, CPU from
+ * the second, the first having no interval. Warm signatures already
+ * carry their EMAs.
+ */
+static inline void seed_first_samples(unsigned int slot)
+{
+    u64 n = sig_cols.total_samples[slot];
+    
+    if (sig_cols.flags[slot] & FLAG_WARM)
+        return;
+    if (n == 0) {
+        sig_cols.ema[SMARTSCHED_RES_MEM][slot] = sig_cols.sample[SMARTSCHED_RES_MEM][slot];
+        sig_cols.ema[SMARTSCHED_RES_IO][slot] = sig_cols.sample[SMARTSCHED_RES_IO][slot];
+    } else if (n == 1) {
+        sig_cols.ema[SMARTSCHED_RES_CPU][slot] = sig_cols.sample[SMARTSCHED_RES_CPU][slot];
+    }
+}
+
+static void seed_free(void)
+{
+    kvfree(seed_pending);
+    kvfree(seed_active);
+    seed_pending = seed_active = NULL;
+    seed_pending_nr = seed_active_nr = 0;
+}
+
+/* ============================================
+ * BINARY SNAPSHOT INTERFACE
+ * ============================================ */
+
+/*
+ * Publish the signature table into the shared snapshot
+ * Called by the coordinator after every tick, with no shard running;
+ * it is the only writer. Each exported column is copied as the
+ * shards' used slot ranges back to back, so the whole publish is
+ * SMARTSCHED_NR_COLUMNS x nr_shards memcpy() calls. Readers retry
+ * while seq is odd or changes under them.
+ */
+static void publish_snapshot(void)
+{
+    struct smartsched_snapshot_header *hdr = snapshot_buf;
+    unsigned int c, i, n = 0;
+    
+    WRITE_ONCE(hdr->seq, hdr->seq + 1);
+    smp_wmb();
+    
+    for (c = 0; c < SMARTSCHED_NR_COLUMNS; c++) {
+        size_t size = sig_col_export[c].size;
+        void *dst = snapshot_buf + hdr->columns[c].offset;
+        
+        n = 0;
+        for (i = 0; i < nr_shards; i++) {
+            const struct sample_shard *shard = &sample_shards[i];
+            
+            memcpy(dst + (size_t)n * size,
+                   sig_col_export[c].base + (size_t)shard->slot_first * size,
+                   (size_t)shard->slot_hwm * size);
+            n += shard->slot_hwm;
+        }
+    }
+    
+    hdr->nr_records = n;
+    hdr->generation = sample_gen;
+    hdr->sample_interval_ms = cfg.sample_interval_ms;
+    hdr->timestamp_ns = ktime_get_ns();
+    
+    smp_wmb();
+    WRITE_ONCE(hdr->seq, hdr->seq + 1);
+}
+
+/* Map the snapshot read-only into the caller */
+static int snapshot_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    
+    return remap_vmalloc_range(vma, snapshot_buf, vma->vm_pgoff);
+}
+
+/* Writes are warm-start seeds, see seed_queue() */
+static ssize_t snapshot_write(struct file *file, const char __user *buf,
+                              size_t count, loff_t *ppos)
+{
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    return seed_queue(buf, count);
+}
+
+static const struct file_operations snapshot_fops = {
+    .owner = THIS_MODULE,
+    .mmap = snapshot_mmap,
+    .write = snapshot_write,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice snapshot_dev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "smartsched",
+    .fops = &snapshot_fops,
+    .mode = 0644,
+};
+
+/*
+ * Allocate the snapshot and register /dev/smartsched
+ * One column per SMARTSCHED_COL_* with a row for every slot
+ */
+static int init_snapshot(void)
+{
+    struct smartsched_snapshot_header *hdr;
+    size_t header_size = ALIGN(sizeof(*hdr), SMP_CACHE_BYTES);
+    size_t off = header_size;
+    int c, ret;
+    
+    for (c = 0; c < SMARTSCHED_NR_COLUMNS; c++)
+        off += ALIGN((size_t)max_tracked * sig_col_export[c].size, SMP_CACHE_BYTES);
+    snapshot_size = PAGE_ALIGN(off);
+    snapshot_buf = vmalloc_user(snapshot_size);
+    if (!snapshot_buf)
+        return -ENOMEM;
+    
+    hdr = snapshot_buf;
+    hdr->magic = SMARTSCHED_SNAPSHOT_MAGIC;
+    hdr->version = SMARTSCHED_ABI_VERSION;
+    hdr->header_size = header_size;
+    hdr->nr_columns = SMARTSCHED_NR_COLUMNS;
+    hdr->capacity = max_tracked;
+    hdr->sample_interval_ms = cfg.sample_interval_ms;
+    hdr->map_size = snapshot_size;
+    
+    off = header_size;
+    for (c = 0; c < SMARTSCHED_NR_COLUMNS; c++) {
+        hdr->columns[c].offset = off;
+        hdr->columns[c].size = sig_col_export[c].size;
+        off += ALIGN((size_t)max_tracked * sig_col_export[c].size, SMP_CACHE_BYTES);
+    }
+    
+    ret = misc_register(&snapshot_dev);
+    if (ret) {
+        vfree(snapshot_buf);
+        return ret;
+    }
+    
+    snapshot_registered = true;
+    return 0;
+}
+
+/* Open mappings pin the module through vm_file, so nothing maps it here */
+static void destroy_snapshot(void)
+{
+    if (snapshot_registered)
+        misc_deregister(&snapshot_dev);
+    vfree(snapshot_buf);
+    seed_free();
+}
+
+/* ============================================
+ * SAMPLING FUNCTIONS
+ * ============================================ */
+
+/*
+ * Get cumulative CPU runtime and major faults of a process
+ * Sums all live threads plus the counts of threads that already
+ * exited. Must be called under rcu_read_lock().
+ */
+static u64 get_task_counters(struct task_struct *task, unsigned long *majflt)
+{
+    struct task_struct *t;
+    u64 runtime = READ_ONCE(task->signal->sum_sched_runtime);
+    unsigned long faults = READ_ONCE(task->signal->maj_flt);
+    
+    for_each_thread(task, t) {
+        runtime += READ_ONCE(t->se.sum_exec_runtime);
+        faults += READ_ONCE(t->maj_flt);
+    }
+    
+    *majflt = faults;
+    return runtime;
+}
+
+/*
+ * Read a process's resident pages by kind
+ * task_lock() keeps exit_mm() from dropping the mm under us; the
+ * counters themselves are lockless reads.
+ */
+static void get_task_rss(struct task_struct *task, struct proc_sample *s)
+{
+    struct mm_struct *mm;
+    
+    s->rss_anon = 0;
+    s->rss_file = 0;
+    s->rss_shmem = 0;
+    
+    task_lock(task);
+    mm = task->mm;
+    if (mm) {
+        s->rss_anon = get_mm_counter(mm, MM_ANONPAGES);
+        s->rss_file = get_mm_counter(mm, MM_FILEPAGES);
+        s->rss_shmem = get_mm_counter(mm, MM_SHMEMPAGES);
+    }
+    task_unlock(task);
+}
+
+/*
+ * Cheap activity probe: the leader's context switch count plus its
+ * thread count. Any wakeup of the leader, or a thread starting or
+ * exiting, changes it. A worker thread waking while the leader sleeps
+ * is not seen, so such a process waits at most one tier period.
+ */
+static unsigned long get_wake_probe(struct task_struct *task)
+{
+    return READ_ONCE(task->nvcsw) + READ_ONCE(task->nivcsw) + get_nr_threads(task);
+}
+
+/* Exact for a single thread: it cannot run without switching in */
+static unsigned long get_thread_wake_probe(struct task_struct *t)
+{
+    return READ_ONCE(t->nvcsw) + READ_ONCE(t->nivcsw);
+}
+
+/*
+ * Decide during the task walk whether a task needs a sample this tick
+ * Tasks without a signature, in tier 0, at the end of their tier
+ * period, or whose wake probe moved are sampled; the rest only have
+ * their signature marked as seen.
+ */
+static bool sample_due(struct proc_signature *sig, unsigned long wake_probe)
+{
+    unsigned int tier = sig ? SIG_COL(sig, tier) : 0;
+    
+    if (!tier || !READ_ONCE(cfg.idle_samples))
+        return true;
+    if (sample_gen - sig->sampled_gen >= (1U << (tier * ADAPT_TIER_SHIFT)))
+        return true;
+    return wake_probe != sig->wake_probe;
+}
+
+/*
+ * Get CPU usage sample for a signature
+ * Runtime consumed since the previous sample over the wall time that
+ * elapsed, normalised per CPU: 10000 = one CPU fully busy, so a
+ * multi-threaded process can exceed it. The first sample of a
+ * signature has no interval and reads as 0.
+ */
+static int get_cpu_sample(struct proc_signature *sig, u64 runtime, u64 now)
+{
+    int sample = 0;
+    
+    /* Runtime can briefly step back while an exiting thread is folded in */
+    if (sig->cpu_stamp && now > sig->cpu_stamp && runtime >= sig->cpu_runtime_prev) {
+        u64 delta_run = runtime - sig->cpu_runtime_prev;
+        u64 delta_wall = now - sig->cpu_stamp;
+        
+        sample = (int)min_t(u64, div64_u64(delta_run * 10000, delta_wall),
+                            SMARTSCHED_SAMPLE_MAX);
+    }
+    
+    sig->cpu_runtime_prev = runtime;
+    sig->cpu_stamp = now;
+    
+    return sample;
+}
+
+/*
+ * Get memory sample for a signature
+ * Weighted RSS plus the major fault rate since the previous sample,
+ * see smartsched_mem_sample(). Must run before get_cpu_sample(),
+ * which moves the shared cpu_stamp on.
+ */
+static int get_mem_sample(struct proc_signature *sig, const struct proc_sample *s, u64 now)
+{
+    u64 rate = 0;
+    
+    if (sig->cpu_stamp && now > sig->cpu_stamp && s->majflt >= sig->majflt_prev)
+        rate = div64_u64((u64)(s->majflt - sig->majflt_prev) * NSEC_PER_SEC,
+                         now - sig->cpu_stamp);
+    
+    sig->majflt_prev = s->majflt;
+    sig->majflt_rate = (unsigned int)min_t(u64, rate, UINT_MAX);
+    sig->rss_anon_kb = s->rss_anon << (PAGE_SHIFT - 10);
+    sig->rss_file_kb = s->rss_file << (PAGE_SHIFT - 10);
+    sig->rss_shmem_kb = s->rss_shmem << (PAGE_SHIFT - 10);
+    
+    return smartsched_mem_sample(sig->rss_anon_kb, sig->rss_file_kb,
+                                 sig->rss_shmem_kb, sig->majflt_rate);
+}
+
+/*
+ * Get I/O sample for a task
+ * Uses ioac if available
+ */
+static int get_io_sample(struct task_struct *task)
+{
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+    return (int)min_t(u64, (task->ioac.read_bytes + task->ioac.write_bytes) >> 10,
+                      SMARTSCHED_SAMPLE_MAX);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Grow the per-tick sample buffers to sample_buf_want entries
+ * Called from the coordinator between ticks (process context)
+ */
+static void resize_sample_buffers(void)
+{
+    struct proc_sample *buf, *sorted;
+    
+    buf = kvmalloc_array(sample_buf_want, sizeof(*buf), GFP_KERNEL);
+    sorted = kvmalloc_array(sample_buf_want, sizeof(*sorted), GFP_KERNEL);
+    if (!buf || !sorted) {
+        kvfree(buf);
+        kvfree(sorted);
+        sampler_perf.resize_failures++;
+        return;
+    }
+    
+    kvfree(sample_buf);
+    kvfree(sample_sorted);
+    sample_buf = buf;
+    sample_sorted = sorted;
+    sample_buf_size = sample_buf_want;
+}
+
+/*
+ * Shard work: apply this tick's samples to the shard's buckets
+ *
+ * Two passes: the first finds each sample's signature, turns the raw
+ * counters into samples and stores them in the slot's columns; the
+ * second steps the model over the due slots in slot order, which
+ * touches only the dense column arrays. A CPU sample without an
+ * interval (the first since the signature was created) is stored as
+ * the EMA itself, so it holds a warm signature's EMA instead of
+ * dragging it towards 0.
+ */
+static void sample_shard_work(struct work_struct *work)
+{
+    struct sample_shard *shard = container_of(work, struct sample_shard, work);
+    unsigned int first = (shard - sample_shards) << shard_shift;
+    unsigned int last = first + (1U << shard_shift);
+    unsigned int i, end;
+    
+    shard->pool_misses = 0;
+    
+    for (i = 0; i < shard->nr_samples; i++) {
+        struct proc_sample *s = &shard->samples[i];
+        struct proc_signature *sig;
+        unsigned int slot;
+        bool cpu_valid;
+        
+        sig = get_or_create_signature(shard, s);
+        if (!sig) {
+            shard->pool_misses++;
+            s->cpu = 0;
+            s->mem = 0;
+            continue;
+        }
+        
+        slot = sig_slot(sig);
+        cpu_valid = sig->cpu_stamp != 0;
+        s->mem = s->thread ? 0 : get_mem_sample(sig, s, sample_now);
+        s->cpu = get_cpu_sample(sig, s->runtime, sample_now);
+        sig->last_update = jiffies;
+        sig->seen_gen = sample_gen;
+        age_spike_history(slot, sample_gen - sig->sampled_gen);
+        sig->sampled_gen = sample_gen;
+        sig->wake_probe = s->wake_probe;
+        if (seed_active)
+            seed_apply(slot);
+        
+        sig_cols.sample[SMARTSCHED_RES_CPU][slot] = cpu_valid ? s->cpu :
+                                                    sig_cols.ema[SMARTSCHED_RES_CPU][slot];
+        sig_cols.sample[SMARTSCHED_RES_MEM][slot] = s->mem;
+        sig_cols.sample[SMARTSCHED_RES_IO][slot] = s->io;
+        seed_first_samples(slot);
+        if (!(sig_cols.flags[slot] & FLAG_SPLIT) != !s->split)
+            emit_split_change(slot, s->split);
+        sig_cols.flags[slot] = (sig_cols.flags[slot] & ~FLAG_SPLIT) |
+                               (s->split ? FLAG_SPLIT : 0);
+        __set_bit(slot - shard->slot_first, shard->due);
+    }
+    
+    /* Step each run of due slots in batches */
+    for (i = find_first_bit(shard->due, shard->slot_hwm); i < shard->slot_hwm;
+         i = find_next_bit(shard->due, shard->slot_hwm, end)) {
+        end = find_next_zero_bit(shard->due, min(shard->slot_hwm, i + SIG_BATCH), i);
+        update_signatures(shard, shard->slot_first + i, end - i);
+    }
+    bitmap_zero(shard->due, shard->slot_hwm);
+    
+    if (sample_sweep)
+        sweep_exited(first, last);
+    
+    if (shard->pool_misses) {
+        atomic_long_add(shard->pool_misses, &dropped_full);
+        evict_lru(first, last, shard->pool_misses);
+    }
+}
+
+/*
+ * Thread mode: queue a CPU sample for each thread of a multi-threaded
+ * process, after its process sample. Threads only feed the CPU model
+ * (memory is per process); their rises flag the TID itself. Idle
+ * threads follow the same adaptive tiers as processes and offer their
+ * last sample for the hot thread. Returns the new buffer fill.
+ * Called from the task walk under rcu_read_lock().
+ */
+static unsigned int sample_threads(struct task_struct *task, struct proc_signature *psig,
+                                   unsigned int nr, unsigned int *seen, unsigned int *due)
+{
+    struct task_struct *t;
+    
+    for_each_thread(task, t) {
+        struct proc_signature *tsig;
+        struct proc_sample *s;
+        unsigned long probe;
+        
+        if (t->exit_state)
+            continue;
+        
+        (*seen)++;
+        tsig = find_signature_rcu(t->pid, t->start_time, true);
+        probe = get_thread_wake_probe(t);
+        if (!sample_due(tsig, probe)) {
+            tsig->seen_gen = sample_gen;
+            if (psig)
+                note_hot_thread(psig, t->pid, SIG_COL(tsig, sample[SMARTSCHED_RES_CPU]));
+            continue;
+        }
+        
+        (*due)++;
+        if (nr >= sample_buf_size)
+            continue;
+        
+        s = &sample_buf[nr++];
+        s->pid = t->pid;
+        s->tgid = task->tgid;
+        s->thread = true;
+        s->split = false;
+        s->start_time = t->start_time;
+        s->group_start = task->start_time;
+        strscpy(s->comm, t->comm, sizeof(s->comm));
+        s->wake_probe = probe;
+        s->cg = NULL;
+        s->runtime = READ_ONCE(t->se.sum_exec_runtime);
+        s->io = 0;
+        
+        sample_shards[sig_shard(s->pid)].nr_samples++;
+    }
+    
+    return nr;
+}
+
+/*
+ * Coordinator work: sample all running processes
+ *
+ * Walks the task list once under RCU collecting raw samples, groups
+ * them by shard, then fans the signature updates out to per-CPU shard
+ * work items. Idle tasks in a slow tier are not sampled, only marked
+ * as seen, so the cost of a tick follows the number of active tasks.
+ * Each phase is timed into sampler_perf; the top-K tables only hold
+ * signatures updated in the tick.
+ * Runs in process context with interrupts enabled.
+ */
+static void sample_work_fn(struct work_struct *work)
+{
+    struct task_struct *task;
+    unsigned int pos[SAMPLE_MAX_SHARDS];
+    unsigned int nr = 0, seen = 0, due = 0, off = 0;
+    unsigned int i;
+    int interval = cfg.sample_interval_ms;
+    unsigned long delay;
+    u64 walked, flushed, done;
+    bool thread_mode;
+    
+    config_apply();
+    thread_mode = cfg.thread_mode;
+    
+    for (i = 0; i < nr_shards; i++) {
+        int o;
+        
+        sample_shards[i].nr_samples = 0;
+        for (o = 0; o < TOP_NR_ORDERS; o++)
+            sample_shards[i].top[o].nr = 0;
+    }
+    
+    sample_gen++;
+    sample_now = ktime_get_ns();
+    perf_tick_start(sample_now, cfg.sample_interval_ms != interval);
+    seed_install();
+    
+    rcu_read_lock();
+    for_each_process(task) {
+        struct cgroup_signature *cg;
+        struct proc_signature *sig;
+        struct proc_sample *s;
+        unsigned long probe;
+        bool split;
+        
+        /* Skip kernel threads and zombies */
+        if (task->flags & PF_KTHREAD)
+            continue;
+        if (task->exit_state)
+            continue;
+        
+        seen++;
+        
+        cg = get_cgroup_signature(task);
+        split = thread_mode && get_nr_threads(task) > 1;
+        
+        /*
+         * No shard runs during the walk, so seen_gen and hot_tid can
+         * be set here. A skipped task is idle: its last sample stands
+         * in for the cgroup sums, as it does for a deferred one.
+         */
+        sig = find_signature_rcu(task->pid, task->start_time, false);
+        probe = get_wake_probe(task);
+        if (sig && SIG_COL(sig, hot_tid))
+            SIG_COL(sig, hot_tid) = 0;
+        if (!sample_due(sig, probe)) {
+            sig->seen_gen = sample_gen;
+            cgroup_account_last(cg, sig);
+        } else {
+            due++;
+            if (nr >= sample_buf_size) {
+                cgroup_account_last(cg, sig);
+            } else {
+                /* Get samples */
+                s = &sample_buf[nr++];
+                s->pid = task->pid;
+                s->tgid = task->tgid;
+                s->thread = false;
+                s->split = split;
+                s->start_time = task->start_time;
+                strscpy(s->comm, task->comm, sizeof(s->comm));
+                s->wake_probe = probe;
+                s->cg = cg;
+                s->runtime = get_task_counters(task, &s->majflt);
+                get_task_rss(task, s);
+                s->io = get_io_sample(task);
+                
+                sample_shards[sig_shard(s->pid)].nr_samples++;
+            }
+        }
+        
+        if (split)
+            nr = sample_threads(task, sig, nr, &seen, &due);
+    }
+    rcu_read_unlock();
+    walked = ktime_get_ns();
+    
+    WRITE_ONCE(tick_sampled, nr);
+    WRITE_ONCE(tick_skipped, seen - due);
+    sampler_perf.seen = seen;
+    sampler_perf.due = due;
+    sampler_perf.sampled = nr;
+    sampler_perf.seen_max = max(sampler_perf.seen_max, seen);
+    sampler_perf.seen_total += seen;
+    sampler_perf.deferred += due - nr;
+    
+    /*
+     * Sweep exited PIDs periodically, but only when every due task
+     * fitted in the buffer; otherwise unsampled live tasks would look
+     * exited.
+     */
+    sample_sweep = (sample_gen % EVICT_SWEEP_TICKS) == 0 && due <= sample_buf_size;
+    
+    /* Group samples by shard (counting sort) */
+    for (i = 0; i < nr_shards; i++) {
+        sample_shards[i].samples = &sample_sorted[off];
+        pos[i] = off;
+        off += sample_shards[i].nr_samples;
+    }
+    for (i = 0; i < nr; i++)
+        sample_sorted[pos[sig_shard(sample_buf[i].pid)]++] = sample_buf[i];
+    
+    /* Fan out to the shard CPUs and wait for the whole tick */
+    cpus_read_lock();
+    for (i = 0; i < nr_shards; i++) {
+        struct sample_shard *shard = &sample_shards[i];
+        int cpu = cpu_online(shard->cpu) ? shard->cpu : WORK_CPU_UNBOUND;
+        
+        if (shard->nr_samples || sample_sweep)
+            queue_work_on(cpu, sample_wq, &shard->work);
+    }
+    cpus_read_unlock();
+    
+    for (i = 0; i < nr_shards; i++)
+        flush_work(&sample_shards[i].work);
+    flushed = ktime_get_ns();
+    
+    /*
+     * Shards filled in the CPU samples: fold process samples into the
+     * cgroups and thread samples into their process's hot thread
+     */
+    rcu_read_lock();
+    for (i = 0; i < nr; i++) {
+        struct proc_sample *s = &sample_sorted[i];
+        struct proc_signature *psig;
+        
+        if (!s->thread) {
+            cgroup_account(s->cg, s->cpu, s->mem, s->io);
+            continue;
+        }
+        psig = find_signature_rcu(s->tgid, s->group_start, false);
+        if (psig)
+            note_hot_thread(psig, s->pid, s->cpu);
+    }
+    rcu_read_unlock();
+    update_cgroup_signatures();
+    
+    publish_top();
+    publish_snapshot();
+    publish_events();
+    done = ktime_get_ns();
+    
+    perf_hist_add(&sampler_perf.walk, walked - sample_now);
+    perf_hist_add(&sampler_perf.shards, flushed - walked);
+    perf_hist_add(&sampler_perf.publish, done - flushed);
+    perf_hist_add(&sampler_perf.tick, done - sample_now);
+    
+    /* Make room for every due task on the next tick */
+    if (due > sample_buf_size) {
+        sample_buf_want = due + due / 4;
+        resize_sample_buffers();
+    }
+    
+    /* Reschedule (a no-op if a config write already re-armed us) */
+    delay = msecs_to_jiffies(cfg.sample_interval_ms);
+    sampler_perf.due_ns = ktime_get_ns() + jiffies_to_nsecs(delay);
+    queue_delayed_work(sample_wq, &sample_work, delay);
+}
+
+/*
+ * Set up shards and sample buffers
+ * One shard per online CPU, capped at SAMPLE_MAX_SHARDS
+ */
+static int init_sampling_engine(void)
+{
+    struct top_entry *e;
+    unsigned int i = 0;
+    int cpu, o;
+    
+    nr_shards = rounddown_pow_of_two(clamp_t(unsigned int, num_online_cpus(),
+                                             1, SAMPLE_MAX_SHARDS));
+    shard_shift = PROC_HASH_BITS - ilog2(nr_shards);
+    
+    for_each_online_cpu(cpu) {
+        if (i >= nr_shards)
+            break;
+        INIT_WORK(&sample_shards[i].work, sample_shard_work);
+        sample_shards[i].cpu = cpu;
+        i++;
+    }
+    
+    /* TOP_K rows per order for each shard and both published tables */
+    top_store = kvcalloc((nr_shards + 2) * TOP_NR_ORDERS * TOP_K,
+                         sizeof(*top_store), GFP_KERNEL);
+    if (!top_store)
+        return -ENOMEM;
+    e = top_store;
+    for (i = 0; i < nr_shards; i++)
+        for (o = 0; o < TOP_NR_ORDERS; o++, e += TOP_K)
+            sample_shards[i].top[o].e = e;
+    for (o = 0; o < TOP_NR_ORDERS; o++, e += 2 * TOP_K) {
+        top_tables[0][o].e = e;
+        top_tables[1][o].e = e + TOP_K;
+    }
+    
+    sample_buf_want = max_tracked;
+    resize_sample_buffers();
+    if (!sample_buf) {
+        kvfree(top_store);
+        return -ENOMEM;
+    }
+    
+    sample_wq = alloc_workqueue("smartsched", 0, 0);
+    if (!sample_wq) {
+        kvfree(sample_buf);
+        kvfree(sample_sorted);
+        kvfree(top_store);
+        return -ENOMEM;
+    }
+    
+    INIT_DELAYED_WORK(&sample_work, sample_work_fn);
+    return 0;
+}
+
+/* ============================================
+ * PROCFS INTERFACE
+ * ============================================ */
+
+/*
+ * /proc/smartscheduler/status
+ * Shows module status and configuration
+ */
+static int status_show(struct seq_file *m, void *v)
+{
+    unsigned long uptime_secs = (jiffies - module_start_time) / HZ;
+    unsigned int tiers[ADAPT_NR_TIERS] = { 0 };
+    unsigned int pool_free = 0;
+    struct proc_signature *sig;
+    int bkt, i;
+    
+    for (i = 0; i < nr_shards; i++)
+        pool_free += READ_ONCE(sample_shards[i].nr_free);
+    
+    seq_puts(m, "=== SmartScheduler Status ===\n\n");
+    seq_printf(m, "Module uptime:        %lu seconds\n", uptime_secs);
+    seq_printf(m, "Tracked processes:    %d\n", atomic_read(&total_tracked));
+    seq_printf(m, "Total predictions:    %d\n", atomic_read(&total_predictions));
+    seq_printf(m, "Trend forecasts:      %d\n", atomic_read(&total_forecasts));
+    seq_printf(m, "Sample interval:      %d ms\n", READ_ONCE(cfg.sample_interval_ms));
+    seq_printf(m, "Sampling shards:      %u\n", nr_shards);
+    seq_printf(m, "Last tick:            %u sampled, %u idle skipped\n",
+               READ_ONCE(tick_sampled), READ_ONCE(tick_skipped));
+    seq_printf(m, "Signature pool:       %u used, %u free, %u capacity (%zu KiB)\n",
+               max_tracked - pool_free, pool_free, max_tracked, sig_pool_bytes >> 10);
+    seq_printf(m, "Tracked cgroups:      %d/%d\n",
+               atomic_read(&cgroups_tracked), MAX_TRACKED_CGROUPS);
+    seq_printf(m, "Snapshot device:      %s (%zu bytes)\n",
+               SMARTSCHED_DEV_PATH, snapshot_size);
+    seq_printf(m, "Spike events:         %llu\n",
+               (unsigned long long)smp_load_acquire(&event_published));
+    seq_printf(m, "Warm-start seeds:     %ld applied\n", atomic_long_read(&seeds_applied));
+    seq_puts(m, "\n=== Eviction ===\n");
+    seq_printf(m, "Evicted (exited):     %ld\n", atomic_long_read(&evicted_exited));
+    seq_printf(m, "Evicted (PID reuse):  %ld\n", atomic_long_read(&evicted_reused));
+    seq_printf(m, "Evicted (LRU):        %ld\n", atomic_long_read(&evicted_lru));
+    seq_printf(m, "Dropped (table full): %ld\n", atomic_long_read(&dropped_full));
+    seq_printf(m, "Cgroups refused:      %ld\n", atomic_long_read(&cgroups_dropped));
+    seq_puts(m, "\n=== Sampler Overhead ===\n");
+    seq_printf(m, "Tick time:            p50 %llu us, p99 %llu us, max %llu us\n",
+               div_u64(perf_hist_pct(&sampler_perf.tick, 50), NSEC_PER_USEC),
+               div_u64(perf_hist_pct(&sampler_perf.tick, 99), NSEC_PER_USEC),
+               div_u64(READ_ONCE(sampler_perf.tick.max_ns), NSEC_PER_USEC));
+    seq_printf(m, "Timer drift:          p99 %llu us, %llu ticks missed\n",
+               div_u64(perf_hist_pct(&sampler_perf.drift, 99), NSEC_PER_USEC),
+               READ_ONCE(sampler_perf.missed));
+    seq_puts(m, "Details:              /proc/smartscheduler/perf\n");
+    seq_puts(m, "\n=== Adaptive Sampling ===\n");
+    if (READ_ONCE(cfg.idle_samples)) {
+        seq_printf(m, "Demote after:         %d flat samples\n", READ_ONCE(cfg.idle_samples));
+        rcu_read_lock();
+        hash_for_each_rcu(proc_signatures, bkt, sig, hash_node)
+            tiers[min_t(unsigned int, READ_ONCE(SIG_COL(sig, tier)), ADAPT_NR_TIERS - 1)]++;
+        rcu_read_unlock();
+        for (i = 0; i < ADAPT_NR_TIERS; i++)
+            seq_printf(m, "Tier %d (every %3u):   %u\n",
+                       i, 1U << (i * ADAPT_TIER_SHIFT), tiers[i]);
+    } else {
+        seq_puts(m, "Disabled (idle_samples=0)\n");
+    }
+    seq_puts(m, "\n=== Thresholds ===\n");
+    seq_printf(m, "CPU spike threshold:  %d\n", READ_ONCE(cfg.model.threshold[SMARTSCHED_RES_CPU]));
+    seq_printf(m, "Memory spike thresh:  %d\n", READ_ONCE(cfg.model.threshold[SMARTSCHED_RES_MEM]));
+    seq_printf(m, "I/O spike threshold:  %d\n", READ_ONCE(cfg.model.threshold[SMARTSCHED_RES_IO]));
+    seq_printf(m, "EMA alpha:            %d.%02d\n",
+               READ_ONCE(cfg.model.alpha) / 100, READ_ONCE(cfg.model.alpha) % 100);
+    seq_printf(m, "Config updates:       %lu applied%s\n",
+               READ_ONCE(cfg_applied), READ_ONCE(cfg_dirty) ? ", 1 pending" : "");
+    
+    return 0;
+}
+
+static int status_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, status_show, NULL);
+}
+
+static const struct proc_ops status_ops = {
+    .proc_open = status_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+/*
+ * Signature table views
+ * A paginated seq_file iterator over proc_signatures shared by the
+ * per-signature views. Position 0 is the header, then each row is
+ * 1 + (bucket << SIG_ITER_SHIFT | slot in the bucket), then the
+ * footer, so every read() resumes at the row where the last one
+ * stopped and the whole table is listed however large it is. Rows are
+ * read under RCU between start() and stop() only: a row may be missed
+ * or repeated if its bucket changed between two reads.
+ */
+struct sig_view {
+    struct seq_operations ops;
+    bool (*match)(const struct proc_signature *sig);
+    void (*header)(struct seq_file *m);
+    void (*row)(struct seq_file *m, const struct proc_signature *sig);
+    void (*footer)(struct seq_file *m);   /* Optional */
+};
+
+#define SIG_ITER_FOOTER ((void *)2)
+
+static inline loff_t sig_iter_pos(unsigned int bkt, unsigned int slot)
+{
+    return ((loff_t)bkt << SIG_ITER_SHIFT) + slot + 1;
+}
+
+static inline const struct sig_view *sig_view_of(struct seq_file *m)
+{
+    return container_of(m->op, struct sig_view, ops);
+}
+
+/*
+ * First matching row at or after node, which is slot `slot` of bucket
+ * bkt (NULL past the bucket's end); the footer once the table is done
+ */
+static void *sig_iter_scan(const struct sig_view *view, struct hlist_node *node,
+                           unsigned int bkt, unsigned int slot, loff_t *pos)
+{
+    for (;;) {
+        for (; node; node = rcu_dereference(hlist_next_rcu(node)), slot++) {
+            struct proc_signature *sig = hlist_entry(node, struct proc_signature, hash_node);
+            
+            if (view->match(sig)) {
+                *pos = sig_iter_pos(bkt, slot);
+                return sig;
+            }
+        }
+        if (++bkt >= HASH_SIZE(proc_signatures))
+            break;
+        node = rcu_dereference(hlist_first_rcu(&proc_signatures[bkt]));
+        slot = 0;
+    }
+    
+    *pos = sig_iter_pos(HASH_SIZE(proc_signatures), 0);
+    return SIG_ITER_FOOTER;
+}
+
+static void *sig_iter_start(struct seq_file *m, loff_t *pos)
+    __acquires(RCU)
+{
+    struct hlist_node *node;
+    unsigned int bkt, slot, i;
+    u64 p;
+    
+    rcu_read_lock();
+    if (*pos == 0)
+        return SEQ_START_TOKEN;
+    
+    p = *pos - 1;
+    bkt = p >> SIG_ITER_SHIFT;
+    slot = p & (BIT_ULL(SIG_ITER_SHIFT) - 1);
+    if (bkt >= HASH_SIZE(proc_signatures))
+        return *pos == sig_iter_pos(bkt, 0) ? SIG_ITER_FOOTER : NULL;
+    
+    node = rcu_dereference(hlist_first_rcu(&proc_signatures[bkt]));
+    for (i = 0; node && i < slot; i++)
+        node = rcu_dereference(hlist_next_rcu(node));
+    
+    return sig_iter_scan(sig_view_of(m), node, bkt, slot, pos);
+}
+
+static void *sig_iter_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    struct proc_signature *sig = v;
+    u64 p = *pos - 1;
+    
+    if (v == SIG_ITER_FOOTER) {
+        ++*pos;
+        return NULL;
+    }
+    if (v == SEQ_START_TOKEN)
+        return sig_iter_scan(sig_view_of(m),
+                             rcu_dereference(hlist_first_rcu(&proc_signatures[0])),
+                             0, 0, pos);
+    
+    return sig_iter_scan(sig_view_of(m), rcu_dereference(hlist_next_rcu(&sig->hash_node)),
+                         p >> SIG_ITER_SHIFT,
+                         (p & (BIT_ULL(SIG_ITER_SHIFT) - 1)) + 1, pos);
+}
+
+static void sig_iter_stop(struct seq_file *m, void *v)
+    __releases(RCU)
+{
+    rcu_read_unlock();
+}
+
+static int sig_iter_show(struct seq_file *m, void *v)
+{
+    const struct sig_view *view = sig_view_of(m);
+    
+    if (v == SEQ_START_TOKEN)
+        view->header(m);
+    else if (v == SIG_ITER_FOOTER) {
+        if (view->footer)
+            view->footer(m);
+    } else {
+        view->row(m, v);
+    }
+    return 0;
+}
+
+#define SIG_VIEW(_match, _header, _row, _footer) {  \
+    .ops = {                                        \
+        .start = sig_iter_start,                    \
+        .next = sig_iter_next,                      \
+        .stop = sig_iter_stop,                      \
+        .show = sig_iter_show,                      \
+    },                                              \
+    .match = _match,                                \
+    .header = _header,                              \
+    .row = _row,                                    \
+    .footer = _footer,                              \
+}
+
+static bool sig_is_process(const struct proc_signature *sig)
+{
+    return !sig->thread;
+}
+
+static bool sig_is_thread(const struct proc_signature *sig)
+{
+    return sig->thread;
+}
+
+static bool sig_is_spiking(const struct proc_signature *sig)
+{
+    return !sig->thread && (READ_ONCE(SIG_COL(sig, flags)) & FLAG_SPIKE_PREDICTED);
+}
+
+static bool sig_is_forecast(const struct proc_signature *sig)
+{
+    return !sig->thread && (READ_ONCE(SIG_COL(sig, flags)) & FLAG_SPIKE_FORECAST);
+}
+
+/*
+ * /proc/smartscheduler/predictions
+ * Shows current predictions for all tracked processes
+ */
+static void predictions_header(struct seq_file *m)
+{
+    seq_puts(m, "=== Current Predictions ===\n\n");
+    seq_printf(m, "%-8s %-16s %6s %6s %6s %8s\n", "PID", "COMM", "CPU", "MEM", "I/O", "FLAGS");
+    seq_printf(m, "%-8s %-16s %6s %6s %6s %8s\n", "---", "----", "---", "---", "---", "-----");
+}
+
+static void predictions_row(struct seq_file *m, const struct proc_signature *sig)
+{
+    unsigned int sflags = READ_ONCE(SIG_COL(sig, flags));
+    char cpu_flag = (sflags & FLAG_CPU_SPIKE_PREDICTED) ? '*' : '-';
+    char mem_flag = (sflags & FLAG_MEM_SPIKE_PREDICTED) ? '*' : '-';
+    char io_flag = (sflags & FLAG_IO_SPIKE_PREDICTED) ? '*' : '-';
+    
+    seq_printf(m, "%-8d %-16s %6c %6c %6c %#8x\n",
+               sig->pid, sig->comm, cpu_flag, mem_flag, io_flag, sflags);
+}
 
-/* Timer for periodic sampling */
-static struct timer_list sample_timer;
+static void predictions_footer(struct seq_file *m)
+{
+    if (atomic_read(&total_tracked) == 0)
+        seq_puts(m, "(no processes currently tracked)\n");
+    
+    seq_printf(m, "\nLegend: * = spike predicted, - = normal\n");
+}
 
-/* Procfs entries */
-static struct proc_dir_entry *proc_dir;
-static struct proc_dir_entry *proc_status;
-static struct proc_dir_entry *proc_predictions;
-static struct proc_dir_entry *proc_stats;
+static const struct sig_view predictions_view =
+    SIG_VIEW(sig_is_process, predictions_header, predictions_row, predictions_footer);
 
-/* Module statistics */
-static atomic_t total_tracked = ATOMIC_INIT(0);
-static atomic_t total_predictions = ATOMIC_INIT(0);
-static unsigned long module_start_time;
+static int predictions_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &predictions_view.ops);
+}
 
-/* ============================================
- * STATISTICAL FUNCTIONS
- * ============================================ */
+static const struct proc_ops predictions_ops = {
+    .proc_open = predictions_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
 
 /*
- * Update Exponential Moving Average
- * Uses integer arithmetic: EMA = alpha * sample + (1-alpha) * old
- * All values scaled by 100 for precision
+ * /proc/smartscheduler/spiking
+ * Only the processes with a spike predicted; COMM is last so names
+ * with spaces parse
  */
-static inline int update_ema(int old_ema, int sample)
+static void spiking_header(struct seq_file *m)
 {
-    return (ALPHA * sample + ALPHA_COMPLEMENT * old_ema) / 100;
+    seq_puts(m, "=== Spiking Processes ===\n\n");
+    seq_printf(m, "%-8s %3s %3s %3s %8s %8s %8s %6s %s\n",
+               "PID", "CPU", "MEM", "I/O", "CPU_ROC", "MEM_ROC", "IO_ROC", "FLAGS", "COMM");
+    seq_printf(m, "%-8s %3s %3s %3s %8s %8s %8s %6s %s\n",
+               "---", "---", "---", "---", "-------", "-------", "------", "-----", "----");
 }
 
-/*
- * Calculate rate of change
- * Returns the difference between current_val and previous sample
- */
-static inline int calc_rate_of_change(int current_val, int previous)
+static void spiking_row(struct seq_file *m, const struct proc_signature *sig)
 {
-    return current_val - previous;
+    unsigned int sflags = READ_ONCE(SIG_COL(sig, flags));
+    
+    seq_printf(m, "%-8d %3c %3c %3c %+8d %+8d %+8d %#6x %s\n",
+               sig->pid,
+               (sflags & FLAG_CPU_SPIKE_PREDICTED) ? '*' : '-',
+               (sflags & FLAG_MEM_SPIKE_PREDICTED) ? '*' : '-',
+               (sflags & FLAG_IO_SPIKE_PREDICTED) ? '*' : '-',
+               SIG_COL(sig, roc[SMARTSCHED_RES_CPU]), SIG_COL(sig, roc[SMARTSCHED_RES_MEM]),
+               SIG_COL(sig, roc[SMARTSCHED_RES_IO]), sflags, sig->comm);
 }
 
-/*
- * Check if value indicates a spike
- * Compares rate-of-change against threshold
- */
-static inline bool is_spike_predicted(int roc, int threshold)
+static const struct sig_view spiking_view =
+    SIG_VIEW(sig_is_spiking, spiking_header, spiking_row, NULL);
+
+static int spiking_open(struct inode *inode, struct file *file)
 {
-    return roc > threshold;
+    return seq_open(file, &spiking_view.ops);
 }
 
-/* ============================================
- * PROCESS SIGNATURE MANAGEMENT
- * ============================================ */
+static const struct proc_ops spiking_ops = {
+    .proc_open = spiking_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
 
 /*
- * Find or create a signature for a process
- * Must be called with sig_lock held
+ * /proc/smartscheduler/forecast
+ * Processes with a trend forecast spike, one line per resource:
+ * level, trend per tick and sigma of the forecaster, and the ETA
  */
-static struct proc_signature *get_or_create_signature(pid_t pid, const char *comm)
+static void forecast_header(struct seq_file *m)
 {
-    struct proc_signature *sig;
-    
-    /* Search existing */
-    hash_for_each_possible(proc_signatures, sig, hash_node, pid) {
-        if (sig->pid == pid) {
-            return sig;
-        }
-    }
-    
-    /* Check limit */
-    if (atomic_read(&total_tracked) >= MAX_TRACKED_PROCS) {
-        return NULL;
-    }
-    
-    /* Create new signature */
-    sig = kzalloc(sizeof(*sig), GFP_ATOMIC);
-    if (!sig) {
-        return NULL;
-    }
+    seq_puts(m, "=== Spike Forecasts ===\n\n");
+    seq_printf(m, "%-8s %-4s %10s %8s %8s %4s %8s %s\n",
+               "PID", "RES", "LEVEL", "TREND", "SIGMA", "ETA", "ETA_MS", "COMM");
+    seq_printf(m, "%-8s %-4s %10s %8s %8s %4s %8s %s\n",
+               "---", "---", "-----", "-----", "-----", "---", "------", "----");
+}
+
+static void forecast_row(struct seq_file *m, const struct proc_signature *sig)
+{
+    static const char * const res_names[SMARTSCHED_NR_RES] = { "cpu", "mem", "io" };
+    unsigned int slot = sig_slot(sig);
+    unsigned int sflags = READ_ONCE(sig_cols.flags[slot]);
+    int interval = READ_ONCE(cfg.sample_interval_ms);
+    int res;
     
-    sig->pid = pid;
-    if (comm) {
-        strncpy(sig->comm, comm, TASK_COMM_LEN - 1);
+    for (res = 0; res < SMARTSCHED_NR_RES; res++) {
+        unsigned int eta = READ_ONCE(sig_cols.eta[res][slot]);
+        
+        if (!(sflags & (1U << (res + SMARTSCHED_FORECAST_SHIFT))))
+            continue;
+        seq_printf(m, "%-8d %-4s %10d %+8d %8u %4u %8u %s\n",
+                   sig->pid, res_names[res], sig_cols.fc_level[res][slot],
+                   sig_cols.fc_trend[res][slot],
+                   smartsched_isqrt(READ_ONCE(sig_cols.fc_var[res][slot])),
+                   eta, eta * interval, sig->comm);
     }
-    sig->created = jiffies;
-    sig->last_update = jiffies;
-    sig->flags = FLAG_ACTIVE;
-    
-    hash_add(proc_signatures, &sig->hash_node, pid);
-    atomic_inc(&total_tracked);
-    
-    return sig;
 }
 
+static const struct sig_view forecast_view =
+    SIG_VIEW(sig_is_forecast, forecast_header, forecast_row, NULL);
+
+static int forecast_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &forecast_view.ops);
+}
+
+static const struct proc_ops forecast_ops = {
+    .proc_open = forecast_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
+
 /*
- * Remove a process signature
- * Must be called with sig_lock held
+ * /proc/smartscheduler/stats
+ * Shows detailed statistics for all tracked processes
  */
-static void remove_signature(struct proc_signature *sig)
+static void stats_header(struct seq_file *m)
 {
-    hash_del(&sig->hash_node);
-    atomic_dec(&total_tracked);
-    kfree(sig);
+    seq_puts(m, "=== Process Statistics ===\n\n");
+    seq_printf(m, "%-8s %8s %8s %8s %8s %8s %8s %10s\n", 
+               "PID", "CPU_EMA", "MEM_EMA", "IO_EMA", "CPU_ROC", "MEM_ROC", "IO_ROC", "SAMPLES");
+    seq_printf(m, "%-8s %8s %8s %8s %8s %8s %8s %10s\n",
+               "---", "-------", "-------", "------", "-------", "-------", "------", "-------");
+}
+
+static void stats_row(struct seq_file *m, const struct proc_signature *sig)
+{
+    unsigned int slot = sig_slot(sig);
+    
+    seq_printf(m, "%-8d %8d %8d %8d %+8d %+8d %+8d %10llu\n",
+               sig->pid,
+               sig_cols.ema[SMARTSCHED_RES_CPU][slot], sig_cols.ema[SMARTSCHED_RES_MEM][slot],
+               sig_cols.ema[SMARTSCHED_RES_IO][slot], sig_cols.roc[SMARTSCHED_RES_CPU][slot],
+               sig_cols.roc[SMARTSCHED_RES_MEM][slot], sig_cols.roc[SMARTSCHED_RES_IO][slot],
+               (unsigned long long)sig_cols.total_samples[slot]);
+}
+
+static const struct sig_view stats_view =
+    SIG_VIEW(sig_is_process, stats_header, stats_row, NULL);
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &stats_view.ops);
 }
 
+static const struct proc_ops stats_ops = {
+    .proc_open = stats_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
+
 /*
- * Update signature with new sample data
- * Computes EMA, rate-of-change, and sets prediction flags
+ * /proc/smartscheduler/top
+ * The TOP_K leaders of the last tick in each order: score is
+ * |CPU_ROC| + |MEM_ROC| + |IO_ROC|, cpu/mem/io the resource's rising
+ * RoC. Ranked incrementally by the shards, so reading it costs
+ * O(TOP_K) whatever the number of tracked processes. Only signatures
+ * updated in the tick with a positive key are listed.
  */
-static void update_signature(struct proc_signature *sig, 
-                            int cpu_sample, int mem_sample, int io_sample)
+static int top_show(struct seq_file *m, void *v)
 {
-    /* Store previous values */
-    sig->cpu_prev = sig->cpu_ema;
-    sig->mem_prev = sig->mem_ema;
-    sig->io_prev = sig->io_ema;
-    
-    /* Update EMAs */
-    sig->cpu_ema = update_ema(sig->cpu_ema, cpu_sample);
-    sig->mem_ema = update_ema(sig->mem_ema, mem_sample);
-    sig->io_ema = update_ema(sig->io_ema, io_sample);
+    static const char * const order_names[TOP_NR_ORDERS] = {
+        [TOP_SCORE] = "score",
+        [TOP_CPU]   = "cpu",
+        [TOP_MEM]   = "mem",
+        [TOP_IO]    = "io",
+    };
+    struct top_entry *rows;
+    unsigned int nr[TOP_NR_ORDERS];
+    unsigned int i;
+    int o;
     
-    /* Calculate rates of change */
-    sig->cpu_roc = calc_rate_of_change(sig->cpu_ema, sig->cpu_prev);
-    sig->mem_roc = calc_rate_of_change(sig->mem_ema, sig->mem_prev);
-    sig->io_roc = calc_rate_of_change(sig->io_ema, sig->io_prev);
-    
-    /* Clear old prediction flags */
-    sig->flags &= ~(FLAG_CPU_SPIKE_PREDICTED | 
-                    FLAG_MEM_SPIKE_PREDICTED | 
-                    FLAG_IO_SPIKE_PREDICTED);
+    rows = kvmalloc_array(TOP_NR_ORDERS * TOP_K, sizeof(*rows), GFP_KERNEL);
+    if (!rows)
+        return -ENOMEM;
     
-    /* Set new prediction flags based on thresholds */
-    if (is_spike_predicted(sig->cpu_roc, CPU_SPIKE_THRESHOLD)) {
-        sig->flags |= FLAG_CPU_SPIKE_PREDICTED;
-        sig->cpu_spikes_predicted++;
-        atomic_inc(&total_predictions);
+    mutex_lock(&top_lock);
+    for (o = 0; o < TOP_NR_ORDERS; o++) {
+        nr[o] = top_pub[o].nr;
+        memcpy(rows + o * TOP_K, top_pub[o].e, nr[o] * sizeof(*rows));
     }
+    mutex_unlock(&top_lock);
     
-    if (is_spike_predicted(sig->mem_roc, MEM_SPIKE_THRESHOLD)) {
-        sig->flags |= FLAG_MEM_SPIKE_PREDICTED;
-        sig->mem_spikes_predicted++;
-        atomic_inc(&total_predictions);
-    }
+    seq_printf(m, "=== Top %d by Rate of Change ===\n\n", TOP_K);
+    seq_printf(m, "%-5s %4s %-8s %8s %8s %8s %8s %8s %8s %8s %6s %s\n",
+               "ORDER", "RANK", "PID", "KEY", "CPU_EMA", "MEM_EMA", "IO_EMA",
+               "CPU_ROC", "MEM_ROC", "IO_ROC", "FLAGS", "COMM");
+    seq_printf(m, "%-5s %4s %-8s %8s %8s %8s %8s %8s %8s %8s %6s %s\n",
+               "-----", "----", "---", "---", "-------", "-------", "------",
+               "-------", "-------", "------", "-----", "----");
     
-    if (is_spike_predicted(sig->io_roc, IO_SPIKE_THRESHOLD)) {
-        sig->flags |= FLAG_IO_SPIKE_PREDICTED;
-        sig->io_spikes_predicted++;
-        atomic_inc(&total_predictions);
+    for (o = 0; o < TOP_NR_ORDERS; o++) {
+        for (i = 0; i < nr[o]; i++) {
+            const struct top_entry *e = &rows[o * TOP_K + i];
+            
+            seq_printf(m, "%-5s %4u %-8d %8d %8d %8d %8d %+8d %+8d %+8d %#6x %s\n",
+                       order_names[o], i + 1, e->pid, e->key,
+                       e->ema[SMARTSCHED_RES_CPU], e->ema[SMARTSCHED_RES_MEM],
+                       e->ema[SMARTSCHED_RES_IO], e->roc[SMARTSCHED_RES_CPU],
+                       e->roc[SMARTSCHED_RES_MEM], e->roc[SMARTSCHED_RES_IO],
+                       e->flags, e->comm);
+        }
     }
+    kvfree(rows);
     
-    sig->total_samples++;
-    sig->last_update = jiffies;
+    return 0;
 }
 
-/* ============================================
- * SAMPLING FUNCTIONS
- * ============================================ */
+static int top_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, top_show, NULL);
+}
+
+static const struct proc_ops top_ops = {
+    .proc_open = top_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
 
 /*
- * Get CPU usage sample for a task
- * Returns scaled value (0-10000 for 0-100%)
+ * /proc/smartscheduler/memory
+ * The resident memory breakdown and fault rate behind each process's
+ * memory sample
  */
-static int get_cpu_sample(struct task_struct *task)
+static void memory_header(struct seq_file *m)
 {
-    /* Use utime + stime as proxy for CPU usage */
-    u64 total_time = task->utime + task->stime;
-    /* Scale to percentage * 100 */
-    return (int)((total_time * 100) / (jiffies - task->start_time + 1));
+    seq_puts(m, "=== Memory Signals ===\n\n");
+    seq_printf(m, "%-8s %-16s %10s %10s %10s %8s %8s %8s %8s\n",
+               "PID", "COMM", "ANON_KB", "FILE_KB", "SHMEM_KB", "MAJFLT/s",
+               "SAMPLE", "MEM_EMA", "MEM_ROC");
+    seq_printf(m, "%-8s %-16s %10s %10s %10s %8s %8s %8s %8s\n",
+               "---", "----", "-------", "-------", "--------", "--------",
+               "------", "-------", "-------");
 }
 
-/*
- * Get memory usage sample for a task
- * Returns scaled value based on memory maps
- */
-static int get_mem_sample(struct task_struct *task)
+static void memory_row(struct seq_file *m, const struct proc_signature *sig)
 {
-    if (task->mm) {
-        /* Use total_vm as proxy for memory usage */
-        return (int)(task->mm->total_vm * 100 / 1024);
-    }
-    return 0;
+    seq_printf(m, "%-8d %-16s %10lu %10lu %10lu %8u %8d %8d %+8d\n",
+               sig->pid, sig->comm, sig->rss_anon_kb, sig->rss_file_kb,
+               sig->rss_shmem_kb, sig->majflt_rate, SIG_COL(sig, sample[SMARTSCHED_RES_MEM]),
+               SIG_COL(sig, ema[SMARTSCHED_RES_MEM]), SIG_COL(sig, roc[SMARTSCHED_RES_MEM]));
 }
 
-/*
- * Get I/O sample for a task
- * Uses ioac if available
- */
-static int get_io_sample(struct task_struct *task)
+static const struct sig_view memory_view =
+    SIG_VIEW(sig_is_process, memory_header, memory_row, NULL);
+
+static int memory_open(struct inode *inode, struct file *file)
 {
-#ifdef CONFIG_TASK_IO_ACCOUNTING
-    return (int)((task->ioac.read_bytes + task->ioac.write_bytes) / 1024);
-#else
-    return 0;
-#endif
+    return seq_open(file, &memory_view.ops);
 }
 
+static const struct proc_ops memory_ops = {
+    .proc_open = memory_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
+
 /*
- * Timer callback: sample all running processes
+ * /proc/smartscheduler/threads
+ * Per-thread signatures (thread_mode); CPU only, 10000 = one CPU
  */
-static void sample_timer_callback(struct timer_list *t)
+static void threads_header(struct seq_file *m)
 {
-    struct task_struct *task;
-    unsigned long flags;
-    
-    spin_lock_irqsave(&sig_lock, flags);
-    
-    rcu_read_lock();
-    for_each_process(task) {
-        struct proc_signature *sig;
-        int cpu_sample, mem_sample, io_sample;
-        
-        /* Skip kernel threads and zombies */
-        if (task->flags & PF_KTHREAD)
-            continue;
-        if (task->exit_state)
-            continue;
-        
-        /* Get samples */
-        cpu_sample = get_cpu_sample(task);
-        mem_sample = get_mem_sample(task);
-        io_sample = get_io_sample(task);
-        
-        /* Get or create signature */
-        sig = get_or_create_signature(task->pid, task->comm);
-        if (sig) {
-            update_signature(sig, cpu_sample, mem_sample, io_sample);
-        }
-    }
-    rcu_read_unlock();
-    
-    spin_unlock_irqrestore(&sig_lock, flags);
+    seq_puts(m, "=== Thread Signatures ===\n\n");
+    seq_printf(m, "%-8s %-8s %-16s %8s %8s %8s %6s\n",
+               "TID", "TGID", "COMM", "CPU", "CPU_EMA", "CPU_ROC", "FLAGS");
+    seq_printf(m, "%-8s %-8s %-16s %8s %8s %8s %6s\n",
+               "---", "----", "----", "---", "-------", "-------", "-----");
+}
+
+static void threads_row(struct seq_file *m, const struct proc_signature *sig)
+{
+    unsigned int slot = sig_slot(sig);
     
-    /* Reschedule timer */
-    mod_timer(&sample_timer, jiffies + msecs_to_jiffies(SAMPLE_INTERVAL_MS));
+    seq_printf(m, "%-8d %-8d %-16s %8d %8d %+8d %#6x\n",
+               sig->pid, sig->tgid, sig->comm, sig_cols.sample[SMARTSCHED_RES_CPU][slot],
+               sig_cols.ema[SMARTSCHED_RES_CPU][slot], sig_cols.roc[SMARTSCHED_RES_CPU][slot],
+               READ_ONCE(sig_cols.flags[slot]));
 }
 
-/* ============================================
- * PROCFS INTERFACE
- * ============================================ */
+static const struct sig_view threads_view =
+    SIG_VIEW(sig_is_thread, threads_header, threads_row, NULL);
+
+static int threads_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &threads_view.ops);
+}
+
+static const struct proc_ops threads_ops = {
+    .proc_open = threads_open,
+    .proc_read = perf_seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
 
 /*
- * /proc/smartscheduler/status
- * Shows module status and configuration
+ * /proc/smartscheduler/cgroups
+ * Per-cgroup signatures; PATH is relative to the cgroup2 mount and
+ * FLAGS carries the spike and forecast bits
  */
-static int status_show(struct seq_file *m, void *v)
+static int cgroups_show(struct seq_file *m, void *v)
 {
-    unsigned long uptime_secs = (jiffies - module_start_time) / HZ;
+    struct cgroup_signature *cg;
+    int bkt;
     
-    seq_puts(m, "=== SmartScheduler Status ===\n\n");
-    seq_printf(m, "Module uptime:        %lu seconds\n", uptime_secs);
-    seq_printf(m, "Tracked processes:    %d\n", atomic_read(&total_tracked));
-    seq_printf(m, "Total predictions:    %d\n", atomic_read(&total_predictions));
-    seq_printf(m, "Sample interval:      %d ms\n", SAMPLE_INTERVAL_MS);
-    seq_puts(m, "\n=== Thresholds ===\n");
-    seq_printf(m, "CPU spike threshold:  %d\n", CPU_SPIKE_THRESHOLD);
-    seq_printf(m, "Memory spike thresh:  %d\n", MEM_SPIKE_THRESHOLD);
-    seq_printf(m, "I/O spike threshold:  %d\n", IO_SPIKE_THRESHOLD);
-    seq_printf(m, "EMA alpha:            0.%d\n", ALPHA);
+    seq_puts(m, "=== Cgroup Signatures ===\n\n");
+    seq_printf(m, "%-12s %6s %8s %8s %8s %8s %8s %8s %6s %s\n",
+               "ID", "TASKS", "CPU_EMA", "MEM_EMA", "IO_EMA",
+               "CPU_ROC", "MEM_ROC", "IO_ROC", "FLAGS", "PATH");
+    seq_printf(m, "%-12s %6s %8s %8s %8s %8s %8s %8s %6s %s\n",
+               "--", "-----", "-------", "-------", "------",
+               "-------", "-------", "------", "-----", "----");
+    
+    rcu_read_lock();
+    hash_for_each_rcu(cgroup_signatures, bkt, cg, hash_node) {
+        seq_printf(m, "%-12llu %6u %8d %8d %8d %+8d %+8d %+8d %#6x %s\n",
+                   (unsigned long long)cg->id, cg->nr_tasks,
+                   cg->cpu_ema, cg->mem_ema, cg->io_ema,
+                   cg->cpu_roc, cg->mem_roc, cg->io_roc,
+                   READ_ONCE(cg->flags), cg->path);
+    }
+    rcu_read_unlock();
     
     return 0;
 }
 
-static int status_open(struct inode *inode, struct file *file)
+static int cgroups_open(struct inode *inode, struct file *file)
 {
-    return single_open(file, status_show, NULL);
+    return single_open(file, cgroups_show, NULL);
 }
 
-static const struct proc_ops status_ops = {
-    .proc_open = status_open,
-    .proc_read = seq_read,
+static const struct proc_ops cgroups_ops = {
+    .proc_open = cgroups_open,
+    .proc_read = perf_seq_read,
     .proc_lseek = seq_lseek,
     .proc_release = single_release,
 };
 
-/*
- * /proc/smartscheduler/predictions
- * Shows current predictions for all tracked processes
- */
-static int predictions_show(struct seq_file *m, void *v)
+/* One histogram as name_count/sum_ns/p50_ns/p99_ns/max_ns/hist lines */
+static void perf_show_hist(struct seq_file *m, const char *name, const struct perf_hist *src)
 {
-    struct proc_signature *sig;
-    unsigned long flags;
-    int bkt;
-    int count = 0;
+    struct perf_hist h = { 0 };
+    int k, last = 0;
     
-    seq_puts(m, "=== Current Predictions ===\n\n");
-    seq_printf(m, "%-8s %-16s %6s %6s %6s %8s\n", "PID", "COMM", "CPU", "MEM", "I/O", "FLAGS");
-    seq_printf(m, "%-8s %-16s %6s %6s %6s %8s\n", "---", "----", "---", "---", "---", "-----");
+    perf_hist_merge(&h, src);
     
-    spin_lock_irqsave(&sig_lock, flags);
+    seq_printf(m, "%s_count %llu\n", name, h.count);
+    seq_printf(m, "%s_sum_ns %llu\n", name, h.sum_ns);
+    seq_printf(m, "%s_p50_ns %llu\n", name, perf_hist_pct(&h, 50));
+    seq_printf(m, "%s_p99_ns %llu\n", name, perf_hist_pct(&h, 99));
+    seq_printf(m, "%s_max_ns %llu\n", name, h.max_ns);
     
-    hash_for_each(proc_signatures, bkt, sig, hash_node) {
-        char cpu_flag = (sig->flags & FLAG_CPU_SPIKE_PREDICTED) ? '*' : '-';
-        char mem_flag = (sig->flags & FLAG_MEM_SPIKE_PREDICTED) ? '*' : '-';
-        char io_flag = (sig->flags & FLAG_IO_SPIKE_PREDICTED) ? '*' : '-';
-        
-        seq_printf(m, "%-8d %-16s %6c %6c %6c %#8x\n",
-                   sig->pid, sig->comm, cpu_flag, mem_flag, io_flag, sig->flags);
-        count++;
+    for (k = 0; k < PERF_HIST_SLOTS; k++)
+        if (h.slot[k])
+            last = k;
+    seq_printf(m, "%s_hist", name);
+    for (k = 0; k <= last; k++)
+        seq_printf(m, " %llu", h.slot[k]);
+    seq_putc(m, '\n');
+}
+
+/* Per-CPU lock statistics folded into one wait or hold histogram */
+static void perf_show_lock_hist(struct seq_file *m, const char *name, bool hold)
+{
+    struct perf_hist h = { 0 };
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct perf_lock_stats *ls = per_cpu_ptr(&perf_locks, cpu);
         
-        /* Limit output */
-        if (count >= 100) {
-            seq_puts(m, "\n... (truncated, showing first 100)\n");
-            break;
-        }
+        perf_hist_merge(&h, hold ? &ls->hold : &ls->wait);
     }
+    perf_show_hist(m, name, &h);
+}
+
+/*
+ * /proc/smartscheduler/perf
+ * What the module itself costs, one "key value" per line for
+ * scraping. Times are nanoseconds; a *_hist line holds the log2 slot
+ * counts (slot 0 = 0 ns, slot k = [2^(k-1), 2^k) ns) up to the last
+ * non-empty one, and percentiles are that slot's upper bound.
+ */
+static int perf_show(struct seq_file *m, void *v)
+{
+    char name[32];
+    u64 contended = 0, ticks;
+    int cpu, i;
     
-    spin_unlock_irqrestore(&sig_lock, flags);
+    ticks = READ_ONCE(sampler_perf.tick.count);
     
-    if (count == 0) {
-        seq_puts(m, "(no processes currently tracked)\n");
-    }
+    seq_printf(m, "interval_ms %d\n", READ_ONCE(cfg.sample_interval_ms));
+    seq_printf(m, "shards %u\n", nr_shards);
+    perf_show_hist(m, "tick", &sampler_perf.tick);
+    perf_show_hist(m, "walk", &sampler_perf.walk);
+    perf_show_hist(m, "shards", &sampler_perf.shards);
+    perf_show_hist(m, "publish", &sampler_perf.publish);
+    perf_show_hist(m, "drift", &sampler_perf.drift);
+    seq_printf(m, "ticks_missed %llu\n", READ_ONCE(sampler_perf.missed));
     
-    seq_printf(m, "\nLegend: * = spike predicted, - = normal\n");
+    seq_printf(m, "tasks_seen %u\n", READ_ONCE(sampler_perf.seen));
+    seq_printf(m, "tasks_due %u\n", READ_ONCE(sampler_perf.due));
+    seq_printf(m, "tasks_sampled %u\n", READ_ONCE(sampler_perf.sampled));
+    seq_printf(m, "tasks_seen_max %u\n", READ_ONCE(sampler_perf.seen_max));
+    seq_printf(m, "tasks_seen_avg %llu\n",
+               ticks ? div64_u64(READ_ONCE(sampler_perf.seen_total), ticks) : 0);
+    seq_printf(m, "tasks_deferred %llu\n", READ_ONCE(sampler_perf.deferred));
+    
+    for_each_possible_cpu(cpu)
+        contended += READ_ONCE(per_cpu_ptr(&perf_locks, cpu)->contended);
+    perf_show_lock_hist(m, "lock_wait", false);
+    perf_show_lock_hist(m, "lock_hold", true);
+    seq_printf(m, "lock_contended %llu\n", contended);
+    
+    seq_printf(m, "alloc_pool_misses %ld\n", atomic_long_read(&dropped_full));
+    seq_printf(m, "alloc_cgroups_refused %ld\n", atomic_long_read(&cgroups_dropped));
+    seq_printf(m, "alloc_resize_failures %llu\n", READ_ONCE(sampler_perf.resize_failures));
+    
+    for (i = 0; i < PERF_NR_READS; i++) {
+        snprintf(name, sizeof(name), "read_%s", perf_reads[i].name);
+        perf_show_hist(m, name, &perf_reads[i].hist);
+    }
     
     return 0;
 }
 
-static int predictions_open(struct inode *inode, struct file *file)
+static int perf_open(struct inode *inode, struct file *file)
 {
-    return single_open(file, predictions_show, NULL);
+    return single_open(file, perf_show, NULL);
 }
 
-static const struct proc_ops predictions_ops = {
-    .proc_open = predictions_open,
-    .proc_read = seq_read,
+static const struct proc_ops perf_ops = {
+    .proc_open = perf_open,
+    .proc_read = perf_seq_read,
     .proc_lseek = seq_lseek,
     .proc_release = single_release,
 };
 
 /*
- * /proc/smartscheduler/stats
- * Shows detailed statistics for all tracked processes
+ * /proc/smartscheduler/config
+ * Reads back one "name value" line per parameter, noting any value
+ * staged for the next tick. Writes take whitespace- or comma-separated
+ * name=value pairs; the whole write is validated first and staged as
+ * one update, so a tick never sees half of it.
  */
-static int stats_show(struct seq_file *m, void *v)
+static int config_show(struct seq_file *m, void *v)
 {
-    struct proc_signature *sig;
-    unsigned long flags;
-    int bkt;
-    
-    seq_puts(m, "=== Process Statistics ===\n\n");
-    seq_printf(m, "%-8s %8s %8s %8s %8s %8s %8s %10s\n", 
-               "PID", "CPU_EMA", "MEM_EMA", "IO_EMA", "CPU_ROC", "MEM_ROC", "IO_ROC", "SAMPLES");
-    seq_printf(m, "%-8s %8s %8s %8s %8s %8s %8s %10s\n",
-               "---", "-------", "-------", "------", "-------", "-------", "------", "-------");
+    struct sched_config pending;
+    int i;
     
-    spin_lock_irqsave(&sig_lock, flags);
+    spin_lock(&cfg_lock);
+    pending = cfg_pending;
+    spin_unlock(&cfg_lock);
     
-    hash_for_each(proc_signatures, bkt, sig, hash_node) {
-        seq_printf(m, "%-8d %8d %8d %8d %+8d %+8d %+8d %10lu\n",
-                   sig->pid,
-                   sig->cpu_ema, sig->mem_ema, sig->io_ema,
-                   sig->cpu_roc, sig->mem_roc, sig->io_roc,
-                   sig->total_samples);
+    for (i = 0; i < CFG_NR_PARAMS; i++) {
+        const struct config_param *p = &config_params[i];
+        int cur = READ_ONCE(*config_field(&cfg, p));
+        int next = *config_field(&pending, p);
+        
+        if (cur != next)
+            seq_printf(m, "%-20s %d (pending %d)\n", p->name, cur, next);
+        else
+            seq_printf(m, "%-20s %d\n", p->name, cur);
     }
-    
-    spin_unlock_irqrestore(&sig_lock, flags);
+    seq_printf(m, "%-20s %u (load time)\n", "max_tracked", max_tracked);
     
     return 0;
 }
 
-static int stats_open(struct inode *inode, struct file *file)
+static int config_open(struct inode *inode, struct file *file)
 {
-    return single_open(file, stats_show, NULL);
+    return single_open(file, config_show, NULL);
 }
 
-static const struct proc_ops stats_ops = {
-    .proc_open = stats_open,
-    .proc_read = seq_read,
+static ssize_t config_write(struct file *file, const char __user *ubuf,
+                            size_t count, loff_t *ppos)
+{
+    char buf[CONFIG_WRITE_MAX];
+    int vals[CFG_NR_PARAMS];
+    unsigned int mask = 0;
+    struct sched_config next;
+    char *cur, *tok;
+    int i;
+    
+    if (count >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, count))
+        return -EFAULT;
+    buf[count] = '\0';
+    
+    cur = buf;
+    while ((tok = strsep(&cur, " \t\n,")) != NULL) {
+        const struct config_param *p;
+        char *val;
+        int v;
+        
+        if (!*tok)
+            continue;
+        
+        val = strchr(tok, '=');
+        if (!val)
+            return -EINVAL;
+        *val++ = '\0';
+        
+        p = config_lookup(tok);
+        if (!p || kstrtoint(val, 0, &v) || v < p->min || v > p->max)
+            return -EINVAL;
+        
+        i = p - config_params;
+        vals[i] = v;
+        mask |= 1U << i;
+    }
+    
+    if (!mask)
+        return -EINVAL;
+    
+    spin_lock(&cfg_lock);
+    next = cfg_pending;
+    for (i = 0; i < CFG_NR_PARAMS; i++)
+        if (mask & (1U << i))
+            *config_field(&next, &config_params[i]) = vals[i];
+    config_stage_locked(&next);
+    spin_unlock(&cfg_lock);
+    
+    return count;
+}
+
+static const struct proc_ops config_ops = {
+    .proc_open = config_open,
+    .proc_read = perf_seq_read,
+    .proc_write = config_write,
     .proc_lseek = seq_lseek,
     .proc_release = single_release,
 };
@@ -487,70 +3677,185 @@ static const struct proc_ops stats_ops = {
 
 static int __init smartscheduler_init(void)
 {
+    int bkt, i;
+    
     printk(KERN_INFO "SmartScheduler: Initializing module...\n");
     
     module_start_time = jiffies;
     
+    /* Load-time parameters were staged by config_param_set() */
+    cfg = cfg_pending;
+    cfg_dirty = false;
+    if (max_tracked < MAX_TRACKED_MIN || max_tracked > MAX_TRACKED_MAX) {
+        printk(KERN_WARNING "SmartScheduler: max_tracked %u out of range, clamping\n",
+               max_tracked);
+        max_tracked = clamp_t(unsigned int, max_tracked, MAX_TRACKED_MIN, MAX_TRACKED_MAX);
+    }
+    
+    for (bkt = 0; bkt < HASH_SIZE(proc_signatures); bkt++)
+        spin_lock_init(&sig_bucket_locks[bkt]);
+    for (i = 0; i < PERF_NR_READS; i++)
+        spin_lock_init(&perf_reads[i].lock);
+    
+    if (init_sampling_engine()) {
+        printk(KERN_ERR "SmartScheduler: Failed to set up sampling engine\n");
+        return -ENOMEM;
+    }
+    
+    /* Slots are split between the shards, so the engine comes first */
+    if (init_sig_pool()) {
+        printk(KERN_ERR "SmartScheduler: Failed to preallocate %u signatures\n",
+               max_tracked);
+        goto cleanup_engine;
+    }
+    
+    if (init_cg_pool()) {
+        printk(KERN_ERR "SmartScheduler: Failed to preallocate %d cgroup signatures\n",
+               MAX_TRACKED_CGROUPS);
+        goto cleanup_engine;
+    }
+    
+    event_ring = kvcalloc(EVENT_RING_SIZE, sizeof(*event_ring), GFP_KERNEL);
+    if (!event_ring) {
+        printk(KERN_ERR "SmartScheduler: Failed to allocate event ring\n");
+        goto cleanup_engine;
+    }
+    
+    /* Binary snapshot device */
+    if (init_snapshot()) {
+        printk(KERN_ERR "SmartScheduler: Failed to register %s\n", SMARTSCHED_DEV_PATH);
+        goto cleanup_engine;
+    }
+    
     /* Create procfs directory */
     proc_dir = proc_mkdir("smartscheduler", NULL);
     if (!proc_dir) {
         printk(KERN_ERR "SmartScheduler: Failed to create /proc/smartscheduler\n");
-        return -ENOMEM;
+        goto cleanup_proc;
     }
     
-    /* Create procfs entries */
-    proc_status = proc_create("status", 0444, proc_dir, &status_ops);
-    proc_predictions = proc_create("predictions", 0444, proc_dir, &predictions_ops);
-    proc_stats = proc_create("stats", 0444, proc_dir, &stats_ops);
+    /* Create procfs entries; the data is the view's read cost counter */
+    proc_status = proc_create_data("status", 0444, proc_dir, &status_ops,
+                                   &perf_reads[PERF_READ_STATUS]);
+    proc_predictions = proc_create_data("predictions", 0444, proc_dir, &predictions_ops,
+                                        &perf_reads[PERF_READ_PREDICTIONS]);
+    proc_stats = proc_create_data("stats", 0444, proc_dir, &stats_ops,
+                                  &perf_reads[PERF_READ_STATS]);
+    proc_events = proc_create("events", 0444, proc_dir, &events_ops);
+    proc_config = proc_create_data("config", 0644, proc_dir, &config_ops,
+                                   &perf_reads[PERF_READ_CONFIG]);
+    proc_cgroups = proc_create_data("cgroups", 0444, proc_dir, &cgroups_ops,
+                                    &perf_reads[PERF_READ_CGROUPS]);
+    proc_threads = proc_create_data("threads", 0444, proc_dir, &threads_ops,
+                                    &perf_reads[PERF_READ_THREADS]);
+    proc_memory = proc_create_data("memory", 0444, proc_dir, &memory_ops,
+                                   &perf_reads[PERF_READ_MEMORY]);
+    proc_perf = proc_create_data("perf", 0444, proc_dir, &perf_ops,
+                                 &perf_reads[PERF_READ_PERF]);
+    proc_spiking = proc_create_data("spiking", 0444, proc_dir, &spiking_ops,
+                                    &perf_reads[PERF_READ_SPIKING]);
+    proc_top = proc_create_data("top", 0444, proc_dir, &top_ops,
+                                &perf_reads[PERF_READ_TOP]);
+    proc_forecast = proc_create_data("forecast", 0444, proc_dir, &forecast_ops,
+                                     &perf_reads[PERF_READ_FORECAST]);
     
-    if (!proc_status || !proc_predictions || !proc_stats) {
+    if (!proc_status || !proc_predictions || !proc_stats || !proc_events ||
+        !proc_config || !proc_cgroups || !proc_threads || !proc_memory || !proc_perf ||
+        !proc_spiking || !proc_top || !proc_forecast) {
         printk(KERN_ERR "SmartScheduler: Failed to create proc entries\n");
         goto cleanup_proc;
     }
     
-    /* Initialize and start sampling timer */
-    timer_setup(&sample_timer, sample_timer_callback, 0);
-    mod_timer(&sample_timer, jiffies + msecs_to_jiffies(SAMPLE_INTERVAL_MS));
+    /* Start sampling */
+    spin_lock(&cfg_lock);
+    cfg_running = true;
+    queue_delayed_work(sample_wq, &sample_work, msecs_to_jiffies(cfg.sample_interval_ms));
+    spin_unlock(&cfg_lock);
     
     printk(KERN_INFO "SmartScheduler: Module loaded successfully\n");
-    printk(KERN_INFO "SmartScheduler: Sampling every %d ms\n", SAMPLE_INTERVAL_MS);
+    printk(KERN_INFO "SmartScheduler: Sampling every %d ms across %u shards, tracking up to %u\n",
+           cfg.sample_interval_ms, nr_shards, max_tracked);
     printk(KERN_INFO "SmartScheduler: View status at /proc/smartscheduler/\n");
     
     return 0;
 
 cleanup_proc:
+    if (proc_forecast) proc_remove(proc_forecast);
+    if (proc_top) proc_remove(proc_top);
+    if (proc_spiking) proc_remove(proc_spiking);
+    if (proc_perf) proc_remove(proc_perf);
+    if (proc_memory) proc_remove(proc_memory);
+    if (proc_threads) proc_remove(proc_threads);
+    if (proc_cgroups) proc_remove(proc_cgroups);
+    if (proc_config) proc_remove(proc_config);
+    if (proc_events) proc_remove(proc_events);
     if (proc_stats) proc_remove(proc_stats);
     if (proc_predictions) proc_remove(proc_predictions);
     if (proc_status) proc_remove(proc_status);
     if (proc_dir) proc_remove(proc_dir);
+    destroy_snapshot();
+cleanup_engine:
+    kvfree(event_ring);
+    destroy_workqueue(sample_wq);
+    kvfree(sample_buf);
+    kvfree(sample_sorted);
+    kvfree(top_store);
+    destroy_cg_pool();
+    destroy_sig_pool();
     return -ENOMEM;
 }
 
 static void __exit smartscheduler_exit(void)
 {
+    struct cgroup_signature *cg;
     struct proc_signature *sig;
     struct hlist_node *tmp;
-    unsigned long flags;
     int bkt;
     
     printk(KERN_INFO "SmartScheduler: Unloading module...\n");
     
-    /* Stop timer */
-    del_timer_sync(&sample_timer);
+    /*
+     * Stop sampling: the coordinator re-arms itself, cancel_*_sync
+     * handles that; clearing cfg_running stops config writes doing it.
+     */
+    spin_lock(&cfg_lock);
+    cfg_running = false;
+    spin_unlock(&cfg_lock);
+    cancel_delayed_work_sync(&sample_work);
+    destroy_workqueue(sample_wq);
     
     /* Remove procfs entries */
+    shutdown_events();
+    proc_remove(proc_forecast);
+    proc_remove(proc_top);
+    proc_remove(proc_spiking);
+    proc_remove(proc_perf);
+    proc_remove(proc_memory);
+    proc_remove(proc_threads);
+    proc_remove(proc_cgroups);
+    proc_remove(proc_config);
+    proc_remove(proc_events);
     proc_remove(proc_stats);
     proc_remove(proc_predictions);
     proc_remove(proc_status);
     proc_remove(proc_dir);
+    destroy_snapshot();
     
-    /* Free all signatures */
-    spin_lock_irqsave(&sig_lock, flags);
-    hash_for_each_safe(proc_signatures, bkt, tmp, sig, hash_node) {
+    /* Unhash all signatures (no sampler or readers left) */
+    hash_for_each_safe(proc_signatures, bkt, tmp, sig, hash_node)
         hash_del(&sig->hash_node);
-        kfree(sig);
-    }
-    spin_unlock_irqrestore(&sig_lock, flags);
+    hash_for_each_safe(cgroup_signatures, bkt, tmp, cg, hash_node)
+        hash_del(&cg->hash_node);
+    
+    /* Wait for pending *_free_rcu() callbacks before freeing the pools */
+    rcu_barrier();
+    destroy_sig_pool();
+    destroy_cg_pool();
+    
+    kvfree(sample_buf);
+    kvfree(sample_sorted);
+    kvfree(top_store);
+    kvfree(event_ring);
     
     printk(KERN_INFO "SmartScheduler: Module unloaded. Total predictions made: %d\n",
            atomic_read(&total_predictions));
@@ -0,0 +1,149 @@
+#!/bin/bash
+#
+# SmartScheduler Benchmark Suite
+# Runs user/bench against each configuration and merges the results
+# into one JSON file for regression tracking across kernel versions:
+#
+#   baseline   nothing loaded: victim throughput, and the model step
+#              per tick, scalar vs. batch vs. SIMD
+#   module     smartscheduler.ko: throughput, detection latency per
+#              resource, sampler cost vs. process and thread count
+#   bpf_<p>    bpf_collector with only eBPF program <p> (cpu, mem, io)
+#
+# The module's load state is restored on exit.
+#
+# Usage: sudo ./bench.sh [-o FILE] [-n COUNTS] [-s SECONDS] [-k REPS] [-f IO_DIR]
+#
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+LOG_DIR="$PROJECT_DIR/logs"
+TIMESTAMP=$(date +%Y%m%d_%H%M%S)
+
+BENCH="$PROJECT_DIR/user/bench"
+COLLECTOR="$PROJECT_DIR/user/bpf_collector"
+MODULE="$PROJECT_DIR/kernel/smartscheduler.ko"
+OBJ_DIR="$PROJECT_DIR/ebpf/.output"
+
+OUTPUT="$LOG_DIR/bench_$(uname -r)_$TIMESTAMP.json"
+COUNTS="0,1000,10000,50000"
+SECONDS_PER_RUN=5
+REPS=10
+IO_DIR="$PROJECT_DIR"
+
+while getopts "o:n:s:k:f:h" opt; do
+    case $opt in
+        o) OUTPUT=$OPTARG ;;
+        n) COUNTS=$OPTARG ;;
+        s) SECONDS_PER_RUN=$OPTARG ;;
+        k) REPS=$OPTARG ;;
+        f) IO_DIR=$OPTARG ;;
+        *) sed -n '3,15p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+    esac
+done
+
+echo "========================================"
+echo "  SmartScheduler Benchmark Suite"
+echo "========================================"
+echo
+
+if [ "$EUID" -ne 0 ]; then
+    echo "Error: Benchmarks require root privileges"
+    echo "Run: sudo ./bench.sh"
+    exit 1
+fi
+
+make -C "$PROJECT_DIR/user" bench >/dev/null
+mkdir -p "$LOG_DIR" "$(dirname "$OUTPUT")"
+
+RUN_DIR=$(mktemp -d)
+WAS_LOADED=0
+lsmod | grep -q '^smartscheduler ' && WAS_LOADED=1
+
+module_load() {
+    lsmod | grep -q '^smartscheduler ' || insmod "$MODULE"
+    sleep 1
+}
+
+module_unload() {
+    if lsmod | grep -q '^smartscheduler '; then
+        rmmod smartscheduler
+    fi
+}
+
+cleanup() {
+    [ -n "$COLLECTOR_PID" ] && kill "$COLLECTOR_PID" 2>/dev/null || true
+    if [ "$WAS_LOADED" -eq 1 ]; then module_load; else module_unload; fi
+    rm -rf "$RUN_DIR"
+}
+trap cleanup EXIT
+
+# Each run writes one JSON document into RUN_DIR
+RUN=0
+bench() {
+    RUN=$((RUN + 1))
+    echo "  bench $*"
+    "$BENCH" "$@" -q -o "$RUN_DIR/$(printf %03d $RUN).json" ||
+        rm -f "$RUN_DIR/$(printf %03d $RUN).json"
+}
+
+echo "[1/3] Baseline (nothing loaded)"
+module_unload
+bench overhead -l baseline -s "$SECONDS_PER_RUN"
+bench model -l baseline -n "1000,10000,50000"
+
+echo "[2/3] Kernel module"
+if [ -f "$MODULE" ]; then
+    module_load
+    bench overhead -l module -s "$SECONDS_PER_RUN"
+    for res in cpu mem io; do
+        bench latency -l module -r "$res" -k "$REPS" -f "$IO_DIR"
+    done
+    bench cost -l module -n "$COUNTS" -s "$SECONDS_PER_RUN"
+
+    # Threads are only walked in thread mode
+    echo "thread_mode=1" > /proc/smartscheduler/config
+    bench cost -l module_threads -T -n "$COUNTS" -s "$SECONDS_PER_RUN"
+    echo "thread_mode=0" > /proc/smartscheduler/config
+    module_unload
+else
+    echo "  skipped: $MODULE not built (make -C kernel)"
+fi
+
+echo "[3/3] eBPF programs"
+if [ -x "$COLLECTOR" ] && [ -d "$OBJ_DIR" ]; then
+    for prog in cpu mem io; do
+        "$COLLECTOR" -d "$OBJ_DIR" -O "$prog" -q >/dev/null 2>&1 &
+        COLLECTOR_PID=$!
+        sleep 2
+        if kill -0 "$COLLECTOR_PID" 2>/dev/null; then
+            bench overhead -l "bpf_$prog" -s "$SECONDS_PER_RUN"
+            kill "$COLLECTOR_PID"
+            wait "$COLLECTOR_PID" 2>/dev/null || true
+        else
+            echo "  skipped: bpf_collector -O $prog failed to start"
+        fi
+        COLLECTOR_PID=
+    done
+else
+    echo "  skipped: build user/bpf_collector and ebpf/ first"
+fi
+
+# Merge: {"suite": ..., "runs": [doc, doc, ...]}
+{
+    printf '{\n  "suite": "smartsched-bench",\n  "kernel": "%s",\n' "$(uname -r)"
+    printf '  "date": "%s",\n  "runs": [\n' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    first=1
+    for f in "$RUN_DIR"/*.json; do
+        [ -e "$f" ] || continue
+        [ $first -eq 1 ] || printf ',\n'
+        first=0
+        printf '%s' "$(sed 's/^/    /' "$f")"
+    done
+    printf '\n  ]\n}\n'
+} > "$OUTPUT"
+
+echo
+echo "Results: $OUTPUT"
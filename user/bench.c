@@ -0,0 +1,1101 @@
+/*
+ * SmartScheduler Benchmark
+ *
+ * Reproducible measurements of what the module detects and what it
+ * costs, written as one JSON document for regression tracking across
+ * kernel versions:
+ *
+ *   latency   Forks a warm, idle victim, makes it spike (the cpu / mem
+ *             / io bursts of stress_test) at a recorded instant and
+ *             waits on /proc/smartscheduler/events for its spike
+ *             event. Reports the time to the flagging tick and to the
+ *             event reaching user space.
+ *   cost      Grows a population of idle processes (or threads) to
+ *             each requested size, up to 50k, and reads the sampler's
+ *             tick time per size from /proc/smartscheduler/perf.
+ *   overhead  Throughput of CPU-bound, syscall-bound, page-fault and
+ *             context-switch victims on the system as it is.
+ *   model     Time per tick of the prediction model's EMA / RoC step
+ *             over N signatures: one smartsched_model_step() call per
+ *             signature and resource on per-signature structs, the
+ *             portable column batch, and the SIMD batch of model_simd.h.
+ *             Also checks the three give identical results.
+ *
+ * overhead does not load anything itself; scripts/bench.sh runs it
+ * with nothing, the module, and each eBPF program loaded and merges
+ * the documents. Every mode can add an idle population (-n) as
+ * background load; -w makes its tasks wake every few ms so adaptive
+ * sampling cannot skip them. Threads (-T) are only visited by the
+ * module with thread_mode=1.
+ *
+ * Compile: gcc -o bench bench.c -Wall -O2 -I../kernel -lpthread
+ * Run: sudo ./bench latency [-r cpu|mem|io] [-k REPS] [-n TASKS] [-o FILE]
+ *      sudo ./bench cost [-n N,N,...] [-s SECONDS] [-T] [-w MS] [-o FILE]
+ *      ./bench overhead [-V cpu,syscall,fault,switch] [-s SECONDS] [-l LABEL]
+ *      ./bench model [-n N,N,...] [-k TICKS] [-o FILE]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+#include "smartsched_abi.h"
+#include "model_simd.h"
+
+#define PROC_EVENTS       "/proc/smartscheduler/events"
+#define PROC_PERF         "/proc/smartscheduler/perf"
+#define PROC_CONFIG       "/proc/smartscheduler/config"
+
+#define BENCH_VERSION     1
+#define MAX_REPS          1000
+#define MAX_COUNTS        16
+#define MAX_TASKS         200000
+#define PERF_HIST_SLOTS   32       /* Matches the module */
+#define PERF_MAX_KEYS     160
+
+#define DEFAULT_REPS      10
+#define DEFAULT_WARMUP_MS 1500     /* Lets the victim's signature settle */
+#define DEFAULT_TIMEOUT_MS 5000
+#define DEFAULT_MEM_MB    256
+#define DEFAULT_SECONDS   5
+#define DEFAULT_COUNTS    "0,1000,10000"
+#define DEFAULT_MODEL_COUNTS "1000,10000,50000"
+#define DEFAULT_MODEL_TICKS 100
+#define MODEL_FRAMES      8        /* Sample sets the model ticks cycle through */
+#define THREAD_STACK      (64 * 1024)
+#define IO_CHUNK          (1024 * 1024)
+#define IO_FILE_MAX       (256ULL * 1024 * 1024)
+
+static const char *res_names[] = { "cpu", "mem", "io" };
+
+static volatile int running = 1;
+static int verbose = 1;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR && running)
+        ;
+}
+
+#define note(...) do { if (verbose) fprintf(stderr, __VA_ARGS__); } while (0)
+
+/* ============================================
+ * JSON OUTPUT
+ * ============================================ */
+
+static FILE *jout;
+static int jdepth;
+static int jfirst[16] = { 1 };
+
+static void json_item(const char *key) {
+    if (!jfirst[jdepth]) fputc(',', jout);
+    jfirst[jdepth] = 0;
+    if (jdepth) fprintf(jout, "\n%*s", jdepth * 2, "");
+    if (key) fprintf(jout, "\"%s\": ", key);
+}
+
+static void json_open(const char *key, char c) {
+    json_item(key);
+    fputc(c, jout);
+    jfirst[++jdepth] = 1;
+}
+
+static void json_close(char c) {
+    int empty = jfirst[jdepth];
+    jdepth--;
+    if (!empty) fprintf(jout, "\n%*s", jdepth * 2, "");
+    fputc(c, jout);
+}
+
+static void json_u64(const char *key, uint64_t v) {
+    json_item(key);
+    fprintf(jout, "%llu", (unsigned long long)v);
+}
+
+static void json_num(const char *key, double v) {
+    json_item(key);
+    fprintf(jout, "%.3f", v);
+}
+
+static void json_bool(const char *key, int v) {
+    json_item(key);
+    fputs(v ? "true" : "false", jout);
+}
+
+static void json_str(const char *key, const char *s) {
+    json_item(key);
+    fputc('"', jout);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(jout, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(jout, "\\u%04x", *s);
+        else fputc(*s, jout);
+    }
+    fputc('"', jout);
+}
+
+/* min / p50 / p90 / max / mean of a sample set, sorted in place */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void json_summary(const char *key, uint64_t *v, int n) {
+    uint64_t sum = 0;
+
+    qsort(v, n, sizeof(*v), compare_u64);
+    for (int i = 0; i < n; i++) sum += v[i];
+
+    json_open(key, '{');
+    json_u64("n", n);
+    if (n > 0) {
+        json_u64("min", v[0]);
+        json_u64("p50", v[(n - 1) / 2]);
+        json_u64("p90", v[(n - 1) * 9 / 10]);
+        json_u64("max", v[n - 1]);
+        json_u64("mean", sum / n);
+    }
+    json_close('}');
+}
+
+/* Host and module description shared by every mode */
+static void json_environment(const char *mode, const char *label) {
+    struct utsname uts;
+    char line[256];
+    FILE *f;
+
+    uname(&uts);
+    json_str("tool", "smartsched-bench");
+    json_u64("version", BENCH_VERSION);
+    json_str("mode", mode);
+    if (label) json_str("label", label);
+    json_str("kernel", uts.release);
+    json_str("machine", uts.machine);
+    json_u64("nr_cpus", sysconf(_SC_NPROCESSORS_ONLN));
+    json_u64("timestamp", (uint64_t)time(NULL));
+    json_bool("module_loaded", access(PROC_PERF, R_OK) == 0);
+
+    /* Module config lines are "name value [(pending N)]" */
+    f = fopen(PROC_CONFIG, "r");
+    if (!f) return;
+    json_open("module_config", '{');
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        long long v;
+        if (sscanf(line, "%63s %lld", name, &v) == 2)
+            json_u64(name, (uint64_t)v);
+    }
+    json_close('}');
+    fclose(f);
+}
+
+/* ============================================
+ * IDLE POPULATION
+ * ============================================ */
+
+static struct {
+    pid_t *pids;
+    int nr_procs;
+    pthread_t *threads;
+    int nr_threads;
+    int wake_ms;                  /* 0 = block until torn down */
+    int stop_pipe[2];             /* Threads block reading [0] */
+    volatile int stop;
+} pop = { .stop_pipe = { -1, -1 } };
+
+static void *idle_thread(void *arg) {
+    char c;
+
+    (void)arg;
+    while (!pop.stop) {
+        if (pop.wake_ms)
+            sleep_ms(pop.wake_ms);
+        else if (read(pop.stop_pipe[0], &c, 1) <= 0)
+            break;
+    }
+    return NULL;
+}
+
+/* Child side of an idle process: dies with the benchmark */
+static void idle_process(pid_t parent) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    for (;;) {
+        if (pop.wake_ms) sleep_ms(pop.wake_ms);
+        else pause();
+    }
+}
+
+/* Grow the population to total tasks; returns how many exist */
+static int population_grow(int total, int threads) {
+    pid_t parent = getpid();
+
+    if (threads) {
+        pthread_attr_t attr;
+
+        if (!pop.threads) pop.threads = calloc(MAX_TASKS, sizeof(*pop.threads));
+        if (pop.stop_pipe[0] < 0 && pipe(pop.stop_pipe) < 0) return 0;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, THREAD_STACK);
+        while (pop.threads && pop.nr_threads < total && running) {
+            if (pthread_create(&pop.threads[pop.nr_threads], &attr, idle_thread, NULL)) {
+                note("bench: thread %d: %s\n", pop.nr_threads, strerror(errno));
+                break;
+            }
+            pop.nr_threads++;
+        }
+        pthread_attr_destroy(&attr);
+        return pop.nr_threads;
+    }
+
+    if (!pop.pids) pop.pids = calloc(MAX_TASKS, sizeof(*pop.pids));
+    while (pop.pids && pop.nr_procs < total && running) {
+        pid_t pid = fork();
+        if (pid == 0) idle_process(parent);
+        if (pid < 0) {
+            note("bench: fork %d: %s (check pid_max and ulimit -u)\n",
+                 pop.nr_procs, strerror(errno));
+            break;
+        }
+        pop.pids[pop.nr_procs++] = pid;
+    }
+    return pop.nr_procs;
+}
+
+static void population_destroy(void) {
+    for (int i = 0; i < pop.nr_procs; i++)
+        kill(pop.pids[i], SIGKILL);
+    for (int i = 0; i < pop.nr_procs; i++)
+        waitpid(pop.pids[i], NULL, 0);
+    pop.nr_procs = 0;
+
+    if (pop.nr_threads) {
+        pop.stop = 1;
+        close(pop.stop_pipe[1]);
+        for (int i = 0; i < pop.nr_threads; i++)
+            pthread_join(pop.threads[i], NULL);
+        pop.nr_threads = 0;
+    }
+    free(pop.pids);
+    free(pop.threads);
+}
+
+/* Let the population and the fork storm drain out of the EMAs */
+static void population_settle(int total, int threads) {
+    if (total <= 0) return;
+    note("bench: %d idle %s, settling\n", population_grow(total, threads),
+         threads ? "threads" : "processes");
+    sleep_ms(2000);
+}
+
+/* ============================================
+ * DETECTION LATENCY
+ * ============================================ */
+
+static void spike_cpu(uint64_t until) {
+    volatile uint64_t x = 1;
+
+    while (now_ns() < until) {
+        for (int i = 0; i < 100000; i++)
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+}
+
+static void spike_mem(uint64_t until, size_t mb) {
+    char *mem = malloc(mb << 20);
+
+    if (!mem) return;
+    for (size_t off = 0; off < (mb << 20) && now_ns() < until; off += 4096)
+        mem[off] = 1;
+    while (now_ns() < until) sleep_ms(10);
+    free(mem);
+}
+
+/*
+ * The module counts storage I/O (task_io_accounting), so writes go
+ * O_DIRECT where the filesystem allows and are synced otherwise;
+ * tmpfs does neither, so dir must be on a real disk
+ */
+static void spike_io(uint64_t until, const char *dir) {
+    char path[PATH_MAX];
+    uint64_t written = 0;
+    int direct = 1, fd;
+    void *buf;
+
+    snprintf(path, sizeof(path), "%s/.smartsched-bench-XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd < 0) return;
+    unlink(path);
+    if (fcntl(fd, F_SETFL, O_DIRECT) < 0) direct = 0;
+    if (posix_memalign(&buf, 4096, IO_CHUNK)) {
+        close(fd);
+        return;
+    }
+    memset(buf, 0xa5, IO_CHUNK);
+
+    while (now_ns() < until) {
+        if (write(fd, buf, IO_CHUNK) != IO_CHUNK) {
+            if (!direct) break;
+            fcntl(fd, F_SETFL, 0);
+            direct = 0;
+            continue;
+        }
+        written += IO_CHUNK;
+        if (!direct && (written & (8 * IO_CHUNK - 1)) == 0) fdatasync(fd);
+        if (written >= IO_FILE_MAX) {
+            lseek(fd, 0, SEEK_SET);
+            written = 0;
+        }
+    }
+    free(buf);
+    close(fd);
+}
+
+typedef struct {
+    int res;
+    int reps;
+    int warmup_ms;
+    int timeout_ms;
+    size_t mem_mb;
+    const char *io_dir;
+} LatencyOpts;
+
+/*
+ * Victim: blocks on the pipe until told to go, then spikes until the
+ * parent kills it or the timeout passes
+ */
+static pid_t start_victim(const LatencyOpts *o, int *go_fd) {
+    int fds[2];
+    pid_t parent = getpid(), pid;
+
+    if (pipe(fds) < 0) return -1;
+    pid = fork();
+    if (pid == 0) {
+        char c;
+        uint64_t until;
+
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) _exit(0);
+        close(fds[1]);
+        if (read(fds[0], &c, 1) != 1) _exit(0);
+        until = now_ns() + (uint64_t)o->timeout_ms * 1000000ULL;
+        switch (o->res) {
+            case SMARTSCHED_RES_CPU: spike_cpu(until); break;
+            case SMARTSCHED_RES_MEM: spike_mem(until, o->mem_mb); break;
+            case SMARTSCHED_RES_IO:  spike_io(until, o->io_dir); break;
+        }
+        _exit(0);
+    }
+    close(fds[0]);
+    if (pid < 0) {
+        close(fds[1]);
+        return -1;
+    }
+    *go_fd = fds[1];
+    return pid;
+}
+
+/*
+ * Wait for the victim's spike event on res
+ * Returns 1 with the flagging tick's timestamp and arrival time, 0 on
+ * timeout; overruns are counted since a lost event may be ours.
+ */
+static int wait_spike(int evfd, pid_t pid, int res, uint64_t deadline,
+                      uint64_t *tick_ns, uint64_t *seen_ns, unsigned long *overruns) {
+    struct smartsched_event evs[64];
+    struct pollfd pfd = { .fd = evfd, .events = POLLIN };
+
+    while (running) {
+        uint64_t now = now_ns();
+        ssize_t n;
+
+        if (now >= deadline) return 0;
+        if (poll(&pfd, 1, (int)((deadline - now) / 1000000ULL) + 1) <= 0) continue;
+
+        n = read(evfd, evs, sizeof(evs));
+        if (n <= 0) continue;
+        now = now_ns();
+        for (int i = 0; i < (int)(n / sizeof(evs[0])); i++) {
+            if (evs[i].type == SMARTSCHED_EVENT_OVERRUN) {
+                (*overruns)++;
+                continue;
+            }
+            if (evs[i].type == SMARTSCHED_EVENT_SPIKE && evs[i].pid == pid &&
+                evs[i].resource == res) {
+                *tick_ns = evs[i].timestamp_ns;
+                *seen_ns = now;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int run_latency(const LatencyOpts *o, int population, int threads, const char *label) {
+    static uint64_t tick_lat[MAX_REPS], seen_lat[MAX_REPS];
+    unsigned long overruns = 0;
+    int detected = 0, evfd;
+
+    evfd = open(PROC_EVENTS, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (evfd < 0) {
+        fprintf(stderr, "bench: %s: %s (is the module loaded?)\n", PROC_EVENTS, strerror(errno));
+        return 1;
+    }
+    population_settle(population, threads);
+
+    for (int rep = 0; rep < o->reps && running; rep++) {
+        uint64_t inject, tick = 0, seen = 0;
+        int go_fd;
+        pid_t pid = start_victim(o, &go_fd);
+
+        if (pid < 0) {
+            fprintf(stderr, "bench: fork: %s\n", strerror(errno));
+            break;
+        }
+        sleep_ms(o->warmup_ms);
+
+        inject = now_ns();
+        if (write(go_fd, "g", 1) == 1 &&
+            wait_spike(evfd, pid, o->res, inject + (uint64_t)o->timeout_ms * 1000000ULL,
+                       &tick, &seen, &overruns)) {
+            /* A tick stamped before the injection cannot be ours */
+            tick_lat[detected] = tick > inject ? tick - inject : 0;
+            seen_lat[detected] = seen - inject;
+            note("bench: %s rep %d: flagged after %.1f ms\n", res_names[o->res], rep,
+                 tick_lat[detected] / 1e6);
+            detected++;
+        } else {
+            note("bench: %s rep %d: not flagged within %d ms\n", res_names[o->res], rep,
+                 o->timeout_ms);
+        }
+        close(go_fd);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    close(evfd);
+
+    json_open(NULL, '{');
+    json_environment("latency", label);
+    json_str("resource", res_names[o->res]);
+    json_u64("population", pop.nr_procs + pop.nr_threads);
+    json_u64("reps", o->reps);
+    json_u64("detected", detected);
+    json_u64("overruns", overruns);
+    json_summary("tick_latency_ns", tick_lat, detected);
+    json_summary("delivery_latency_ns", seen_lat, detected);
+    json_close('}');
+    return 0;
+}
+
+/* ============================================
+ * SAMPLER COST
+ * ============================================ */
+
+/* /proc/smartscheduler/perf: "key v [v ...]" per line */
+typedef struct {
+    char key[48];
+    uint64_t v[PERF_HIST_SLOTS];
+    int n;
+} PerfKey;
+
+typedef struct {
+    PerfKey keys[PERF_MAX_KEYS];
+    int n;
+} PerfSnap;
+
+static int perf_read(PerfSnap *p) {
+    char line[1024];
+    FILE *f = fopen(PROC_PERF, "r");
+
+    p->n = 0;
+    if (!f) return -1;
+    while (p->n < PERF_MAX_KEYS && fgets(line, sizeof(line), f)) {
+        PerfKey *k = &p->keys[p->n];
+        char *tok = strtok(line, " \n");
+
+        if (!tok) continue;
+        snprintf(k->key, sizeof(k->key), "%s", tok);
+        k->n = 0;
+        while (k->n < PERF_HIST_SLOTS && (tok = strtok(NULL, " \n")))
+            k->v[k->n++] = strtoull(tok, NULL, 10);
+        p->n++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static const PerfKey *perf_key(const PerfSnap *p, const char *key) {
+    for (int i = 0; i < p->n; i++)
+        if (strcmp(p->keys[i].key, key) == 0) return &p->keys[i];
+    return NULL;
+}
+
+static uint64_t perf_val(const PerfSnap *p, const char *key) {
+    const PerfKey *k = perf_key(p, key);
+    return k && k->n ? k->v[0] : 0;
+}
+
+/* Percentile over the slots added between two snapshots, as the module reports them */
+static uint64_t perf_delta_pct(const PerfSnap *a, const PerfSnap *b, const char *hist, int pct) {
+    const PerfKey *ka = perf_key(a, hist), *kb = perf_key(b, hist);
+    uint64_t slot[PERF_HIST_SLOTS] = { 0 }, total = 0, want, acc = 0;
+
+    if (!kb) return 0;
+    for (int i = 0; i < kb->n; i++) {
+        slot[i] = kb->v[i] - (ka && i < ka->n ? ka->v[i] : 0);
+        total += slot[i];
+    }
+    if (!total) return 0;
+
+    want = (total * pct + 99) / 100;
+    for (int i = 0; i < PERF_HIST_SLOTS; i++) {
+        acc += slot[i];
+        if (acc >= want) return i ? (1ULL << i) - 1 : 0;
+    }
+    return 0;
+}
+
+#define PERF_DELTA(a, b, key) (perf_val(b, key) - perf_val(a, key))
+
+static void json_phase(const PerfSnap *a, const PerfSnap *b, const char *phase) {
+    char key[64];
+    uint64_t ticks = PERF_DELTA(a, b, "tick_count");
+
+    json_open(phase, '{');
+    snprintf(key, sizeof(key), "%s_sum_ns", phase);
+    json_u64("mean_ns", ticks ? PERF_DELTA(a, b, key) / ticks : 0);
+    snprintf(key, sizeof(key), "%s_hist", phase);
+    json_u64("p50_ns", perf_delta_pct(a, b, key, 50));
+    json_u64("p99_ns", perf_delta_pct(a, b, key, 99));
+    json_close('}');
+}
+
+static int run_cost(const int *counts, int nr_counts, int seconds, int threads,
+                    const char *label) {
+    static PerfSnap before, after;
+
+    if (perf_read(&before) < 0) {
+        fprintf(stderr, "bench: %s: %s (is the module loaded?)\n", PROC_PERF, strerror(errno));
+        return 1;
+    }
+
+    json_open(NULL, '{');
+    json_environment("cost", label);
+    json_str("tasks", threads ? "threads" : "processes");
+    json_u64("wake_ms", pop.wake_ms);
+    json_u64("window_s", seconds);
+    json_open("points", '[');
+
+    for (int c = 0; c < nr_counts && running; c++) {
+        int have = population_grow(counts[c], threads);
+        uint64_t ticks, interval_ns;
+
+        note("bench: %d idle %s, settling\n", have, threads ? "threads" : "processes");
+        sleep_ms(3000);
+        perf_read(&before);
+        sleep_ms(seconds * 1000);
+        perf_read(&after);
+
+        ticks = PERF_DELTA(&before, &after, "tick_count");
+        interval_ns = perf_val(&after, "interval_ms") * 1000000ULL;
+
+        json_open(NULL, '{');
+        json_u64("requested", counts[c]);
+        json_u64("spawned", have);
+        json_u64("tasks_seen", perf_val(&after, "tasks_seen"));
+        json_u64("tasks_sampled", perf_val(&after, "tasks_sampled"));
+        json_u64("ticks", ticks);
+        json_phase(&before, &after, "tick");
+        json_phase(&before, &after, "walk");
+        json_phase(&before, &after, "shards");
+        json_phase(&before, &after, "publish");
+        if (ticks && interval_ns)
+            json_num("tick_share_pct", 100.0 * PERF_DELTA(&before, &after, "tick_sum_ns") /
+                                       ticks / interval_ns);
+        json_u64("ticks_missed", PERF_DELTA(&before, &after, "ticks_missed"));
+        json_u64("lock_contended", PERF_DELTA(&before, &after, "lock_contended"));
+        json_u64("tasks_deferred", PERF_DELTA(&before, &after, "tasks_deferred"));
+        json_close('}');
+
+        note("bench: %d tasks: tick mean %.1f us\n", have,
+             ticks ? PERF_DELTA(&before, &after, "tick_sum_ns") / ticks / 1e3 : 0.0);
+        if (have < counts[c]) break;
+    }
+
+    json_close(']');
+    json_close('}');
+    return 0;
+}
+
+/* ============================================
+ * THROUGHPUT OVERHEAD
+ * ============================================ */
+
+enum { VICTIM_CPU, VICTIM_SYSCALL, VICTIM_FAULT, VICTIM_SWITCH, NR_VICTIMS };
+static const char *victim_names[NR_VICTIMS] = { "cpu", "syscall", "fault", "switch" };
+
+/* Each victim runs for the window and returns operations done */
+static uint64_t victim_cpu(uint64_t until) {
+    volatile uint64_t x = 1;
+    uint64_t ops = 0;
+
+    while (now_ns() < until) {
+        for (int i = 0; i < 10000; i++)
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        ops += 10000;
+    }
+    return ops;
+}
+
+/* One read() and one write(), the syscalls io_trace hooks */
+static uint64_t victim_syscall(uint64_t until) {
+    int in = open("/dev/zero", O_RDONLY), out = open("/dev/null", O_WRONLY);
+    char buf[64];
+    uint64_t ops = 0;
+
+    while (in >= 0 && out >= 0 && (ops & 1023 || now_ns() < until)) {
+        if (read(in, buf, sizeof(buf)) < 0 || write(out, buf, sizeof(buf)) < 0) break;
+        ops++;
+    }
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    return ops;
+}
+
+/* Fresh anonymous pages: one minor fault per page touched */
+static uint64_t victim_fault(uint64_t until) {
+    size_t len = 4 << 20, page = sysconf(_SC_PAGESIZE);
+    uint64_t ops = 0;
+
+    while (now_ns() < until) {
+        char *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) break;
+        for (size_t off = 0; off < len; off += page)
+            p[off] = 1;
+        munmap(p, len);
+        ops += len / page;
+    }
+    return ops;
+}
+
+/* Pipe ping-pong with a child: two context switches per round trip */
+static uint64_t victim_switch(uint64_t until) {
+    int ping[2], pong[2];
+    uint64_t ops = 0;
+    char c = 0;
+    pid_t pid;
+
+    if (pipe(ping) < 0 || pipe(pong) < 0) return 0;
+    pid = fork();
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        close(ping[1]);
+        close(pong[0]);
+        while (read(ping[0], &c, 1) == 1 && write(pong[1], &c, 1) == 1)
+            ;
+        _exit(0);
+    }
+    close(ping[0]);
+    close(pong[1]);
+    if (pid > 0) {
+        while (now_ns() < until) {
+            if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1) break;
+            ops++;
+        }
+    }
+    /* EOF on ping ends the child */
+    close(ping[1]);
+    close(pong[0]);
+    if (pid > 0) waitpid(pid, NULL, 0);
+    return ops;
+}
+
+static uint64_t (*const victims[NR_VICTIMS])(uint64_t) = {
+    victim_cpu, victim_syscall, victim_fault, victim_switch,
+};
+
+static int run_overhead(const int *enabled, int seconds, int reps, int cpu,
+                        int population, int threads, const char *label) {
+    static uint64_t rates[MAX_REPS];
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            note("bench: cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+    }
+    population_settle(population, threads);
+
+    json_open(NULL, '{');
+    json_environment("overhead", label);
+    json_u64("population", pop.nr_procs + pop.nr_threads);
+    json_u64("window_s", seconds);
+    json_open("victims", '{');
+
+    for (int v = 0; v < NR_VICTIMS && running; v++) {
+        if (!enabled[v]) continue;
+        for (int r = 0; r < reps; r++) {
+            uint64_t start = now_ns();
+            uint64_t ops = victims[v](start + (uint64_t)seconds * 1000000000ULL);
+            uint64_t elapsed = now_ns() - start;
+            rates[r] = elapsed ? (uint64_t)(ops * 1e9 / elapsed) : 0;
+        }
+        note("bench: %s: %llu ops/s (first run)\n", victim_names[v],
+             (unsigned long long)rates[0]);
+        json_summary(victim_names[v], rates, reps);
+    }
+
+    json_close('}');
+    json_close('}');
+    return 0;
+}
+
+/* ============================================
+ * MODEL STEP
+ * ============================================ */
+
+/* Per-signature model state, the layout before the columns */
+typedef struct {
+    int ema[SMARTSCHED_NR_RES];
+    int prev[SMARTSCHED_NR_RES];
+    int roc[SMARTSCHED_NR_RES];
+    unsigned int flags;
+} ModelRow;
+
+/* Column layout stepped by the batches */
+typedef struct {
+    int *ema[SMARTSCHED_NR_RES];
+    int *prev[SMARTSCHED_NR_RES];
+    int *roc[SMARTSCHED_NR_RES];
+    __u32 *flags;
+} ModelColumns;
+
+enum { PATH_SCALAR, PATH_BATCH, PATH_SIMD, NR_PATHS };
+static const char *path_names[NR_PATHS] = { "scalar_ns", "batch_ns", "simd_ns" };
+
+static int model_columns_alloc(ModelColumns *c, int n) {
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        c->ema[k] = calloc(n, sizeof(int));
+        c->prev[k] = calloc(n, sizeof(int));
+        c->roc[k] = calloc(n, sizeof(int));
+        if (!c->ema[k] || !c->prev[k] || !c->roc[k]) return -1;
+    }
+    c->flags = calloc(n, sizeof(__u32));
+    return c->flags ? 0 : -1;
+}
+
+static void model_columns_free(ModelColumns *c) {
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        free(c->ema[k]);
+        free(c->prev[k]);
+        free(c->roc[k]);
+    }
+    free(c->flags);
+}
+
+/* Whether the columns hold exactly the per-signature state */
+static int model_same(const ModelRow *rows, const ModelColumns *c, int n) {
+    for (int i = 0; i < n; i++) {
+        if (rows[i].flags != c->flags[i]) return 0;
+        for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+            if (rows[i].ema[k] != c->ema[k][i] || rows[i].prev[k] != c->prev[k][i] ||
+                rows[i].roc[k] != c->roc[k][i])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int run_model(const int *counts, int nr_counts, int ticks, const char *label) {
+    static uint64_t ns[NR_PATHS][MAX_REPS];
+    struct smartsched_model_params p = SMARTSCHED_MODEL_DEFAULTS;
+
+    json_open(NULL, '{');
+    json_environment("model", label);
+    json_str("simd", smartsched_simd_name());
+    json_u64("ticks", ticks);
+    json_open("points", '[');
+
+    for (int c = 0; c < nr_counts && running; c++) {
+        int n = counts[c];
+        ModelRow *rows;
+        int *samples;
+        ModelColumns cols[NR_PATHS] = { 0 };
+        uint64_t mean[NR_PATHS] = { 0 };
+        uint32_t x = 1;
+        int same;
+
+        if (n <= 0) continue;
+        rows = calloc(n, sizeof(*rows));
+        samples = malloc((size_t)MODEL_FRAMES * SMARTSCHED_NR_RES * n * sizeof(int));
+        if (!rows || !samples || model_columns_alloc(&cols[PATH_BATCH], n) < 0 ||
+            model_columns_alloc(&cols[PATH_SIMD], n) < 0) {
+            fprintf(stderr, "bench: out of memory for %d signatures\n", n);
+            return 1;
+        }
+
+        /* Loads up to two CPUs, so a share of the steps flag spikes */
+        for (size_t i = 0; i < (size_t)MODEL_FRAMES * SMARTSCHED_NR_RES * n; i++) {
+            x = x * 1103515245 + 12345;
+            samples[i] = (x >> 8) % 20000;
+        }
+
+        for (int t = 0; t < ticks; t++) {
+            const int *frame = samples + (size_t)(t % MODEL_FRAMES) * SMARTSCHED_NR_RES * n;
+            uint64_t start = now_ns();
+
+            for (int i = 0; i < n; i++) {
+                rows[i].flags = 0;
+                for (int k = 0; k < SMARTSCHED_NR_RES; k++)
+                    rows[i].flags |= smartsched_model_step(&p, k, &rows[i].ema[k],
+                                                           &rows[i].prev[k], &rows[i].roc[k],
+                                                           frame[k * n + i]);
+            }
+            ns[PATH_SCALAR][t] = now_ns() - start;
+
+            for (int path = PATH_BATCH; path < NR_PATHS; path++) {
+                ModelColumns *m = &cols[path];
+
+                start = now_ns();
+                memset(m->flags, 0, n * sizeof(*m->flags));
+                for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+                    if (path == PATH_BATCH)
+                        smartsched_model_step_batch(&p, k, m->ema[k], m->prev[k], m->roc[k],
+                                                    frame + (size_t)k * n, m->flags, n);
+                    else
+                        smartsched_model_step_simd(&p, k, m->ema[k], m->prev[k], m->roc[k],
+                                                   frame + (size_t)k * n, m->flags, n);
+                }
+                ns[path][t] = now_ns() - start;
+            }
+        }
+
+        same = model_same(rows, &cols[PATH_BATCH], n) && model_same(rows, &cols[PATH_SIMD], n);
+
+        json_open(NULL, '{');
+        json_u64("signatures", n);
+        for (int path = 0; path < NR_PATHS; path++) {
+            for (int t = 0; t < ticks; t++) mean[path] += ns[path][t];
+            mean[path] /= ticks;
+            json_summary(path_names[path], ns[path], ticks);
+        }
+        json_bool("identical", same);
+        json_close('}');
+
+        note("bench: %d signatures: scalar %.1f us, batch %.1f us, %s %.1f us per tick%s\n",
+             n, mean[PATH_SCALAR] / 1e3, mean[PATH_BATCH] / 1e3, smartsched_simd_name(),
+             mean[PATH_SIMD] / 1e3, same ? "" : " (MISMATCH)");
+
+        model_columns_free(&cols[PATH_BATCH]);
+        model_columns_free(&cols[PATH_SIMD]);
+        free(samples);
+        free(rows);
+        if (!same) {
+            json_close(']');
+            json_close('}');
+            return 1;
+        }
+    }
+
+    json_close(']');
+    json_close('}');
+    return 0;
+}
+
+/* ============================================
+ * MAIN
+ * ============================================ */
+
+static int parse_res(const char *s) {
+    for (int i = 0; i < (int)(sizeof(res_names) / sizeof(res_names[0])); i++)
+        if (strcmp(s, res_names[i]) == 0) return i;
+    return -1;
+}
+
+static int parse_counts(const char *s, int *counts) {
+    char buf[256];
+    int n = 0;
+
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *tok = strtok(buf, ","); tok && n < MAX_COUNTS; tok = strtok(NULL, ",")) {
+        counts[n] = atoi(tok);
+        if (counts[n] < 0 || counts[n] > MAX_TASKS) return -1;
+        n++;
+    }
+    return n;
+}
+
+static int parse_victims(const char *s, int *enabled) {
+    char buf[128];
+
+    memset(enabled, 0, NR_VICTIMS * sizeof(*enabled));
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        int v;
+        for (v = 0; v < NR_VICTIMS; v++)
+            if (strcmp(tok, victim_names[v]) == 0) break;
+        if (v == NR_VICTIMS) return -1;
+        enabled[v] = 1;
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("SmartScheduler Benchmark\n\n");
+    printf("Usage: %s <latency|cost|overhead|model> [options]\n\n", prog);
+    printf("Modes:\n");
+    printf("  latency   Injection-to-flag latency of a spiking victim (needs the module)\n");
+    printf("  cost      Sampler tick time vs. task count (needs the module)\n");
+    printf("  overhead  Throughput of CPU, syscall, fault and switch victims\n");
+    printf("  model     Model step time per tick: scalar vs. batch vs. SIMD (%s)\n",
+           smartsched_simd_name());
+    printf("\nOptions:\n");
+    printf("  -r <res>    latency: resource to spike, cpu|mem|io (default: cpu)\n");
+    printf("  -k <n>      Repetitions (default: %d for latency, 3 for overhead, %d ticks\n"
+           "              for model)\n", DEFAULT_REPS, DEFAULT_MODEL_TICKS);
+    printf("  -W <ms>     latency: victim warm-up before the spike (default: %d)\n",
+           DEFAULT_WARMUP_MS);
+    printf("  -t <ms>     latency: give up after this long (default: %d)\n", DEFAULT_TIMEOUT_MS);
+    printf("  -m <mb>     latency: memory spike size (default: %d)\n", DEFAULT_MEM_MB);
+    printf("  -f <dir>    latency: directory for I/O spikes, not tmpfs (default: .)\n");
+    printf("  -n <list>   Idle tasks; cost takes a list (default: %s)\n", DEFAULT_COUNTS);
+    printf("              model: signature counts (default: %s)\n", DEFAULT_MODEL_COUNTS);
+    printf("  -T          Idle tasks are threads of this process (needs thread_mode=1)\n");
+    printf("  -w <ms>     Idle tasks wake every ms (default: never)\n");
+    printf("  -s <sec>    cost / overhead measurement window (default: %d)\n", DEFAULT_SECONDS);
+    printf("  -V <list>   overhead: victims (default: cpu,syscall,fault,switch)\n");
+    printf("  -c <cpu>    overhead: pin the victims to this CPU\n");
+    printf("  -l <label>  Label stored in the output (e.g. baseline, module, bpf_cpu)\n");
+    printf("  -o <file>   Write JSON here (default: stdout)\n");
+    printf("  -q          No progress messages on stderr\n");
+    printf("  -h          Show this help\n");
+    printf("\nscripts/bench.sh runs the full suite and merges the results.\n");
+}
+
+int main(int argc, char *argv[]) {
+    LatencyOpts lat = {
+        .res = SMARTSCHED_RES_CPU,
+        .reps = DEFAULT_REPS,
+        .warmup_ms = DEFAULT_WARMUP_MS,
+        .timeout_ms = DEFAULT_TIMEOUT_MS,
+        .mem_mb = DEFAULT_MEM_MB,
+        .io_dir = ".",
+    };
+    int counts[MAX_COUNTS], nr_counts = -1;
+    int enabled[NR_VICTIMS] = { 1, 1, 1, 1 };
+    int seconds = DEFAULT_SECONDS, reps = -1, threads = 0, cpu = -1;
+    const char *label = NULL, *outfile = NULL, *mode;
+    int opt, ret;
+
+    if (argc < 2 || argv[1][0] == '-') {
+        usage(argv[0]);
+        return argc < 2;
+    }
+    mode = argv[1];
+    optind = 2;
+
+    while ((opt = getopt(argc, argv, "r:k:W:t:m:f:n:Tw:s:V:c:l:o:qh")) != -1) {
+        switch (opt) {
+            case 'r':
+                lat.res = parse_res(optarg);
+                if (lat.res < 0) {
+                    fprintf(stderr, "bench: unknown resource '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k': reps = atoi(optarg); break;
+            case 'W': lat.warmup_ms = atoi(optarg); break;
+            case 't': lat.timeout_ms = atoi(optarg); break;
+            case 'm': lat.mem_mb = (size_t)atoi(optarg); break;
+            case 'f': lat.io_dir = optarg; break;
+            case 'n':
+                nr_counts = parse_counts(optarg, counts);
+                if (nr_counts <= 0) {
+                    fprintf(stderr, "bench: bad task count list '%s' (max %d)\n",
+                            optarg, MAX_TASKS);
+                    return 1;
+                }
+                break;
+            case 'T': threads = 1; break;
+            case 'w': pop.wake_ms = atoi(optarg); break;
+            case 's': seconds = atoi(optarg); break;
+            case 'V':
+                if (parse_victims(optarg, enabled) < 0) {
+                    fprintf(stderr, "bench: unknown victim in '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'l': label = optarg; break;
+            case 'o': outfile = optarg; break;
+            case 'q': verbose = 0; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+    if (seconds < 1) seconds = 1;
+    if (reps > MAX_REPS) reps = MAX_REPS;
+
+    jout = outfile ? fopen(outfile, "w") : stdout;
+    if (!jout) {
+        fprintf(stderr, "bench: %s: %s\n", outfile, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (strcmp(mode, "latency") == 0) {
+        if (reps > 0) lat.reps = reps;
+        ret = run_latency(&lat, nr_counts > 0 ? counts[0] : 0, threads, label);
+    } else if (strcmp(mode, "cost") == 0) {
+        if (nr_counts < 0) nr_counts = parse_counts(DEFAULT_COUNTS, counts);
+        ret = run_cost(counts, nr_counts, seconds, threads, label);
+    } else if (strcmp(mode, "overhead") == 0) {
+        ret = run_overhead(enabled, seconds, reps > 0 ? reps : 3, cpu,
+                           nr_counts > 0 ? counts[0] : 0, threads, label);
+    } else if (strcmp(mode, "model") == 0) {
+        if (nr_counts < 0) nr_counts = parse_counts(DEFAULT_MODEL_COUNTS, counts);
+        ret = run_model(counts, nr_counts, reps > 0 ? reps : DEFAULT_MODEL_TICKS, label);
+    } else {
+        usage(argv[0]);
+        ret = 1;
+    }
+
+    if (ret == 0) fputc('\n', jout);
+    if (outfile) fclose(jout);
+    population_destroy();
+    return ret;
+}
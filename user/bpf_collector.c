@@ -0,0 +1,915 @@
+/*
+ * SmartScheduler eBPF Collector
+ *
+ * Runs the spike prediction model on the eBPF tracing maps instead of
+ * the kernel module, for hosts where out-of-tree modules can't load:
+ * - Loads and attaches cpu_trace, mem_trace and io_trace .bpf.o
+ * - Reads cpu_stats_map, mem_stats_map and io_stats_map in batches
+ * - Turns counter deltas into per-tick samples
+ * - Applies the kernel's EMA / rate-of-change / threshold model, to
+ *   all PIDs of a tick at once with the SIMD step (model_simd.h)
+ * - With -p, uses the per-CPU map builds and sums the CPU copies
+ * - With -P / -g, limits syscall I/O tracing to a PID list or cgroup
+ *   and -H prints the in-kernel size/latency histograms on exit
+ * - With -O, loads only some of the programs (resources without one
+ *   sample 0), e.g. to measure each program's overhead on its own
+ *
+ * Sample units (per tick):
+ *   CPU - runtime share, 10000 = one full CPU (same as the module)
+ *   MEM - smartsched_mem_sample(): weighted RSS from mem_trace's
+ *         rss_map (seeded from /proc/<pid>/statm) plus major faults/s
+ *   I/O - KB read + written by syscalls
+ *
+ * Map keys follow the BPF programs: cpu_trace is keyed by thread id,
+ * mem_trace and io_trace by process id, so threads other than the
+ * main one only carry CPU data.
+ *
+ * Compile: gcc -o bpf_collector bpf_collector.c -Wall -O2 -lbpf
+ * Run: sudo ./bpf_collector [-d OBJ_DIR] [-i MS] [-t SECONDS] [-p]
+ *                           [-P PID,...] [-g CGROUP_DIR] [-O cpu,mem,io]
+ *                           [-H] [-q]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "smartsched_model.h"
+#include "model_simd.h"
+
+#define DEFAULT_OBJ_DIR   "../ebpf/.output"
+#define DEFAULT_INTERVAL_MS 100
+#define MAX_ENTRIES 10240     /* MAX_ENTRIES in the .bpf.c programs */
+#define BATCH_SIZE  1024
+
+#define FLAG_CPU_SPIKE_PREDICTED  SMARTSCHED_FLAG_CPU_SPIKE
+#define FLAG_MEM_SPIKE_PREDICTED  SMARTSCHED_FLAG_MEM_SPIKE
+#define FLAG_IO_SPIKE_PREDICTED   SMARTSCHED_FLAG_IO_SPIKE
+
+/* Model table: open addressing, twice the map capacity */
+#define TABLE_BITS 15
+#define TABLE_SIZE (1U << TABLE_BITS)
+#define TABLE_MASK (TABLE_SIZE - 1)
+#define SLOT_EMPTY 0
+#define SLOT_DEAD  (-1)
+
+#define COLOR_RESET   "\033[0m"
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_YELLOW  "\033[33m"
+#define COLOR_MAGENTA "\033[35m"
+#define COLOR_CYAN    "\033[36m"
+#define COLOR_BOLD    "\033[1m"
+
+/* Map value layouts; must match the .bpf.c programs */
+struct cpu_stats {
+    uint64_t total_runtime_ns;
+    uint64_t switch_count;
+    uint64_t wakeup_count;
+    uint64_t last_switch_time;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+};
+
+struct mem_stats {
+    uint64_t minor_faults;
+    uint64_t major_faults;
+    uint64_t alloc_count;
+    uint64_t alloc_bytes;
+    uint64_t last_fault_time;
+    uint64_t fault_rate;
+};
+
+/* rss_map value, bytes per mm counter; valid has a bit per counter seen */
+#define RSS_FILE   0
+#define RSS_ANON   1
+#define RSS_SWAP   2
+#define RSS_SHMEM  3
+#define RSS_MEMBERS 4
+#define RSS_USED   ((1u << RSS_FILE) | (1u << RSS_ANON) | (1u << RSS_SHMEM))
+
+struct rss_stats {
+    uint64_t bytes[RSS_MEMBERS];
+    uint64_t valid;
+};
+
+struct io_stats {
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t read_count;
+    uint64_t write_count;
+    uint64_t io_wait_ns;
+    uint64_t syscall_ns;
+    uint64_t last_io_time;
+};
+
+#define IO_FILTER_ALL     0
+#define IO_FILTER_PID     1
+#define IO_FILTER_CGROUP  2
+
+struct io_filter_cfg {
+    uint32_t mode;
+    uint32_t reserved;
+    uint64_t cgroup_id;
+};
+
+#define IO_HIST_SLOTS   32
+#define IO_HIST_ENTRIES 4096
+
+struct io_hist {
+    uint64_t size[IO_HIST_SLOTS];
+    uint64_t latency[IO_HIST_SLOTS];
+};
+
+/* Per-PID model state */
+typedef struct {
+    int pid;                  /* SLOT_EMPTY / SLOT_DEAD when unused */
+    unsigned int seen;        /* Tick in which a map still had the PID */
+
+    /* Counters from the current and previous tick */
+    uint64_t runtime, runtime_prev;
+    uint64_t majflt, majflt_prev;
+    uint64_t io_bytes, io_bytes_prev;
+
+    /* Resident memory in KB; rss_bpf marks counters rss_map reported */
+    uint64_t rss_kb[RSS_MEMBERS];
+    unsigned int rss_bpf;
+
+    int ema[SMARTSCHED_NR_RES];
+    int roc[SMARTSCHED_NR_RES];
+    struct smartsched_forecast fc[SMARTSCHED_NR_RES];
+    unsigned int flags;
+
+    unsigned long samples;
+    unsigned long cpu_spikes, mem_spikes, io_spikes;
+    char comm[16];
+} ModelEntry;
+
+static ModelEntry table[TABLE_SIZE];
+static unsigned int table_used;   /* Live + dead slots */
+static unsigned int table_live;
+static unsigned int tick;
+
+static volatile int running = 1;
+static int verbose = 1;
+
+static struct {
+    unsigned long ticks;
+    unsigned long cpu_spikes;
+    unsigned long mem_spikes;
+    unsigned long io_spikes;
+    unsigned long forecasts;
+    unsigned long batch_fallbacks;
+} stats;
+
+/* Batch read buffers, shared by all three maps */
+static uint32_t keys[MAX_ENTRIES];
+static union {
+    struct cpu_stats cpu[MAX_ENTRIES];
+    struct mem_stats mem[MAX_ENTRIES];
+    struct rss_stats rss[MAX_ENTRIES];
+    struct io_stats io[MAX_ENTRIES];
+} values;
+
+void signal_handler(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+/* ============================================
+ * MODEL (shared with the kernel module)
+ * ============================================ */
+
+static const struct smartsched_model_params model_params = SMARTSCHED_MODEL_DEFAULTS;
+
+/* Clamp a 64-bit sample into the range the model's int EMA can weigh */
+static inline int clamp_sample(uint64_t v) {
+    return v > SMARTSCHED_SAMPLE_MAX ? SMARTSCHED_SAMPLE_MAX : (int)v;
+}
+
+/* ============================================
+ * MODEL TABLE
+ * ============================================ */
+
+static inline unsigned int hash_pid(int pid) {
+    return ((uint32_t)pid * 0x9E3779B1u) >> (32 - TABLE_BITS);
+}
+
+/* Drop tombstones once they make probe chains long */
+static void compact_table(void) {
+    static ModelEntry old[TABLE_SIZE];
+
+    memcpy(old, table, sizeof(table));
+    memset(table, 0, sizeof(table));
+    table_used = table_live = 0;
+
+    for (unsigned int i = 0; i < TABLE_SIZE; i++) {
+        if (old[i].pid <= 0) continue;
+        unsigned int h = hash_pid(old[i].pid);
+        while (table[h].pid != SLOT_EMPTY)
+            h = (h + 1) & TABLE_MASK;
+        table[h] = old[i];
+        table_used++;
+        table_live++;
+    }
+}
+
+/* Find a PID's entry, creating it if needed; NULL when full */
+static ModelEntry *get_entry(int pid) {
+    unsigned int h = hash_pid(pid);
+    ModelEntry *dead = NULL;
+
+    for (unsigned int n = 0; n < TABLE_SIZE; n++, h = (h + 1) & TABLE_MASK) {
+        ModelEntry *e = &table[h];
+
+        if (e->pid == pid) return e;
+        if (e->pid == SLOT_DEAD && !dead) dead = e;
+        if (e->pid == SLOT_EMPTY) {
+            if (!dead) {
+                if (table_used >= TABLE_SIZE / 2 + TABLE_SIZE / 4) return NULL;
+                table_used++;
+                dead = e;
+            }
+            break;
+        }
+    }
+    if (!dead) return NULL;
+
+    memset(dead, 0, sizeof(*dead));
+    dead->pid = pid;
+    table_live++;
+    return dead;
+}
+
+/* ============================================
+ * MAP READING
+ * ============================================ */
+
+/*
+ * Per-CPU maps (-p) return one value per possible CPU. Counters are
+ * summed; timestamp and rate fields, marked in max_mask by u64 index,
+ * take the largest copy. rss_map holds absolute values and is never
+ * per-CPU, so it is read with a single copy.
+ */
+#define CPU_STATS_MAX_MASK (1u << 3)                  /* last_switch_time */
+#define MEM_STATS_MAX_MASK ((1u << 4) | (1u << 5))    /* last_fault_time, fault_rate */
+#define IO_STATS_MAX_MASK  (1u << 6)                  /* last_io_time */
+
+static int nr_cpus = 1;       /* Value copies per key */
+static uint64_t *percpu_buf;  /* Staging for BATCH_SIZE per-CPU values */
+
+static void fold_percpu(uint64_t *dst, const uint64_t *src, size_t value_size,
+                        uint32_t max_mask, int copies) {
+    size_t words = value_size / sizeof(uint64_t);
+
+    for (size_t w = 0; w < words; w++) {
+        uint64_t v = 0;
+        for (int c = 0; c < copies; c++) {
+            uint64_t x = src[c * words + w];
+            if (max_mask & (1u << w)) {
+                if (x > v) v = x;
+            } else {
+                v += x;
+            }
+        }
+        dst[w] = v;
+    }
+}
+
+/*
+ * Read a whole map with bpf_map_lookup_batch()
+ * Falls back to get_next_key iteration on kernels without batch ops.
+ * copies is the number of values per key (nr_cpus or 1).
+ * Returns the number of entries read into keys[] / values.
+ */
+static int read_map(int fd, size_t value_size, uint32_t max_mask, int copies) {
+    char *vals = (char *)&values;
+    size_t stride = value_size * copies;
+    uint32_t batch, count;
+    int n = 0, err;
+    void *in = NULL;
+
+    do {
+        count = BATCH_SIZE;
+        if (n + count > MAX_ENTRIES) count = MAX_ENTRIES - n;
+        if (count == 0) break;
+
+        /* Shared maps land in place; per-CPU ones are staged and folded */
+        void *out = copies > 1 ? (void *)percpu_buf : vals + (size_t)n * value_size;
+        err = bpf_map_lookup_batch(fd, in, &batch, keys + n, out, &count, NULL);
+        if (err && errno != ENOENT) {
+            if (n == 0 && (errno == EINVAL || errno == ENOTSUP || errno == EOPNOTSUPP))
+                goto iterate;
+            return n;
+        }
+        if (copies > 1) {
+            for (uint32_t i = 0; i < count; i++)
+                fold_percpu((uint64_t *)(vals + (size_t)(n + i) * value_size),
+                            (uint64_t *)((char *)percpu_buf + i * stride),
+                            value_size, max_mask, copies);
+        }
+        n += count;
+        in = &batch;
+    } while (!err);
+
+    return n;
+
+iterate:
+    /* Slow path: one syscall pair per key */
+    stats.batch_fallbacks++;
+    {
+        uint32_t key, next;
+        void *prev = NULL;
+
+        while (n < MAX_ENTRIES && bpf_map_get_next_key(fd, prev, &next) == 0) {
+            void *dst = vals + (size_t)n * value_size;
+            void *out = copies > 1 ? (void *)percpu_buf : dst;
+
+            if (bpf_map_lookup_elem(fd, &next, out) == 0) {
+                if (copies > 1)
+                    fold_percpu(dst, percpu_buf, value_size, max_mask, copies);
+                keys[n++] = next;
+            }
+            key = next;
+            prev = &key;
+        }
+    }
+    return n;
+}
+
+/* Pull every map into the model table for this tick */
+static void collect(int cpu_fd, int mem_fd, int rss_fd, int io_fd) {
+    int n;
+
+    n = cpu_fd >= 0 ? read_map(cpu_fd, sizeof(struct cpu_stats), CPU_STATS_MAX_MASK, nr_cpus) : 0;
+    for (int i = 0; i < n; i++) {
+        ModelEntry *e = get_entry((int)keys[i]);
+        if (!e) break;
+        e->runtime = values.cpu[i].total_runtime_ns;
+        e->seen = tick;
+    }
+
+    n = mem_fd >= 0 ? read_map(mem_fd, sizeof(struct mem_stats), MEM_STATS_MAX_MASK, nr_cpus) : 0;
+    for (int i = 0; i < n; i++) {
+        ModelEntry *e = get_entry((int)keys[i]);
+        if (!e) break;
+        e->majflt = values.mem[i].major_faults;
+        e->seen = tick;
+    }
+
+    n = rss_fd >= 0 ? read_map(rss_fd, sizeof(struct rss_stats), 0, 1) : 0;
+    for (int i = 0; i < n; i++) {
+        ModelEntry *e = get_entry((int)keys[i]);
+        if (!e) break;
+        for (int m = 0; m < RSS_MEMBERS; m++) {
+            if (values.rss[i].valid & (1u << m))
+                e->rss_kb[m] = values.rss[i].bytes[m] >> 10;
+        }
+        e->rss_bpf |= (unsigned int)values.rss[i].valid & RSS_USED;
+        e->seen = tick;
+    }
+
+    n = io_fd >= 0 ? read_map(io_fd, sizeof(struct io_stats), IO_STATS_MAX_MASK, nr_cpus) : 0;
+    for (int i = 0; i < n; i++) {
+        ModelEntry *e = get_entry((int)keys[i]);
+        if (!e) break;
+        e->io_bytes = values.io[i].read_bytes + values.io[i].write_bytes;
+        e->seen = tick;
+    }
+}
+
+/* ============================================
+ * PREDICTION
+ * ============================================ */
+
+static void load_comm(ModelEntry *e) {
+    char path[64];
+
+    if (e->comm[0]) return;
+    snprintf(path, sizeof(path), "/proc/%d/comm", e->pid);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(e->comm, sizeof(e->comm), "?");
+        return;
+    }
+    if (fgets(e->comm, sizeof(e->comm), f))
+        e->comm[strcspn(e->comm, "\n")] = '\0';
+    fclose(f);
+}
+
+static void report_spike(ModelEntry *e, const char *res, const char *color,
+                         int roc, int ema) {
+    if (!verbose) return;
+    load_comm(e);
+    printf("%s[%s]%s SPIKE PID %d (%s): ROC=%+d EMA=%d\n",
+           color, res, COLOR_RESET, e->pid, e->comm, roc, ema);
+}
+
+static void report_forecast(ModelEntry *e, int res, unsigned int eta, uint64_t tick_ns) {
+    static const char *names[SMARTSCHED_NR_RES] = { "CPU", "MEM", "I/O" };
+
+    if (!verbose) return;
+    load_comm(e);
+    printf("%s[%s]%s FORECAST PID %d (%s): spike in ~%llu ms, trend %+d/tick\n",
+           COLOR_CYAN, names[res], COLOR_RESET, e->pid, e->comm,
+           (unsigned long long)(eta * tick_ns / 1000000), e->fc[res].trend);
+}
+
+/*
+ * rss_stat only fires when a counter moves, so counters that have not
+ * changed since attach come from statm: anon ~ resident - shared and
+ * file ~ shared (statm folds shmem into shared).
+ */
+static void seed_rss(ModelEntry *e) {
+    unsigned long size, resident, shared;
+    uint64_t page_kb = (uint64_t)sysconf(_SC_PAGESIZE) >> 10;
+    char path[64];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/statm", e->pid);
+    f = fopen(path, "r");
+    if (!f) return;
+    if (fscanf(f, "%lu %lu %lu", &size, &resident, &shared) == 3) {
+        if (!(e->rss_bpf & (1u << RSS_ANON)))
+            e->rss_kb[RSS_ANON] = (resident > shared ? resident - shared : 0) * page_kb;
+        if (!(e->rss_bpf & (1u << RSS_FILE)))
+            e->rss_kb[RSS_FILE] = shared * page_kb;
+    }
+    fclose(f);
+}
+
+/* One entry's samples for this tick; the first tick only seeds the counters */
+static void sample_entry(ModelEntry *e, uint64_t elapsed_ns, int sample[SMARTSCHED_NR_RES]) {
+    sample[SMARTSCHED_RES_CPU] = 0;
+    sample[SMARTSCHED_RES_MEM] = 0;
+    sample[SMARTSCHED_RES_IO] = 0;
+
+    if (e->samples == 0 && (e->rss_bpf & RSS_USED) != RSS_USED)
+        seed_rss(e);
+
+    if (e->samples > 0) {
+        uint64_t majflt_rate = 0;
+
+        if (e->runtime > e->runtime_prev)
+            sample[SMARTSCHED_RES_CPU] =
+                clamp_sample((e->runtime - e->runtime_prev) * 10000 / elapsed_ns);
+        if (e->majflt > e->majflt_prev)
+            majflt_rate = (e->majflt - e->majflt_prev) * 1000000000ULL / elapsed_ns;
+        sample[SMARTSCHED_RES_MEM] =
+            smartsched_mem_sample(e->rss_kb[RSS_ANON], e->rss_kb[RSS_FILE],
+                                  e->rss_kb[RSS_SHMEM], majflt_rate);
+        if (e->io_bytes > e->io_bytes_prev)
+            sample[SMARTSCHED_RES_IO] = clamp_sample((e->io_bytes - e->io_bytes_prev) / 1024);
+    }
+    e->runtime_prev = e->runtime;
+    e->majflt_prev = e->majflt;
+    e->io_bytes_prev = e->io_bytes;
+}
+
+/*
+ * Finish one entry's tick after the batched EMA / RoC step, with
+ * model_flags the spike bits it predicted: forecasts and reports
+ */
+static void finish_entry(ModelEntry *e, const int sample[SMARTSCHED_NR_RES],
+                         unsigned int model_flags, uint64_t elapsed_ns) {
+    unsigned int old_flags = e->flags;
+
+    e->flags = model_flags;
+
+    /* Trend forecasts, reported on their rising edge */
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        unsigned int eta;
+        unsigned int bit = smartsched_forecast_step(&model_params, k, &e->fc[k],
+                                                    sample[k], &eta);
+
+        e->flags |= bit;
+        if (bit & ~old_flags) {
+            stats.forecasts++;
+            report_forecast(e, k, eta, elapsed_ns);
+        }
+    }
+
+    if (e->flags & FLAG_CPU_SPIKE_PREDICTED) {
+        e->cpu_spikes++;
+        stats.cpu_spikes++;
+        report_spike(e, "CPU", COLOR_RED, e->roc[SMARTSCHED_RES_CPU],
+                     e->ema[SMARTSCHED_RES_CPU]);
+    }
+    if (e->flags & FLAG_MEM_SPIKE_PREDICTED) {
+        e->mem_spikes++;
+        stats.mem_spikes++;
+        report_spike(e, "MEM", COLOR_YELLOW, e->roc[SMARTSCHED_RES_MEM],
+                     e->ema[SMARTSCHED_RES_MEM]);
+    }
+    if (e->flags & FLAG_IO_SPIKE_PREDICTED) {
+        e->io_spikes++;
+        stats.io_spikes++;
+        report_spike(e, "I/O", COLOR_MAGENTA, e->roc[SMARTSCHED_RES_IO],
+                     e->ema[SMARTSCHED_RES_IO]);
+    }
+
+    e->samples++;
+}
+
+/* A tick's live entries gathered for the batched model step */
+static struct {
+    ModelEntry *entry[TABLE_SIZE];
+    int ema[SMARTSCHED_NR_RES][TABLE_SIZE];
+    int prev[SMARTSCHED_NR_RES][TABLE_SIZE];
+    int roc[SMARTSCHED_NR_RES][TABLE_SIZE];
+    int sample[SMARTSCHED_NR_RES][TABLE_SIZE];
+    __u32 flags[TABLE_SIZE];
+} batch;
+
+/*
+ * Run the model for every PID seen this tick, forget the rest
+ * Samples are gathered first so the EMA / RoC step runs column-wise
+ * over all entries, then each entry is finished on its own.
+ */
+static void predict(uint64_t elapsed_ns) {
+    unsigned int n = 0;
+
+    for (unsigned int i = 0; i < TABLE_SIZE; i++) {
+        ModelEntry *e = &table[i];
+        int sample[SMARTSCHED_NR_RES];
+
+        if (e->pid <= 0) continue;
+        if (e->seen != tick) {
+            /* Gone from every map: the process exited */
+            e->pid = SLOT_DEAD;
+            table_live--;
+            continue;
+        }
+        sample_entry(e, elapsed_ns, sample);
+        for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+            /* The EMAs start at the first real samples (smartsched_model.h) */
+            batch.ema[k][n] = e->samples == 1 ? sample[k] : e->ema[k];
+            batch.sample[k][n] = sample[k];
+        }
+        batch.flags[n] = 0;
+        batch.entry[n++] = e;
+    }
+
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++)
+        smartsched_model_step_simd(&model_params, k, batch.ema[k], batch.prev[k],
+                                   batch.roc[k], batch.sample[k], batch.flags, n);
+
+    for (unsigned int j = 0; j < n; j++) {
+        ModelEntry *e = batch.entry[j];
+        int sample[SMARTSCHED_NR_RES];
+
+        for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+            e->ema[k] = batch.ema[k][j];
+            e->roc[k] = batch.roc[k][j];
+            sample[k] = batch.sample[k][j];
+        }
+        finish_entry(e, sample, batch.flags[j], elapsed_ns);
+    }
+
+    if (table_used - table_live > TABLE_SIZE / 4)
+        compact_table();
+}
+
+/* ============================================
+ * BPF OBJECTS
+ * ============================================ */
+
+#define NR_OBJS 3
+static const char *obj_names[NR_OBJS] = { "cpu_trace", "mem_trace", "io_trace" };
+static const char *obj_short[NR_OBJS] = { "cpu", "mem", "io" };
+static struct bpf_object *objs[NR_OBJS];
+static int obj_enabled[NR_OBJS] = { 1, 1, 1 };
+
+/* Parse -O: a comma-separated subset of cpu,mem,io */
+static int select_objects(const char *list) {
+    char buf[64];
+
+    memset(obj_enabled, 0, sizeof(obj_enabled));
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        int i;
+        for (i = 0; i < NR_OBJS; i++) {
+            if (strcmp(tok, obj_short[i]) == 0 || strcmp(tok, obj_names[i]) == 0) {
+                obj_enabled[i] = 1;
+                break;
+            }
+        }
+        if (i == NR_OBJS) {
+            fprintf(stderr, "%sError: unknown program '%s' (cpu, mem, io)%s\n",
+                    COLOR_RED, tok, COLOR_RESET);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Map fd in an object, -1 if the object is not loaded or lacks it */
+static int map_fd(int obj, const char *name) {
+    return objs[obj] ? bpf_object__find_map_fd_by_name(objs[obj], name) : -1;
+}
+
+/* Open and load obj_dir/<name>[_percpu].bpf.o */
+static int load_objects(const char *obj_dir, int percpu) {
+    char path[512];
+
+    for (int i = 0; i < NR_OBJS; i++) {
+        if (!obj_enabled[i]) continue;
+        snprintf(path, sizeof(path), "%s/%s%s.bpf.o", obj_dir, obj_names[i],
+                 percpu ? "_percpu" : "");
+        objs[i] = bpf_object__open_file(path, NULL);
+        if (!objs[i]) {
+            fprintf(stderr, "%sError: Cannot open %s: %s%s\n",
+                    COLOR_RED, path, strerror(errno), COLOR_RESET);
+            return -1;
+        }
+        if (bpf_object__load(objs[i])) {
+            fprintf(stderr, "%sError: Cannot load %s: %s%s\n",
+                    COLOR_RED, path, strerror(errno), COLOR_RESET);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Attach every program; maps must be configured first */
+static void attach_objects(void) {
+    for (int i = 0; i < NR_OBJS; i++) {
+        struct bpf_program *prog;
+
+        if (!objs[i]) continue;
+        bpf_object__for_each_program(prog, objs[i]) {
+            /* Links are released with the object on exit */
+            if (!bpf_program__attach(prog)) {
+                fprintf(stderr, "%sWarning: %s: cannot attach %s%s\n",
+                        COLOR_YELLOW, obj_names[i], bpf_program__name(prog), COLOR_RESET);
+            }
+        }
+    }
+}
+
+/*
+ * Restrict io_trace's syscall hooks to a PID list or a cgroup
+ * pids is a comma-separated list; cgroup a cgroup v2 directory, whose
+ * inode number is the id bpf_get_current_cgroup_id() reports.
+ */
+static int configure_io_filter(const char *pids, const char *cgroup) {
+    struct io_filter_cfg cfg = { .mode = IO_FILTER_ALL };
+    uint32_t zero = 0;
+    int cfg_fd = map_fd(2, "io_filter_map");
+
+    if (!pids && !cgroup) return 0;
+    if (cfg_fd < 0) {
+        fprintf(stderr, "%sError: io_trace not loaded or has no filter map (rebuild ebpf/)%s\n",
+                COLOR_RED, COLOR_RESET);
+        return -1;
+    }
+
+    if (cgroup) {
+        struct stat st;
+        if (stat(cgroup, &st) < 0 || !S_ISDIR(st.st_mode)) {
+            fprintf(stderr, "%sError: %s is not a cgroup directory%s\n",
+                    COLOR_RED, cgroup, COLOR_RESET);
+            return -1;
+        }
+        cfg.mode = IO_FILTER_CGROUP;
+        cfg.cgroup_id = st.st_ino;
+    } else {
+        int list_fd = map_fd(2, "pid_allowlist");
+        char buf[1024];
+        uint8_t one = 1;
+
+        snprintf(buf, sizeof(buf), "%s", pids);
+        for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+            uint32_t pid = (uint32_t)atoi(tok);
+            if (pid == 0 || bpf_map_update_elem(list_fd, &pid, &one, BPF_ANY) < 0) {
+                fprintf(stderr, "%sError: cannot allow PID '%s'%s\n",
+                        COLOR_RED, tok, COLOR_RESET);
+                return -1;
+            }
+        }
+        cfg.mode = IO_FILTER_PID;
+    }
+
+    return bpf_map_update_elem(cfg_fd, &zero, &cfg, BPF_ANY);
+}
+
+/* Lower bound of the log2 bucket holding the given percentile */
+static uint64_t hist_percentile(const uint64_t *slots, uint64_t total, int pct) {
+    uint64_t want = (total * pct + 99) / 100, seen = 0;
+
+    for (int i = 0; i < IO_HIST_SLOTS; i++) {
+        seen += slots[i];
+        if (seen >= want && slots[i]) return i ? 1ULL << i : 0;
+    }
+    return 0;
+}
+
+typedef struct {
+    uint32_t pid;
+    uint64_t ops;
+    struct io_hist hist;
+} HistDump;
+
+static int compare_hist_ops(const void *a, const void *b) {
+    uint64_t x = ((const HistDump *)a)->ops, y = ((const HistDump *)b)->ops;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Print size/latency percentiles for the busiest PIDs */
+static void print_io_histograms(int top_n) {
+    int fd = map_fd(2, "io_hist_map");
+    HistDump *dump = calloc(IO_HIST_ENTRIES, sizeof(*dump));
+    uint32_t key, next;
+    void *prev = NULL;
+    int n = 0;
+
+    if (fd < 0 || !dump) goto out;
+
+    /* Exit-time only, so plain iteration is fine; shared in both builds */
+    while (n < IO_HIST_ENTRIES && bpf_map_get_next_key(fd, prev, &next) == 0) {
+        if (bpf_map_lookup_elem(fd, &next, &dump[n].hist) == 0) {
+            dump[n].pid = next;
+            for (int i = 0; i < IO_HIST_SLOTS; i++)
+                dump[n].ops += dump[n].hist.size[i];
+            n++;
+        }
+        key = next;
+        prev = &key;
+    }
+
+    qsort(dump, n, sizeof(*dump), compare_hist_ops);
+
+    printf("\n%s%s=== Syscall I/O Histograms (top %d) ===%s\n",
+           COLOR_BOLD, COLOR_CYAN, top_n, COLOR_RESET);
+    printf("%s%7s %10s %10s %10s %12s %12s%s\n", COLOR_BOLD,
+           "PID", "OPS", "SIZE_P50", "SIZE_P99", "LAT_P50_NS", "LAT_P99_NS", COLOR_RESET);
+    for (int i = 0; i < n && i < top_n; i++) {
+        const struct io_hist *h = &dump[i].hist;
+        printf("%7u %10llu %10llu %10llu %12llu %12llu\n", dump[i].pid,
+               (unsigned long long)dump[i].ops,
+               (unsigned long long)hist_percentile(h->size, dump[i].ops, 50),
+               (unsigned long long)hist_percentile(h->size, dump[i].ops, 99),
+               (unsigned long long)hist_percentile(h->latency, dump[i].ops, 50),
+               (unsigned long long)hist_percentile(h->latency, dump[i].ops, 99));
+    }
+    if (n == 0)
+        printf("  (no syscall I/O recorded)\n");
+
+out:
+    free(dump);
+}
+
+static void unload_objects(void) {
+    for (int i = 0; i < NR_OBJS; i++) {
+        bpf_object__close(objs[i]);
+        objs[i] = NULL;
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_summary(double secs) {
+    printf("\n%s%s=== eBPF Collector Summary ===%s\n", COLOR_BOLD, COLOR_CYAN, COLOR_RESET);
+    printf("  Runtime:           %.1f seconds (%lu ticks)\n", secs, stats.ticks);
+    printf("  Tracked PIDs:      %u\n", table_live);
+    printf("  CPU spikes:        %lu\n", stats.cpu_spikes);
+    printf("  Memory spikes:     %lu\n", stats.mem_spikes);
+    printf("  I/O spikes:        %lu\n", stats.io_spikes);
+    printf("  Forecasts:         %lu\n", stats.forecasts);
+    if (stats.batch_fallbacks)
+        printf("  Non-batch reads:   %lu (kernel lacks map batch ops)\n",
+               stats.batch_fallbacks);
+}
+
+void usage(const char *prog) {
+    printf("SmartScheduler eBPF Collector\n\n");
+    printf("Usage: sudo %s [options]\n\n", prog);
+    printf("Options:\n");
+    printf("  -d <dir>  Directory with the .bpf.o objects (default: %s)\n", DEFAULT_OBJ_DIR);
+    printf("  -i <ms>   Sampling interval in ms (default: %d)\n", DEFAULT_INTERVAL_MS);
+    printf("  -t <sec>  Stop after this many seconds (default: run until Ctrl+C)\n");
+    printf("  -p        Use the per-CPU map builds (*_percpu.bpf.o)\n");
+    printf("  -P <list> Trace syscall I/O only for these PIDs (comma-separated)\n");
+    printf("  -g <dir>  Trace syscall I/O only inside this cgroup v2 directory\n");
+    printf("  -O <list> Load only these programs (comma-separated: cpu, mem, io)\n");
+    printf("  -H        Print per-PID I/O size/latency histograms on exit\n");
+    printf("  -q        Quiet: print only the summary\n");
+    printf("  -h        Show this help\n");
+    printf("\nBuild the objects first with: make -C ebpf\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *obj_dir = DEFAULT_OBJ_DIR;
+    int interval_ms = DEFAULT_INTERVAL_MS;
+    int duration = 0;
+    int percpu = 0;
+    int show_hist = 0;
+    const char *filter_pids = NULL, *filter_cgroup = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:i:t:pP:g:O:Hqh")) != -1) {
+        switch (opt) {
+            case 'd': obj_dir = optarg; break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                if (interval_ms < 10) interval_ms = 10;
+                break;
+            case 't': duration = atoi(optarg); break;
+            case 'p': percpu = 1; break;
+            case 'P': filter_pids = optarg; break;
+            case 'g': filter_cgroup = optarg; break;
+            case 'O':
+                if (select_objects(optarg) < 0) return 1;
+                break;
+            case 'H': show_hist = 1; break;
+            case 'q': verbose = 0; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+
+    if (geteuid() != 0) {
+        fprintf(stderr, "%sError: Must run as root to load eBPF programs%s\n",
+                COLOR_RED, COLOR_RESET);
+        return 1;
+    }
+
+    if (percpu) {
+        nr_cpus = libbpf_num_possible_cpus();
+        if (nr_cpus < 1) {
+            fprintf(stderr, "%sError: Cannot count possible CPUs%s\n", COLOR_RED, COLOR_RESET);
+            return 1;
+        }
+        /* Largest value is struct io_stats */
+        percpu_buf = calloc((size_t)BATCH_SIZE * nr_cpus, sizeof(struct io_stats));
+        if (!percpu_buf) {
+            fprintf(stderr, "%sError: Out of memory%s\n", COLOR_RED, COLOR_RESET);
+            return 1;
+        }
+    }
+
+    if (load_objects(obj_dir, percpu) < 0 ||
+        configure_io_filter(filter_pids, filter_cgroup) < 0) {
+        unload_objects();
+        return 1;
+    }
+    attach_objects();
+
+    int cpu_fd = map_fd(0, "cpu_stats_map");
+    int mem_fd = map_fd(1, "mem_stats_map");
+    int io_fd = map_fd(2, "io_stats_map");
+    if ((obj_enabled[0] && cpu_fd < 0) || (obj_enabled[1] && mem_fd < 0) ||
+        (obj_enabled[2] && io_fd < 0)) {
+        fprintf(stderr, "%sError: stats maps missing from objects%s\n",
+                COLOR_RED, COLOR_RESET);
+        unload_objects();
+        return 1;
+    }
+    /* Older mem_trace objects have no rss_map; RSS then stays at the statm seed */
+    int rss_fd = map_fd(1, "rss_map");
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    printf("%sSmartScheduler eBPF collector running (%d ms ticks, %s maps)%s\n",
+           COLOR_GREEN, interval_ms, percpu ? "per-CPU" : "shared", COLOR_RESET);
+    printf("Press Ctrl+C to stop\n\n");
+
+    uint64_t start = now_ns();
+    uint64_t last = start;
+
+    while (running) {
+        usleep(interval_ms * 1000);
+
+        uint64_t now = now_ns();
+        tick++;
+        collect(cpu_fd, mem_fd, rss_fd, io_fd);
+        predict(now > last ? now - last : 1);
+        last = now;
+        stats.ticks++;
+
+        if (duration > 0 && now - start >= (uint64_t)duration * 1000000000ULL)
+            break;
+    }
+
+    print_summary((now_ns() - start) / 1e9);
+    if (show_hist)
+        print_io_histograms(10);
+    unload_objects();
+    free(percpu_buf);
+    return 0;
+}
@@ -0,0 +1,347 @@
+/*
+ * SmartScheduler Checkpoint Tool
+ *
+ * Saves the module's signature state from the binary snapshot and
+ * seeds it back after the module is reloaded, so a rollout does not
+ * start every process from cold EMAs (and the daemon does not act on
+ * the warm-up). A checkpoint holds one struct smartsched_seed per
+ * signature; restore writes them to /dev/smartsched, where the module
+ * matches them by PID and start time against the signatures of its
+ * first ticks (see smartsched_abi.h).
+ *
+ * Start times count from boot, so a checkpoint is only restored on the
+ * boot it was saved in, and only while it is younger than -m seconds.
+ * Signatures with fewer than two samples have no CPU EMA yet and are
+ * left out.
+ *
+ * Compile: gcc -o checkpoint checkpoint.c -Wall -O2 -I../kernel
+ * Run: ./checkpoint save|restore|show [-f FILE] [-m MAX_AGE]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+#define DEFAULT_FILE     "/run/smartscheduler/signatures.ckpt"
+#define DEFAULT_MAX_AGE  600           /* Seconds */
+#define BOOT_ID_PATH     "/proc/sys/kernel/random/boot_id"
+
+#define CKPT_MAGIC       0x4b435353    /* "SSCK" */
+#define CKPT_VERSION     1
+#define MIN_SAMPLES      2
+
+struct ckpt_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;              /* sizeof(struct smartsched_seed) */
+    uint32_t nr_seeds;
+    uint32_t abi_version;              /* SMARTSCHED_ABI_VERSION of the module saved */
+    uint64_t saved_ns;                 /* CLOCK_REALTIME at save */
+    char boot_id[40];
+};
+
+static const char *path = DEFAULT_FILE;
+static int max_age = DEFAULT_MAX_AGE;
+
+static int read_boot_id(char *id, size_t size) {
+    FILE *f = fopen(BOOT_ID_PATH, "r");
+
+    memset(id, 0, size);
+    if (!f)
+        return -1;
+    if (!fgets(id, (int)size, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    id[strcspn(id, "\n")] = '\0';
+    return 0;
+}
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Create the checkpoint's directory if it is missing */
+static void make_parent(const char *file) {
+    char dir[4096];
+    char *slash;
+
+    snprintf(dir, sizeof(dir), "%s", file);
+    slash = strrchr(dir, '/');
+    if (!slash || slash == dir)
+        return;
+    *slash = '\0';
+    mkdir(dir, 0755);
+}
+
+/* ==== SAVE ==== */
+
+/* Copy every signature worth seeding out of the snapshot; returns the count or -1 */
+static int collect_seeds(const ss_snapshot_t *ss, struct smartsched_seed *out,
+                         unsigned int max) {
+    for (int tries = 0; tries < SS_SNAPSHOT_RETRIES; tries++) {
+        unsigned int seq = ss_snapshot_read_begin(ss);
+        unsigned int rows = ss->hdr->nr_records;
+        uint64_t saved = ss->hdr->timestamp_ns;
+        uint32_t interval = ss->hdr->sample_interval_ms;
+        unsigned int n = 0;
+
+        if (rows > ss->hdr->capacity)
+            rows = ss->hdr->capacity;
+        for (unsigned int i = 0; i < rows && n < max; i++) {
+            __u32 flags = SS_COL(ss, FLAGS, __u32)[i];
+            struct smartsched_seed *s = &out[n];
+
+            if (!(flags & SMARTSCHED_FLAG_ACTIVE) ||
+                SS_COL(ss, TOTAL_SAMPLES, __u64)[i] < MIN_SAMPLES)
+                continue;
+
+            memset(s, 0, sizeof(*s));
+            s->pid = SS_COL(ss, PID, __s32)[i];
+            s->flags = flags & SMARTSCHED_FLAG_THREAD;
+            s->start_time_ns = SS_COL(ss, START_TIME, __u64)[i];
+            s->saved_ns = saved;
+            s->interval_ms = interval;
+            s->total_samples = SS_COL(ss, TOTAL_SAMPLES, __u64)[i];
+            for (int r = SMARTSCHED_RES_CPU; r <= SMARTSCHED_RES_IO; r++) {
+                s->ema[r] = ((const __s32 *)ss->col[SMARTSCHED_COL_EMA(r)])[i];
+                s->spikes[r] = ((const __u64 *)ss->col[SMARTSCHED_COL_SPIKES(r)])[i];
+                s->spike_history[r] = ((const __u64 *)ss->col[SMARTSCHED_COL_HISTORY(r)])[i];
+            }
+            n++;
+        }
+        if (!ss_snapshot_read_retry(ss, seq))
+            return (int)n;
+    }
+    return -1;
+}
+
+static int cmd_save(void) {
+    struct ckpt_header h = { .magic = CKPT_MAGIC, .version = CKPT_VERSION,
+                             .record_size = sizeof(struct smartsched_seed),
+                             .abi_version = SMARTSCHED_ABI_VERSION };
+    struct smartsched_seed *seeds;
+    ss_snapshot_t ss;
+    char tmp[4096];
+    int n, ret;
+
+    ret = ss_snapshot_open(&ss);
+    if (ret < 0) {
+        fprintf(stderr, "Error: Cannot map %s: %s\n", SMARTSCHED_DEV_PATH,
+                ret == -EPROTO ? "ABI version mismatch" : strerror(-ret));
+        return 1;
+    }
+
+    seeds = calloc(ss.hdr->capacity ? ss.hdr->capacity : 1, sizeof(*seeds));
+    if (!seeds) {
+        fprintf(stderr, "Error: out of memory\n");
+        ss_snapshot_close(&ss);
+        return 1;
+    }
+    n = collect_seeds(&ss, seeds, ss.hdr->capacity);
+    ss_snapshot_close(&ss);
+    if (n < 0) {
+        fprintf(stderr, "Error: snapshot kept changing while it was read\n");
+        free(seeds);
+        return 1;
+    }
+
+    h.nr_seeds = (uint32_t)n;
+    h.saved_ns = realtime_ns();
+    read_boot_id(h.boot_id, sizeof(h.boot_id));
+
+    /* Written aside and renamed, so a crash never leaves half a checkpoint */
+    make_parent(path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot create %s: %s\n", tmp, strerror(errno));
+        free(seeds);
+        return 1;
+    }
+    ret = fwrite(&h, sizeof(h), 1, f) == 1 &&
+          fwrite(seeds, sizeof(*seeds), (size_t)n, f) == (size_t)n;
+    if (fclose(f) != 0 || !ret || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: Cannot write %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        free(seeds);
+        return 1;
+    }
+
+    printf("Saved %d signatures to %s\n", n, path);
+    free(seeds);
+    return 0;
+}
+
+/* ==== RESTORE ==== */
+
+/* Read and check a checkpoint; returns its seeds (malloc'd) or NULL */
+static struct smartsched_seed *load_checkpoint(struct ckpt_header *h, int check) {
+    struct smartsched_seed *seeds;
+    char boot_id[40];
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (fread(h, sizeof(*h), 1, f) != 1 || h->magic != CKPT_MAGIC ||
+        h->version != CKPT_VERSION || h->record_size != sizeof(struct smartsched_seed)) {
+        fprintf(stderr, "Error: %s is not a checkpoint of this version\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    if (check) {
+        uint64_t now = realtime_ns();
+
+        read_boot_id(boot_id, sizeof(boot_id));
+        if (strncmp(boot_id, h->boot_id, sizeof(boot_id)) != 0) {
+            fprintf(stderr, "Error: %s was saved before the last boot\n", path);
+            fclose(f);
+            return NULL;
+        }
+        if (max_age > 0 && now > h->saved_ns &&
+            (now - h->saved_ns) / 1000000000ull > (uint64_t)max_age) {
+            fprintf(stderr, "Error: %s is older than %d s\n", path, max_age);
+            fclose(f);
+            return NULL;
+        }
+    }
+
+    seeds = calloc(h->nr_seeds ? h->nr_seeds : 1, sizeof(*seeds));
+    if (!seeds || fread(seeds, sizeof(*seeds), h->nr_seeds, f) != h->nr_seeds) {
+        fprintf(stderr, "Error: %s is truncated\n", path);
+        free(seeds);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    return seeds;
+}
+
+static int cmd_restore(void) {
+    struct ckpt_header h;
+    struct smartsched_seed *seeds = load_checkpoint(&h, 1);
+    size_t done = 0, total;
+    int fd;
+
+    if (!seeds)
+        return 1;
+
+    fd = open(SMARTSCHED_DEV_PATH, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s for writing: %s\n", SMARTSCHED_DEV_PATH,
+                strerror(errno));
+        free(seeds);
+        return 1;
+    }
+
+    /* The module takes what fits its table and refuses the rest */
+    total = (size_t)h.nr_seeds * sizeof(*seeds);
+    while (done < total) {
+        ssize_t n = write(fd, (const char *)seeds + done, total - done);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != ENOSPC)
+                fprintf(stderr, "Error: Cannot write seeds: %s\n", strerror(errno));
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+
+    printf("Restored %zu of %u signatures from %s\n", done / sizeof(*seeds), h.nr_seeds,
+           path);
+    free(seeds);
+    return done || !total ? 0 : 1;
+}
+
+/* ==== SHOW ==== */
+
+static int cmd_show(void) {
+    struct ckpt_header h;
+    struct smartsched_seed *seeds = load_checkpoint(&h, 0);
+    time_t when;
+
+    if (!seeds)
+        return 1;
+
+    when = (time_t)(h.saved_ns / 1000000000ull);
+    printf("Checkpoint %s: %u signatures, ABI v%u, boot %s, saved %s", path, h.nr_seeds,
+           h.abi_version, h.boot_id, ctime(&when));
+    printf("%8s %-6s %10s %10s %10s %10s %s\n", "PID", "KIND", "CPU_EMA", "MEM_EMA",
+           "IO_EMA", "SAMPLES", "SPIKES");
+    for (uint32_t i = 0; i < h.nr_seeds; i++) {
+        const struct smartsched_seed *s = &seeds[i];
+
+        printf("%8d %-6s %10d %10d %10d %10llu %llu/%llu/%llu\n", s->pid,
+               s->flags & SMARTSCHED_FLAG_THREAD ? "thread" : "proc",
+               s->ema[SMARTSCHED_RES_CPU], s->ema[SMARTSCHED_RES_MEM],
+               s->ema[SMARTSCHED_RES_IO], (unsigned long long)s->total_samples,
+               (unsigned long long)s->spikes[SMARTSCHED_RES_CPU],
+               (unsigned long long)s->spikes[SMARTSCHED_RES_MEM],
+               (unsigned long long)s->spikes[SMARTSCHED_RES_IO]);
+    }
+    free(seeds);
+    return 0;
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s save|restore|show [options]\n", prog);
+    printf("Carry SmartScheduler signature state across a module reload\n\n");
+    printf("Commands:\n");
+    printf("  save        Write the loaded module's signatures to the checkpoint\n");
+    printf("  restore     Seed the (re)loaded module from the checkpoint\n");
+    printf("  show        List a checkpoint's signatures\n\n");
+    printf("Options:\n");
+    printf("  -f FILE     Checkpoint file (default: %s)\n", DEFAULT_FILE);
+    printf("  -m SECONDS  Refuse to restore older checkpoints, 0 = any age (default: %d)\n",
+           DEFAULT_MAX_AGE);
+    printf("  -h          Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *cmd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:m:h")) != -1) {
+        switch (opt) {
+            case 'f': path = optarg; break;
+            case 'm': max_age = atoi(optarg); break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || max_age < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    cmd = argv[optind];
+    if (!strcmp(cmd, "save"))
+        return cmd_save();
+    if (!strcmp(cmd, "restore"))
+        return cmd_restore();
+    if (!strcmp(cmd, "show"))
+        return cmd_show();
+
+    usage(argv[0]);
+    return 1;
+}
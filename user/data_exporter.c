@@ -4,7 +4,12 @@
  * Exports prediction data to CSV format for analysis and graphing
  * Can be used with gnuplot, Python matplotlib, or Excel
  *
- * Compile: gcc -o data_exporter data_exporter.c -Wall
+ * Long recordings use the compact .ssr format instead of CSV (see
+ * ssr_format.h): delta/varint-coded columns per sample, written in
+ * chunks every flush interval and zstd-compressed when built with
+ * HAVE_ZSTD. 'convert' turns a recording back into CSV.
+ *
+ * Compile: gcc -o data_exporter data_exporter.c -Wall [-DHAVE_ZSTD -lzstd]
  */
 
 #include <stdio.h>
@@ -13,12 +18,24 @@
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+#include "snapshot.h"
+#include "ssr_format.h"
+
 #define PROC_STATS "/proc/smartscheduler/stats"
 #define LOG_DIR "../logs"
 #define MAX_LINE 1024
 
+/* .ssr recording parameters */
+#define KEYFRAME_INTERVAL   100          /* Blocks between keyframes */
+#define DEFAULT_FLUSH_MS    1000
+#define CHUNK_MAX_BYTES     (4 << 20)    /* Flush early past this */
+#define ZSTD_LEVEL          3
+
 static volatile int running = 1;
 
 void signal_handler(int sig) {
@@ -44,16 +61,17 @@ int export_snapshot(FILE *out, int sample_num) {
     char line[MAX_LINE];
     int count = 0;
     
-    /* Skip header lines */
-    fgets(line, sizeof(line), f);
-    fgets(line, sizeof(line), f);
-    fgets(line, sizeof(line), f);
+    /* Title, blank line, column names, dashes */
+    for (int i = 0; i < 4; i++) {
+        if (!fgets(line, sizeof(line), f)) break;
+    }
     
     while (fgets(line, sizeof(line), f)) {
         int pid, cpu, mem, io, cpu_roc, mem_roc, io_roc;
         unsigned long samples;
         
-        if (sscanf(line, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%lu",
+        /* stats_show() pads with spaces; %d skips any whitespace */
+        if (sscanf(line, "%d %d %d %d %d %d %d %lu",
                    &pid, &cpu, &mem, &io, &cpu_roc, &mem_roc, &io_roc, &samples) == 8) {
             fprintf(out, "%d,%d,%d,%d,%d,%d,%d,%d,%lu\n",
                     sample_num, pid, cpu, mem, io, cpu_roc, mem_roc, io_roc, samples);
@@ -92,9 +110,9 @@ void continuous_export(int interval_ms, int max_samples) {
             break;
         }
         
+        /* Leave file buffering to stdio; no per-tick flush */
         printf("\rSample %d: %d processes exported", sample, count);
         fflush(stdout);
-        fflush(out);
         
         sample++;
         if (max_samples > 0 && sample >= max_samples) break;
@@ -125,6 +143,413 @@ void single_export(void) {
     printf("Exported %d processes to %s\n", count, filename);
 }
 
+/* ---- Sampling ---- */
+
+static ss_snapshot_t snapshot;             /* Mapped only inside read_rows() */
+static int have_snapshot = 0;               /* Recording from the snapshot */
+static struct smartsched_record *snap_records;
+static unsigned long long snap_gen;         /* Sampler tick of the last read */
+
+/*
+ * Fill rows from the binary snapshot, else from the stats file;
+ * *with_samples says whether the raw sample columns were filled and
+ * *truncated whether processes were left out for lack of rows. max
+ * covers the snapshot's capacity at the start, so only the stats file
+ * or a module reloaded with a larger max_tracked truncates. The
+ * snapshot is mapped per read, so a recording never pins the module.
+ */
+int read_rows(ssr_row_t *rows, int max, int *with_samples, int *truncated) {
+    int n = 0;
+
+    *with_samples = 0;
+    *truncated = 0;
+    if (have_snapshot && ss_snapshot_open(&snapshot) == 0) {
+        int got = ss_snapshot_read(&snapshot, snap_records, max, &snap_gen);
+
+        *truncated = got == max && snapshot.hdr->capacity > (unsigned int)max;
+        ss_snapshot_close(&snapshot);
+        if (got >= 0) {
+            for (int i = 0; i < got; i++) {
+                const struct smartsched_record *r = &snap_records[i];
+                ssr_row_t *row = &rows[n++];
+                row->pid = r->pid;
+                row->v[SSR_COL_CPU_EMA] = r->cpu_ema;
+                row->v[SSR_COL_MEM_EMA] = r->mem_ema;
+                row->v[SSR_COL_IO_EMA] = r->io_ema;
+                row->v[SSR_COL_CPU_ROC] = r->cpu_roc;
+                row->v[SSR_COL_MEM_ROC] = r->mem_roc;
+                row->v[SSR_COL_IO_ROC] = r->io_roc;
+                row->v[SSR_COL_TOTAL_SAMPLES] = (int64_t)r->total_samples;
+                row->v[SSR_COL_CPU_SAMPLE] = r->cpu_sample;
+                row->v[SSR_COL_MEM_SAMPLE] = r->mem_sample;
+                row->v[SSR_COL_IO_SAMPLE] = r->io_sample;
+            }
+            *with_samples = 1;
+            goto sort;
+        }
+    }
+
+    FILE *f = fopen(PROC_STATS, "r");
+    if (!f) return -1;
+
+    char line[MAX_LINE];
+    for (int i = 0; i < 4; i++) {
+        if (!fgets(line, sizeof(line), f)) break;
+    }
+    while (n < max && fgets(line, sizeof(line), f)) {
+        int pid, cpu, mem, io, cpu_roc, mem_roc, io_roc;
+        unsigned long samples;
+
+        if (sscanf(line, "%d %d %d %d %d %d %d %lu",
+                   &pid, &cpu, &mem, &io, &cpu_roc, &mem_roc, &io_roc, &samples) == 8) {
+            ssr_row_t *row = &rows[n++];
+            memset(row, 0, sizeof(*row));
+            row->pid = pid;
+            row->v[SSR_COL_CPU_EMA] = cpu;
+            row->v[SSR_COL_MEM_EMA] = mem;
+            row->v[SSR_COL_IO_EMA] = io;
+            row->v[SSR_COL_CPU_ROC] = cpu_roc;
+            row->v[SSR_COL_MEM_ROC] = mem_roc;
+            row->v[SSR_COL_IO_ROC] = io_roc;
+            row->v[SSR_COL_TOTAL_SAMPLES] = (int64_t)samples;
+        }
+    }
+    *truncated = n == max && fgets(line, sizeof(line), f);
+    fclose(f);
+
+sort:
+    qsort(rows, n, sizeof(ssr_row_t), ssr_compare_rows);
+    return n;
+}
+
+static uint64_t clock_ns(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* ---- Recording ---- */
+
+typedef struct {
+    int fd;
+    uint8_t *buf;               /* Pending blocks of the current chunk */
+    size_t len;
+    size_t cap;
+    uint64_t bytes_written;
+} ChunkWriter;
+
+int write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Write out pending blocks as one chunk */
+int flush_chunk(ChunkWriter *w) {
+    struct ssr_chunk_header ch = {
+        .magic = SSR_CHUNK_MAGIC,
+        .raw_len = (uint32_t)w->len,
+    };
+    const void *data = w->buf;
+    size_t stored = w->len;
+
+    if (w->len == 0) return 0;
+
+#ifdef HAVE_ZSTD
+    static void *zbuf;
+    static size_t zcap;
+    size_t bound = ZSTD_compressBound(w->len);
+
+    if (bound > zcap) {
+        void *nb = realloc(zbuf, bound);
+        if (nb) {
+            zbuf = nb;
+            zcap = bound;
+        }
+    }
+    if (bound <= zcap) {
+        size_t z = ZSTD_compress(zbuf, zcap, w->buf, w->len, ZSTD_LEVEL);
+        if (!ZSTD_isError(z) && z < w->len) {
+            ch.flags |= SSR_CHUNK_ZSTD;
+            data = zbuf;
+            stored = z;
+        }
+    }
+#endif
+
+    ch.stored_len = (uint32_t)stored;
+    if (write_all(w->fd, &ch, sizeof(ch)) < 0 ||
+        write_all(w->fd, data, stored) < 0)
+        return -1;
+
+    w->bytes_written += sizeof(ch) + stored;
+    w->len = 0;
+    return 0;
+}
+
+/* Make room for one more block of n rows */
+int reserve_block(ChunkWriter *w, int n) {
+    size_t need = w->len + sizeof(struct ssr_block_header) +
+                  (size_t)n * SSR_MAX_ROW_BYTES;
+
+    if (need > w->cap) {
+        size_t cap = w->cap ? w->cap : 65536;
+        while (cap < need) cap *= 2;
+        uint8_t *nb = realloc(w->buf, cap);
+        if (!nb) return -1;
+        w->buf = nb;
+        w->cap = cap;
+    }
+    return 0;
+}
+
+/* Binary recording mode */
+void record_export(int interval_ms, int max_samples, int flush_ms) {
+    ssr_row_t *rows = NULL, *prev = NULL;
+    const ssr_row_t **base = NULL;
+    int max_rows = SSR_MAX_ROWS, nprev = 0, with_samples, truncated;
+    unsigned long long last_gen = 0, missed_ticks = 0, truncated_samples = 0;
+    char filename[256];
+    uint64_t raw_rows = 0;
+
+    get_output_filename(filename, sizeof(filename), "smartsched_record");
+    /* get_output_filename() names CSVs; swap the extension */
+    char *ext = strrchr(filename, '.');
+    if (ext) snprintf(ext, filename + sizeof(filename) - ext, ".ssr");
+
+    ChunkWriter w = { .fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) };
+    if (w.fd < 0) {
+        fprintf(stderr, "Error: Cannot create %s: %s\n", filename, strerror(errno));
+        return;
+    }
+
+    /* One row per snapshot slot, so a frame is never cut short */
+    have_snapshot = ss_snapshot_open(&snapshot) == 0;
+    if (have_snapshot && snapshot.hdr->capacity > (unsigned int)max_rows)
+        max_rows = (int)snapshot.hdr->capacity;
+    ss_snapshot_close(&snapshot);
+    if (have_snapshot)
+        snap_records = calloc(max_rows, sizeof(*snap_records));
+    have_snapshot = have_snapshot && snap_records;
+
+    rows = malloc(max_rows * sizeof(*rows));
+    prev = malloc(max_rows * sizeof(*prev));
+    base = malloc(max_rows * sizeof(*base));
+    if (!rows || !prev || !base) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto out;
+    }
+
+    struct ssr_file_header fh = {
+        .magic = SSR_MAGIC,
+        .version = SSR_VERSION,
+        .columns = SSR_COLUMNS,
+        .interval_ms = (uint32_t)interval_ms,
+        .start_ns = clock_ns(CLOCK_REALTIME),
+    };
+    uint64_t start_mono = clock_ns(CLOCK_MONOTONIC);
+    uint64_t last_flush = start_mono;
+
+    if (write_all(w.fd, &fh, sizeof(fh)) < 0) {
+        fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+        goto out;
+    }
+    w.bytes_written = sizeof(fh);
+
+    printf("Recording to: %s (%s, %s)\n", filename,
+           have_snapshot ? "snapshot" : "procfs",
+#ifdef HAVE_ZSTD
+           "zstd"
+#else
+           "uncompressed"
+#endif
+           );
+    printf("Interval: %dms, Flush: %dms, Max samples: %d\n", interval_ms,
+           flush_ms, max_samples > 0 ? max_samples : -1);
+    printf("Press Ctrl+C to stop\n\n");
+
+    int sample = 0, module_away = 0;
+    while (running) {
+        int n = read_rows(rows, max_rows, &with_samples, &truncated);
+        if (n < 0 && have_snapshot) {
+            /* Module reloading: wait for it rather than end the recording */
+            if (!module_away++)
+                fprintf(stderr, "\nWaiting for the module to come back...\n");
+            usleep(interval_ms * 1000);
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "Error reading proc file\n");
+            break;
+        }
+        module_away = 0;
+
+        /*
+         * Replaying needs every sampler tick: drop re-reads of the same
+         * tick and count the ones we were too slow to see.
+         */
+        if (with_samples && sample > 0) {
+            if (snap_gen == last_gen) {
+                usleep(interval_ms * 250);
+                continue;
+            }
+            if (snap_gen > last_gen + 1)
+                missed_ticks += snap_gen - last_gen - 1;
+        }
+        last_gen = snap_gen;
+
+        if (truncated && truncated_samples++ == 0)
+            fprintf(stderr, "\nWarning: more than %d processes; the rest are "
+                    "dropped from sample %d on\n", max_rows, sample);
+
+        uint64_t now = clock_ns(CLOCK_MONOTONIC);
+        int key = sample % KEYFRAME_INTERVAL == 0;
+
+        if (reserve_block(&w, n) < 0) {
+            fprintf(stderr, "Error: out of memory\n");
+            break;
+        }
+        uint8_t *hdr_at = w.buf + w.len;
+        uint8_t *payload = hdr_at + sizeof(struct ssr_block_header);
+        uint8_t *end = ssr_encode_block(payload, rows, n, prev, key ? 0 : nprev,
+                                        SSR_COLUMNS, base);
+        struct ssr_block_header bh = {
+            .sample = (uint32_t)sample,
+            .nr_rows = (uint32_t)n,
+            .offset_ns = now - start_mono,
+            .payload_len = (uint32_t)(end - payload),
+            .flags = (key ? SSR_BLOCK_KEY : 0) |
+                     (with_samples ? SSR_BLOCK_SAMPLES : 0) |
+                     (truncated ? SSR_BLOCK_TRUNCATED : 0),
+        };
+        memcpy(hdr_at, &bh, sizeof(bh));
+        w.len = end - w.buf;
+        raw_rows += n;
+
+        /* Current rows become the reference for the next block */
+        ssr_row_t *t = prev; prev = rows; rows = t;
+        nprev = n;
+
+        if (now - last_flush >= (uint64_t)flush_ms * 1000000ull ||
+            w.len >= CHUNK_MAX_BYTES) {
+            if (flush_chunk(&w) < 0) {
+                fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+                break;
+            }
+            last_flush = now;
+        }
+
+        printf("\rSample %d: %d processes, %.1f KB written", sample, n,
+               w.bytes_written / 1024.0);
+        fflush(stdout);
+
+        sample++;
+        if (max_samples > 0 && sample >= max_samples) break;
+
+        usleep(interval_ms * 1000);
+    }
+
+    if (flush_chunk(&w) < 0)
+        fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+
+    printf("\n\nRecording complete: %d samples, %llu rows, %.1f KB to %s\n",
+           sample, (unsigned long long)raw_rows, w.bytes_written / 1024.0, filename);
+    if (raw_rows)
+        printf("Average: %.2f bytes per row\n", (double)w.bytes_written / raw_rows);
+    if (missed_ticks)
+        printf("Missed %llu sampler ticks; record at the module's interval "
+               "for exact replays\n", missed_ticks);
+    if (truncated_samples)
+        printf("Truncated %llu samples to %d processes\n", truncated_samples, max_rows);
+
+out:
+    close(w.fd);
+    free(w.buf);
+    free(rows);
+    free(prev);
+    free(base);
+    free(snap_records);
+}
+
+/* ---- Conversion ---- */
+
+/* Decode a .ssr recording to CSV */
+int convert_recording(const char *in_file, const char *out_file) {
+    ssr_reader_t r;
+    unsigned long blocks = 0;
+    int n, ret;
+
+    ret = ssr_reader_open(&r, in_file);
+    if (ret < 0) {
+        if (ret == -EPROTO)
+            fprintf(stderr, "Error: %s is not a version 1-%d recording\n",
+                    in_file, SSR_VERSION);
+        else
+            fprintf(stderr, "Error: Cannot open %s: %s\n", in_file, strerror(-ret));
+        return -1;
+    }
+
+    FILE *out = out_file ? fopen(out_file, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Cannot create %s: %s\n", out_file, strerror(errno));
+        ssr_reader_close(&r);
+        return -1;
+    }
+
+    fprintf(out, "sample,pid,cpu_ema,mem_ema,io_ema,cpu_roc,mem_roc,io_roc,total_samples,time_ms,"
+                 "cpu_sample,mem_sample,io_sample\n");
+
+    while ((n = ssr_reader_next(&r)) >= 0) {
+        const ssr_row_t *rows = ssr_reader_rows(&r);
+        unsigned long long ms = r.bh.offset_ns / 1000000ull;
+        int with_samples = r.bh.flags & SSR_BLOCK_SAMPLES;
+
+        for (int i = 0; i < n; i++) {
+            const int64_t *v = rows[i].v;
+            fprintf(out, "%u,%d,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%llu",
+                    r.bh.sample, rows[i].pid,
+                    (long long)v[SSR_COL_CPU_EMA], (long long)v[SSR_COL_MEM_EMA],
+                    (long long)v[SSR_COL_IO_EMA], (long long)v[SSR_COL_CPU_ROC],
+                    (long long)v[SSR_COL_MEM_ROC], (long long)v[SSR_COL_IO_ROC],
+                    (long long)v[SSR_COL_TOTAL_SAMPLES], ms);
+            /* Leave the sample fields empty when they were not recorded */
+            if (with_samples)
+                fprintf(out, ",%lld,%lld,%lld\n", (long long)v[SSR_COL_CPU_SAMPLE],
+                        (long long)v[SSR_COL_MEM_SAMPLE], (long long)v[SSR_COL_IO_SAMPLE]);
+            else
+                fprintf(out, ",,,\n");
+        }
+        blocks++;
+    }
+
+    ret = n == -1 ? 0 : n;
+    if (ret == -ENOTSUP)
+        fprintf(stderr, "Error: recording is zstd-compressed; rebuild with -DHAVE_ZSTD\n");
+    else if (ret < 0)
+        fprintf(stderr, "Error: corrupt recording: %s\n", strerror(-ret));
+
+    if (out_file) {
+        fclose(out);
+        fprintf(stderr, "Converted %lu samples to %s", blocks, out_file);
+        if (r.skipped)
+            fprintf(stderr, " (%lu unreadable)", r.skipped);
+        if (r.truncated)
+            fprintf(stderr, " (%lu truncated)", r.truncated);
+        fprintf(stderr, "\n");
+    }
+    ssr_reader_close(&r);
+    return ret < 0 ? -1 : 0;
+}
+
 /* Generate gnuplot script */
 void generate_gnuplot_script(const char *csv_file) {
     char script_file[256];
@@ -163,11 +588,18 @@ void usage(const char *prog) {
     printf("Modes:\n");
     printf("  snapshot               - Export single snapshot (default)\n");
     printf("  continuous <ms> [max]  - Continuous export\n");
+    printf("  record <ms> [max] [flush_ms]\n");
+    printf("                         - Binary .ssr recording (flush default %dms)\n",
+           DEFAULT_FLUSH_MS);
+    printf("  convert <file.ssr> [out.csv]\n");
+    printf("                         - Decode a recording to CSV (default stdout)\n");
     printf("  gnuplot <csv_file>     - Generate gnuplot script\n");
     printf("\nExamples:\n");
     printf("  %s                     # Single snapshot\n", prog);
     printf("  %s continuous 500      # Record every 500ms\n", prog);
     printf("  %s continuous 100 60   # 60 samples at 100ms\n", prog);
+    printf("  %s record 100          # Record every 100ms to .ssr\n", prog);
+    printf("  %s convert rec.ssr out.csv\n", prog);
 }
 
 int main(int argc, char *argv[]) {
@@ -192,6 +624,17 @@ int main(int argc, char *argv[]) {
         int max = argc >= 4 ? atoi(argv[3]) : 0;
         continuous_export(interval, max);
     }
+    else if (strcmp(argv[1], "record") == 0 && argc >= 3) {
+        int interval = atoi(argv[2]);
+        int max = argc >= 4 ? atoi(argv[3]) : 0;
+        int flush = argc >= 5 ? atoi(argv[4]) : DEFAULT_FLUSH_MS;
+        if (interval < 1) interval = 1;
+        if (flush < 0) flush = 0;
+        record_export(interval, max, flush);
+    }
+    else if (strcmp(argv[1], "convert") == 0 && argc >= 3) {
+        return convert_recording(argv[2], argc >= 4 ? argv[3] : NULL) < 0;
+    }
     else if (strcmp(argv[1], "gnuplot") == 0 && argc >= 3) {
         generate_gnuplot_script(argv[2]);
     }
@@ -15,6 +15,8 @@
 #include <sys/sysinfo.h>
 #include <time.h>
 
+#include "snapshot.h"
+
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
 #define COLOR_GREEN   "\033[32m"
@@ -25,6 +27,7 @@
 #define PROC_STATUS      "/proc/smartscheduler/status"
 #define PROC_PREDICTIONS "/proc/smartscheduler/predictions"
 #define PROC_STATS       "/proc/smartscheduler/stats"
+#define PROC_SPIKING     "/proc/smartscheduler/spiking"
 
 typedef struct {
     char name[64];
@@ -124,8 +127,133 @@ typedef struct {
 static SpikeProc spike_procs[50];
 static int spike_proc_count = 0;
 
+/* Record a process if any of its spike flags are set; returns 1 if so */
+static int note_spike_proc(int pid, const char *comm, int cpu, int mem, int io) {
+    if (!cpu && !mem && !io) return 0;
+    
+    SpikeProc *sp = &spike_procs[spike_proc_count];
+    sp->pid = pid;
+    snprintf(sp->comm, sizeof(sp->comm), "%s", comm);
+    sp->cpu_spike = cpu;
+    sp->mem_spike = mem;
+    sp->io_spike = io;
+    spike_proc_count++;
+    return 1;
+}
+
+/* Report the spike totals gathered from either source */
+static void add_spike_check(int cpu_spikes, int mem_spikes, int io_spikes) {
+    int total = cpu_spikes + mem_spikes + io_spikes;
+    char details[256];
+    snprintf(details, sizeof(details), 
+             "%d total: %d CPU, %d MEM, %d I/O across %d processes",
+             total, cpu_spikes, mem_spikes, io_spikes, spike_proc_count);
+    
+    if (total > 10) {
+        add_check("Active Spikes", 0, details);
+    } else if (total > 3) {
+        add_check("Active Spikes", 2, details);
+    } else {
+        add_check("Active Spikes", 1, details);
+    }
+}
+
+/* Count spikes straight from the binary snapshot; returns 0 if unavailable */
+static int check_spikes_snapshot(void) {
+    ss_snapshot_t ss;
+    unsigned int seq;
+    int cpu_spikes, mem_spikes, io_spikes;
+    int tries = 0;
+    
+    if (ss_snapshot_open(&ss) < 0) return 0;
+    
+    /* Walk the flags column in place; pid and comm are read for spiking rows only */
+    do {
+        if (tries++ >= SS_SNAPSHOT_RETRIES) {
+            ss_snapshot_close(&ss);
+            return 0;
+        }
+        seq = ss_snapshot_read_begin(&ss);
+        cpu_spikes = mem_spikes = io_spikes = 0;
+        spike_proc_count = 0;
+        
+        const __u32 *flags = SS_COL(&ss, FLAGS, __u32);
+        unsigned int n = ss.hdr->nr_records;
+        for (unsigned int i = 0; i < n; i++) {
+            if (!ss_snapshot_is_process(&ss, i) ||
+                !(flags[i] & (SMARTSCHED_FLAG_CPU_SPIKE | SMARTSCHED_FLAG_MEM_SPIKE |
+                              SMARTSCHED_FLAG_IO_SPIKE)))
+                continue;
+            
+            int cpu = !!(flags[i] & SMARTSCHED_FLAG_CPU_SPIKE);
+            int mem = !!(flags[i] & SMARTSCHED_FLAG_MEM_SPIKE);
+            int io = !!(flags[i] & SMARTSCHED_FLAG_IO_SPIKE);
+            char comm[SMARTSCHED_COMM_LEN + 1];
+            
+            cpu_spikes += cpu;
+            mem_spikes += mem;
+            io_spikes += io;
+            if (spike_proc_count < 50) {
+                memcpy(comm, SS_COL(&ss, COMM, char) + (size_t)i * SMARTSCHED_COMM_LEN,
+                       SMARTSCHED_COMM_LEN);
+                comm[SMARTSCHED_COMM_LEN] = '\0';
+                note_spike_proc(SS_COL(&ss, PID, __s32)[i], comm, cpu, mem, io);
+            }
+        }
+    } while (ss_snapshot_read_retry(&ss, seq));
+    
+    ss_snapshot_close(&ss);
+    add_spike_check(cpu_spikes, mem_spikes, io_spikes);
+    return 1;
+}
+
+/*
+ * Count spikes from the spiking view, which lists flagged processes
+ * only; returns 0 if unavailable
+ */
+static int check_spikes_view(void) {
+    FILE *f = fopen(PROC_SPIKING, "r");
+    if (!f) return 0;
+    
+    char line[256];
+    int cpu_spikes = 0, mem_spikes = 0, io_spikes = 0;
+    spike_proc_count = 0;
+    
+    /* Skip header lines */
+    for (int i = 0; i < 4 && fgets(line, sizeof(line), f); i++);
+    
+    while (fgets(line, sizeof(line), f)) {
+        int pid, cpu_roc, mem_roc, io_roc;
+        unsigned int flags;
+        char cpu_flag, mem_flag, io_flag;
+        char comm[32] = "";
+        
+        if (sscanf(line, "%d %c %c %c %d %d %d %x %31[^\n]",
+                   &pid, &cpu_flag, &mem_flag, &io_flag,
+                   &cpu_roc, &mem_roc, &io_roc, &flags, comm) < 8)
+            continue;
+        
+        int cpu = cpu_flag == '*';
+        int mem = mem_flag == '*';
+        int io = io_flag == '*';
+        
+        cpu_spikes += cpu;
+        mem_spikes += mem;
+        io_spikes += io;
+        if (spike_proc_count < 50)
+            note_spike_proc(pid, comm, cpu, mem, io);
+    }
+    fclose(f);
+    
+    add_spike_check(cpu_spikes, mem_spikes, io_spikes);
+    return 1;
+}
+
 /* Check for active spikes */
 void check_spikes(void) {
+    if (check_spikes_view()) return;
+    if (check_spikes_snapshot()) return;
+    
     FILE *f = fopen(PROC_PREDICTIONS, "r");
     if (!f) {
         add_check("Active Spikes", 2, "Cannot read predictions");
@@ -147,51 +275,19 @@ void check_spikes(void) {
         
         if (sscanf(line, "%d %31s %c %c %c %x",
                    &pid, comm, &cpu_flag, &mem_flag, &io_flag, &flags) >= 5) {
+            int cpu = cpu_flag == '*';
+            int mem = mem_flag == '*';
+            int io = io_flag == '*';
             
-            int has_spike = 0;
-            SpikeProc *sp = &spike_procs[spike_proc_count];
-            sp->pid = pid;
-            strncpy(sp->comm, comm, 31);
-            sp->cpu_spike = 0;
-            sp->mem_spike = 0;
-            sp->io_spike = 0;
-            
-            if (cpu_flag == '*') {
-                cpu_spikes++;
-                sp->cpu_spike = 1;
-                has_spike = 1;
-            }
-            if (mem_flag == '*') {
-                mem_spikes++;
-                sp->mem_spike = 1;
-                has_spike = 1;
-            }
-            if (io_flag == '*') {
-                io_spikes++;
-                sp->io_spike = 1;
-                has_spike = 1;
-            }
-            
-            if (has_spike) {
-                spike_proc_count++;
-            }
+            cpu_spikes += cpu;
+            mem_spikes += mem;
+            io_spikes += io;
+            note_spike_proc(pid, comm, cpu, mem, io);
         }
     }
     fclose(f);
     
-    int total = cpu_spikes + mem_spikes + io_spikes;
-    char details[256];
-    snprintf(details, sizeof(details), 
-             "%d total: %d CPU, %d MEM, %d I/O across %d processes",
-             total, cpu_spikes, mem_spikes, io_spikes, spike_proc_count);
-    
-    if (total > 10) {
-        add_check("Active Spikes", 0, details);
-    } else if (total > 3) {
-        add_check("Active Spikes", 2, details);
-    } else {
-        add_check("Active Spikes", 1, details);
-    }
+    add_spike_check(cpu_spikes, mem_spikes, io_spikes);
 }
 
 /* Print spiking processes */
@@ -0,0 +1,1129 @@
+/*
+ * SmartScheduler Metrics Exporter
+ *
+ * Serves the module's predictions at /metrics for Prometheus (text
+ * format 0.0.4) or OpenMetrics scrapers, straight from the binary
+ * snapshot. One thread, one epoll loop: a timer checks the snapshot's
+ * generation a few times per sampling interval and re-renders the
+ * response only when it has moved, so a scrape is one write of a
+ * buffer that is already there however many signatures are tracked.
+ *
+ * Label cardinality is bounded:
+ * - node-wide totals over every signature (no per-process labels)
+ * - per-process series for the top -k processes only, ranked by
+ *   resources flagged now, then flagged ticks in the history window,
+ *   then CPU EMA
+ * - per-cgroup series for the top -c cgroups of
+ *   /proc/smartscheduler/cgroups, read at most once a second
+ *
+ * A top process's lines stay rendered between ticks and are redone
+ * only when one of its exported values changes. Responses in flight
+ * keep the buffer they started with, so re-rendering never blocks on
+ * a slow scraper.
+ *
+ * The snapshot is mapped only for the duration of each poll: a live
+ * mapping holds a reference on the module, and would make rmmod fail
+ * (and with it make -C kernel reload) for as long as the exporter runs.
+ *
+ * Compile: gcc -o metrics_exporter metrics_exporter.c -Wall -O2 -I../kernel
+ * Run: ./metrics_exporter [-p PORT] [-b ADDR] [-k TOP] [-c CGROUPS] [-1]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+
+#include "smartsched_model.h"
+#include "snapshot.h"
+
+#define PROC_CGROUPS     "/proc/smartscheduler/cgroups"
+
+#define DEFAULT_PORT     9811
+#define DEFAULT_TOP      20
+#define DEFAULT_CGROUPS  20
+#define MAX_TOP          1000
+#define MAX_CGROUPS      1024       /* Matches the module's MAX_TRACKED_CGROUPS ceiling */
+#define MAX_CONNS        128
+#define REQ_MAX          4096
+#define IDLE_TIMEOUT_MS  60000      /* Keep-alive connections with no request */
+#define CGROUP_READ_MS   1000
+#define POLLS_PER_TICK   4          /* Generation checks per sampling interval */
+#define MIN_POLL_MS      10
+#define REOPEN_MS        1000       /* Poll period while the module is away */
+
+#define CT_PROMETHEUS    "text/plain; version=0.0.4; charset=utf-8"
+#define CT_OPENMETRICS   "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+static const char *res_name[SMARTSCHED_NR_RES] = { "cpu", "mem", "io" };
+
+static volatile int running = 1;
+
+/* ==== BUFFERS ==== */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static void buf_reserve(Buf *b, size_t more) {
+    if (b->len + more <= b->cap)
+        return;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + more)
+        cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) {
+        perror("realloc");
+        exit(1);
+    }
+    b->data = data;
+    b->cap = cap;
+}
+
+static void buf_put(Buf *b, const char *s, size_t n) {
+    buf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+__attribute__((format(printf, 2, 3)))
+static void buf_printf(Buf *b, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t)n >= b->cap - b->len) {
+        buf_reserve(b, (size_t)n + 1);
+        va_start(ap, fmt);
+        vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+    }
+    b->len += (size_t)n;
+}
+
+/* Label value with \, " and newlines escaped; stops at NUL or max */
+static void buf_label(Buf *b, const char *s, size_t max) {
+    buf_reserve(b, max * 2);
+    for (size_t i = 0; i < max && s[i]; i++) {
+        char c = s[i];
+        if (c == '\\' || c == '"') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = c;
+        } else if (c == '\n') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = 'n';
+        } else {
+            b->data[b->len++] = c;
+        }
+    }
+}
+
+/*
+ * A rendered response body. Connections hold a reference while they
+ * write it out; the exporter drops its own when it renders the next.
+ */
+typedef struct {
+    int refs;
+    size_t len;
+    char data[];
+} Body;
+
+static Body *body_new(const Buf *b) {
+    Body *body = malloc(sizeof(*body) + b->len);
+    if (!body) {
+        perror("malloc");
+        exit(1);
+    }
+    body->refs = 1;
+    body->len = b->len;
+    memcpy(body->data, b->data, b->len);
+    return body;
+}
+
+static void body_put(Body *body) {
+    if (body && --body->refs == 0)
+        free(body);
+}
+
+/* ==== COLLECTION ==== */
+
+/* Values a top process exports; its lines are redone when they change */
+typedef struct {
+    int pid;
+    unsigned int flags;
+    int ema[SMARTSCHED_NR_RES];
+    int roc[SMARTSCHED_NR_RES];
+    unsigned int ticks[SMARTSCHED_NR_RES];
+    unsigned int spike_ms[SMARTSCHED_NR_RES];
+    unsigned long long spikes[SMARTSCHED_NR_RES];
+    unsigned long long start_time;
+    char comm[SMARTSCHED_COMM_LEN];
+} ProcValues;
+
+/* Per-process metric families, each rendered as one cached piece */
+enum {
+    PF_EMA,
+    PF_ROC,
+    PF_SPIKE,
+    PF_FORECAST,
+    PF_SPIKE_TICKS,
+    PF_SPIKE_SECONDS,
+    PF_SPIKES,
+    NR_PF
+};
+
+typedef struct {
+    const char *name;
+    const char *type;
+    const char *help;
+} Family;
+
+static const Family proc_family[NR_PF] = {
+    [PF_EMA] = { "smartsched_process_ema", "gauge",
+                 "Sample EMA in the procfs scale (CPU % x100, memory MB x100, I/O KB)" },
+    [PF_ROC] = { "smartsched_process_roc", "gauge",
+                 "EMA change over the last sampling tick, same scale" },
+    [PF_SPIKE] = { "smartsched_process_spike", "gauge",
+                   "1 while a spike is predicted" },
+    [PF_FORECAST] = { "smartsched_process_forecast", "gauge",
+                      "1 while the trend forecaster expects a spike within its horizon" },
+    [PF_SPIKE_TICKS] = { "smartsched_process_spike_ticks", "gauge",
+                         "Flagged ticks among the last 64 sampling ticks" },
+    [PF_SPIKE_SECONDS] = { "smartsched_process_spike_seconds", "gauge",
+                           "Length of the current spike, 0 when none" },
+    [PF_SPIKES] = { "smartsched_process_spikes", "counter",
+                    "Ticks flagged since the signature was created" },
+};
+
+typedef struct {
+    int row;                       /* Snapshot row it was cached for, -1 = empty */
+    ProcValues v;
+    Buf text;                      /* The NR_PF pieces back to back */
+    size_t off[NR_PF + 1];
+} TopEntry;
+
+typedef struct {
+    unsigned long long key;
+    int row;
+} Rank;
+
+typedef struct {
+    unsigned long long id;
+    unsigned int tasks;
+    int ema[SMARTSCHED_NR_RES];
+    int roc[SMARTSCHED_NR_RES];
+    unsigned int flags;
+    char path[128];
+} CgroupValues;
+
+/* Everything one tick exports, gathered before rendering */
+typedef struct {
+    int up;
+    int abi_mismatch;
+    unsigned long long generation;
+    unsigned int interval_ms;
+    unsigned int processes;
+    unsigned int threads;
+    unsigned int capacity;
+    unsigned int spiking[SMARTSCHED_NR_RES];
+    unsigned int forecast[SMARTSCHED_NR_RES];
+    unsigned int persistent[SMARTSCHED_NR_RES];   /* Spiking for half the window or more */
+    int nr_top;
+} Tick;
+
+static int top_k = DEFAULT_TOP;
+static int max_cgroups = DEFAULT_CGROUPS;
+
+static ss_snapshot_t ss = { .fd = -1 };      /* Mapped only inside refresh() */
+static unsigned int sample_interval_ms;      /* Of the last snapshot read, 0 = down */
+static Tick tick;
+static Rank rank[MAX_TOP];
+static ProcValues top_values[MAX_TOP];
+static TopEntry top_cache[MAX_TOP];
+static CgroupValues cgroup_all[MAX_CGROUPS];
+static CgroupValues cgroup_top[MAX_CGROUPS];
+static int cgroups_up;
+static int nr_cgroups;
+static unsigned int cgroups_listed;
+static double last_render_secs;
+
+static Body *current[2];           /* Prometheus text, OpenMetrics */
+
+static long long now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double now_secs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Ranking key of a process row: resources flagged now, then flagged
+ * ticks in the history window, then CPU EMA
+ */
+static inline unsigned long long rank_key(unsigned int flags, unsigned int ticks, int cpu_ema) {
+    unsigned int flagged = __builtin_popcount(flags & (SMARTSCHED_FLAG_CPU_SPIKE |
+                                                       SMARTSCHED_FLAG_MEM_SPIKE |
+                                                       SMARTSCHED_FLAG_IO_SPIKE));
+
+    return ((unsigned long long)flagged << 48) | ((unsigned long long)ticks << 32) |
+           (unsigned int)(cpu_ema > 0 ? cpu_ema : 0);
+}
+
+/* Min-heap of the k best ranks seen so far, root = weakest */
+static void heap_sift_down(Rank *h, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && h[l].key < h[m].key) m = l;
+        if (r < n && h[r].key < h[m].key) m = r;
+        if (m == i)
+            return;
+        Rank t = h[i]; h[i] = h[m]; h[m] = t;
+        i = m;
+    }
+}
+
+static void heap_push(Rank *h, int *n, int k, unsigned long long key, int row) {
+    if (*n < k) {
+        int i = (*n)++;
+        h[i].key = key;
+        h[i].row = row;
+        while (i && h[(i - 1) / 2].key > h[i].key) {
+            Rank t = h[i]; h[i] = h[(i - 1) / 2]; h[(i - 1) / 2] = t;
+            i = (i - 1) / 2;
+        }
+    } else if (k && key > h[0].key) {
+        h[0].key = key;
+        h[0].row = row;
+        heap_sift_down(h, *n, 0);
+    }
+}
+
+static int compare_rank(const void *a, const void *b) {
+    const Rank *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? 1 : -1;
+    return x->row - y->row;
+}
+
+/*
+ * Walk the snapshot columns in place: node-wide counts over every
+ * row and the top-k process rows, copied out under the same sequence
+ * so totals and top agree. Returns 0, or -EAGAIN if the writer kept
+ * getting in the way.
+ */
+static int collect_snapshot(void) {
+    const struct smartsched_snapshot_header *hdr = (const void *)ss.hdr;
+
+    for (int tries = 0; tries < SS_SNAPSHOT_RETRIES; tries++) {
+        unsigned int seq = ss_snapshot_read_begin(&ss);
+        unsigned int rows = hdr->nr_records;
+        const __u32 *flags = SS_COL(&ss, FLAGS, __u32);
+        const __s32 *cpu_ema = SS_COL(&ss, CPU_EMA, __s32);
+        const __u64 *history[SMARTSCHED_NR_RES];
+        int n = 0;
+
+        for (int r = 0; r < SMARTSCHED_NR_RES; r++)
+            history[r] = ss.col[SMARTSCHED_COL_HISTORY(r)];
+
+        memset(&tick, 0, sizeof(tick));
+        tick.generation = hdr->generation;
+        tick.interval_ms = hdr->sample_interval_ms;
+        tick.capacity = hdr->capacity;
+        if (rows > hdr->capacity)
+            rows = hdr->capacity;
+
+        for (unsigned int i = 0; i < rows; i++) {
+            unsigned int f = flags[i], ticks = 0;
+
+            if (!(f & SMARTSCHED_FLAG_ACTIVE))
+                continue;
+            if (f & SMARTSCHED_FLAG_THREAD) {
+                tick.threads++;
+                continue;
+            }
+            tick.processes++;
+            for (int r = 0; r < SMARTSCHED_NR_RES; r++) {
+                unsigned int t = smartsched_history_ticks(history[r][i]);
+
+                tick.spiking[r] += (f >> r) & 1;
+                tick.forecast[r] += (f >> (r + SMARTSCHED_FORECAST_SHIFT)) & 1;
+                tick.persistent[r] += t >= SMARTSCHED_HISTORY_TICKS / 2;
+                ticks += t;
+            }
+            heap_push(rank, &n, top_k, rank_key(f, ticks, cpu_ema[i]), (int)i);
+        }
+
+        qsort(rank, n, sizeof(rank[0]), compare_rank);
+        for (int t = 0; t < n; t++) {
+            struct smartsched_record rec;
+            ProcValues *v = &top_values[t];
+
+            ss_snapshot_row(&ss, rank[t].row, &rec);
+            memset(v, 0, sizeof(*v));
+            v->pid = rec.pid;
+            v->flags = rec.flags;
+            v->ema[0] = rec.cpu_ema;
+            v->ema[1] = rec.mem_ema;
+            v->ema[2] = rec.io_ema;
+            v->roc[0] = rec.cpu_roc;
+            v->roc[1] = rec.mem_roc;
+            v->roc[2] = rec.io_roc;
+            v->spikes[0] = rec.cpu_spikes;
+            v->spikes[1] = rec.mem_spikes;
+            v->spikes[2] = rec.io_spikes;
+            for (int r = 0; r < SMARTSCHED_NR_RES; r++) {
+                v->ticks[r] = smartsched_history_ticks(rec.spike_history[r]);
+                if (rec.spike_since_ns[r] && hdr->timestamp_ns > rec.spike_since_ns[r])
+                    v->spike_ms[r] = (hdr->timestamp_ns - rec.spike_since_ns[r]) / 1000000;
+            }
+            v->start_time = rec.start_time_ns;
+            memcpy(v->comm, rec.comm, SMARTSCHED_COMM_LEN);
+            v->comm[SMARTSCHED_COMM_LEN - 1] = '\0';
+        }
+        tick.nr_top = n;
+
+        if (!ss_snapshot_read_retry(&ss, seq)) {
+            tick.up = 1;
+            return 0;
+        }
+    }
+    return -EAGAIN;
+}
+
+static int compare_cgroup(const void *a, const void *b) {
+    const CgroupValues *x = a, *y = b;
+    unsigned long long kx = rank_key(x->flags, 0, x->ema[0]);
+    unsigned long long ky = rank_key(y->flags, 0, y->ema[0]);
+
+    if (kx != ky)
+        return kx < ky ? 1 : -1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* Top max_cgroups cgroup signatures; rate-limited to CGROUP_READ_MS */
+static void collect_cgroups(int force) {
+    static long long last;
+    long long now = now_ms();
+
+    if (!force && now - last < CGROUP_READ_MS)
+        return;
+    last = now;
+
+    FILE *f = fopen(PROC_CGROUPS, "r");
+    cgroups_up = f != NULL;
+    nr_cgroups = 0;
+    cgroups_listed = 0;
+    if (!f)
+        return;
+
+    char line[512];
+    int n = 0;
+
+    /* Skip header lines */
+    for (int i = 0; i < 4; i++) {
+        if (!fgets(line, sizeof(line), f)) break;
+    }
+
+    while (fgets(line, sizeof(line), f) && n < MAX_CGROUPS) {
+        CgroupValues *cg = &cgroup_all[n];
+
+        if (sscanf(line, "%llu %u %d %d %d %d %d %d %x %127[^\n]",
+                   &cg->id, &cg->tasks, &cg->ema[0], &cg->ema[1], &cg->ema[2],
+                   &cg->roc[0], &cg->roc[1], &cg->roc[2], &cg->flags, cg->path) == 10)
+            n++;
+    }
+    fclose(f);
+
+    cgroups_listed = n;
+    qsort(cgroup_all, n, sizeof(cgroup_all[0]), compare_cgroup);
+    nr_cgroups = n < max_cgroups ? n : max_cgroups;
+    memcpy(cgroup_top, cgroup_all, nr_cgroups * sizeof(cgroup_all[0]));
+}
+
+/* ==== RENDERING ==== */
+
+/* HELP / TYPE lines; OpenMetrics names counters without _total */
+static void family(Buf *b, int om, const Family *fam) {
+    const char *suffix = !om && !strcmp(fam->type, "counter") ? "_total" : "";
+
+    buf_printf(b, "# HELP %s%s %s\n", fam->name, suffix, fam->help);
+    buf_printf(b, "# TYPE %s%s %s\n", fam->name, suffix, fam->type);
+}
+
+static void sample_name(Buf *b, const Family *fam) {
+    buf_put(b, fam->name, strlen(fam->name));
+    if (!strcmp(fam->type, "counter"))
+        buf_put(b, "_total", 6);
+}
+
+/* The NR_PF pieces of one top process */
+static void render_process(TopEntry *e) {
+    const ProcValues *v = &e->v;
+    Buf *b = &e->text;
+    char labels[96];
+    Buf lb = { 0 };
+
+    buf_label(&lb, v->comm, SMARTSCHED_COMM_LEN);
+    snprintf(labels, sizeof(labels), "pid=\"%d\",comm=\"%.*s\"", v->pid, (int)lb.len, lb.data);
+    free(lb.data);
+
+    b->len = 0;
+    for (int pf = 0; pf < NR_PF; pf++) {
+        const Family *fam = &proc_family[pf];
+
+        e->off[pf] = b->len;
+        for (int r = 0; r < SMARTSCHED_NR_RES; r++) {
+            sample_name(b, fam);
+            buf_printf(b, "{%s,resource=\"%s\"} ", labels, res_name[r]);
+            switch (pf) {
+            case PF_EMA:
+                buf_printf(b, "%d\n", v->ema[r]);
+                break;
+            case PF_ROC:
+                buf_printf(b, "%d\n", v->roc[r]);
+                break;
+            case PF_SPIKE:
+                buf_printf(b, "%u\n", (v->flags >> r) & 1);
+                break;
+            case PF_FORECAST:
+                buf_printf(b, "%u\n", (v->flags >> (r + SMARTSCHED_FORECAST_SHIFT)) & 1);
+                break;
+            case PF_SPIKE_TICKS:
+                buf_printf(b, "%u\n", v->ticks[r]);
+                break;
+            case PF_SPIKE_SECONDS:
+                buf_printf(b, "%u.%03u\n", v->spike_ms[r] / 1000, v->spike_ms[r] % 1000);
+                break;
+            case PF_SPIKES:
+                buf_printf(b, "%llu\n", v->spikes[r]);
+                break;
+            }
+        }
+    }
+    e->off[NR_PF] = b->len;
+}
+
+/*
+ * Bring the top cache in line with this tick's top processes: one
+ * that kept its row and values keeps its rendered pieces, wherever it
+ * now ranks. Returns the number of processes re-rendered.
+ */
+static int update_top_cache(void) {
+    static TopEntry next[MAX_TOP];
+    int rendered = 0;
+
+    for (int t = 0; t < tick.nr_top; t++) {
+        TopEntry *e = &next[t];
+
+        *e = (TopEntry){ .row = -1 };
+        for (int c = 0; c < top_k; c++) {
+            if (top_cache[c].row == rank[t].row &&
+                top_cache[c].v.pid == top_values[t].pid &&
+                top_cache[c].v.start_time == top_values[t].start_time) {
+                *e = top_cache[c];
+                top_cache[c] = (TopEntry){ .row = -1 };
+                break;
+            }
+        }
+        if (e->row < 0 || memcmp(&e->v, &top_values[t], sizeof(e->v))) {
+            e->row = rank[t].row;
+            e->v = top_values[t];
+            render_process(e);
+            rendered++;
+        }
+    }
+
+    /* Processes that left the top */
+    for (int c = 0; c < top_k; c++)
+        free(top_cache[c].text.data);
+    for (int t = tick.nr_top; t < top_k; t++)
+        next[t] = (TopEntry){ .row = -1 };
+
+    memcpy(top_cache, next, top_k * sizeof(top_cache[0]));
+    return rendered;
+}
+
+static void gauge(Buf *b, int om, const char *name, const char *help) {
+    Family fam = { name, "gauge", help };
+    family(b, om, &fam);
+}
+
+static void per_res(Buf *b, const char *name, const unsigned int *v) {
+    for (int r = 0; r < SMARTSCHED_NR_RES; r++)
+        buf_printf(b, "%s{resource=\"%s\"} %u\n", name, res_name[r], v[r]);
+}
+
+static void render(Buf *b, int om) {
+    b->len = 0;
+
+    gauge(b, om, "smartsched_up", "1 if the snapshot at " SMARTSCHED_DEV_PATH " could be read");
+    buf_printf(b, "smartsched_up %d\n", tick.up);
+    gauge(b, om, "smartsched_abi_mismatch", "1 if the module's snapshot ABI differs from the exporter's");
+    buf_printf(b, "smartsched_abi_mismatch %d\n", tick.abi_mismatch);
+
+    if (tick.up) {
+        Family ticks = { "smartsched_ticks", "counter", "Sampling ticks of the module" };
+        family(b, om, &ticks);
+        buf_printf(b, "smartsched_ticks_total %llu\n", tick.generation);
+        gauge(b, om, "smartsched_sample_interval_seconds", "Module sampling interval");
+        buf_printf(b, "smartsched_sample_interval_seconds %u.%03u\n",
+                   tick.interval_ms / 1000, tick.interval_ms % 1000);
+        gauge(b, om, "smartsched_signatures", "Live signatures by kind");
+        buf_printf(b, "smartsched_signatures{kind=\"process\"} %u\n", tick.processes);
+        buf_printf(b, "smartsched_signatures{kind=\"thread\"} %u\n", tick.threads);
+        gauge(b, om, "smartsched_signature_capacity", "Rows of the snapshot");
+        buf_printf(b, "smartsched_signature_capacity %u\n", tick.capacity);
+        gauge(b, om, "smartsched_spiking", "Processes with a spike predicted now");
+        per_res(b, "smartsched_spiking", tick.spiking);
+        gauge(b, om, "smartsched_forecast", "Processes with a spike forecast within the horizon");
+        per_res(b, "smartsched_forecast", tick.forecast);
+        gauge(b, om, "smartsched_spiking_persistent",
+              "Processes flagged in at least half of the last 64 ticks");
+        per_res(b, "smartsched_spiking_persistent", tick.persistent);
+
+        for (int pf = 0; pf < NR_PF; pf++) {
+            family(b, om, &proc_family[pf]);
+            for (int t = 0; t < tick.nr_top; t++) {
+                const TopEntry *e = &top_cache[t];
+                buf_put(b, e->text.data + e->off[pf], e->off[pf + 1] - e->off[pf]);
+            }
+        }
+    }
+
+    if (cgroups_up) {
+        gauge(b, om, "smartsched_cgroups", "Cgroup signatures listed by the module");
+        buf_printf(b, "smartsched_cgroups %u\n", cgroups_listed);
+        gauge(b, om, "smartsched_cgroup_tasks", "Tasks in the cgroup");
+        for (int i = 0; i < nr_cgroups; i++) {
+            buf_printf(b, "smartsched_cgroup_tasks{cgroup=\"");
+            buf_label(b, cgroup_top[i].path, sizeof(cgroup_top[i].path));
+            buf_printf(b, "\"} %u\n", cgroup_top[i].tasks);
+        }
+
+        static const char *cg_name[] = {
+            "smartsched_cgroup_ema", "smartsched_cgroup_roc", "smartsched_cgroup_spike",
+        };
+        static const char *cg_help[] = {
+            "Aggregate sample EMA of the cgroup, procfs scale",
+            "Aggregate EMA change over the last tick",
+            "1 while a spike is predicted for the cgroup",
+        };
+        for (int m = 0; m < 3; m++) {
+            gauge(b, om, cg_name[m], cg_help[m]);
+            for (int i = 0; i < nr_cgroups; i++) {
+                const CgroupValues *cg = &cgroup_top[i];
+                for (int r = 0; r < SMARTSCHED_NR_RES; r++) {
+                    int val = m == 0 ? cg->ema[r] : m == 1 ? cg->roc[r] : (int)((cg->flags >> r) & 1);
+                    buf_printf(b, "%s{cgroup=\"", cg_name[m]);
+                    buf_label(b, cg->path, sizeof(cg->path));
+                    buf_printf(b, "\",resource=\"%s\"} %d\n", res_name[r], val);
+                }
+            }
+        }
+    }
+
+    gauge(b, om, "smartsched_exporter_render_seconds", "Time the previous render took");
+    buf_printf(b, "smartsched_exporter_render_seconds %.6f\n", last_render_secs);
+    gauge(b, om, "smartsched_exporter_top_processes", "Per-process label sets exported (-k)");
+    buf_printf(b, "smartsched_exporter_top_processes %d\n", tick.nr_top);
+
+    if (om)
+        buf_put(b, "# EOF\n", 6);
+}
+
+/*
+ * Map the snapshot, re-read it if it moved and swap in freshly
+ * rendered bodies, then unmap it again; returns 1 if they changed.
+ * A module that went away is exported as down until it is back.
+ */
+static int refresh(int force) {
+    static Buf scratch;
+    static unsigned long long last_gen = ~0ULL;
+    double start = now_secs();
+    int mismatch = tick.abi_mismatch;
+    int ret = ss_snapshot_open(&ss);
+
+    tick.abi_mismatch = ret == -EPROTO;
+    force |= !current[0] || tick.abi_mismatch != mismatch;
+
+    if (ret == 0) {
+        sample_interval_ms = ss.hdr->sample_interval_ms;
+        if (!force && ss.hdr->generation == last_gen) {
+            ss_snapshot_close(&ss);
+            return 0;
+        }
+        ret = collect_snapshot();
+        ss_snapshot_close(&ss);
+        if (ret < 0)
+            return 0;
+        last_gen = tick.generation;
+        update_top_cache();
+    } else {
+        sample_interval_ms = 0;
+        if (tick.up) {
+            /* Unloaded: a reloaded module counts its ticks from 0 again */
+            tick.up = 0;
+            last_gen = ~0ULL;
+            force = 1;
+        }
+        if (!force)
+            return 0;
+    }
+    collect_cgroups(force);
+
+    for (int om = 0; om < 2; om++) {
+        render(&scratch, om);
+        body_put(current[om]);
+        current[om] = body_new(&scratch);
+    }
+    last_render_secs = now_secs() - start;
+    return 1;
+}
+
+/* ==== HTTP ==== */
+
+typedef struct {
+    int fd;                        /* -1 = free */
+    char req[REQ_MAX];
+    size_t req_len;
+    char head[256];
+    struct iovec iov[2];
+    Body *body;                    /* Held while iov[1] points into it */
+    int writing;
+    int close_after;
+    long long last_active;
+} Conn;
+
+static Conn conns[MAX_CONNS];
+
+static const char msg_index[] =
+    "SmartScheduler metrics exporter\nScrape /metrics\n";
+static const char msg_not_found[] = "Not found\n";
+static const char msg_bad_method[] = "Method not allowed\n";
+static const char msg_bad_request[] = "Bad request\n";
+
+static void conn_close(int ep, Conn *c) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    body_put(c->body);
+    c->body = NULL;
+    c->fd = -1;
+}
+
+static void conn_watch(int ep, Conn *c, unsigned int events) {
+    struct epoll_event ev = { .events = events, .data.ptr = c };
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void respond(Conn *c, int status, const char *reason, const char *type,
+                    const char *data, size_t len, Body *body, int head_only) {
+    int n = snprintf(c->head, sizeof(c->head),
+                     "HTTP/1.1 %d %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "%s%s\r\n",
+                     status, reason, type, len,
+                     status == 405 ? "Allow: GET, HEAD\r\n" : "",
+                     c->close_after ? "Connection: close\r\n" : "");
+
+    c->iov[0].iov_base = c->head;
+    c->iov[0].iov_len = (size_t)n;
+    c->iov[1].iov_base = (void *)data;
+    c->iov[1].iov_len = head_only ? 0 : len;
+    if (body)
+        body->refs++;
+    c->body = body;
+    c->writing = 1;
+}
+
+/* Value of header name in the request block, or NULL; *len is set */
+static const char *header(const char *req, const char *name, size_t *len) {
+    size_t nlen = strlen(name);
+
+    for (const char *p = strstr(req, "\r\n"); p && p[2] != '\r'; p = strstr(p + 2, "\r\n")) {
+        const char *line = p + 2;
+        if (strncasecmp(line, name, nlen) || line[nlen] != ':')
+            continue;
+        line += nlen + 1;
+        while (*line == ' ' || *line == '\t')
+            line++;
+        const char *end = strstr(line, "\r\n");
+        *len = end ? (size_t)(end - line) : strlen(line);
+        return line;
+    }
+    return NULL;
+}
+
+static int contains(const char *s, size_t len, const char *needle) {
+    size_t n = strlen(needle);
+
+    for (size_t i = 0; i + n <= len; i++) {
+        if (!strncasecmp(s + i, needle, n))
+            return 1;
+    }
+    return 0;
+}
+
+/* Parse the NUL-terminated request head in c->req and queue a response */
+static void handle_request(Conn *c) {
+    char method[8], path[256], version[16];
+    const char *v;
+    size_t len;
+
+    if (sscanf(c->req, "%7s %255s %15s", method, path, version) != 3 ||
+        strncmp(version, "HTTP/1.", 7)) {
+        c->close_after = 1;
+        respond(c, 400, "Bad Request", "text/plain", msg_bad_request,
+                sizeof(msg_bad_request) - 1, NULL, 0);
+        return;
+    }
+
+    /* HTTP/1.1 keeps the connection unless told otherwise, 1.0 the reverse */
+    v = header(c->req, "Connection", &len);
+    if (!strcmp(version, "HTTP/1.0"))
+        c->close_after = !(v && contains(v, len, "keep-alive"));
+    else
+        c->close_after = v && contains(v, len, "close");
+
+    char *query = strchr(path, '?');
+    if (query)
+        *query = '\0';
+
+    int head_only = !strcmp(method, "HEAD");
+    if (!head_only && strcmp(method, "GET")) {
+        respond(c, 405, "Method Not Allowed", "text/plain", msg_bad_method,
+                sizeof(msg_bad_method) - 1, NULL, 0);
+    } else if (!strcmp(path, "/metrics")) {
+        v = header(c->req, "Accept", &len);
+        int om = v && contains(v, len, "application/openmetrics-text");
+        Body *body = current[om];
+        respond(c, 200, "OK", om ? CT_OPENMETRICS : CT_PROMETHEUS,
+                body->data, body->len, body, head_only);
+    } else if (!strcmp(path, "/")) {
+        respond(c, 200, "OK", "text/plain", msg_index, sizeof(msg_index) - 1, NULL, head_only);
+    } else {
+        respond(c, 404, "Not Found", "text/plain", msg_not_found,
+                sizeof(msg_not_found) - 1, NULL, head_only);
+    }
+}
+
+/* Write what the socket takes; returns 0 to keep the connection */
+static int conn_write(int ep, Conn *c) {
+    while (c->iov[0].iov_len + c->iov[1].iov_len) {
+        struct iovec *iov = c->iov[0].iov_len ? &c->iov[0] : &c->iov[1];
+        int cnt = iov == &c->iov[0] ? 2 : 1;
+        ssize_t n = writev(c->fd, iov, cnt);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_watch(ep, c, EPOLLOUT);
+                return 0;
+            }
+            return -1;
+        }
+        for (int i = 0; i < 2 && n > 0; i++) {
+            size_t step = (size_t)n < c->iov[i].iov_len ? (size_t)n : c->iov[i].iov_len;
+            c->iov[i].iov_base = (char *)c->iov[i].iov_base + step;
+            c->iov[i].iov_len -= step;
+            n -= step;
+        }
+    }
+
+    body_put(c->body);
+    c->body = NULL;
+    c->writing = 0;
+    if (c->close_after)
+        return -1;
+    conn_watch(ep, c, EPOLLIN);
+    return 0;
+}
+
+/* Read and serve requests; returns 0 to keep the connection */
+static int conn_read(int ep, Conn *c) {
+    for (;;) {
+        char *end;
+
+        /* Requests already buffered (pipelined) are served in turn */
+        while (!c->writing && (end = memmem(c->req, c->req_len, "\r\n\r\n", 4))) {
+            size_t used = (size_t)(end - c->req) + 4;
+
+            end[2] = '\0';
+            handle_request(c);
+            memmove(c->req, c->req + used, c->req_len - used);
+            c->req_len -= used;
+            if (conn_write(ep, c) < 0)
+                return -1;
+        }
+        if (c->writing)
+            return 0;
+
+        if (c->req_len == sizeof(c->req) - 1) {
+            c->close_after = 1;
+            respond(c, 400, "Bad Request", "text/plain", msg_bad_request,
+                    sizeof(msg_bad_request) - 1, NULL, 0);
+            return conn_write(ep, c) < 0 ? -1 : 0;
+        }
+
+        ssize_t n = read(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (n <= 0)
+            return -1;
+        c->req_len += (size_t)n;
+        c->req[c->req_len] = '\0';
+        c->last_active = now_ms();
+    }
+}
+
+static void accept_all(int ep, int lfd) {
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        Conn *c = NULL;
+        for (int i = 0; i < MAX_CONNS; i++) {
+            if (conns[i].fd < 0) {
+                c = &conns[i];
+                break;
+            }
+        }
+        if (!c) {
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->req_len = 0;
+        c->writing = 0;
+        c->close_after = 0;
+        c->body = NULL;
+        c->last_active = now_ms();
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            c->fd = -1;
+        }
+    }
+}
+
+static void close_idle(int ep) {
+    long long now = now_ms();
+
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (conns[i].fd >= 0 && now - conns[i].last_active > IDLE_TIMEOUT_MS)
+            conn_close(ep, &conns[i]);
+    }
+}
+
+/* ==== MAIN ==== */
+
+static int listen_on(const char *addr, int port) {
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int one = 1;
+
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        fprintf(stderr, "Bad listen address: %s\n", addr);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "Cannot listen on %s:%d: %s\n", addr, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Poll period: a fraction of the sampling interval, REOPEN_MS while down */
+static void arm_timer(int tfd) {
+    static long long armed;
+    long long ms = sample_interval_ms ? sample_interval_ms / POLLS_PER_TICK : REOPEN_MS;
+
+    if (ms < MIN_POLL_MS)
+        ms = MIN_POLL_MS;
+    if (ms == armed)
+        return;
+    armed = ms;
+
+    struct itimerspec its = {
+        .it_interval = { ms / 1000, (ms % 1000) * 1000000 },
+        .it_value = { ms / 1000, (ms % 1000) * 1000000 },
+    };
+    timerfd_settime(tfd, 0, &its, NULL);
+}
+
+void signal_handler(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("Serve SmartScheduler predictions for Prometheus / OpenMetrics scrapers\n\n");
+    printf("Options:\n");
+    printf("  -p PORT     Port to listen on (default: %d)\n", DEFAULT_PORT);
+    printf("  -b ADDR     IPv4 address to bind (default: 0.0.0.0)\n");
+    printf("  -k TOP      Processes exported with per-process labels, 0..%d (default: %d)\n",
+           MAX_TOP, DEFAULT_TOP);
+    printf("  -c CGROUPS  Cgroups exported, 0..%d (default: %d)\n", MAX_CGROUPS, DEFAULT_CGROUPS);
+    printf("  -1          Print one Prometheus text page to stdout and exit\n");
+    printf("              (e.g. for node_exporter's textfile collector)\n");
+    printf("  -h          Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *addr = "0.0.0.0";
+    int port = DEFAULT_PORT;
+    int once = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:b:k:c:1h")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'b': addr = optarg; break;
+            case 'k': top_k = atoi(optarg); break;
+            case 'c': max_cgroups = atoi(optarg); break;
+            case '1': once = 1; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || top_k < 0 || top_k > MAX_TOP ||
+        max_cgroups < 0 || max_cgroups > MAX_CGROUPS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_TOP; i++)
+        top_cache[i].row = -1;
+    refresh(1);
+
+    if (once) {
+        fwrite(current[0]->data, 1, current[0]->len, stdout);
+        return tick.up ? 0 : 1;
+    }
+
+    int lfd = listen_on(addr, port);
+    if (lfd < 0)
+        return 1;
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ep < 0 || tfd < 0) {
+        perror("epoll / timerfd");
+        return 1;
+    }
+
+    /* The listener and the timer are told apart from connections by address */
+    static int listen_tag, timer_tag;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &listen_tag };
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev);
+    ev.data.ptr = &timer_tag;
+    epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+    arm_timer(tfd);
+
+    for (int i = 0; i < MAX_CONNS; i++)
+        conns[i].fd = -1;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("SmartScheduler metrics exporter on %s:%d (top %d processes, %d cgroups)\n",
+           addr, port, top_k, max_cgroups);
+    if (!tick.up)
+        printf("Snapshot %s unavailable%s, exporting smartsched_up 0 until it appears\n",
+               SMARTSCHED_DEV_PATH, tick.abi_mismatch ? " (ABI mismatch)" : "");
+    fflush(stdout);
+
+    while (running) {
+        struct epoll_event events[64];
+        int n = epoll_wait(ep, events, 64, -1);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+
+            if (tag == &listen_tag) {
+                accept_all(ep, lfd);
+            } else if (tag == &timer_tag) {
+                unsigned long long expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                    perror("timerfd");
+                refresh(0);
+                arm_timer(tfd);
+                close_idle(ep);
+            } else {
+                Conn *c = tag;
+                int err;
+
+                if (c->fd < 0)
+                    continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    err = -1;
+                else if (c->writing)
+                    err = conn_write(ep, c) < 0 || (!c->writing && conn_read(ep, c) < 0);
+                else
+                    err = conn_read(ep, c);
+                if (err)
+                    conn_close(ep, c);
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (conns[i].fd >= 0)
+            conn_close(ep, &conns[i]);
+    }
+    close(tfd);
+    close(ep);
+    close(lfd);
+    printf("Exporter stopped\n");
+    return 0;
+}
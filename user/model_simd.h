@@ -0,0 +1,142 @@
+/*
+ * SmartScheduler SIMD Model Step
+ *
+ * Header-only vector versions of smartsched_model_step_batch() for the
+ * user-space collectors: AVX2 (8 signatures per step) on x86-64,
+ * picked at run time so the tools need no -mavx2, and NEON (4 per
+ * step) on AArch64. Results are bit for bit those of the scalar model,
+ * including the truncating division by 100, which is done with the
+ * compiler's multiply-high sequence:
+ *
+ *   x / 100 = (hi32(x * 0x51eb851f) >> 5) - (x >> 31)
+ *
+ * Tails shorter than a vector, and other CPUs, use the portable batch.
+ */
+
+#ifndef SMARTSCHED_MODEL_SIMD_H
+#define SMARTSCHED_MODEL_SIMD_H
+
+#include "smartsched_model.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SS_SIMD_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SS_SIMD_NEON 1
+#endif
+
+#define SS_DIV100_MAGIC 0x51eb851f
+
+#ifdef SS_SIMD_AVX2
+__attribute__((target("avx2")))
+static inline __m256i ss_div100_avx2(__m256i x)
+{
+    const __m256i magic = _mm256_set1_epi32(SS_DIV100_MAGIC);
+    __m256i even = _mm256_mul_epi32(x, magic);
+    __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), magic);
+    __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+
+    return _mm256_sub_epi32(_mm256_srai_epi32(hi, 5), _mm256_srai_epi32(x, 31));
+}
+
+__attribute__((target("avx2")))
+static unsigned int ss_model_step_avx2(const struct smartsched_model_params *p, int res,
+                                       int *ema, int *prev, int *roc, const int *sample,
+                                       __u32 *flags, unsigned int n)
+{
+    const __m256i alpha = _mm256_set1_epi32(p->alpha);
+    const __m256i keep = _mm256_set1_epi32(100 - p->alpha);
+    const __m256i threshold = _mm256_set1_epi32(p->threshold[res]);
+    const __m256i bit = _mm256_set1_epi32(1 << res);
+    unsigned int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i old = _mm256_loadu_si256((const __m256i *)(ema + i));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(sample + i));
+        __m256i f = _mm256_loadu_si256((const __m256i *)(flags + i));
+        __m256i cur = ss_div100_avx2(_mm256_add_epi32(_mm256_mullo_epi32(alpha, s),
+                                                      _mm256_mullo_epi32(keep, old)));
+        __m256i d = _mm256_sub_epi32(cur, old);
+
+        _mm256_storeu_si256((__m256i *)(prev + i), old);
+        _mm256_storeu_si256((__m256i *)(ema + i), cur);
+        _mm256_storeu_si256((__m256i *)(roc + i), d);
+        f = _mm256_or_si256(f, _mm256_and_si256(_mm256_cmpgt_epi32(d, threshold), bit));
+        _mm256_storeu_si256((__m256i *)(flags + i), f);
+    }
+    return i;
+}
+#endif /* SS_SIMD_AVX2 */
+
+#ifdef SS_SIMD_NEON
+static inline int32x4_t ss_div100_neon(int32x4_t x)
+{
+    const int32x2_t magic = vdup_n_s32(SS_DIV100_MAGIC);
+    int32x4_t hi = vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(x), magic), 32),
+                                vshrn_n_s64(vmull_s32(vget_high_s32(x), magic), 32));
+
+    return vsubq_s32(vshrq_n_s32(hi, 5), vshrq_n_s32(x, 31));
+}
+
+static unsigned int ss_model_step_neon(const struct smartsched_model_params *p, int res,
+                                       int *ema, int *prev, int *roc, const int *sample,
+                                       __u32 *flags, unsigned int n)
+{
+    const int32x4_t alpha = vdupq_n_s32(p->alpha);
+    const int32x4_t keep = vdupq_n_s32(100 - p->alpha);
+    const int32x4_t threshold = vdupq_n_s32(p->threshold[res]);
+    const uint32x4_t bit = vdupq_n_u32(1u << res);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        int32x4_t old = vld1q_s32(ema + i);
+        int32x4_t cur = ss_div100_neon(vmlaq_s32(vmulq_s32(alpha, vld1q_s32(sample + i)),
+                                                 keep, old));
+        int32x4_t d = vsubq_s32(cur, old);
+
+        vst1q_s32(prev + i, old);
+        vst1q_s32(ema + i, cur);
+        vst1q_s32(roc + i, d);
+        vst1q_u32(flags + i, vorrq_u32(vld1q_u32(flags + i),
+                                       vandq_u32(vcgtq_s32(d, threshold), bit)));
+    }
+    return i;
+}
+#endif /* SS_SIMD_NEON */
+
+/* Name of the vector path smartsched_model_step_simd() takes here */
+static inline const char *smartsched_simd_name(void)
+{
+#if defined(SS_SIMD_AVX2)
+    return __builtin_cpu_supports("avx2") ? "avx2" : "scalar";
+#elif defined(SS_SIMD_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/* smartsched_model_step_batch() on the widest vectors available */
+static inline void smartsched_model_step_simd(const struct smartsched_model_params *p,
+                                              int res, int *ema, int *prev, int *roc,
+                                              const int *sample, __u32 *flags,
+                                              unsigned int n)
+{
+    unsigned int done = 0;
+
+#if defined(SS_SIMD_AVX2)
+    static int avx2 = -1;
+
+    if (avx2 < 0)
+        avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        done = ss_model_step_avx2(p, res, ema, prev, roc, sample, flags, n);
+#elif defined(SS_SIMD_NEON)
+    done = ss_model_step_neon(p, res, ema, prev, roc, sample, flags, n);
+#endif
+    smartsched_model_step_batch(p, res, ema + done, prev + done, roc + done,
+                                sample + done, flags + done, n - done);
+}
+
+#endif /* SMARTSCHED_MODEL_SIMD_H */
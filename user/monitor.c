@@ -12,8 +12,11 @@
  * - Advisory categorization
  * - Color-coded severity
  * - Export to CSV
+ * - Persistent /proc fds re-read with pread() each refresh
+ * - Persistence from the kernel's spike history (/dev/smartsched) when
+ *   mapped: how long each spike has run, not how many refreshes saw it
  *
- * Compile: gcc -o monitor monitor.c -Wall -O2
+ * Compile: gcc -o monitor monitor.c -Wall -O2 -I../kernel
  * Run: ./monitor [options]
  */
 
@@ -27,6 +30,10 @@
 #include <sys/sysinfo.h>
 #include <errno.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+#include "snapshot.h"
 
 #define PROC_STATUS      "/proc/smartscheduler/status"
 #define PROC_PREDICTIONS "/proc/smartscheduler/predictions"
@@ -34,7 +41,7 @@
 
 #define DEFAULT_INTERVAL_MS 1000
 #define MAX_LINE_LEN 1024
-#define MAX_PROCS 512
+#define MAX_PROCS 4096
 #define SPIKE_HISTORY_SIZE 10
 #define LOG_DIR "logs"
 
@@ -76,7 +83,7 @@ typedef struct {
     int has_cpu_spike;
     int has_mem_spike;
     int has_io_spike;
-    int spike_count;           /* How many consecutive samples with spike */
+    int spike_count;           /* Seconds spiking (kernel history), else samples seen */
     time_t first_spike_time;
     AlertLevel alert_level;
     long ram_kb;               /* RAM usage in KB */
@@ -126,74 +133,249 @@ int check_module_loaded(void) {
     return stat(PROC_STATUS, &st) == 0;
 }
 
-/* Get RAM usage for a specific PID */
-long get_pid_ram_kb(int pid) {
-    char path[64];
-    FILE *f;
-    char line[256];
-    long ram_kb = 0;
-    
-    snprintf(path, sizeof(path), "/proc/%d/status", pid);
-    f = fopen(path, "r");
-    if (!f) return 0;
-    
-    while (fgets(line, sizeof(line), f)) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line + 6, "%ld", &ram_kb);
-            break;
+/*
+ * Per-PID collector
+ *
+ * /proc/<pid>/stat and /proc/<pid>/statm stay open across frames and
+ * are re-read with pread(), so a steady-state refresh costs two reads
+ * per process and no opens. Entries not seen in a frame are closed by
+ * sweep_pid_fds(). Reads on an fd whose process has exited fail with
+ * ESRCH; the entry is then reopened once in case the PID was reused.
+ */
+typedef struct {
+    int pid;
+    int stat_fd;
+    int statm_fd;
+    unsigned long frame;            /* Last frame this entry was used */
+    unsigned long long ticks_prev;  /* utime + stime at the last read */
+    double uptime_prev;             /* /proc/uptime at the last read */
+} PidFds;
+
+/* Open-addressing PID -> array index map, rebuilt as arrays change */
+#define PID_INDEX_BITS  13
+#define PID_INDEX_SLOTS (1 << PID_INDEX_BITS)
+#define PID_INDEX_MASK  (PID_INDEX_SLOTS - 1)
+
+typedef struct {
+    int pid[PID_INDEX_SLOTS];       /* 0 = empty */
+    int idx[PID_INDEX_SLOTS];
+} PidIndex;
+
+static PidFds pid_fds[MAX_PROCS];
+static int pid_fds_count = 0;
+static int pid_fds_limit = MAX_PROCS;
+static PidIndex pid_fds_index;
+static PidIndex process_index;
+
+static unsigned long frame_no = 0;
+static double frame_uptime = 0;
+static int uptime_fd = -1;
+static long clk_tck = 100;
+static long page_kb = 4;
+
+static inline unsigned int pid_hash(int pid) {
+    return ((unsigned int)pid * 2654435761u) >> (32 - PID_INDEX_BITS);
+}
+
+void pid_index_clear(PidIndex *ix) {
+    memset(ix->pid, 0, sizeof(ix->pid));
+}
+
+void pid_index_add(PidIndex *ix, int pid, int idx) {
+    unsigned int s = pid_hash(pid);
+
+    while (ix->pid[s] && ix->pid[s] != pid)
+        s = (s + 1) & PID_INDEX_MASK;
+    ix->pid[s] = pid;
+    ix->idx[s] = idx;
+}
+
+/* Returns the stored index, or -1 */
+int pid_index_find(const PidIndex *ix, int pid) {
+    unsigned int s = pid_hash(pid);
+
+    while (ix->pid[s]) {
+        if (ix->pid[s] == pid)
+            return ix->idx[s];
+        s = (s + 1) & PID_INDEX_MASK;
+    }
+    return -1;
+}
+
+/* Size the fd cache to RLIMIT_NOFILE, raising the soft limit if allowed */
+void init_collector(void) {
+    struct rlimit rl;
+    rlim_t want = (rlim_t)MAX_PROCS * 2 + 64;
+
+    clk_tck = sysconf(_SC_CLK_TCK);
+    if (clk_tck <= 0) clk_tck = 100;
+    page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (page_kb <= 0) page_kb = 4;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < want) {
+            rl.rlim_cur = rl.rlim_max < want ? rl.rlim_max : want;
+            setrlimit(RLIMIT_NOFILE, &rl);
+            getrlimit(RLIMIT_NOFILE, &rl);
         }
+        if (rl.rlim_cur < want)
+            pid_fds_limit = rl.rlim_cur > 64 ? (int)((rl.rlim_cur - 64) / 2) : 0;
     }
-    fclose(f);
-    return ram_kb;
+
+    uptime_fd = open("/proc/uptime", O_RDONLY | O_CLOEXEC);
+    pid_index_clear(&pid_fds_index);
+}
+
+void close_pid_fds(PidFds *e) {
+    if (e->stat_fd >= 0) close(e->stat_fd);
+    if (e->statm_fd >= 0) close(e->statm_fd);
+    e->stat_fd = e->statm_fd = -1;
 }
 
-/* Get CPU usage percentage for a PID */
-float get_pid_cpu_percent(int pid) {
+int open_pid_fds(PidFds *e, int pid) {
     char path[64];
-    FILE *f;
-    unsigned long utime, stime, starttime;
-    long hertz = sysconf(_SC_CLK_TCK);
-    
+
     snprintf(path, sizeof(path), "/proc/%d/stat", pid);
-    f = fopen(path, "r");
-    if (!f) return 0.0;
-    
-    /* Skip to utime (field 14) and stime (field 15) */
+    e->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+    e->statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (e->stat_fd < 0 || e->statm_fd < 0) {
+        close_pid_fds(e);
+        return -1;
+    }
+    e->pid = pid;
+    e->ticks_prev = 0;
+    e->uptime_prev = 0;
+    return 0;
+}
+
+/* pread the whole file into buf; returns bytes read or -1 */
+ssize_t pread_text(int fd, char *buf, size_t size) {
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/* Read /proc/uptime once per frame */
+void begin_frame(void) {
+    char buf[64];
+
+    frame_no++;
+    if (uptime_fd >= 0 && pread_text(uptime_fd, buf, sizeof(buf)) > 0)
+        frame_uptime = strtod(buf, NULL);
+}
+
+/* Parse utime+stime and starttime out of /proc/<pid>/stat */
+int parse_stat(const char *buf, unsigned long long *ticks,
+               unsigned long long *starttime) {
+    /* comm may contain spaces and ')', fields resume after the last one */
+    const char *p = strrchr(buf, ')');
+    unsigned long long utime = 0, stime = 0;
+    int field = 2;
+
+    if (!p) return -1;
+    p++;
+    while (*p && field < 22) {
+        while (*p == ' ') p++;
+        field++;
+        if (field == 14)
+            utime = strtoull(p, NULL, 10);
+        else if (field == 15)
+            stime = strtoull(p, NULL, 10);
+        else if (field == 22)
+            *starttime = strtoull(p, NULL, 10);
+        while (*p && *p != ' ') p++;
+    }
+    if (field < 22) return -1;
+    *ticks = utime + stime;
+    return 0;
+}
+
+/* Fill p->ram_kb / p->cpu_percent from the persistent fds */
+int read_pid_fds(PidFds *e, ProcessInfo *p) {
     char buf[1024];
-    if (fgets(buf, sizeof(buf), f)) {
-        char *p = buf;
-        int field = 0;
-        while (*p && field < 13) {
-            if (*p == ' ') field++;
-            p++;
-        }
-        if (sscanf(p, "%lu %lu", &utime, &stime) == 2) {
-            /* Get system uptime */
-            FILE *upf = fopen("/proc/uptime", "r");
-            double uptime = 0;
-            if (upf) {
-                if (fscanf(upf, "%lf", &uptime) != 1) uptime = 1;
-                fclose(upf);
-            }
-            
-            /* Skip to starttime (field 22) */
-            field = 0;
-            while (*p && field < 8) {
-                if (*p == ' ') field++;
-                p++;
-            }
-            if (sscanf(p, "%lu", &starttime) == 1) {
-                double total_time = (utime + stime) / (double)hertz;
-                double seconds = uptime - (starttime / (double)hertz);
-                if (seconds > 0) {
-                    fclose(f);
-                    return (float)(100.0 * total_time / seconds);
-                }
-            }
+    unsigned long long ticks, starttime;
+    unsigned long size_pages, rss_pages;
+
+    if (pread_text(e->stat_fd, buf, sizeof(buf)) <= 0 ||
+        parse_stat(buf, &ticks, &starttime) < 0)
+        return -1;
+
+    if (e->uptime_prev > 0 && frame_uptime > e->uptime_prev &&
+        ticks >= e->ticks_prev) {
+        /* Usage over the last refresh */
+        p->cpu_percent = (float)(100.0 * (ticks - e->ticks_prev) / clk_tck /
+                                 (frame_uptime - e->uptime_prev));
+    } else {
+        /* First sight: lifetime average */
+        double seconds = frame_uptime - starttime / (double)clk_tck;
+        p->cpu_percent = seconds > 0 ?
+            (float)(100.0 * ticks / clk_tck / seconds) : 0.0f;
+    }
+    e->ticks_prev = ticks;
+    e->uptime_prev = frame_uptime;
+
+    if (pread_text(e->statm_fd, buf, sizeof(buf)) <= 0 ||
+        sscanf(buf, "%lu %lu", &size_pages, &rss_pages) != 2)
+        return -1;
+    p->ram_kb = (long)rss_pages * page_kb;
+    return 0;
+}
+
+/* Collect RAM and CPU% for one process */
+void collect_pid(ProcessInfo *p) {
+    int i = pid_index_find(&pid_fds_index, p->pid);
+    PidFds tmp, *e;
+
+    p->ram_kb = 0;
+    p->cpu_percent = 0.0f;
+
+    if (i >= 0) {
+        e = &pid_fds[i];
+        e->frame = frame_no;
+        if (read_pid_fds(e, p) == 0)
+            return;
+        /* Exited or PID reused: reopen once */
+        close_pid_fds(e);
+        if (open_pid_fds(e, p->pid) == 0)
+            read_pid_fds(e, p);
+        return;
+    }
+
+    if (pid_fds_count < pid_fds_limit) {
+        e = &pid_fds[pid_fds_count];
+        if (open_pid_fds(e, p->pid) < 0)
+            return;
+        e->frame = frame_no;
+        pid_index_add(&pid_fds_index, p->pid, pid_fds_count++);
+        read_pid_fds(e, p);
+        return;
+    }
+
+    /* Cache full: one-off read */
+    if (open_pid_fds(&tmp, p->pid) == 0) {
+        read_pid_fds(&tmp, p);
+        close_pid_fds(&tmp);
+    }
+}
+
+/* Close fds of processes that left the module's table this frame */
+void sweep_pid_fds(void) {
+    int w = 0;
+
+    pid_index_clear(&pid_fds_index);
+    for (int i = 0; i < pid_fds_count; i++) {
+        if (pid_fds[i].frame != frame_no || pid_fds[i].stat_fd < 0) {
+            close_pid_fds(&pid_fds[i]);
+            continue;
         }
+        if (w != i)
+            pid_fds[w] = pid_fds[i];
+        pid_index_add(&pid_fds_index, pid_fds[w].pid, w);
+        w++;
     }
-    fclose(f);
-    return 0.0;
+    pid_fds_count = w;
 }
 
 /* Get system memory info */
@@ -324,6 +506,45 @@ int is_persistent_spike(int pid) {
     return 0;
 }
 
+/*
+ * Persistent spikes from the snapshot's spike history: a process
+ * counts once a resource has been flagged on every tick for at least
+ * PERSISTENT_SECS, and spike_count is that time in seconds. Returns 0
+ * if the snapshot is unavailable, leaving update_spike_history() to
+ * count refreshes instead.
+ */
+#define PERSISTENT_SECS 5
+
+int read_kernel_history(void) {
+    ss_snapshot_t ss;
+    static struct smartsched_record recs[MAX_PROCS];
+    
+    /* Mapped per refresh only, so the monitor never holds the module */
+    if (ss_snapshot_open(&ss) < 0) return 0;
+    
+    int n = ss_snapshot_read(&ss, recs, MAX_PROCS, NULL);
+    unsigned long long now = ss.hdr->timestamp_ns;
+    ss_snapshot_close(&ss);
+    if (n < 0) return 0;
+    
+    for (int k = 0; k < n; k++) {
+        const struct smartsched_record *r = &recs[k];
+        unsigned long long first = 0;
+        
+        for (int res = SMARTSCHED_RES_CPU; res <= SMARTSCHED_RES_IO; res++) {
+            if (r->spike_since_ns[res] && (!first || r->spike_since_ns[res] < first))
+                first = r->spike_since_ns[res];
+        }
+        if (!first || now < first + PERSISTENT_SECS * 1000000000ULL) continue;
+        
+        int i = pid_index_find(&process_index, r->pid);
+        if (i < 0) continue;
+        processes[i].spike_count = (int)((now - first) / 1000000000ULL);
+        persistent_spike_count++;
+    }
+    return 1;
+}
+
 /* Clean old spike history entries */
 void clean_spike_history(void) {
     time_t now = time(NULL);
@@ -407,6 +628,8 @@ void read_process_stats(void) {
     
     char line[MAX_LINE_LEN];
     process_count = 0;
+    pid_index_clear(&process_index);
+    begin_frame();
     
     /* Skip header lines */
     for (int i = 0; i < 4; i++) {
@@ -421,14 +644,19 @@ void read_process_stats(void) {
                    &p->cpu_roc, &p->mem_roc, &p->io_roc) >= 7) {
             
             /* Get additional info */
-            p->ram_kb = get_pid_ram_kb(p->pid);
-            p->cpu_percent = get_pid_cpu_percent(p->pid);
+            p->comm[0] = '\0';
+            p->flags = 0;
+            p->has_cpu_spike = p->has_mem_spike = p->has_io_spike = 0;
+            p->spike_count = 0;
+            collect_pid(p);
             p->alert_level = calc_alert_level(p->cpu_roc, p->mem_roc, p->io_roc);
             
+            pid_index_add(&process_index, p->pid, process_count);
             process_count++;
         }
     }
     fclose(f);
+    sweep_pid_fds();
 }
 
 /* Read predictions and update process info */
@@ -441,6 +669,7 @@ void read_predictions(void) {
     total_mem_spikes = 0;
     total_io_spikes = 0;
     persistent_spike_count = 0;
+    int kernel_history = read_kernel_history();
     
     /* Skip header lines */
     for (int i = 0; i < 4; i++) {
@@ -456,34 +685,29 @@ void read_predictions(void) {
         if (sscanf(line, "%d %31s %c %c %c %x",
                    &pid, comm, &cpu_flag, &mem_flag, &io_flag, &flags) >= 5) {
             
-            /* Find matching process */
-            for (int i = 0; i < process_count; i++) {
-                if (processes[i].pid == pid) {
-                    strncpy(processes[i].comm, comm, 31);
-                    processes[i].flags = flags;
-                    processes[i].has_cpu_spike = (cpu_flag == '*');
-                    processes[i].has_mem_spike = (mem_flag == '*');
-                    processes[i].has_io_spike = (io_flag == '*');
-                    
-                    if (processes[i].has_cpu_spike) {
-                        total_cpu_spikes++;
-                        update_spike_history(pid, 1);
-                    }
-                    if (processes[i].has_mem_spike) {
-                        total_mem_spikes++;
-                        update_spike_history(pid, 2);
-                    }
-                    if (processes[i].has_io_spike) {
-                        total_io_spikes++;
-                        update_spike_history(pid, 4);
-                    }
-                    
-                    processes[i].spike_count = is_persistent_spike(pid);
-                    if (processes[i].spike_count > 0) {
-                        persistent_spike_count++;
-                    }
-                    break;
-                }
+            /* Join with the stats row by PID */
+            int i = pid_index_find(&process_index, pid);
+            if (i < 0) continue;
+
+            ProcessInfo *p = &processes[i];
+            snprintf(p->comm, sizeof(p->comm), "%s", comm);
+            p->flags = flags;
+            p->has_cpu_spike = (cpu_flag == '*');
+            p->has_mem_spike = (mem_flag == '*');
+            p->has_io_spike = (io_flag == '*');
+
+            total_cpu_spikes += p->has_cpu_spike;
+            total_mem_spikes += p->has_mem_spike;
+            total_io_spikes += p->has_io_spike;
+            if (kernel_history) continue;
+
+            if (p->has_cpu_spike) update_spike_history(pid, 1);
+            if (p->has_mem_spike) update_spike_history(pid, 2);
+            if (p->has_io_spike) update_spike_history(pid, 4);
+
+            p->spike_count = is_persistent_spike(pid);
+            if (p->spike_count > 0) {
+                persistent_spike_count++;
             }
         }
     }
@@ -798,6 +1022,7 @@ int main(int argc, char *argv[]) {
     
     /* Create logs directory */
     mkdir("logs", 0755);
+    init_collector();
     
     while (running) {
         if (!oneshot) {
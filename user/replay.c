@@ -0,0 +1,787 @@
+/*
+ * SmartScheduler Model Replay
+ *
+ * Drives the prediction model (kernel/smartsched_model.h, the same code
+ * the module runs) from a data_exporter .ssr recording, so ALPHA and
+ * the spike thresholds can be tuned offline:
+ * - Loads every block that carries raw samples into flat arrays once
+ * - Replays them through the model for each parameter combination
+ * - Scores predicted spikes against labelled spikes: precision,
+ *   recall and detection lead time
+ *
+ * A prediction is the rising edge of a resource's spike flag. It is a
+ * hit if it falls in a label's window, widened by the horizon (-H) on
+ * the early side; lead time is label start minus the first prediction
+ * in its window, so positive means the model fired before the spike.
+ *
+ * Labels come from a CSV file (-l, lines of pid,resource,start_ms,end_ms
+ * with resource cpu/mem/io and times relative to the recording start),
+ * or are derived from the recording (-L res:level): a spike is every
+ * run of raw samples at or above level. Without either, CPU samples at
+ * 50% of one CPU and above are labelled.
+ *
+ * Each process's model state is seeded from the first recorded row, so
+ * at the module's own parameters the replay reproduces the recorded
+ * EMAs exactly (-V checks this). Like the module, a process's CPU EMA
+ * restarts at its second sample, the first valid one. A block's rows
+ * are gathered into arrays and stepped together by the SIMD model
+ * (model_simd.h).
+ *
+ * With -F the rising edges of the trend forecast flags are scored
+ * instead, using the forecast parameters given by -b, -k and -N.
+ *
+ * Compile: gcc -o replay replay.c -Wall -O2 -I../kernel
+ * Run: ./replay [-a A[:B[:STEP]]] [-c ..] [-m ..] [-o ..] [-l FILE]
+ *               [-L RES:LEVEL] [-H MS] [-F] [-b B] [-k K] [-N TICKS]
+ *               [-r N] [-V] RECORDING.ssr
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "smartsched_model.h"
+#include "model_simd.h"
+#include "ssr_format.h"
+
+#define DEFAULT_HORIZON_MS   2000
+#define DEFAULT_CPU_LEVEL    5000       /* 50% of one CPU */
+#define MAX_SWEEP            64         /* Values per swept parameter */
+
+/* PID -> dense process id, open addressing */
+#define ID_BITS  16
+#define ID_SLOTS (1U << ID_BITS)
+#define ID_MASK  (ID_SLOTS - 1)
+
+#define COLOR_RESET   "\033[0m"
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_CYAN    "\033[36m"
+#define COLOR_BOLD    "\033[1m"
+
+static const char *res_names[SMARTSCHED_NR_RES] = { "cpu", "mem", "io" };
+
+/* ============================================
+ * TRACE
+ * ============================================ */
+
+/* Row kinds: a process's first row, and its second sample (first valid CPU) */
+#define ROW_FIRST     1
+#define ROW_SEED_CPU  2
+
+/*
+ * Structure-of-arrays copy of the recording: block b covers rows
+ * block_start[b] .. block_start[b + 1] - 1 and happened at block_ms[b].
+ */
+typedef struct {
+    uint32_t nr_blocks;
+    uint32_t *block_start;
+    uint32_t *block_ms;
+
+    uint32_t nr_rows;
+    uint32_t *id;
+    int32_t *sample[SMARTSCHED_NR_RES];
+    int32_t *ema[SMARTSCHED_NR_RES];       /* Recorded model output */
+    uint8_t *first;                        /* ROW_FIRST / ROW_SEED_CPU */
+
+    uint32_t nr_ids;
+    int *id_pid;                           /* Dense id -> pid */
+} Trace;
+
+typedef struct {
+    int pid;
+    int res;
+    uint32_t start_ms;
+    uint32_t end_ms;
+    int detected;
+    int32_t lead_ms;
+} Label;
+
+typedef struct {
+    int pid;
+    int res;
+    uint32_t ms;
+} Prediction;
+
+static Trace trace;
+
+static Label *labels;
+static size_t nr_labels, labels_cap;
+
+static Prediction *preds;
+static size_t nr_preds, preds_cap;
+
+static int verbose = 1;
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return p;
+    size_t cap2 = *cap ? *cap : 1024;
+    while (cap2 < need) cap2 *= 2;
+    void *np = realloc(p, cap2 * size);
+    if (!np) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    *cap = cap2;
+    return np;
+}
+
+static void add_label(int pid, int res, uint32_t start_ms, uint32_t end_ms) {
+    labels = grow(labels, &labels_cap, nr_labels + 1, sizeof(*labels));
+    labels[nr_labels++] = (Label){ .pid = pid, .res = res,
+                                   .start_ms = start_ms, .end_ms = end_ms };
+}
+
+/* Make room for need rows in every per-row array */
+static void reserve_rows(size_t need) {
+    static size_t cap;
+
+    if (need <= cap) return;
+    size_t n = cap ? cap : 65536;
+    while (n < need) n *= 2;
+
+    trace.id = realloc(trace.id, n * sizeof(*trace.id));
+    trace.first = realloc(trace.first, n * sizeof(*trace.first));
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        trace.sample[k] = realloc(trace.sample[k], n * sizeof(int32_t));
+        trace.ema[k] = realloc(trace.ema[k], n * sizeof(int32_t));
+        if (!trace.sample[k] || !trace.ema[k]) trace.id = NULL;
+    }
+    if (!trace.id || !trace.first) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    cap = n;
+}
+
+/*
+ * Read a recording into the trace. Rows without raw samples (procfs
+ * fallback) can't drive the model and are left out. A PID whose
+ * total_samples went backwards was reused and gets a new dense id.
+ */
+static int load_trace(const char *path) {
+    static uint32_t slot_id[ID_SLOTS];
+    static int slot_pid[ID_SLOTS];
+    static int64_t last_total[ID_SLOTS / 2];
+    size_t blocks_cap = 0, ms_cap = 0, ids_cap = 0;
+    unsigned long no_samples = 0;
+    ssr_reader_t r;
+    int n, ret;
+
+    ret = ssr_reader_open(&r, path);
+    if (ret < 0) {
+        if (ret == -EPROTO)
+            fprintf(stderr, "Error: %s is not a .ssr recording\n", path);
+        else
+            fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(-ret));
+        return -1;
+    }
+
+    while ((n = ssr_reader_next(&r)) >= 0) {
+        const ssr_row_t *rows = ssr_reader_rows(&r);
+
+        if (!(r.bh.flags & SSR_BLOCK_SAMPLES)) {
+            no_samples++;
+            continue;
+        }
+
+        trace.block_start = grow(trace.block_start, &blocks_cap,
+                                 trace.nr_blocks + 2, sizeof(uint32_t));
+        trace.block_ms = grow(trace.block_ms, &ms_cap,
+                              trace.nr_blocks + 1, sizeof(uint32_t));
+        trace.block_start[trace.nr_blocks] = trace.nr_rows;
+        trace.block_ms[trace.nr_blocks] = (uint32_t)(r.bh.offset_ns / 1000000ull);
+        trace.nr_blocks++;
+
+        reserve_rows((size_t)trace.nr_rows + n);
+
+        for (int i = 0; i < n; i++) {
+            const ssr_row_t *row = &rows[i];
+            unsigned int s = ((unsigned int)row->pid * 2654435761u) >> (32 - ID_BITS);
+            uint32_t row_no = trace.nr_rows++;
+
+            while (slot_pid[s] && slot_pid[s] != row->pid)
+                s = (s + 1) & ID_MASK;
+
+            int is_new = !slot_pid[s] ||
+                         row->v[SSR_COL_TOTAL_SAMPLES] < last_total[slot_id[s]];
+            if (is_new) {
+                if (trace.nr_ids == ID_SLOTS / 2) {
+                    fprintf(stderr, "Error: more than %u processes in recording\n",
+                            ID_SLOTS / 2);
+                    ssr_reader_close(&r);
+                    return -1;
+                }
+                trace.id_pid = grow(trace.id_pid, &ids_cap, trace.nr_ids + 1, sizeof(int));
+                slot_pid[s] = row->pid;
+                slot_id[s] = trace.nr_ids++;
+                trace.id_pid[slot_id[s]] = row->pid;
+            }
+            last_total[slot_id[s]] = row->v[SSR_COL_TOTAL_SAMPLES];
+
+            trace.id[row_no] = slot_id[s];
+            trace.first[row_no] = is_new ? ROW_FIRST :
+                                  row->v[SSR_COL_TOTAL_SAMPLES] == 2 ? ROW_SEED_CPU : 0;
+            trace.sample[SMARTSCHED_RES_CPU][row_no] = (int32_t)row->v[SSR_COL_CPU_SAMPLE];
+            trace.sample[SMARTSCHED_RES_MEM][row_no] = (int32_t)row->v[SSR_COL_MEM_SAMPLE];
+            trace.sample[SMARTSCHED_RES_IO][row_no] = (int32_t)row->v[SSR_COL_IO_SAMPLE];
+            trace.ema[SMARTSCHED_RES_CPU][row_no] = (int32_t)row->v[SSR_COL_CPU_EMA];
+            trace.ema[SMARTSCHED_RES_MEM][row_no] = (int32_t)row->v[SSR_COL_MEM_EMA];
+            trace.ema[SMARTSCHED_RES_IO][row_no] = (int32_t)row->v[SSR_COL_IO_EMA];
+        }
+    }
+    if (trace.block_start)
+        trace.block_start[trace.nr_blocks] = trace.nr_rows;
+
+    ret = n == -1 ? 0 : n;
+    if (ret == -ENOTSUP)
+        fprintf(stderr, "Error: recording is zstd-compressed; rebuild with -DHAVE_ZSTD\n");
+    else if (ret < 0)
+        fprintf(stderr, "Error: corrupt recording: %s\n", strerror(-ret));
+    if (no_samples)
+        fprintf(stderr, "Warning: %lu samples were recorded from procfs without raw "
+                "samples and are skipped\n", no_samples);
+    if (r.skipped)
+        fprintf(stderr, "Warning: %lu unreadable samples skipped\n", r.skipped);
+    if (r.truncated)
+        fprintf(stderr, "Warning: %lu samples were truncated by the recorder and "
+                "miss some processes\n", r.truncated);
+
+    ssr_reader_close(&r);
+    return ret < 0 ? -1 : 0;
+}
+
+/* ============================================
+ * LABELS
+ * ============================================ */
+
+static int parse_res(const char *s) {
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        if (strcmp(s, res_names[k]) == 0)
+            return k;
+    }
+    return -1;
+}
+
+static int load_labels(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[256], res[16];
+    int pid, lineno = 0;
+    unsigned int start, end;
+
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "%d , %15[a-z] , %u , %u", &pid, res, &start, &end) != 4 ||
+            parse_res(res) < 0 || end < start) {
+            /* Allow a header line */
+            if (lineno == 1) continue;
+            fprintf(stderr, "Error: %s:%d: expected pid,cpu|mem|io,start_ms,end_ms\n",
+                    path, lineno);
+            fclose(f);
+            return -1;
+        }
+        add_label(pid, parse_res(res), start, end);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Label every run of raw samples at or above level[res] */
+static void derive_labels(const int *level) {
+    uint32_t *run_start = calloc(trace.nr_ids, sizeof(uint32_t));
+    uint32_t *last_ms = calloc(trace.nr_ids, sizeof(uint32_t));
+    uint8_t *in_run = calloc(trace.nr_ids, sizeof(uint8_t));
+
+    if (!run_start || !last_ms || !in_run) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        if (level[k] <= 0) continue;
+        memset(in_run, 0, trace.nr_ids);
+
+        for (uint32_t b = 0; b < trace.nr_blocks; b++) {
+            uint32_t ms = trace.block_ms[b];
+            for (uint32_t i = trace.block_start[b]; i < trace.block_start[b + 1]; i++) {
+                uint32_t id = trace.id[i];
+                int high = trace.sample[k][i] >= level[k];
+
+                if (high && !in_run[id]) {
+                    in_run[id] = 1;
+                    run_start[id] = ms;
+                } else if (!high && in_run[id]) {
+                    in_run[id] = 0;
+                    add_label(trace.id_pid[id], k, run_start[id], last_ms[id]);
+                }
+                last_ms[id] = ms;
+            }
+        }
+        for (uint32_t id = 0; id < trace.nr_ids; id++) {
+            if (in_run[id])
+                add_label(trace.id_pid[id], k, run_start[id], last_ms[id]);
+        }
+    }
+
+    free(run_start);
+    free(last_ms);
+    free(in_run);
+}
+
+/* ============================================
+ * REPLAY
+ * ============================================ */
+
+typedef struct {
+    struct smartsched_model_params params;
+    size_t predictions;
+    size_t hits;
+    size_t detected;
+    double mean_lead_ms;
+    int32_t median_lead_ms;
+    double precision;
+    double recall;
+    double f1;
+} Result;
+
+/* Per-process model state, reused across runs */
+static int *st_ema[SMARTSCHED_NR_RES];
+static int *st_prev[SMARTSCHED_NR_RES];
+static int *st_roc[SMARTSCHED_NR_RES];
+static struct smartsched_forecast *st_fc[SMARTSCHED_NR_RES];
+static unsigned int *st_flags;
+
+/* Score forecast flags (-F) rather than spike flags */
+static int score_forecast = 0;
+
+/* One block's rows gathered for the batched model step */
+static uint32_t *bt_row;
+static int *bt_ema[SMARTSCHED_NR_RES];
+static int *bt_prev[SMARTSCHED_NR_RES];
+static int *bt_roc[SMARTSCHED_NR_RES];
+static int *bt_sample[SMARTSCHED_NR_RES];
+static __u32 *bt_flags;
+
+static int alloc_state(void) {
+    uint32_t rows = 0;
+
+    for (uint32_t b = 0; b < trace.nr_blocks; b++) {
+        if (trace.block_start[b + 1] - trace.block_start[b] > rows)
+            rows = trace.block_start[b + 1] - trace.block_start[b];
+    }
+
+    for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+        st_ema[k] = calloc(trace.nr_ids, sizeof(int));
+        st_prev[k] = calloc(trace.nr_ids, sizeof(int));
+        st_roc[k] = calloc(trace.nr_ids, sizeof(int));
+        st_fc[k] = calloc(trace.nr_ids, sizeof(struct smartsched_forecast));
+        if (!st_ema[k] || !st_prev[k] || !st_roc[k] || !st_fc[k]) return -1;
+
+        bt_ema[k] = calloc(rows + 1, sizeof(int));
+        bt_prev[k] = calloc(rows + 1, sizeof(int));
+        bt_roc[k] = calloc(rows + 1, sizeof(int));
+        bt_sample[k] = calloc(rows + 1, sizeof(int));
+        if (!bt_ema[k] || !bt_prev[k] || !bt_roc[k] || !bt_sample[k]) return -1;
+    }
+    bt_row = calloc(rows + 1, sizeof(uint32_t));
+    bt_flags = calloc(rows + 1, sizeof(__u32));
+    st_flags = calloc(trace.nr_ids, sizeof(unsigned int));
+    return st_flags && bt_row && bt_flags ? 0 : -1;
+}
+
+/*
+ * Run the whole trace through the model; predictions collect rising
+ * flag edges. Returns rows whose EMAs differ from the recording.
+ *
+ * Each block is one tick with a process at most once, so its rows are
+ * gathered, the EMA / RoC step runs over all of them per resource,
+ * and the state is scattered back before the forecasts and edges.
+ */
+static size_t run_model(const struct smartsched_model_params *p) {
+    size_t mismatches = 0;
+
+    nr_preds = 0;
+    for (uint32_t b = 0; b < trace.nr_blocks; b++) {
+        uint32_t ms = trace.block_ms[b];
+        uint32_t n = 0;
+
+        for (uint32_t i = trace.block_start[b]; i < trace.block_start[b + 1]; i++) {
+            uint32_t id = trace.id[i];
+
+            if (trace.first[i] == ROW_FIRST) {
+                /* Seed from what the module computed for this row */
+                for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+                    st_ema[k][id] = trace.ema[k][i];
+                    st_prev[k][id] = trace.ema[k][i];
+                    st_fc[k][id] = (struct smartsched_forecast){ .level = trace.sample[k][i] };
+                }
+                st_flags[id] = 0;
+                continue;
+            }
+            if (trace.first[i] == ROW_SEED_CPU)
+                st_ema[SMARTSCHED_RES_CPU][id] = trace.sample[SMARTSCHED_RES_CPU][i];
+            bt_row[n++] = i;
+        }
+        if (!n)
+            continue;
+
+        memset(bt_flags, 0, n * sizeof(*bt_flags));
+        for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+            for (uint32_t j = 0; j < n; j++) {
+                bt_ema[k][j] = st_ema[k][trace.id[bt_row[j]]];
+                bt_sample[k][j] = trace.sample[k][bt_row[j]];
+            }
+            smartsched_model_step_simd(p, k, bt_ema[k], bt_prev[k], bt_roc[k],
+                                       bt_sample[k], bt_flags, n);
+            for (uint32_t j = 0; j < n; j++) {
+                uint32_t id = trace.id[bt_row[j]];
+
+                st_ema[k][id] = bt_ema[k][j];
+                st_prev[k][id] = bt_prev[k][j];
+                st_roc[k][id] = bt_roc[k][j];
+                mismatches += bt_ema[k][j] != trace.ema[k][bt_row[j]];
+            }
+        }
+
+        for (uint32_t j = 0; j < n; j++) {
+            uint32_t i = bt_row[j], id = trace.id[i];
+            unsigned int flags = bt_flags[j];
+
+            if (score_forecast) {
+                flags = 0;
+                for (int k = 0; k < SMARTSCHED_NR_RES; k++) {
+                    unsigned int eta;
+
+                    flags |= smartsched_forecast_step(p, k, &st_fc[k][id],
+                                                      trace.sample[k][i], &eta);
+                }
+                flags >>= SMARTSCHED_FORECAST_SHIFT;
+            }
+
+            unsigned int rising = flags & ~st_flags[id];
+            st_flags[id] = flags;
+            while (rising) {
+                int k = __builtin_ctz(rising);
+                rising &= rising - 1;
+                preds = grow(preds, &preds_cap, nr_preds + 1, sizeof(*preds));
+                preds[nr_preds++] = (Prediction){ trace.id_pid[id], k, ms };
+            }
+        }
+    }
+    return mismatches;
+}
+
+static int cmp_pred(const void *a, const void *b) {
+    const Prediction *x = a, *y = b;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    if (x->res != y->res) return x->res - y->res;
+    return (x->ms > y->ms) - (x->ms < y->ms);
+}
+
+static int cmp_label(const void *a, const void *b) {
+    const Label *x = a, *y = b;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    if (x->res != y->res) return x->res - y->res;
+    return (x->start_ms > y->start_ms) - (x->start_ms < y->start_ms);
+}
+
+static int cmp_int32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Group key order shared by predictions and labels */
+static int key_cmp(int pid_a, int res_a, int pid_b, int res_b) {
+    if (pid_a != pid_b) return pid_a < pid_b ? -1 : 1;
+    return res_a - res_b;
+}
+
+/* Match sorted predictions against sorted labels */
+static void score(Result *res, uint32_t horizon_ms) {
+    static int32_t *leads;
+    static size_t leads_cap;
+    size_t li = 0, nleads = 0;
+    double lead_sum = 0;
+
+    qsort(preds, nr_preds, sizeof(*preds), cmp_pred);
+    for (size_t l = 0; l < nr_labels; l++)
+        labels[l].detected = 0;
+
+    res->predictions = nr_preds;
+    res->hits = 0;
+
+    for (size_t i = 0; i < nr_preds; i++) {
+        const Prediction *p = &preds[i];
+
+        /* Skip labels of earlier groups and labels that ended before p */
+        while (li < nr_labels &&
+               (key_cmp(labels[li].pid, labels[li].res, p->pid, p->res) < 0 ||
+                (key_cmp(labels[li].pid, labels[li].res, p->pid, p->res) == 0 &&
+                 labels[li].end_ms < p->ms)))
+            li++;
+
+        if (li < nr_labels &&
+            key_cmp(labels[li].pid, labels[li].res, p->pid, p->res) == 0 &&
+            p->ms + horizon_ms >= labels[li].start_ms) {
+            Label *l = &labels[li];
+            res->hits++;
+            if (!l->detected) {
+                l->detected = 1;
+                l->lead_ms = (int32_t)l->start_ms - (int32_t)p->ms;
+            }
+        }
+    }
+
+    res->detected = 0;
+    for (size_t l = 0; l < nr_labels; l++) {
+        if (!labels[l].detected) continue;
+        res->detected++;
+        leads = grow(leads, &leads_cap, nleads + 1, sizeof(*leads));
+        leads[nleads++] = labels[l].lead_ms;
+        lead_sum += labels[l].lead_ms;
+    }
+
+    res->precision = nr_preds ? (double)res->hits / nr_preds : 0.0;
+    res->recall = nr_labels ? (double)res->detected / nr_labels : 0.0;
+    res->f1 = res->precision + res->recall > 0 ?
+        2 * res->precision * res->recall / (res->precision + res->recall) : 0.0;
+    res->mean_lead_ms = nleads ? lead_sum / nleads : 0.0;
+    if (nleads) {
+        qsort(leads, nleads, sizeof(*leads), cmp_int32);
+        res->median_lead_ms = leads[nleads / 2];
+    } else {
+        res->median_lead_ms = 0;
+    }
+}
+
+/* ============================================
+ * CLI
+ * ============================================ */
+
+/* Parse A, A:B or A:B:STEP into values[]; returns the count or -1 */
+static int parse_range(const char *s, int *values) {
+    int a, b, step = 0, n = 0;
+    int got = sscanf(s, "%d:%d:%d", &a, &b, &step);
+
+    if (got < 1) return -1;
+    if (got == 1) b = a;
+    if (step <= 0) step = got == 3 ? 1 : (b > a ? (b - a) / 4 : 1);
+    if (step <= 0) step = 1;
+    if (b < a) return -1;
+
+    for (int v = a; v <= b && n < MAX_SWEEP; v += step)
+        values[n++] = v;
+    return n;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void usage(const char *prog) {
+    printf("SmartScheduler Model Replay\n\n");
+    printf("Usage: %s [options] RECORDING.ssr\n\n", prog);
+    printf("Record with: ./data_exporter record <ms> (needs /dev/smartsched)\n\n");
+    printf("Parameters (a value, A:B, or A:B:STEP to sweep):\n");
+    printf("  -a <alpha>   EMA alpha x100 (default: %d)\n", SMARTSCHED_DEFAULT_ALPHA);
+    printf("  -c <thresh>  CPU spike threshold (default: %d)\n", SMARTSCHED_DEFAULT_CPU_THRESH);
+    printf("  -m <thresh>  Memory spike threshold (default: %d)\n", SMARTSCHED_DEFAULT_MEM_THRESH);
+    printf("  -o <thresh>  I/O spike threshold (default: %d)\n", SMARTSCHED_DEFAULT_IO_THRESH);
+    printf("\nScoring:\n");
+    printf("  -l <file>    Labelled spikes: pid,cpu|mem|io,start_ms,end_ms\n");
+    printf("  -L <r:lvl>   Label runs of raw samples >= lvl for resource r\n");
+    printf("               (repeatable; default cpu:%d when no -l is given)\n",
+           DEFAULT_CPU_LEVEL);
+    printf("  -H <ms>      Early-detection horizon (default: %d)\n", DEFAULT_HORIZON_MS);
+    printf("  -F           Score the trend forecast flags instead of the spike flags\n");
+    printf("\nForecast (-F, single values):\n");
+    printf("  -b <beta>    Trend smoothing x100 (default: %d)\n", SMARTSCHED_DEFAULT_BETA);
+    printf("  -k <k>       Rise in sigma x100 (default: %d)\n", SMARTSCHED_DEFAULT_SIGMA_K);
+    printf("  -N <ticks>   Ticks looked ahead, 1..%d (default: %d)\n",
+           SMARTSCHED_MAX_HORIZON, SMARTSCHED_DEFAULT_HORIZON);
+    printf("\nOther:\n");
+    printf("  -r <n>       Repeat each run n times for timing (default: 1)\n");
+    printf("  -V           Check the model reproduces the recorded EMAs\n");
+    printf("  -q           Only print the best combination\n");
+    printf("  -h           Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    int alphas[MAX_SWEEP] = { SMARTSCHED_DEFAULT_ALPHA };
+    int thresh[SMARTSCHED_NR_RES][MAX_SWEEP] = {
+        { SMARTSCHED_DEFAULT_CPU_THRESH },
+        { SMARTSCHED_DEFAULT_MEM_THRESH },
+        { SMARTSCHED_DEFAULT_IO_THRESH },
+    };
+    int nr_alpha = 1, nr_thresh[SMARTSCHED_NR_RES] = { 1, 1, 1 };
+    int level[SMARTSCHED_NR_RES] = { 0 };
+    int have_level = 0, repeat = 1, verify = 0;
+    uint32_t horizon_ms = DEFAULT_HORIZON_MS;
+    const char *label_file = NULL;
+    struct smartsched_model_params fc_params = SMARTSCHED_MODEL_DEFAULTS;
+    int opt, k;
+
+    while ((opt = getopt(argc, argv, "a:c:m:o:l:L:H:Fb:k:N:r:Vqh")) != -1) {
+        switch (opt) {
+            case 'a':
+                nr_alpha = parse_range(optarg, alphas);
+                if (nr_alpha < 1 || alphas[0] < 1 || alphas[nr_alpha - 1] > 100) {
+                    fprintf(stderr, "Error: alpha must be within 1..100\n");
+                    return 1;
+                }
+                break;
+            case 'c':
+            case 'm':
+            case 'o':
+                k = opt == 'c' ? SMARTSCHED_RES_CPU :
+                    opt == 'm' ? SMARTSCHED_RES_MEM : SMARTSCHED_RES_IO;
+                nr_thresh[k] = parse_range(optarg, thresh[k]);
+                if (nr_thresh[k] < 1) {
+                    fprintf(stderr, "Error: bad threshold range '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l': label_file = optarg; break;
+            case 'L': {
+                char name[16];
+                int lvl;
+                if (sscanf(optarg, "%15[a-z]:%d", name, &lvl) != 2 ||
+                    (k = parse_res(name)) < 0) {
+                    fprintf(stderr, "Error: -L expects cpu|mem|io:LEVEL\n");
+                    return 1;
+                }
+                level[k] = lvl;
+                have_level = 1;
+                break;
+            }
+            case 'H': horizon_ms = (uint32_t)atoi(optarg); break;
+            case 'F': score_forecast = 1; break;
+            case 'b':
+                fc_params.beta = atoi(optarg);
+                if (fc_params.beta < 0 || fc_params.beta > 100) {
+                    fprintf(stderr, "Error: beta must be within 0..100\n");
+                    return 1;
+                }
+                break;
+            case 'k': fc_params.sigma_k = atoi(optarg); break;
+            case 'N':
+                fc_params.horizon = atoi(optarg);
+                if (fc_params.horizon < 1 || fc_params.horizon > SMARTSCHED_MAX_HORIZON) {
+                    fprintf(stderr, "Error: -N must be within 1..%d\n", SMARTSCHED_MAX_HORIZON);
+                    return 1;
+                }
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                if (repeat < 1) repeat = 1;
+                break;
+            case 'V': verify = 1; break;
+            case 'q': verbose = 0; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    double t0 = now_sec();
+    if (load_trace(argv[optind]) < 0)
+        return 1;
+    if (trace.nr_rows == 0) {
+        fprintf(stderr, "Error: no replayable samples in %s\n", argv[optind]);
+        return 1;
+    }
+    if (alloc_state() < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    if (label_file && load_labels(label_file) < 0)
+        return 1;
+    if (!label_file && !have_level)
+        level[SMARTSCHED_RES_CPU] = DEFAULT_CPU_LEVEL;
+    derive_labels(level);
+    qsort(labels, nr_labels, sizeof(*labels), cmp_label);
+
+    printf("%sLoaded%s %u samples, %u rows, %u processes, %zu labels in %.2fs\n",
+           COLOR_CYAN, COLOR_RESET, trace.nr_blocks, trace.nr_rows,
+           trace.nr_ids, nr_labels, now_sec() - t0);
+
+    if (verify) {
+        struct smartsched_model_params p = SMARTSCHED_MODEL_DEFAULTS;
+        size_t bad = run_model(&p);
+        printf("Model check at defaults: %s%zu%s of %u row EMAs differ from the recording\n",
+               bad ? COLOR_RED : COLOR_GREEN, bad, COLOR_RESET,
+               trace.nr_rows * SMARTSCHED_NR_RES);
+    }
+
+    if (verbose)
+        printf("\n%s%5s %6s %6s %6s | %8s %7s | %7s %7s | %6s %9s %9s%s\n",
+               COLOR_BOLD, "ALPHA", "CPU", "MEM", "IO", "PREDICT", "PREC",
+               "DETECT", "RECALL", "F1", "LEAD_AVG", "LEAD_P50", COLOR_RESET);
+
+    Result best = { .f1 = -1 };
+    uint64_t rows_run = 0;
+    double run_time = 0;
+
+    for (int a = 0; a < nr_alpha; a++)
+    for (int c = 0; c < nr_thresh[SMARTSCHED_RES_CPU]; c++)
+    for (int m = 0; m < nr_thresh[SMARTSCHED_RES_MEM]; m++)
+    for (int o = 0; o < nr_thresh[SMARTSCHED_RES_IO]; o++) {
+        Result res = {
+            .params = {
+                .alpha = alphas[a],
+                .threshold = {
+                    [SMARTSCHED_RES_CPU] = thresh[SMARTSCHED_RES_CPU][c],
+                    [SMARTSCHED_RES_MEM] = thresh[SMARTSCHED_RES_MEM][m],
+                    [SMARTSCHED_RES_IO] = thresh[SMARTSCHED_RES_IO][o],
+                },
+                .beta = fc_params.beta,
+                .sigma_k = fc_params.sigma_k,
+                .horizon = fc_params.horizon,
+            },
+        };
+
+        double start = now_sec();
+        for (int i = 0; i < repeat; i++)
+            run_model(&res.params);
+        run_time += now_sec() - start;
+        rows_run += (uint64_t)trace.nr_rows * repeat;
+
+        score(&res, horizon_ms);
+        if (res.f1 > best.f1)
+            best = res;
+
+        if (verbose)
+            printf("%5d %6d %6d %6d | %8zu %6.1f%% | %7zu %6.1f%% | %6.3f %7.0fms %7dms\n",
+                   res.params.alpha, res.params.threshold[0], res.params.threshold[1],
+                   res.params.threshold[2], res.predictions, res.precision * 100,
+                   res.detected, res.recall * 100, res.f1,
+                   res.mean_lead_ms, res.median_lead_ms);
+    }
+
+    printf("\n%sBest F1%s: alpha=%d cpu=%d mem=%d io=%d  "
+           "precision=%.1f%% recall=%.1f%% f1=%.3f lead=%.0fms\n",
+           COLOR_GREEN, COLOR_RESET, best.params.alpha,
+           best.params.threshold[0], best.params.threshold[1], best.params.threshold[2],
+           best.precision * 100, best.recall * 100, best.f1, best.mean_lead_ms);
+    printf("Replay speed: %.1f M samples/s (%llu rows in %.3fs)\n",
+           run_time > 0 ? rows_run / run_time / 1e6 : 0.0,
+           (unsigned long long)rows_run, run_time);
+    return 0;
+}
@@ -10,6 +10,27 @@
  * - Statistics and reporting
  * - Action logging with timestamps
  * - Escalation levels
+ * - Event-driven: sleeps in epoll on /proc/smartscheduler/events
+ *   and reacts within one sampling tick (polls procfs on old modules)
+ * - PID-hashed tracking table, actions batched once per tick and
+ *   applied with direct syscalls / file writes (no fork+exec)
+ * - With the module's thread_mode, CPU events name the hot thread's
+ *   TID, so nice/ionice land on that thread alone
+ * - Cgroup mode (-g): acts on whole cgroups from
+ *   /proc/smartscheduler/cgroups with one cpu.weight / io.weight write
+ * - Throttle mode (-t): instead of boosting anything, a control loop
+ *   caps the offending cgroup's cpu.max / memory.high / io.max near its
+ *   current usage on a spike or a forecast one, tightening with the
+ *   escalation level, and relaxes then restores the original limits
+ *   once it has been quiet
+ * - Escalation follows the kernel's per-tick spike history carried by
+ *   each event (flagged ticks in the last 64), so it does not depend
+ *   on how often the daemon gets to read. Events mark only a spike's
+ *   start and end; spikes the module holds are re-read from the
+ *   snapshot once a second to escalate
+ * - Warm restart: the tracking table is saved on exit and taken over
+ *   by the next run for processes still alive, keeping cooldowns,
+ *   escalation and the original nice values to restore
  *
  * Compile: gcc -o scheduler_daemon scheduler_daemon.c -Wall -O2
  * Run: sudo ./scheduler_daemon
@@ -24,16 +45,62 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <stdint.h>
+
+#include "smartsched_abi.h"
+#include "snapshot.h"
 
 #define PROC_PREDICTIONS "/proc/smartscheduler/predictions"
 #define PROC_STATS       "/proc/smartscheduler/stats"
+#define PROC_CGROUPS     "/proc/smartscheduler/cgroups"
+#define CGROUP_ROOT      "/sys/fs/cgroup"
 #define LOG_FILE         "logs/daemon_actions.log"
 #define REPORT_FILE      "logs/daemon_report.txt"
+#define STATE_DIR        "/run/smartscheduler"
+#define STATE_FILE       STATE_DIR "/daemon.state"
+#define BOOT_ID_PATH     "/proc/sys/kernel/random/boot_id"
+#define STATE_MAGIC      0x54534453   /* "SDST" */
+#define STATE_VERSION    1
 #define CHECK_INTERVAL_MS 500
 #define PERSISTENT_CHECK_INTERVAL 5  /* Check every 5 seconds */
+#define HOUSEKEEPING_MS   1000        /* Restore/persistent checks while idle */
+#define EVENT_BATCH       256
+#define HELD_SPIKES_MAX   1024        /* Held spikes re-dispatched per pass */
 #define MAX_LINE 256
 #define MAX_TRACKED 1024
+#define TRACK_BITS  11            /* 2048 slots: load factor <= 50% */
+#define TRACK_SLOTS (1 << TRACK_BITS)
+#define TRACK_MASK  (TRACK_SLOTS - 1)
+#define SLOT_EMPTY  0
+#define SLOT_DEAD   (-1)          /* Tombstone, reusable by inserts */
+#define STALE_SECS  30            /* Unadjusted entries idle this long are dropped */
+#define MAX_PENDING 256           /* Actions queued per tick */
+#define MAX_CGROUPS 256
+#define CGROUP_CHECK_MS   500
+#define CGROUP_WEIGHT_DEFAULT 100 /* cpu.weight / io.weight default */
+#define RESTORE_SECS      5       /* Quiet time before undoing an adjustment */
+
+/* Throttle mode control loop */
+#define THROTTLE_ENGAGE_READS 3       /* Consecutive hot cgroup reads before limiting */
+#define THROTTLE_STEP_SECS    2       /* Minimum time between writes to one limit */
+#define THROTTLE_RELEASE_SECS 10      /* Quiet time before relaxing a limit */
+#define THROTTLE_RELAX_STEPS  3       /* x1.5 steps, then the original is restored */
+#define THROTTLE_MAX_WRITES   8       /* Limit writes per cgroup pass, all cgroups */
+#define THROTTLE_CPU_FLOOR    1000    /* Lowest cap: 10% of one CPU (CPU % x100) */
+#define THROTTLE_MEM_FLOOR    (64LL << 20)  /* Lowest memory.high, bytes */
+#define THROTTLE_IO_FLOOR     (1LL << 20)   /* Lowest io.max rbps / wbps */
+#define THROTTLE_MAX_DEVS     8       /* Block devices limited per cgroup */
+#define THROTTLE_IO_STALE_SECS 5      /* Older io.stat reads only restart the rates */
+#define LIMIT_MAX             (-1LL)  /* "max" in cpu.max / memory.high / io.max */
+
+/* ioprio_set(2), see linux/ioprio.h */
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
 
 /* ANSI colors */
 #define COLOR_RESET   "\033[0m"
@@ -88,20 +155,106 @@ typedef struct {
     time_t adjusted_time;
     time_t last_seen;
     int spike_type;
-    int spike_samples;        /* Consecutive spike samples */
+    int spike_samples;        /* Flagged ticks: kernel history, or polls seen flagged */
+    int history_ticks[3];     /* Per SMARTSCHED_RES_*, from the latest event */
+    uint64_t spike_since_ns[3]; /* CLOCK_MONOTONIC start of each current spike, 0 = none */
     EscalationLevel escalation;
     int action_count;         /* Total actions taken */
+    int queued;               /* ACT_* bits waiting in pending[] */
 } TrackedProcess;
 
+/* One block device of a throttled cgroup's io.max */
+typedef struct {
+    unsigned int major, minor;  /* 0:0 = free */
+    int seen;                   /* rbytes / wbytes hold a previous io.stat read */
+    unsigned long long rbytes, wbytes;
+    long long orig_rbps, orig_wbps;  /* Before the first limit, LIMIT_MAX if none */
+    long long rbps, wbps;       /* Written, LIMIT_MAX if none */
+} ThrottleDev;
+
+/* Control state of one resource of a cgroup (throttle mode) */
+typedef struct {
+    int hot;                    /* Consecutive reads flagged or forecast */
+    int engaged;                /* A limit of ours is in place */
+    int relax_steps;            /* Taken since the resource went quiet */
+    long long limit;            /* cpu.max quota (us) or memory.high (bytes) */
+    long long orig;             /* Same, before the first limit; LIMIT_MAX if none */
+    time_t last_hot;
+    time_t last_write;
+} Throttle;
+
+/* Per-cgroup tracking (cgroup mode) */
+typedef struct {
+    unsigned long long id;    /* cgroup id from the kernel, 0 = free slot */
+    char path[128];           /* Relative to CGROUP_ROOT */
+    int nr_tasks;
+    int spike_type;
+    int spike_samples;
+    EscalationLevel escalation;
+    int orig_cpu_weight;      /* 0 until first adjusted */
+    int cur_cpu_weight;
+    int orig_io_weight;
+    int cur_io_weight;
+    time_t adjusted_time;
+    time_t last_flagged;
+    time_t last_listed;
+    Throttle thr[3];          /* Per SMARTSCHED_RES_*, throttle mode */
+    long long cpu_period;     /* cpu.max period (us) */
+    ThrottleDev dev[THROTTLE_MAX_DEVS];
+    struct timespec io_read;  /* When dev[] byte counts were read */
+} TrackedCgroup;
+
+/* Tracking table saved across restarts, see save_state() */
+typedef struct {
+    uint32_t magic;           /* STATE_MAGIC */
+    uint16_t version;
+    uint16_t entry_size;      /* sizeof(SavedProcess) */
+    uint32_t count;
+    uint32_t reserved;
+    char boot_id[40];
+} StateHeader;
+
+typedef struct {
+    unsigned long long start_time;  /* /proc/<pid>/stat starttime, tells reused PIDs apart */
+    TrackedProcess p;
+} SavedProcess;
+
+/* Action kinds, also bits of TrackedProcess.queued */
+#define ACT_NICE    0x01
+#define ACT_IOPRIO  0x02
+#define ACT_OOM     0x04
+
+/* Action decided while handling spikes, applied at the end of the tick */
+typedef struct {
+    int kind;                 /* ACT_* */
+    int pid;
+    int value;                /* Nice value, ioprio class, or oom_score_adj */
+    int level;                /* ioprio level */
+    EscalationLevel escalation;
+    int roc;
+} PendingAction;
+
 /* Global state */
-static TrackedProcess tracked[MAX_TRACKED];
-static int tracked_count = 0;
+static TrackedProcess tracked[TRACK_SLOTS];   /* Open addressing by PID */
+static int tracked_count = 0;                /* Live entries */
+static int tracked_dead = 0;                 /* Tombstones */
+static int tracked_total = 0;                /* Entries ever created */
+static PendingAction pending[MAX_PENDING];
+static int pending_count = 0;
 static volatile int running = 1;
 static FILE *log_file = NULL;
 static int verbose = 1;
 static int dry_run = 0;
 static time_t last_persistent_check = 0;
 static time_t daemon_start_time;
+static int event_epfd = -1;
+static int event_fd = -1;
+static int held_sync_due = 1;               /* Re-read held spikes now (start, overrun) */
+static int cgroup_mode = 0;
+static int throttle_mode = 0;
+static int throttle_writes = 0;             /* This cgroup pass */
+static int fresh_start = 0;                 /* -F: ignore the saved state */
+static TrackedCgroup cgroups[MAX_CGROUPS];  /* Small: linear search by id */
 
 /* Statistics */
 static struct {
@@ -114,6 +267,12 @@ static struct {
     int restorations;
     int escalations;
     int persistent_spikes;
+    int actions_dropped;
+    int cgroup_cpu_actions;
+    int cgroup_io_actions;
+    int cgroup_restorations;
+    int cgroup_throttles[3];  /* Limit writes per SMARTSCHED_RES_* */
+    int cgroup_releases;      /* Limits restored to their original */
 } stats = {0};
 
 /* Spike configurations */
@@ -164,29 +323,220 @@ void log_action(const char *category, const char *action, int pid,
     }
 }
 
+/* ============================================
+ * TRACKING TABLE
+ * ============================================ */
+
+static inline unsigned int track_hash(int pid) {
+    return ((unsigned int)pid * 0x9E3779B1u) >> (32 - TRACK_BITS);
+}
+
 /* Find tracked process by PID */
 TrackedProcess* find_tracked(int pid) {
-    for (int i = 0; i < tracked_count; i++) {
-        if (tracked[i].pid == pid) {
-            return &tracked[i];
-        }
+    unsigned int h = track_hash(pid);
+    
+    for (int n = 0; n < TRACK_SLOTS; n++, h = (h + 1) & TRACK_MASK) {
+        if (tracked[h].pid == pid) return &tracked[h];
+        if (tracked[h].pid == SLOT_EMPTY) break;
     }
     return NULL;
 }
 
+/* Drop an entry, leaving a tombstone so probe chains stay intact */
+void remove_tracked(TrackedProcess *p) {
+    p->pid = SLOT_DEAD;
+    tracked_count--;
+    tracked_dead++;
+}
+
+/* Rebuild the table without tombstones */
+void rehash_tracked(void) {
+    static TrackedProcess old[TRACK_SLOTS];
+    
+    memcpy(old, tracked, sizeof(tracked));
+    memset(tracked, 0, sizeof(tracked));
+    tracked_dead = 0;
+    
+    for (int i = 0; i < TRACK_SLOTS; i++) {
+        if (old[i].pid <= 0) continue;
+        unsigned int h = track_hash(old[i].pid);
+        while (tracked[h].pid != SLOT_EMPTY) h = (h + 1) & TRACK_MASK;
+        tracked[h] = old[i];
+    }
+}
+
+/*
+ * Forget entries nobody needs: exited processes, and processes we
+ * never adjusted that have not spiked for STALE_SECS
+ */
+void expire_tracked(time_t now) {
+    for (int i = 0; i < TRACK_SLOTS; i++) {
+        TrackedProcess *p = &tracked[i];
+        
+        if (p->pid <= 0 || p->queued) continue;
+        if (kill(p->pid, 0) < 0 && errno == ESRCH) {
+            remove_tracked(p);
+        } else if (!p->adjusted && now - p->last_seen > STALE_SECS) {
+            remove_tracked(p);
+        }
+    }
+    
+    if (tracked_dead > TRACK_SLOTS / 4) rehash_tracked();
+}
+
 /* Add process to tracking */
 TrackedProcess* add_tracked(int pid, const char *comm) {
     if (tracked_count >= MAX_TRACKED) {
-        return NULL;
+        expire_tracked(time(NULL));
+        if (tracked_count >= MAX_TRACKED) return NULL;
+    }
+    
+    /* Reuse the first tombstone on the probe path, else the empty slot */
+    unsigned int h = track_hash(pid);
+    TrackedProcess *slot = NULL;
+    for (int n = 0; n < TRACK_SLOTS; n++, h = (h + 1) & TRACK_MASK) {
+        if (tracked[h].pid == SLOT_DEAD && !slot) slot = &tracked[h];
+        if (tracked[h].pid == SLOT_EMPTY) {
+            if (!slot) slot = &tracked[h];
+            break;
+        }
     }
-    TrackedProcess *p = &tracked[tracked_count++];
+    if (!slot) return NULL;
+    
+    if (slot->pid == SLOT_DEAD) tracked_dead--;
+    TrackedProcess *p = slot;
     memset(p, 0, sizeof(*p));
     p->pid = pid;
     strncpy(p->comm, comm, sizeof(p->comm) - 1);
     p->last_seen = time(NULL);
+    tracked_count++;
+    tracked_total++;
     return p;
 }
 
+/* ============================================
+ * STATE PERSISTENCE
+ * ============================================ */
+
+/* Start time of a process or thread in clock ticks since boot, 0 if gone */
+unsigned long long proc_start_time(int pid) {
+    char path[64], buf[1024];
+    unsigned long long start = 0;
+    
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    
+    /* comm may hold spaces and ')': fields resume after the last one; starttime is 22 */
+    char *s = strrchr(buf, ')');
+    for (int field = 3; s && field <= 22; field++) {
+        s = strchr(s, ' ');
+        if (s) s++;
+    }
+    if (!s || sscanf(s, "%llu", &start) != 1) return 0;
+    return start;
+}
+
+void read_boot_id(char *id, size_t size) {
+    memset(id, 0, size);
+    FILE *f = fopen(BOOT_ID_PATH, "r");
+    if (!f) return;
+    if (fgets(id, (int)size, f)) id[strcspn(id, "\n")] = '\0';
+    fclose(f);
+}
+
+/*
+ * Save the tracking table for the next run, so a restart (e.g. after
+ * a module reload closed the event stream) neither forgets the nice
+ * values it has to restore nor acts afresh on every process it was
+ * already handling. Entries are tied to the process start time.
+ * Cgroups are restored on exit and need no state.
+ */
+void save_state(void) {
+    static SavedProcess out[MAX_TRACKED];
+    StateHeader h = { .magic = STATE_MAGIC, .version = STATE_VERSION,
+                      .entry_size = sizeof(SavedProcess) };
+    int n = 0;
+    
+    if (dry_run) return;
+    
+    for (int i = 0; i < TRACK_SLOTS && n < MAX_TRACKED; i++) {
+        const TrackedProcess *p = &tracked[i];
+        if (p->pid <= 0) continue;
+        
+        unsigned long long start = proc_start_time(p->pid);
+        if (!start) continue;
+        out[n].start_time = start;
+        out[n].p = *p;
+        out[n].p.queued = 0;
+        n++;
+    }
+    h.count = n;
+    read_boot_id(h.boot_id, sizeof(h.boot_id));
+    
+    /* Written aside and renamed, so the next run never reads half a table */
+    mkdir(STATE_DIR, 0755);
+    FILE *f = fopen(STATE_FILE ".tmp", "wb");
+    if (!f) return;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(out, sizeof(out[0]), n, f) == (size_t)n;
+    if (fclose(f) != 0 || !ok || rename(STATE_FILE ".tmp", STATE_FILE) < 0) {
+        unlink(STATE_FILE ".tmp");
+        return;
+    }
+    
+    if (verbose) printf("Tracking state saved: %d processes (%s)\n", n, STATE_FILE);
+}
+
+/*
+ * Take over the table saved by the previous run, for the processes
+ * still running under the same PID and start time. The file is
+ * consumed: after a crash, an older one must not be applied again.
+ */
+void load_state(void) {
+    StateHeader h;
+    SavedProcess s;
+    char boot_id[40];
+    int restored = 0, adjusted = 0;
+    
+    if (dry_run) return;
+    
+    FILE *f = fopen(STATE_FILE, "rb");
+    if (!f) return;
+    
+    read_boot_id(boot_id, sizeof(boot_id));
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != STATE_MAGIC ||
+        h.version != STATE_VERSION || h.entry_size != sizeof(SavedProcess) ||
+        strncmp(h.boot_id, boot_id, sizeof(boot_id)) != 0) {
+        fclose(f);
+        unlink(STATE_FILE);
+        return;
+    }
+    
+    for (uint32_t i = 0; i < h.count && fread(&s, sizeof(s), 1, f) == 1; i++) {
+        if (s.p.pid <= 0 || find_tracked(s.p.pid) ||
+            proc_start_time(s.p.pid) != s.start_time)
+            continue;
+        
+        TrackedProcess *p = add_tracked(s.p.pid, s.p.comm);
+        if (!p) break;
+        *p = s.p;
+        p->queued = 0;
+        restored++;
+        adjusted += p->adjusted != 0;
+    }
+    fclose(f);
+    unlink(STATE_FILE);
+    
+    char details[128];
+    snprintf(details, sizeof(details), "%d of %u processes taken over, %d adjusted",
+             restored, h.count, adjusted);
+    log_action("STATE", "Warm restart", 0, "daemon", details);
+}
+
 /* Get process nice value */
 int get_nice(int pid) {
     errno = 0;
@@ -216,21 +566,81 @@ ActionResult set_io_priority(int pid, int ioprio_class, int ioprio_level,
         return ACTION_SUCCESS;
     }
     
-    char cmd[128];
-    snprintf(cmd, sizeof(cmd), "ionice -c %d -n %d -p %d 2>/dev/null",
-             ioprio_class, ioprio_level, pid);
-    if (system(cmd) == 0) {
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid,
+                IOPRIO_PRIO_VALUE(ioprio_class, ioprio_level)) == 0) {
         return ACTION_SUCCESS;
     }
     return ACTION_FAILED;
 }
 
+/* Set OOM score adjustment */
+ActionResult set_oom_score_adj(int pid, int score, const char *comm, const char *reason) {
+    if (dry_run) {
+        log_action("DRY-RUN", "Would set oom_score_adj", pid, comm, reason);
+        return ACTION_SUCCESS;
+    }
+    
+    char path[64], buf[16];
+    snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", pid);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return ACTION_FAILED;
+    
+    int len = snprintf(buf, sizeof(buf), "%d", score);
+    ssize_t ret = write(fd, buf, len);
+    close(fd);
+    return ret == len ? ACTION_SUCCESS : ACTION_FAILED;
+}
+
+/* Determine escalation level from consecutive spike samples */
+EscalationLevel escalation_for_samples(int spike_samples) {
+    if (spike_samples <= 2) return ESCALATION_ADVISORY;
+    if (spike_samples <= 5) return ESCALATION_SOFT;
+    if (spike_samples <= 10) return ESCALATION_HARD;
+    return ESCALATION_CRITICAL;
+}
+
 /* Determine escalation level based on spike history */
 EscalationLevel get_escalation_level(TrackedProcess *p) {
-    if (p->spike_samples <= 2) return ESCALATION_ADVISORY;
-    if (p->spike_samples <= 5) return ESCALATION_SOFT;
-    if (p->spike_samples <= 10) return ESCALATION_HARD;
-    return ESCALATION_CRITICAL;
+    return escalation_for_samples(p->spike_samples);
+}
+
+/*
+ * Count a flagged tick of resource res. An event's history (non-zero
+ * while flagged) gives the exact number of flagged ticks in the
+ * kernel's window, the busiest resource setting spike_samples; polled
+ * procfs rows carry none and are tallied here instead.
+ */
+void count_spike(TrackedProcess *p, int res, uint64_t history, uint64_t since_ns) {
+    p->spike_type |= 1 << res;
+    p->last_seen = time(NULL);
+    
+    if (!history) {
+        p->spike_samples++;
+        return;
+    }
+    
+    p->history_ticks[res] = smartsched_history_ticks(history);
+    p->spike_since_ns[res] = since_ns;
+    p->spike_samples = 0;
+    for (int r = 0; r < 3; r++) {
+        if (p->history_ticks[r] > p->spike_samples) p->spike_samples = p->history_ticks[r];
+    }
+}
+
+/* Seconds the longest current spike of p has lasted, 0 if unknown */
+double spike_age_secs(const TrackedProcess *p) {
+    struct timespec ts;
+    uint64_t first = 0;
+    
+    for (int r = 0; r < 3; r++) {
+        if (p->spike_since_ns[r] && (!first || p->spike_since_ns[r] < first))
+            first = p->spike_since_ns[r];
+    }
+    if (!first) return 0;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    return now > first ? (now - first) / 1e9 : 0;
 }
 
 /* Get escalation string */
@@ -244,8 +654,103 @@ const char* escalation_str(EscalationLevel level) {
     }
 }
 
+/* ============================================
+ * BATCHED ACTIONS
+ * ============================================ */
+
+/*
+ * Queue an action for the end of the tick
+ * A second action of the same kind for the same process in one tick
+ * replaces the first, so a burst of events costs one syscall.
+ */
+void queue_action(TrackedProcess *p, int kind, int value, int level,
+                  EscalationLevel escalation, int roc) {
+    PendingAction *a = NULL;
+    
+    if (p->queued & kind) {
+        for (int i = 0; i < pending_count; i++) {
+            if (pending[i].pid == p->pid && pending[i].kind == kind) {
+                a = &pending[i];
+                break;
+            }
+        }
+    }
+    if (!a) {
+        if (pending_count >= MAX_PENDING) {
+            stats.actions_dropped++;
+            return;
+        }
+        a = &pending[pending_count++];
+        p->queued |= kind;
+    }
+    
+    a->kind = kind;
+    a->pid = p->pid;
+    a->value = value;
+    a->level = level;
+    a->escalation = escalation;
+    a->roc = roc;
+}
+
+/* Apply everything queued this tick */
+void apply_actions(void) {
+    time_t now = time(NULL);
+    char details[256];
+    
+    for (int i = 0; i < pending_count; i++) {
+        PendingAction *a = &pending[i];
+        TrackedProcess *p = find_tracked(a->pid);
+        if (!p) continue;
+        p->queued &= ~a->kind;
+        
+        switch (a->kind) {
+        case ACT_NICE:
+            snprintf(details, sizeof(details),
+                     "Boosting priority: nice %d -> %d (level=%s, ROC=%d)",
+                     p->current_nice, a->value, escalation_str(a->escalation), a->roc);
+            if (set_nice(p->pid, a->value, p->comm, details) == ACTION_SUCCESS) {
+                p->current_nice = a->value;
+                p->adjusted = 1;
+                p->adjusted_time = now;
+                p->escalation = a->escalation;
+                p->action_count++;
+                stats.cpu_boosts++;
+                if (a->escalation >= ESCALATION_HARD) {
+                    stats.escalations++;
+                }
+                log_action("CPU", "BOOST", p->pid, p->comm, details);
+            }
+            break;
+        
+        case ACT_IOPRIO:
+            snprintf(details, sizeof(details),
+                     "Setting I/O priority: class=%d level=%d (level=%s)",
+                     a->value, a->level, escalation_str(a->escalation));
+            if (set_io_priority(p->pid, a->value, a->level, p->comm, details) == ACTION_SUCCESS) {
+                p->adjusted = 1;
+                p->adjusted_time = now;
+                p->action_count++;
+                stats.io_boosts++;
+                log_action("I/O", "BOOST", p->pid, p->comm, details);
+            }
+            break;
+        
+        case ACT_OOM:
+            snprintf(details, sizeof(details),
+                     "Set OOM score to %d (more likely to be killed)", a->value);
+            if (set_oom_score_adj(p->pid, a->value, p->comm, details) == ACTION_SUCCESS) {
+                p->action_count++;
+                log_action("MEM", "OOM_SCORE", p->pid, p->comm, details);
+            }
+            break;
+        }
+    }
+    pending_count = 0;
+}
+
 /* Handle CPU spike with categorization */
-void handle_cpu_spike(int pid, const char *comm, int roc) {
+void handle_cpu_spike(int pid, const char *comm, int roc,
+                      uint64_t history, uint64_t since_ns) {
     TrackedProcess *p = find_tracked(pid);
     time_t now = time(NULL);
     
@@ -255,9 +760,7 @@ void handle_cpu_spike(int pid, const char *comm, int roc) {
         p->original_nice = get_nice(pid);
     }
     
-    p->spike_type |= SPIKE_CPU;
-    p->spike_samples++;
-    p->last_seen = now;
+    count_spike(p, SMARTSCHED_RES_CPU, history, since_ns);
     
     EscalationLevel level = get_escalation_level(p);
     char details[256];
@@ -271,6 +774,9 @@ void handle_cpu_spike(int pid, const char *comm, int roc) {
         return;
     }
     
+    /* Cgroup mode adjusts the process's cgroup instead */
+    if (cgroup_mode) return;
+    
     /* Check cooldown */
     if (p->adjusted && (now - p->adjusted_time) < spike_configs[0].cooldown_secs) {
         return; /* Still in cooldown */
@@ -285,39 +791,20 @@ void handle_cpu_spike(int pid, const char *comm, int roc) {
         nice_boost = -15;  /* Maximum boost for critical */
     }
     
-    snprintf(details, sizeof(details), 
-             "Boosting priority: nice %d -> %d (level=%s, ROC=%d)",
-             p->current_nice, nice_boost, escalation_str(level), roc);
-    
-    if (set_nice(pid, nice_boost, comm, details) == ACTION_SUCCESS) {
-        p->current_nice = nice_boost;
-        p->adjusted = 1;
-        p->adjusted_time = now;
-        p->escalation = level;
-        p->action_count++;
-        stats.cpu_boosts++;
-        
-        if (level >= ESCALATION_HARD) {
-            stats.escalations++;
-        }
-        
-        log_action("CPU", "BOOST", pid, comm, details);
-    }
+    queue_action(p, ACT_NICE, nice_boost, 0, level, roc);
 }
 
 /* Handle Memory spike with categorization */
-void handle_mem_spike(int pid, const char *comm, int roc) {
+void handle_mem_spike(int pid, const char *comm, int roc,
+                      uint64_t history, uint64_t since_ns) {
     TrackedProcess *p = find_tracked(pid);
-    time_t now = time(NULL);
     
     if (!p) {
         p = add_tracked(pid, comm);
         if (!p) return;
     }
     
-    p->spike_type |= SPIKE_MEM;
-    p->spike_samples++;
-    p->last_seen = now;
+    count_spike(p, SMARTSCHED_RES_MEM, history, since_ns);
     
     EscalationLevel level = get_escalation_level(p);
     char details[256];
@@ -342,20 +829,19 @@ void handle_mem_spike(int pid, const char *comm, int roc) {
         stats.mem_actions++;
         stats.persistent_spikes++;
         
-        /* For critical, we could add OOM score adjustment */
-        if (level >= ESCALATION_CRITICAL && !dry_run) {
-            char cmd[128];
-            snprintf(cmd, sizeof(cmd), 
-                     "echo 500 > /proc/%d/oom_score_adj 2>/dev/null", pid);
-            system(cmd);
-            log_action("MEM", "OOM_SCORE", pid, comm, 
-                      "Set OOM score to 500 (more likely to be killed)");
+        /* Cgroup mode adjusts the process's cgroup instead */
+        if (cgroup_mode) return;
+        
+        /* For critical, make the process the preferred OOM victim */
+        if (level >= ESCALATION_CRITICAL) {
+            queue_action(p, ACT_OOM, 500, 0, level, roc);
         }
     }
 }
 
 /* Handle I/O spike with categorization */
-void handle_io_spike(int pid, const char *comm, int roc) {
+void handle_io_spike(int pid, const char *comm, int roc,
+                     uint64_t history, uint64_t since_ns) {
     TrackedProcess *p = find_tracked(pid);
     time_t now = time(NULL);
     
@@ -364,9 +850,7 @@ void handle_io_spike(int pid, const char *comm, int roc) {
         if (!p) return;
     }
     
-    p->spike_type |= SPIKE_IO;
-    p->spike_samples++;
-    p->last_seen = now;
+    count_spike(p, SMARTSCHED_RES_IO, history, since_ns);
     
     EscalationLevel level = get_escalation_level(p);
     char details[256];
@@ -379,6 +863,8 @@ void handle_io_spike(int pid, const char *comm, int roc) {
         return;
     }
     
+    if (cgroup_mode) return;
+    
     /* Check cooldown */
     if (p->adjusted && (now - p->adjusted_time) < spike_configs[2].cooldown_secs) {
         return;
@@ -393,28 +879,19 @@ void handle_io_spike(int pid, const char *comm, int roc) {
         io_level = 4;
     }
     
-    snprintf(details, sizeof(details),
-             "Setting I/O priority: class=%d level=%d (level=%s)",
-             io_class, io_level, escalation_str(level));
-    
-    if (set_io_priority(pid, io_class, io_level, comm, details) == ACTION_SUCCESS) {
-        p->adjusted = 1;
-        p->adjusted_time = now;
-        p->action_count++;
-        stats.io_boosts++;
-        log_action("I/O", "BOOST", pid, comm, details);
-    }
+    queue_action(p, ACT_IOPRIO, io_class, io_level, level, 0);
 }
 
 /* Restore original priorities */
 void restore_priorities(void) {
     time_t now = time(NULL);
     
-    for (int i = 0; i < tracked_count; i++) {
+    for (int i = 0; i < TRACK_SLOTS; i++) {
         TrackedProcess *p = &tracked[i];
+        if (p->pid <= 0) continue;
         
         /* If not seen for 5+ seconds and was adjusted, restore */
-        if (p->adjusted && (now - p->last_seen) > 5) {
+        if (p->adjusted && (now - p->last_seen) > RESTORE_SECS) {
             char details[128];
             snprintf(details, sizeof(details),
                      "Restoring priority: nice %d -> %d (no spike for %lds)",
@@ -425,6 +902,7 @@ void restore_priorities(void) {
                 p->adjusted = 0;
                 p->current_nice = p->original_nice;
                 p->spike_samples = 0;
+                memset(p->history_ticks, 0, sizeof(p->history_ticks));
                 p->escalation = ESCALATION_NONE;
                 stats.restorations++;
             }
@@ -440,19 +918,21 @@ void check_persistent_spikes(void) {
         return;
     }
     last_persistent_check = now;
+    expire_tracked(now);
     
     printf("\n%s=== Persistent Spike Check ===%s\n", COLOR_YELLOW, COLOR_RESET);
     
     int persistent = 0;
-    for (int i = 0; i < tracked_count; i++) {
+    for (int i = 0; i < TRACK_SLOTS; i++) {
         TrackedProcess *p = &tracked[i];
+        if (p->pid <= 0) continue;
         
         if (p->spike_samples >= 5 && (now - p->last_seen) < 2) {
             persistent++;
             
-            printf("  %s⚠ PID %d (%s)%s: %d samples, type=%s%s%s, level=%s\n",
+            printf("  %s⚠ PID %d (%s)%s: %d samples (%.1fs), type=%s%s%s, level=%s\n",
                    COLOR_RED, p->pid, p->comm, COLOR_RESET,
-                   p->spike_samples,
+                   p->spike_samples, spike_age_secs(p),
                    (p->spike_type & SPIKE_CPU) ? "CPU " : "",
                    (p->spike_type & SPIKE_MEM) ? "MEM " : "",
                    (p->spike_type & SPIKE_IO) ? "I/O " : "",
@@ -528,21 +1008,782 @@ void process_predictions(void) {
             read_roc_values(&cpu_roc, &mem_roc, &io_roc, pid);
             
             if (cpu_flag == '*') {
-                handle_cpu_spike(pid, comm, cpu_roc);
+                handle_cpu_spike(pid, comm, cpu_roc, 0, 0);
             }
             if (mem_flag == '*') {
-                handle_mem_spike(pid, comm, mem_roc);
+                handle_mem_spike(pid, comm, mem_roc, 0, 0);
             }
             if (io_flag == '*') {
-                handle_io_spike(pid, comm, io_roc);
+                handle_io_spike(pid, comm, io_roc, 0, 0);
             }
         }
     }
     
     fclose(f);
+    apply_actions();
     restore_priorities();
 }
 
+/* ============================================
+ * CGROUP MODE
+ * ============================================ */
+
+/* Log a cgroup-level action */
+void log_cgroup_action(const char *category, const char *action,
+                       const TrackedCgroup *cg, const char *details) {
+    if (verbose) {
+        printf("%s[%s]%s %s[%s]%s %s CGROUP %s (%d tasks): %s\n",
+               COLOR_CYAN, get_time_str(), COLOR_RESET,
+               COLOR_BLUE, category, COLOR_RESET,
+               action, cg->path, cg->nr_tasks, details);
+    }
+    
+    if (log_file) {
+        fprintf(log_file, "[%s] [%s] %s CGROUP %s (%d tasks): %s\n",
+                get_time_str(), category, action, cg->path, cg->nr_tasks, details);
+        fflush(log_file);
+    }
+}
+
+/* Read a cgroup interface file; returns its length, or -1 */
+int read_cgroup_file(const TrackedCgroup *cg, const char *file, char *buf, size_t size) {
+    char path[256];
+    
+    snprintf(path, sizeof(path), CGROUP_ROOT "%s/%s", cg->path, file);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0) return -1;
+    buf[len] = '\0';
+    return (int)len;
+}
+
+/* Write one value to a cgroup interface file with a single write() */
+ActionResult write_cgroup_file(const TrackedCgroup *cg, const char *file, const char *value) {
+    char path[256];
+    char details[128];
+    
+    if (dry_run) {
+        snprintf(details, sizeof(details), "Would write %s: %s", file, value);
+        log_cgroup_action("DRY-RUN", file, cg, details);
+        return ACTION_SUCCESS;
+    }
+    
+    snprintf(path, sizeof(path), CGROUP_ROOT "%s/%s", cg->path, file);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return ACTION_FAILED;
+    
+    ssize_t len = strlen(value);
+    ssize_t ret = write(fd, value, len);
+    close(fd);
+    return ret == len ? ACTION_SUCCESS : ACTION_FAILED;
+}
+
+/*
+ * Read a cgroup weight file: "N" for cpu.weight, "default N" first
+ * for io.weight. Returns the default weight if it cannot be read.
+ */
+int read_cgroup_weight(const TrackedCgroup *cg, const char *file) {
+    char buf[64];
+    int weight = CGROUP_WEIGHT_DEFAULT;
+    
+    if (read_cgroup_file(cg, file, buf, sizeof(buf)) <= 0) return weight;
+    if (sscanf(buf, "default %d", &weight) != 1) sscanf(buf, "%d", &weight);
+    return weight;
+}
+
+/* Write a weight in the file's own format */
+ActionResult write_cgroup_weight(const TrackedCgroup *cg, const char *file, int weight) {
+    char buf[32];
+    
+    if (strcmp(file, "io.weight") == 0)
+        snprintf(buf, sizeof(buf), "default %d", weight);
+    else
+        snprintf(buf, sizeof(buf), "%d", weight);
+    return write_cgroup_file(cg, file, buf);
+}
+
+/* Weight for an escalation level, mirroring the per-process nice boosts */
+int cgroup_weight_for(EscalationLevel level) {
+    if (level >= ESCALATION_CRITICAL) return 800;
+    if (level >= ESCALATION_HARD) return 400;
+    return 200;
+}
+
+TrackedCgroup* find_cgroup(unsigned long long id) {
+    TrackedCgroup *free_slot = NULL;
+    
+    for (int i = 0; i < MAX_CGROUPS; i++) {
+        if (cgroups[i].id == id) return &cgroups[i];
+        if (!cgroups[i].id && !free_slot) free_slot = &cgroups[i];
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->id = id;
+    }
+    return free_slot;
+}
+
+/* Raise one weight if the level calls for more than is set */
+void boost_cgroup(TrackedCgroup *cg, const char *file, int *orig, int *cur,
+                  const char *category, int *counter) {
+    int weight = cgroup_weight_for(cg->escalation);
+    char details[128];
+    
+    if (weight == *cur) return;
+    if (!*orig) *orig = *cur = read_cgroup_weight(cg, file);
+    if (weight <= *orig) return;
+    
+    snprintf(details, sizeof(details), "Setting %s: %d -> %d (level=%s)",
+             file, *cur, weight, escalation_str(cg->escalation));
+    if (write_cgroup_weight(cg, file, weight) == ACTION_SUCCESS) {
+        *cur = weight;
+        cg->adjusted_time = time(NULL);
+        (*counter)++;
+        log_cgroup_action(category, "BOOST", cg, details);
+    }
+}
+
+/* Put a cgroup's weights back once it has been quiet for RESTORE_SECS */
+void restore_cgroup(TrackedCgroup *cg) {
+    char details[128];
+    int restored = 0;
+    
+    if (cg->orig_cpu_weight && cg->cur_cpu_weight != cg->orig_cpu_weight &&
+        write_cgroup_weight(cg, "cpu.weight", cg->orig_cpu_weight) == ACTION_SUCCESS) {
+        cg->cur_cpu_weight = cg->orig_cpu_weight;
+        restored = 1;
+    }
+    if (cg->orig_io_weight && cg->cur_io_weight != cg->orig_io_weight &&
+        write_cgroup_weight(cg, "io.weight", cg->orig_io_weight) == ACTION_SUCCESS) {
+        cg->cur_io_weight = cg->orig_io_weight;
+        restored = 1;
+    }
+    
+    if (restored) {
+        snprintf(details, sizeof(details), "Restored cpu.weight=%d io.weight=%d",
+                 cg->cur_cpu_weight, cg->cur_io_weight);
+        log_cgroup_action("RESTORE", "WEIGHT", cg, details);
+        stats.cgroup_restorations++;
+    }
+    cg->escalation = ESCALATION_NONE;
+}
+
+/* Apply one flagged cgroup row */
+void handle_cgroup_spike(TrackedCgroup *cg, int flags, int cpu_roc, int mem_roc, int io_roc) {
+    time_t now = time(NULL);
+    char details[128];
+    
+    cg->spike_type = flags & (SPIKE_CPU | SPIKE_MEM | SPIKE_IO);
+    cg->spike_samples++;
+    cg->last_flagged = now;
+    cg->escalation = escalation_for_samples(cg->spike_samples);
+    
+    if (cg->escalation == ESCALATION_ADVISORY) {
+        snprintf(details, sizeof(details), "Monitoring (type=%s%s%s ROC=%d/%d/%d)",
+                 (flags & SPIKE_CPU) ? "CPU " : "", (flags & SPIKE_MEM) ? "MEM " : "",
+                 (flags & SPIKE_IO) ? "I/O " : "", cpu_roc, mem_roc, io_roc);
+        log_cgroup_action("CGROUP", "ADVISORY", cg, details);
+        return;
+    }
+    
+    /* Throttle mode limits the cgroup in throttle_cgroup() instead */
+    if (throttle_mode) return;
+    
+    if (flags & SPIKE_MEM) {
+        snprintf(details, sizeof(details),
+                 "Memory growth (ROC=%d, samples=%d) - Consider memory.high",
+                 mem_roc, cg->spike_samples);
+        log_cgroup_action("MEM", "WARNING", cg, details);
+    }
+    
+    if (cg->adjusted_time && now - cg->adjusted_time < spike_configs[0].cooldown_secs) {
+        return;
+    }
+    
+    if (flags & SPIKE_CPU) {
+        boost_cgroup(cg, "cpu.weight", &cg->orig_cpu_weight, &cg->cur_cpu_weight,
+                     "CPU", &stats.cgroup_cpu_actions);
+    }
+    if (flags & SPIKE_IO) {
+        boost_cgroup(cg, "io.weight", &cg->orig_io_weight, &cg->cur_io_weight,
+                     "I/O", &stats.cgroup_io_actions);
+    }
+}
+
+/* ============================================
+ * THROTTLE MODE
+ * ============================================ */
+
+/*
+ * Limit as a percentage of current usage: forecast only, then spikes
+ * at SOFT (or ADVISORY) / HARD / CRITICAL. memory.high stays close to
+ * usage, as below it every allocation goes to direct reclaim.
+ */
+static const int throttle_pct[3][4] = {
+    [SMARTSCHED_RES_CPU] = { 110, 100, 85, 70 },
+    [SMARTSCHED_RES_MEM] = { 110, 105, 100, 95 },
+    [SMARTSCHED_RES_IO]  = { 110, 100, 80, 60 },
+};
+
+static const char *throttle_file[3] = { "cpu.max", "memory.high", "io.max" };
+static const char *throttle_category[3] = { "CPU", "MEM", "I/O" };
+
+/* "max" or a number, as in cpu.max / memory.high / io.max */
+long long parse_limit(const char *s) {
+    return strncmp(s, "max", 3) == 0 ? LIMIT_MAX : atoll(s);
+}
+
+void format_limit(char *buf, size_t size, long long v) {
+    if (v == LIMIT_MAX) snprintf(buf, size, "max");
+    else snprintf(buf, size, "%lld", v);
+}
+
+/* min() for limits, LIMIT_MAX being the largest */
+static inline long long limit_min(long long a, long long b) {
+    if (a == LIMIT_MAX) return b;
+    if (b == LIMIT_MAX) return a;
+    return a < b ? a : b;
+}
+
+int throttle_pct_for(const TrackedCgroup *cg, int res, unsigned int flags) {
+    if (!(flags & (1u << res))) return throttle_pct[res][0];
+    if (cg->escalation >= ESCALATION_CRITICAL) return throttle_pct[res][3];
+    if (cg->escalation >= ESCALATION_HARD) return throttle_pct[res][2];
+    return throttle_pct[res][1];
+}
+
+ThrottleDev* find_throttle_dev(TrackedCgroup *cg, unsigned int major, unsigned int minor) {
+    for (int i = 0; i < THROTTLE_MAX_DEVS; i++) {
+        ThrottleDev *d = &cg->dev[i];
+        if (d->major == major && d->minor == minor) return d;
+        if (!d->major && !d->minor) {
+            memset(d, 0, sizeof(*d));
+            d->major = major;
+            d->minor = minor;
+            d->orig_rbps = d->orig_wbps = d->rbps = d->wbps = LIMIT_MAX;
+            return d;
+        }
+    }
+    return NULL;
+}
+
+/* Write one device's rbps / wbps; the other io.max keys are left alone */
+ActionResult write_io_max(const TrackedCgroup *cg, const ThrottleDev *d,
+                          long long rbps, long long wbps) {
+    char buf[96], r[24], w[24];
+    
+    format_limit(r, sizeof(r), rbps);
+    format_limit(w, sizeof(w), wbps);
+    snprintf(buf, sizeof(buf), "%u:%u rbps=%s wbps=%s", d->major, d->minor, r, w);
+    return write_cgroup_file(cg, "io.max", buf);
+}
+
+/* Record the original limits of a resource before its first write */
+void throttle_save_original(TrackedCgroup *cg, int res) {
+    Throttle *t = &cg->thr[res];
+    char buf[1024];
+    
+    t->orig = LIMIT_MAX;
+    if (res == SMARTSCHED_RES_CPU) {
+        cg->cpu_period = 100000;
+        if (read_cgroup_file(cg, "cpu.max", buf, sizeof(buf)) > 0) {
+            t->orig = parse_limit(buf);
+            sscanf(buf, "%*s %lld", &cg->cpu_period);
+        }
+    } else if (res == SMARTSCHED_RES_MEM) {
+        if (read_cgroup_file(cg, "memory.high", buf, sizeof(buf)) > 0)
+            t->orig = parse_limit(buf);
+    } else if (read_cgroup_file(cg, "io.max", buf, sizeof(buf)) > 0) {
+        /* "MAJ:MIN rbps=N wbps=N riops=N wiops=N" per limited device */
+        for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+            unsigned int major, minor;
+            if (sscanf(line, "%u:%u", &major, &minor) != 2) continue;
+            ThrottleDev *d = find_throttle_dev(cg, major, minor);
+            if (!d) continue;
+            char *r = strstr(line, "rbps="), *w = strstr(line, "wbps=");
+            d->orig_rbps = d->rbps = r ? parse_limit(r + 5) : LIMIT_MAX;
+            d->orig_wbps = d->wbps = w ? parse_limit(w + 5) : LIMIT_MAX;
+        }
+    }
+    t->limit = t->orig;
+}
+
+/*
+ * Read the cgroup's io.stat into dev[] and fill each device's read /
+ * write bytes per second since the previous read. Returns the seconds
+ * since that read, or 0 if there was none recent enough to measure.
+ */
+double throttle_read_io(TrackedCgroup *cg, long long *rrate, long long *wrate) {
+    char buf[4096];
+    struct timespec ts;
+    double dt = 0;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (cg->io_read.tv_sec)
+        dt = (ts.tv_sec - cg->io_read.tv_sec) + (ts.tv_nsec - cg->io_read.tv_nsec) / 1e9;
+    if (dt > THROTTLE_IO_STALE_SECS) dt = 0;   /* Would average over the quiet time */
+    cg->io_read = ts;
+    
+    for (int i = 0; i < THROTTLE_MAX_DEVS; i++) rrate[i] = wrate[i] = 0;
+    if (read_cgroup_file(cg, "io.stat", buf, sizeof(buf)) <= 0) return 0;
+    
+    /* "MAJ:MIN rbytes=N wbytes=N rios=N wios=N ..." per device */
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        unsigned int major, minor;
+        if (sscanf(line, "%u:%u", &major, &minor) != 2) continue;
+        ThrottleDev *d = find_throttle_dev(cg, major, minor);
+        if (!d) continue;
+        
+        char *r = strstr(line, "rbytes="), *w = strstr(line, "wbytes=");
+        unsigned long long rb = r ? strtoull(r + 7, NULL, 10) : 0;
+        unsigned long long wb = w ? strtoull(w + 7, NULL, 10) : 0;
+        int i = d - cg->dev;
+        
+        if (d->seen && dt > 0) {
+            rrate[i] = rb > d->rbytes ? (long long)((rb - d->rbytes) / dt) : 0;
+            wrate[i] = wb > d->wbytes ? (long long)((wb - d->wbytes) / dt) : 0;
+        }
+        d->rbytes = rb;
+        d->wbytes = wb;
+        d->seen = 1;
+    }
+    return dt;
+}
+
+/* pct% of a measured byte rate, at least THROTTLE_IO_FLOOR */
+static inline long long io_cap(long long rate, int pct) {
+    long long cap = rate / 100 * pct;
+    return cap > THROTTLE_IO_FLOOR ? cap : THROTTLE_IO_FLOOR;
+}
+
+/* Lower the limit of one resource to pct% of current usage, never raising it */
+void throttle_tighten(TrackedCgroup *cg, int res, int pct, int cpu_ema, time_t now) {
+    Throttle *t = &cg->thr[res];
+    char buf[96], details[192];
+    long long limit;
+    int written = 0;
+    
+    if (!t->engaged) throttle_save_original(cg, res);
+    
+    if (res == SMARTSCHED_RES_CPU) {
+        /* CPU EMA is CPU % x100: 10000 = one CPU for the whole period */
+        long long cap = (long long)cpu_ema * pct / 100;
+        if (cap < THROTTLE_CPU_FLOOR) cap = THROTTLE_CPU_FLOOR;
+        limit = limit_min(t->limit, cap * cg->cpu_period / 10000);
+        if (limit < 1000) limit = 1000;   /* cpu.max quota minimum, us */
+        if (limit == t->limit) return;
+        snprintf(buf, sizeof(buf), "%lld %lld", limit, cg->cpu_period);
+        snprintf(details, sizeof(details), "cpu.max -> %s (%d%% of %d.%02d%% CPU, level=%s)",
+                 buf, pct, cpu_ema / 100, cpu_ema % 100, escalation_str(cg->escalation));
+        written = write_cgroup_file(cg, "cpu.max", buf) == ACTION_SUCCESS;
+    } else if (res == SMARTSCHED_RES_MEM) {
+        if (read_cgroup_file(cg, "memory.current", buf, sizeof(buf)) <= 0) return;
+        long long cap = atoll(buf) / 100 * pct;
+        if (cap < THROTTLE_MEM_FLOOR) cap = THROTTLE_MEM_FLOOR;
+        limit = limit_min(t->limit, cap);
+        if (limit == t->limit) return;
+        snprintf(buf, sizeof(buf), "%lld", limit);
+        snprintf(details, sizeof(details), "memory.high -> %lld MB (%d%% of usage, level=%s)",
+                 limit >> 20, pct, escalation_str(cg->escalation));
+        written = write_cgroup_file(cg, "memory.high", buf) == ACTION_SUCCESS;
+    } else {
+        long long rrate[THROTTLE_MAX_DEVS], wrate[THROTTLE_MAX_DEVS];
+        
+        /* The first read only sets the baseline for the rates */
+        if (throttle_read_io(cg, rrate, wrate) <= 0) return;
+        for (int i = 0; i < THROTTLE_MAX_DEVS; i++) {
+            ThrottleDev *d = &cg->dev[i];
+            if (!rrate[i] && !wrate[i]) continue;
+            
+            long long rbps = rrate[i] ? limit_min(d->rbps, io_cap(rrate[i], pct)) : d->rbps;
+            long long wbps = wrate[i] ? limit_min(d->wbps, io_cap(wrate[i], pct)) : d->wbps;
+            if (rbps == d->rbps && wbps == d->wbps) continue;
+            
+            if (write_io_max(cg, d, rbps, wbps) == ACTION_SUCCESS) {
+                char r[24], w[24];
+                format_limit(r, sizeof(r), rbps);
+                format_limit(w, sizeof(w), wbps);
+                snprintf(details, sizeof(details),
+                         "io.max %u:%u -> rbps=%s wbps=%s (%d%% of usage, level=%s)",
+                         d->major, d->minor, r, w, pct, escalation_str(cg->escalation));
+                log_cgroup_action("I/O", "THROTTLE", cg, details);
+                d->rbps = rbps;
+                d->wbps = wbps;
+                written = 1;
+            }
+        }
+        limit = t->limit;
+        details[0] = '\0';   /* Logged per device */
+    }
+    
+    if (!written) return;
+    t->limit = limit;
+    t->engaged = 1;
+    t->last_write = now;
+    throttle_writes++;
+    stats.cgroup_throttles[res]++;
+    if (details[0]) log_cgroup_action(throttle_category[res], "THROTTLE", cg, details);
+}
+
+/* Put one resource's original limits back */
+void throttle_restore(TrackedCgroup *cg, int res) {
+    Throttle *t = &cg->thr[res];
+    char buf[64], details[128];
+    int ok = 1;
+    
+    if (!t->engaged) return;
+    
+    if (res == SMARTSCHED_RES_CPU) {
+        char quota[24];
+        format_limit(quota, sizeof(quota), t->orig);
+        snprintf(buf, sizeof(buf), "%s %lld", quota, cg->cpu_period);
+        ok = write_cgroup_file(cg, "cpu.max", buf) == ACTION_SUCCESS;
+    } else if (res == SMARTSCHED_RES_MEM) {
+        format_limit(buf, sizeof(buf), t->orig);
+        ok = write_cgroup_file(cg, "memory.high", buf) == ACTION_SUCCESS;
+    } else {
+        for (int i = 0; i < THROTTLE_MAX_DEVS; i++) {
+            ThrottleDev *d = &cg->dev[i];
+            if (d->rbps == d->orig_rbps && d->wbps == d->orig_wbps) continue;
+            if (write_io_max(cg, d, d->orig_rbps, d->orig_wbps) == ACTION_SUCCESS) {
+                d->rbps = d->orig_rbps;
+                d->wbps = d->orig_wbps;
+            } else {
+                ok = 0;
+            }
+        }
+        snprintf(buf, sizeof(buf), "original");
+    }
+    if (!ok) return;
+    
+    snprintf(details, sizeof(details), "%s restored to %s (quiet for %lds)",
+             throttle_file[res], buf, time(NULL) - t->last_hot);
+    log_cgroup_action("RESTORE", "THROTTLE", cg, details);
+    t->engaged = 0;
+    t->relax_steps = 0;
+    t->limit = t->orig;
+    stats.cgroup_releases++;
+}
+
+/* Raise one resource's limits by half, or restore them after the last step */
+void throttle_relax(TrackedCgroup *cg, int res, time_t now) {
+    Throttle *t = &cg->thr[res];
+    char buf[64], details[128];
+    int ok = 1;
+    
+    if (++t->relax_steps > THROTTLE_RELAX_STEPS) {
+        throttle_restore(cg, res);
+        t->last_write = now;
+        throttle_writes++;
+        return;
+    }
+    
+    if (res == SMARTSCHED_RES_IO) {
+        for (int i = 0; i < THROTTLE_MAX_DEVS; i++) {
+            ThrottleDev *d = &cg->dev[i];
+            if (d->rbps == d->orig_rbps && d->wbps == d->orig_wbps) continue;
+            long long rbps = d->rbps == LIMIT_MAX ? LIMIT_MAX : limit_min(d->orig_rbps, d->rbps * 3 / 2);
+            long long wbps = d->wbps == LIMIT_MAX ? LIMIT_MAX : limit_min(d->orig_wbps, d->wbps * 3 / 2);
+            if (write_io_max(cg, d, rbps, wbps) == ACTION_SUCCESS) {
+                d->rbps = rbps;
+                d->wbps = wbps;
+            } else {
+                ok = 0;
+            }
+        }
+        snprintf(buf, sizeof(buf), "x1.5");
+    } else {
+        long long limit = limit_min(t->orig, t->limit * 3 / 2);
+        if (res == SMARTSCHED_RES_CPU) {
+            snprintf(buf, sizeof(buf), "%lld %lld", limit, cg->cpu_period);
+            ok = write_cgroup_file(cg, "cpu.max", buf) == ACTION_SUCCESS;
+        } else {
+            snprintf(buf, sizeof(buf), "%lld", limit);
+            ok = write_cgroup_file(cg, "memory.high", buf) == ACTION_SUCCESS;
+        }
+        if (ok) t->limit = limit;
+    }
+    if (!ok) return;
+    
+    snprintf(details, sizeof(details), "Relaxing %s -> %s (step %d/%d)",
+             throttle_file[res], buf, t->relax_steps, THROTTLE_RELAX_STEPS);
+    log_cgroup_action(throttle_category[res], "RELAX", cg, details);
+    t->last_write = now;
+    throttle_writes++;
+}
+
+/*
+ * One control step for a listed cgroup. Per resource, a spike or
+ * forecast flag in THROTTLE_ENGAGE_READS reads in a row engages (or
+ * tightens) the limit; THROTTLE_RELEASE_SECS without either starts
+ * relaxing it. Each limit is written at most every THROTTLE_STEP_SECS
+ * and all cgroups together at most THROTTLE_MAX_WRITES times a pass.
+ */
+void throttle_cgroup(TrackedCgroup *cg, unsigned int flags, int cpu_ema, time_t now) {
+    for (int res = SMARTSCHED_RES_CPU; res <= SMARTSCHED_RES_IO; res++) {
+        Throttle *t = &cg->thr[res];
+        
+        if (flags & ((1u << res) | (SMARTSCHED_FLAG_CPU_FORECAST << res))) {
+            t->hot++;
+            t->last_hot = now;
+            t->relax_steps = 0;
+        } else {
+            t->hot = 0;
+        }
+        
+        if (throttle_writes >= THROTTLE_MAX_WRITES) continue;
+        if (t->last_write && now - t->last_write < THROTTLE_STEP_SECS) continue;
+        
+        if (t->hot >= THROTTLE_ENGAGE_READS) {
+            throttle_tighten(cg, res, throttle_pct_for(cg, res, flags), cpu_ema, now);
+        } else if (t->engaged && !t->hot && now - t->last_hot >= THROTTLE_RELEASE_SECS) {
+            throttle_relax(cg, res, now);
+        }
+    }
+}
+
+/* Undo every limit of a cgroup (exit, or the kernel stopped listing it) */
+void throttle_restore_all(TrackedCgroup *cg) {
+    for (int res = SMARTSCHED_RES_CPU; res <= SMARTSCHED_RES_IO; res++)
+        throttle_restore(cg, res);
+}
+
+/*
+ * Read the kernel's cgroup signatures, act on flagged ones, restore
+ * quiet ones and forget cgroups that are gone. Rate-limited to
+ * CGROUP_CHECK_MS.
+ */
+void process_cgroups(void) {
+    static struct timespec last;
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if ((ts.tv_sec - last.tv_sec) * 1000 + (ts.tv_nsec - last.tv_nsec) / 1000000 <
+        CGROUP_CHECK_MS) {
+        return;
+    }
+    last = ts;
+    
+    FILE *f = fopen(PROC_CGROUPS, "r");
+    if (!f) return;
+    
+    time_t now = time(NULL);
+    char line[MAX_LINE];
+    
+    throttle_writes = 0;
+    
+    /* Skip header lines */
+    for (int i = 0; i < 4; i++) {
+        if (!fgets(line, sizeof(line), f)) break;
+    }
+    
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long id;
+        int tasks, cpu_ema, mem_ema, io_ema, cpu_roc, mem_roc, io_roc;
+        unsigned int flags;
+        char path[128];
+        
+        if (sscanf(line, "%llu %d %d %d %d %d %d %d %x %127[^\n]",
+                   &id, &tasks, &cpu_ema, &mem_ema, &io_ema,
+                   &cpu_roc, &mem_roc, &io_roc, &flags, path) != 10) {
+            continue;
+        }
+        
+        TrackedCgroup *cg = find_cgroup(id);
+        if (!cg) continue;
+        if (!cg->path[0]) snprintf(cg->path, sizeof(cg->path), "%s", path);
+        cg->nr_tasks = tasks;
+        cg->last_listed = now;
+        
+        if (flags & (SPIKE_CPU | SPIKE_MEM | SPIKE_IO)) {
+            handle_cgroup_spike(cg, flags, cpu_roc, mem_roc, io_roc);
+        } else {
+            cg->spike_type = 0;
+            cg->spike_samples = 0;
+        }
+        if (throttle_mode) throttle_cgroup(cg, flags, cpu_ema, now);
+    }
+    fclose(f);
+    
+    for (int i = 0; i < MAX_CGROUPS; i++) {
+        TrackedCgroup *cg = &cgroups[i];
+        if (!cg->id) continue;
+        
+        if (cg->escalation != ESCALATION_NONE && now - cg->last_flagged > RESTORE_SECS) {
+            restore_cgroup(cg);
+        }
+        /* The kernel drops empty or removed cgroups from its view */
+        if (now - cg->last_listed > STALE_SECS) {
+            throttle_restore_all(cg);
+            cg->id = 0;
+        }
+    }
+}
+
+/* Undo every cgroup adjustment (daemon exit) */
+void restore_all_cgroups(void) {
+    for (int i = 0; i < MAX_CGROUPS; i++) {
+        if (!cgroups[i].id) continue;
+        restore_cgroup(&cgroups[i]);
+        throttle_restore_all(&cgroups[i]);
+    }
+}
+
+/*
+ * Open the kernel spike event stream and register it with epoll
+ * Returns the epoll fd, or -1 if the module has no event stream
+ */
+int open_event_stream(int *event_fd) {
+    struct epoll_event ev = { .events = EPOLLIN };
+    
+    *event_fd = open(SMARTSCHED_EVENTS_PATH, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (*event_fd < 0) return -1;
+    
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, *event_fd, &ev) < 0) {
+        if (epfd >= 0) close(epfd);
+        close(*event_fd);
+        *event_fd = -1;
+        return -1;
+    }
+    return epfd;
+}
+
+/* Dispatch one kernel event to the matching spike handler */
+void handle_event(const struct smartsched_event *ev) {
+    char comm[SMARTSCHED_COMM_LEN + 1];
+    
+    if (ev->type == SMARTSCHED_EVENT_OVERRUN) {
+        if (verbose) {
+            fprintf(stderr, "%sWarning: fell behind, %d spike events lost%s\n",
+                    COLOR_YELLOW, ev->roc, COLOR_RESET);
+        }
+        held_sync_due = 1;
+        return;
+    }
+    
+    /* The resource indexes the per-resource arrays below */
+    if (ev->resource > SMARTSCHED_RES_IO) return;
+    
+    memcpy(comm, ev->comm, SMARTSCHED_COMM_LEN);
+    comm[SMARTSCHED_COMM_LEN] = '\0';
+    
+    if (ev->type == SMARTSCHED_EVENT_CLEAR) {
+        TrackedProcess *p = find_tracked(ev->pid);
+        int bit = ev->resource == SMARTSCHED_RES_CPU ? SPIKE_CPU :
+                  ev->resource == SMARTSCHED_RES_MEM ? SPIKE_MEM : SPIKE_IO;
+        if (p) {
+            p->spike_type &= ~bit;
+            p->history_ticks[ev->resource] = smartsched_history_ticks(ev->history);
+            p->spike_since_ns[ev->resource] = 0;
+        }
+        return;
+    }
+    
+    switch (ev->resource) {
+        case SMARTSCHED_RES_CPU:
+            handle_cpu_spike(ev->pid, comm, ev->roc, ev->history, ev->since_ns);
+            break;
+        case SMARTSCHED_RES_MEM:
+            handle_mem_spike(ev->pid, comm, ev->roc, ev->history, ev->since_ns);
+            break;
+        case SMARTSCHED_RES_IO:
+            handle_io_spike(ev->pid, comm, ev->roc, ev->history, ev->since_ns);
+            break;
+    }
+}
+
+/*
+ * Re-dispatch the spikes the module is still holding
+ * Events fire only when a spike starts and ends, so a held spike is
+ * re-read from the snapshot here: its history keeps escalating it and
+ * keeps the process from being restored. This also picks up spikes
+ * that started before the daemon or were lost to an overrun. As in
+ * the event stream, CPU spikes of a split process belong to its
+ * threads. The snapshot is mapped only for the pass, so the daemon
+ * never holds the module.
+ */
+void sync_held_spikes(void) {
+    static struct smartsched_record held[HELD_SPIKES_MAX];
+    static long long last_ms;
+    struct timespec ts;
+    ss_snapshot_t ss;
+    int n = 0;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long now = ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+    if (!held_sync_due && now - last_ms < HOUSEKEEPING_MS) return;
+    last_ms = now;
+    held_sync_due = 0;
+    
+    if (ss_snapshot_open(&ss) < 0) return;
+    for (int tries = 0; tries < SS_SNAPSHOT_RETRIES; tries++) {
+        unsigned int seq = ss_snapshot_read_begin(&ss);
+        unsigned int rows = ss.hdr->nr_records;
+        const __u32 *flags = SS_COL(&ss, FLAGS, __u32);
+        
+        if (rows > ss.hdr->capacity) rows = ss.hdr->capacity;
+        n = 0;
+        for (unsigned int i = 0; i < rows && n < HELD_SPIKES_MAX; i++) {
+            if ((flags[i] & SMARTSCHED_FLAG_ACTIVE) &&
+                (flags[i] & (SMARTSCHED_FLAG_CPU_SPIKE | SMARTSCHED_FLAG_MEM_SPIKE |
+                             SMARTSCHED_FLAG_IO_SPIKE)))
+                ss_snapshot_row(&ss, i, &held[n++]);
+        }
+        if (!ss_snapshot_read_retry(&ss, seq)) break;
+        n = 0;
+    }
+    ss_snapshot_close(&ss);
+    
+    for (int i = 0; i < n; i++) {
+        const struct smartsched_record *r = &held[i];
+        char comm[SMARTSCHED_COMM_LEN + 1];
+        unsigned int f = r->flags;
+        
+        if (f & SMARTSCHED_FLAG_THREAD) f &= SMARTSCHED_FLAG_CPU_SPIKE;
+        if (f & SMARTSCHED_FLAG_SPLIT) f &= ~SMARTSCHED_FLAG_CPU_SPIKE;
+        memcpy(comm, r->comm, SMARTSCHED_COMM_LEN);
+        comm[SMARTSCHED_COMM_LEN] = '\0';
+        
+        if (f & SMARTSCHED_FLAG_CPU_SPIKE)
+            handle_cpu_spike(r->pid, comm, r->cpu_roc, r->spike_history[SMARTSCHED_RES_CPU],
+                             r->spike_since_ns[SMARTSCHED_RES_CPU]);
+        if (f & SMARTSCHED_FLAG_MEM_SPIKE)
+            handle_mem_spike(r->pid, comm, r->mem_roc, r->spike_history[SMARTSCHED_RES_MEM],
+                             r->spike_since_ns[SMARTSCHED_RES_MEM]);
+        if (f & SMARTSCHED_FLAG_IO_SPIKE)
+            handle_io_spike(r->pid, comm, r->io_roc, r->spike_history[SMARTSCHED_RES_IO],
+                            r->spike_since_ns[SMARTSCHED_RES_IO]);
+    }
+}
+
+/*
+ * Wait for spike events and handle everything queued
+ * Returns 0 on timeout or after handling events, -1 if the stream ended
+ */
+int process_events(int epfd, int event_fd) {
+    static struct smartsched_event evs[EVENT_BATCH];
+    struct epoll_event ready;
+    
+    int n = epoll_wait(epfd, &ready, 1, HOUSEKEEPING_MS);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    if (n == 0) return 0;
+    if (ready.events & (EPOLLHUP | EPOLLERR)) return -1;
+    
+    for (;;) {
+        ssize_t len = read(event_fd, evs, sizeof(evs));
+        if (len < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        if (len == 0) return -1;
+        
+        for (size_t i = 0; i < (size_t)len / sizeof(evs[0]); i++) {
+            handle_event(&evs[i]);
+        }
+    }
+}
+
 /* Print status header */
 void print_status(void) {
     printf("\n%s╔══════════════════════════════════════════════════════════════╗%s\n",
@@ -551,14 +1792,24 @@ void print_status(void) {
            COLOR_GREEN, COLOR_RESET);
     printf("%s╠══════════════════════════════════════════════════════════════╣%s\n",
            COLOR_GREEN, COLOR_RESET);
-    printf("%s║%s Check interval:     %d ms                                    %s║%s\n",
-           COLOR_GREEN, COLOR_RESET, CHECK_INTERVAL_MS, COLOR_GREEN, COLOR_RESET);
+    if (event_epfd >= 0) {
+        printf("%s║%s Spike source:       kernel events (epoll)                 %s║%s\n",
+               COLOR_GREEN, COLOR_RESET, COLOR_GREEN, COLOR_RESET);
+    } else {
+        printf("%s║%s Check interval:     %d ms                                    %s║%s\n",
+               COLOR_GREEN, COLOR_RESET, CHECK_INTERVAL_MS, COLOR_GREEN, COLOR_RESET);
+    }
     printf("%s║%s Persistent check:   Every %d seconds                         %s║%s\n",
            COLOR_GREEN, COLOR_RESET, PERSISTENT_CHECK_INTERVAL, COLOR_GREEN, COLOR_RESET);
     printf("%s║%s Dry run mode:       %s                                     %s║%s\n",
            COLOR_GREEN, COLOR_RESET, 
            dry_run ? "YES (no changes)" : "NO (actions enabled)",
            COLOR_GREEN, COLOR_RESET);
+    printf("%s║%s Action target:      %s                                     %s║%s\n",
+           COLOR_GREEN, COLOR_RESET,
+           throttle_mode ? "cgroup limits   " :
+           cgroup_mode ? "cgroups         " : "processes       ",
+           COLOR_GREEN, COLOR_RESET);
     printf("%s╚══════════════════════════════════════════════════════════════╝%s\n\n",
            COLOR_GREEN, COLOR_RESET);
     
@@ -571,6 +1822,14 @@ void print_status(void) {
            COLOR_MAGENTA, COLOR_RESET);
     printf("  %s[RESTORE]%s → Priority restoration after spike ends\n",
            COLOR_GREEN, COLOR_RESET);
+    if (throttle_mode) {
+        printf("  %s[THROTTLE]%s → cpu.max / memory.high / io.max on the offending cgroup,\n"
+               "               relaxed and restored after %ds quiet\n",
+               COLOR_BLUE, COLOR_RESET, THROTTLE_RELEASE_SECS);
+    } else if (cgroup_mode) {
+        printf("  %s[CGROUP]%s  → cpu.weight / io.weight on the whole cgroup\n",
+               COLOR_BLUE, COLOR_RESET);
+    }
     printf("  %s[ESCALATE]%s → Elevated response for persistent spikes\n",
            BG_RED, COLOR_RESET);
     printf("\nEscalation Levels:\n");
@@ -595,7 +1854,7 @@ void print_summary(void) {
     printf("%s║%s Uptime:                    %ld seconds                        %s║%s\n",
            COLOR_YELLOW, COLOR_RESET, uptime, COLOR_YELLOW, COLOR_RESET);
     printf("%s║%s Processes tracked:         %d                                  %s║%s\n",
-           COLOR_YELLOW, COLOR_RESET, tracked_count, COLOR_YELLOW, COLOR_RESET);
+           COLOR_YELLOW, COLOR_RESET, tracked_total, COLOR_YELLOW, COLOR_RESET);
     printf("%s╠══════════════════════════════════════════════════════════════╣%s\n",
            COLOR_YELLOW, COLOR_RESET);
     printf("%s║%s CPU advisories:            %d                                  %s║%s\n",
@@ -616,6 +1875,22 @@ void print_summary(void) {
            COLOR_YELLOW, COLOR_RESET, stats.escalations, COLOR_YELLOW, COLOR_RESET);
     printf("%s║%s Persistent spikes handled: %d                                  %s║%s\n",
            COLOR_YELLOW, COLOR_RESET, stats.persistent_spikes, COLOR_YELLOW, COLOR_RESET);
+    if (cgroup_mode) {
+        printf("%s║%s Cgroup CPU weight boosts:  %d                                  %s║%s\n",
+               COLOR_YELLOW, COLOR_RESET, stats.cgroup_cpu_actions, COLOR_YELLOW, COLOR_RESET);
+        printf("%s║%s Cgroup I/O weight boosts:  %d                                  %s║%s\n",
+               COLOR_YELLOW, COLOR_RESET, stats.cgroup_io_actions, COLOR_YELLOW, COLOR_RESET);
+        printf("%s║%s Cgroup restorations:       %d                                  %s║%s\n",
+               COLOR_YELLOW, COLOR_RESET, stats.cgroup_restorations, COLOR_YELLOW, COLOR_RESET);
+    }
+    if (throttle_mode) {
+        printf("%s║%s Throttle writes CPU/MEM/IO: %d/%d/%d                             %s║%s\n",
+               COLOR_YELLOW, COLOR_RESET, stats.cgroup_throttles[SMARTSCHED_RES_CPU],
+               stats.cgroup_throttles[SMARTSCHED_RES_MEM], stats.cgroup_throttles[SMARTSCHED_RES_IO],
+               COLOR_YELLOW, COLOR_RESET);
+        printf("%s║%s Limits restored:           %d                                  %s║%s\n",
+               COLOR_YELLOW, COLOR_RESET, stats.cgroup_releases, COLOR_YELLOW, COLOR_RESET);
+    }
     printf("%s╚══════════════════════════════════════════════════════════════╝%s\n",
            COLOR_YELLOW, COLOR_RESET);
     
@@ -626,7 +1901,7 @@ void print_summary(void) {
         fprintf(f, "============================\n");
         fprintf(f, "Generated: %s\n\n", get_time_str());
         fprintf(f, "Uptime: %ld seconds\n", uptime);
-        fprintf(f, "Processes tracked: %d\n\n", tracked_count);
+        fprintf(f, "Processes tracked: %d\n\n", tracked_total);
         fprintf(f, "Statistics:\n");
         fprintf(f, "  CPU advisories: %d\n", stats.cpu_advisories);
         fprintf(f, "  CPU boosts: %d\n", stats.cpu_boosts);
@@ -637,6 +1912,19 @@ void print_summary(void) {
         fprintf(f, "  Restorations: %d\n", stats.restorations);
         fprintf(f, "  Escalations: %d\n", stats.escalations);
         fprintf(f, "  Persistent spikes: %d\n", stats.persistent_spikes);
+        fprintf(f, "  Actions dropped (queue full): %d\n", stats.actions_dropped);
+        if (cgroup_mode) {
+            fprintf(f, "  Cgroup CPU weight boosts: %d\n", stats.cgroup_cpu_actions);
+            fprintf(f, "  Cgroup I/O weight boosts: %d\n", stats.cgroup_io_actions);
+            fprintf(f, "  Cgroup restorations: %d\n", stats.cgroup_restorations);
+        }
+        if (throttle_mode) {
+            fprintf(f, "  Throttle writes (CPU/MEM/IO): %d/%d/%d\n",
+                    stats.cgroup_throttles[SMARTSCHED_RES_CPU],
+                    stats.cgroup_throttles[SMARTSCHED_RES_MEM],
+                    stats.cgroup_throttles[SMARTSCHED_RES_IO]);
+            fprintf(f, "  Limits restored: %d\n", stats.cgroup_releases);
+        }
         fclose(f);
         printf("\nReport saved to: %s\n", REPORT_FILE);
     }
@@ -648,6 +1936,13 @@ void usage(const char *prog) {
     printf("Options:\n");
     printf("  -q        Quiet mode\n");
     printf("  -n        Dry run (no priority changes)\n");
+    printf("  -g        Cgroup mode: adjust cpu.weight/io.weight of spiking\n");
+    printf("            cgroups instead of per-process nice/ionice\n");
+    printf("  -t        Throttle mode: cap the spiking or forecast-to-spike\n");
+    printf("            cgroup's cpu.max/memory.high/io.max near its usage,\n");
+    printf("            restoring them once quiet (implies -g, no boosts)\n");
+    printf("  -F        Fresh start: ignore the tracking state saved by\n");
+    printf("            the previous run (%s)\n", STATE_FILE);
     printf("  -h        Show this help\n");
     printf("\nRequires root for priority adjustments.\n");
 }
@@ -655,10 +1950,13 @@ void usage(const char *prog) {
 int main(int argc, char *argv[]) {
     int opt;
     
-    while ((opt = getopt(argc, argv, "qnh")) != -1) {
+    while ((opt = getopt(argc, argv, "qngtFh")) != -1) {
         switch (opt) {
             case 'q': verbose = 0; break;
             case 'n': dry_run = 1; break;
+            case 'g': cgroup_mode = 1; break;
+            case 't': cgroup_mode = throttle_mode = 1; break;
+            case 'F': fresh_start = 1; break;
             case 'h':
             default:
                 usage(argv[0]);
@@ -680,6 +1978,12 @@ int main(int argc, char *argv[]) {
     }
     fclose(f);
     
+    if (cgroup_mode && access(PROC_CGROUPS, R_OK) != 0) {
+        fprintf(stderr, "%sError: %s missing, module too old for %s%s\n",
+                COLOR_RED, PROC_CGROUPS, throttle_mode ? "-t" : "-g", COLOR_RESET);
+        return 1;
+    }
+    
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
@@ -691,13 +1995,37 @@ int main(int argc, char *argv[]) {
     
     daemon_start_time = time(NULL);
     last_persistent_check = daemon_start_time;
+    if (fresh_start && !dry_run) unlink(STATE_FILE);
+    else load_state();
+    
+    event_epfd = open_event_stream(&event_fd);
     
     print_status();
     
     while (running) {
-        process_predictions();
+        if (event_epfd >= 0) {
+            if (process_events(event_epfd, event_fd) < 0) {
+                fprintf(stderr, "%sEvent stream closed (module unloaded?)%s\n",
+                        COLOR_RED, COLOR_RESET);
+                break;
+            }
+            sync_held_spikes();
+            apply_actions();
+            restore_priorities();
+        } else {
+            process_predictions();
+            usleep(CHECK_INTERVAL_MS * 1000);
+        }
+        if (cgroup_mode) process_cgroups();
         check_persistent_spikes();
-        usleep(CHECK_INTERVAL_MS * 1000);
+    }
+    
+    if (cgroup_mode) restore_all_cgroups();
+    save_state();
+    
+    if (event_epfd >= 0) {
+        close(event_epfd);
+        close(event_fd);
     }
     
     print_summary();
@@ -13,11 +13,14 @@ Features:
   - System resource summary header
   - Advisory panel with spike categorisation
   - Demo mode for testing without the kernel module
+  - Incremental collector: cached psutil handles, one /proc pass per PID
+  - Optional zero-syscall source: the module's mmap'd binary snapshot
 
 Usage:
   python3 smartmonitor.py              # Live mode (requires kernel module)
   python3 smartmonitor.py --demo       # Demo with synthetic data
   python3 smartmonitor.py --interval 500 --top 30
+  python3 smartmonitor.py --snapshot   # CPU/RAM from /dev/smartsched
 
 Requirements:
   pip install rich psutil
@@ -27,8 +30,10 @@ from __future__ import annotations
 
 import argparse
 import json
+import mmap
 import os
 import signal
+import struct
 import sys
 import time
 from dataclasses import dataclass, field
@@ -59,6 +64,7 @@ except ImportError:
 PROC_STATUS      = "/proc/smartscheduler/status"
 PROC_PREDICTIONS = "/proc/smartscheduler/predictions"
 PROC_STATS       = "/proc/smartscheduler/stats"
+SNAPSHOT_DEV     = "/dev/smartsched"
 SCRIPT_DIR       = Path(__file__).resolve().parent
 BLOCKLIST_PATH   = SCRIPT_DIR / "blocklist.json"
 LOG_DIR          = SCRIPT_DIR.parent / "logs"
@@ -276,6 +282,117 @@ class ProcReader:
         return stats
 
 
+# ── Snapshot Reader ──────────────────────────────────────────────────────────
+
+class SnapshotReader:
+    """Reads the module's binary snapshot from /dev/smartsched.
+
+    Layouts mirror kernel/smartsched_abi.h. The mapping is column-major
+    and republished every sampler tick under a sequence counter: the
+    columns are copied out and the copy is retried if the counter was
+    odd or moved meanwhile, then zipped back into one tuple per process.
+    """
+
+    MAGIC = 0x53534E50              # "SSNP"
+    ABI_VERSION = 4
+    HEADER = struct.Struct("<8I4Q")
+    COLUMN = struct.Struct("<2I")
+    SEQ_OFFSET = 24
+    RETRIES = 64
+    FLAG_THREAD, FLAG_ACTIVE = 0x40, 0x80
+
+    # struct codes of the SMARTSCHED_COL_* columns, in order
+    COLUMNS = ("i", "I", "i", "i", "i", "i", "i", "i", "i", "i", "i", "i",
+               "B", "B", "B", "Q", "Q", "Q", "Q", "Q", "Q", "Q", "Q", "Q", "Q", "Q",
+               "16s")
+
+    # Row field positions, the same as the column ids
+    F_PID, F_FLAGS = 0, 1
+    F_CPU_EMA, F_MEM_EMA, F_IO_EMA = 2, 3, 4
+    F_CPU_ROC, F_MEM_ROC, F_IO_ROC = 5, 6, 7
+    F_CPU_SAMPLE, F_MEM_SAMPLE, F_IO_SAMPLE = 8, 9, 10
+    F_HOT_TID = 11
+    F_CPU_ETA, F_MEM_ETA, F_IO_ETA = 12, 13, 14   # Ticks to a forecast spike
+    F_CPU_HISTORY, F_MEM_HISTORY, F_IO_HISTORY = 20, 21, 22  # Spike flag per tick, bit 0 = latest
+    F_COMM = 26
+
+    @staticmethod
+    def streak(history: int) -> int:
+        """Consecutive flagged ticks up to the latest, from a history bitmap."""
+        return (~history & (history + 1)).bit_length() - 1
+
+    def __init__(self):
+        self._fd = -1
+        self._map: Optional[mmap.mmap] = None
+        self.offsets: list[int] = []
+        self.generation = 0
+
+    @classmethod
+    def open(cls) -> Optional["SnapshotReader"]:
+        """Returns a mapped reader, or None if unavailable or ABI differs."""
+        reader = cls()
+        try:
+            reader._fd = os.open(SNAPSHOT_DEV, os.O_RDONLY | os.O_CLOEXEC)
+            # Character devices report no size: map the header, then the rest
+            size = cls.HEADER.size + len(cls.COLUMNS) * cls.COLUMN.size
+            head = mmap.mmap(reader._fd, size, mmap.MAP_SHARED, mmap.PROT_READ)
+            hdr = cls.HEADER.unpack_from(head)
+            table = [cls.COLUMN.unpack_from(head, cls.HEADER.size + i * cls.COLUMN.size)
+                     for i in range(len(cls.COLUMNS))]
+            head.close()
+            magic, version, _, nr_columns = hdr[:4]
+            if (magic != cls.MAGIC or version != cls.ABI_VERSION
+                    or nr_columns != len(cls.COLUMNS)
+                    or any(sz != struct.calcsize(code)
+                           for (_, sz), code in zip(table, cls.COLUMNS))):
+                reader.close()
+                return None
+            reader.offsets = [off for off, _ in table]
+            reader._map = mmap.mmap(reader._fd, hdr[10], mmap.MAP_SHARED, mmap.PROT_READ)
+        except (OSError, ValueError):
+            reader.close()
+            return None
+        return reader
+
+    def close(self) -> None:
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+        if self._fd >= 0:
+            os.close(self._fd)
+            self._fd = -1
+
+    def _column(self, i: int, count: int):
+        code, off = self.COLUMNS[i], self.offsets[i]
+        if code == "16s":
+            raw = self._map[off:off + count * 16]
+            return [raw[j:j + 16] for j in range(0, len(raw), 16)]
+        return struct.unpack_from(f"<{count}{code}", self._map, off)
+
+    def read(self) -> Optional[list[tuple]]:
+        """Returns a consistent list of process rows, or None."""
+        m = self._map
+        if m is None:
+            return None
+        for _ in range(self.RETRIES):
+            seq, = struct.unpack_from("<I", m, self.SEQ_OFFSET)
+            if seq & 1:
+                continue
+            hdr = self.HEADER.unpack_from(m)
+            count = min(hdr[5], hdr[4])
+            cols = [self._column(i, count) for i in range(len(self.COLUMNS))]
+            if struct.unpack_from("<I", m, self.SEQ_OFFSET)[0] == seq:
+                self.generation = hdr[8]
+                mask = self.FLAG_ACTIVE | self.FLAG_THREAD
+                return [row for row in zip(*cols)
+                        if row[self.F_FLAGS] & mask == self.FLAG_ACTIVE]
+        return None
+
+    @classmethod
+    def comm(cls, rec: tuple) -> str:
+        return rec[cls.F_COMM].split(b"\0", 1)[0].decode(errors="replace")
+
+
 # ── Red Pulse Animation ─────────────────────────────────────────────────────
 
 class RedPulseAnimation:
@@ -394,6 +511,13 @@ class SmartMonitor:
         # Spike history tracking
         self._spike_history: dict[int, int] = {}  # pid → consecutive count
         self._process_cache: dict[int, psutil.Process] = {}  # pid → psutil object
+        self._create_times: dict[int, float] = {}  # pid → start time of cached handle
+
+        # Binary snapshot: enrichment source when mapped, and with
+        # --snapshot also the CPU/RAM source. Mapped per refresh only, so
+        # the TUI does not pin the module
+        self.use_snapshot = args.snapshot
+        self._mem_sample_mb = 0.01
 
         signal.signal(signal.SIGINT, self._signal)
         signal.signal(signal.SIGTERM, self._signal)
@@ -403,61 +527,117 @@ class SmartMonitor:
 
     # ── Data Collection ────────────────────────────────────────────────
 
+    def _kernel_data(self) -> tuple[dict[int, dict], dict[int, dict], bool]:
+        """Predictions and stats keyed by PID, and whether they came from
+        the snapshot. The device is opened and closed around each read."""
+        reader = SnapshotReader.open()
+        if reader is not None:
+            records = reader.read()
+            reader.close()
+            if records is not None:
+                S = SnapshotReader
+                preds = {}
+                stats = {}
+                for r in records:
+                    flags = r[S.F_FLAGS]
+                    preds[r[S.F_PID]] = {
+                        "name": S.comm(r),
+                        "cpu_spike": bool(flags & 0x1),
+                        "mem_spike": bool(flags & 0x2),
+                        "io_spike": bool(flags & 0x4),
+                        "flags": flags,
+                        "cpu_sample": r[S.F_CPU_SAMPLE],
+                        "mem_sample": r[S.F_MEM_SAMPLE],
+                        # Longest current run of flagged ticks, kept by the kernel
+                        "spike_streak": max(S.streak(r[S.F_CPU_HISTORY]),
+                                            S.streak(r[S.F_MEM_HISTORY]),
+                                            S.streak(r[S.F_IO_HISTORY])),
+                    }
+                    stats[r[S.F_PID]] = {
+                        "cpu_ema": r[S.F_CPU_EMA],
+                        "mem_ema": r[S.F_MEM_EMA],
+                        "io_ema": r[S.F_IO_EMA],
+                        "cpu_roc": r[S.F_CPU_ROC],
+                        "mem_roc": r[S.F_MEM_ROC],
+                        "io_roc": r[S.F_IO_ROC],
+                    }
+                return preds, stats, True
+        if ProcReader.module_loaded():
+            return ProcReader.read_predictions(), ProcReader.read_stats(), False
+        return {}, {}, False
+
+    def _sample_psutil(self, pid: int) -> Optional[tuple[str, float, float]]:
+        """(name, cpu%, ram MB) from a cached handle, one /proc pass each.
+
+        Handles persist across refreshes so cpu_percent() measures the
+        interval since the previous frame; the first frame after a PID
+        appears primes the handle and reports 0.
+        """
+        proc = self._process_cache.get(pid)
+        try:
+            if proc is not None:
+                with proc.oneshot():
+                    # A recycled PID shows up as a new start time
+                    if proc.create_time() == self._create_times.get(pid):
+                        return (proc.name(), proc.cpu_percent(interval=None),
+                                proc.memory_info().rss / (1024 * 1024))
+            proc = psutil.Process(pid)
+            with proc.oneshot():
+                proc.cpu_percent(interval=None)
+                self._create_times[pid] = proc.create_time()
+                self._process_cache[pid] = proc
+                return (proc.name(), 0.0, proc.memory_info().rss / (1024 * 1024))
+        except (psutil.NoSuchProcess, psutil.ZombieProcess, psutil.AccessDenied):
+            self._process_cache.pop(pid, None)
+            self._create_times.pop(pid, None)
+            return None
+
+    def _prune(self, live_pids: set[int]) -> None:
+        """Drop cached handles and spike counters of exited PIDs."""
+        for cache in (self._process_cache, self._create_times, self._spike_history):
+            for pid in cache.keys() - live_pids:
+                del cache[pid]
+
     def collect_processes(self) -> list[ProcessInfo]:
         """
         Collects all running processes from system (psutil) and enriches
-        them with SmartScheduler data (active set).
+        them with SmartScheduler data (active set). With --snapshot the
+        kernel's tracked set is the source and no per-PID reads are made.
         """
         if self.demo:
             return generate_demo_processes(self.tick)
 
         # 1. Get Kernel Data (Enrichment source)
-        if ProcReader.module_loaded():
-            preds = ProcReader.read_predictions()
-            stats = ProcReader.read_stats()
-        else:
-            preds = {}
-            stats = {}
+        preds, stats, from_snapshot = self._kernel_data()
+        snapshot_source = self.use_snapshot and from_snapshot
 
         processes: list[ProcessInfo] = []
-        live_pids = set()
 
-        # 2. Iterate ALL system processes (Source of Truth)
-        # using process_iter is efficient and robust against kernel desync
-        for proc in psutil.process_iter(['pid', 'name', 'username']):
-            pid = proc.pid
-            live_pids.add(pid)
-            
-            # Manage Cache
-            if pid not in self._process_cache:
-                # New process found
-                try:
-                    # We utilize the yielded proc object but must ensure we
-                    # store a persistent reference for cpu_percent state.
-                    # psutil.process_iter yields new objects, so we should 
-                    # use them to initialize the cache IF valid.
-                    p_obj = psutil.Process(pid) 
-                    p_obj.cpu_percent() # Init CPU state
-                    self._process_cache[pid] = p_obj
-                except (psutil.NoSuchProcess, psutil.AccessDenied):
-                    continue
-            
-            # Use Cached Object for CPU Calculation
-            p = self._process_cache[pid]
-            try:
-                cpu_pct = p.cpu_percent(interval=0)
-                mem_info = p.memory_info()
-                ram_mb = mem_info.rss / (1024 * 1024)
-            except (psutil.NoSuchProcess, psutil.AccessDenied):
-                self._process_cache.pop(pid, None)
-                continue
+        # 2. PIDs to show: every live process, or the module's tracked set
+        if snapshot_source:
+            live_pids = set(preds)
+        else:
+            live_pids = set(psutil.pids())
 
-            # 3. Merge with Kernel Data
+        for pid in live_pids:
             pred = preds.get(pid, {})
             st = stats.get(pid, {})
-            
+
+            if snapshot_source:
+                # cpu_sample is one-CPU percent x100; mem_sample is the
+                # module's memory sample (weighted RSS plus major-fault
+                # pressure, MB x100; see smartsched_mem_sample())
+                name = pred.get("name", "")
+                cpu_pct = pred.get("cpu_sample", 0) / 100.0
+                ram_mb = pred.get("mem_sample", 0) * self._mem_sample_mb
+            else:
+                sample = self._sample_psutil(pid)
+                if sample is None:
+                    continue
+                name, cpu_pct, ram_mb = sample
+
+            # 3. Merge with Kernel Data
             # Determine Alert Level
-            name = proc.name()
             is_blocked = self.blocklist.is_monitored(name)
             
             # Spike Flags
@@ -472,31 +652,41 @@ class SmartMonitor:
             elif has_cpu_spike or has_mem_spike or has_io_spike:
                 alert = "WARNING"
             
-            # Track Consecutive Spikes
+            # Track Consecutive Spikes: the snapshot carries the kernel's
+            # per-tick history; otherwise count frames here
             if alert != "NORMAL":
                 self._spike_history[pid] = self._spike_history.get(pid, 0) + 1
             else:
                 self._spike_history.pop(pid, None)
 
-            consecutive_spikes = self._spike_history.get(pid, 0)
+            if pred.get("spike_streak"):
+                consecutive_spikes = pred["spike_streak"]
+            else:
+                consecutive_spikes = self._spike_history.get(pid, 0)
 
             process_info = ProcessInfo(
                 pid=pid,
                 name=name,
                 cpu_percent=round(cpu_pct, 1),
                 ram_mb=round(ram_mb, 1),
+                cpu_ema=st.get("cpu_ema", 0),
+                mem_ema=st.get("mem_ema", 0),
+                io_ema=st.get("io_ema", 0),
+                cpu_roc=st.get("cpu_roc", 0),
+                mem_roc=st.get("mem_roc", 0),
                 io_rate=st.get("io_roc", 0.0), # From kernel stats if avail
                 trend="↑" if st.get("cpu_roc", 0) > 0 else "↓" if st.get("cpu_roc", 0) < 0 else "→",
                 alert_level=alert,
                 has_cpu_spike=has_cpu_spike,
                 has_mem_spike=has_mem_spike,
                 has_io_spike=has_io_spike,
+                flags=pred.get("flags", 0),
                 is_blocklisted=is_blocked,
                 consecutive_spikes=consecutive_spikes
             )
             processes.append(process_info)
 
-
+        self._prune(live_pids)
         return processes
 
     def collect_system_info(self) -> SystemInfo:
@@ -885,6 +1075,7 @@ def main():
             "  python3 smartmonitor.py --demo        # Demo with synthetic data\n"
             "  python3 smartmonitor.py --interval 500 --top 30\n"
             "  python3 smartmonitor.py --all         # Show all processes\n"
+            "  python3 smartmonitor.py --snapshot    # Kernel snapshot as source\n"
         ),
     )
     parser.add_argument(
@@ -903,6 +1094,10 @@ def main():
         "--demo", "-d", action="store_true",
         help="Run in demo mode with synthetic data (no kernel module needed)",
     )
+    parser.add_argument(
+        "--snapshot", "-s", action="store_true",
+        help="Take CPU/RAM from the module's binary snapshot instead of psutil",
+    )
     parser.add_argument(
         "--blocklist", "-b", type=str, default=str(BLOCKLIST_PATH),
         help=f"Path to blocklist JSON config (default: {BLOCKLIST_PATH})",
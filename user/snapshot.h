@@ -0,0 +1,200 @@
+/*
+ * SmartScheduler Snapshot Reader
+ *
+ * Header-only helper for the binary snapshot at /dev/smartsched.
+ * The mapping is read-only, column-major and republished by the
+ * module every tick under a sequence counter, so readers either copy
+ * process rows out with ss_snapshot_read() or walk the columns in
+ * place (SS_COL()) between ss_snapshot_read_begin() and
+ * ss_snapshot_read_retry().
+ *
+ * Tools fall back to the procfs text files when open fails.
+ */
+
+#ifndef SMARTSCHED_SNAPSHOT_H
+#define SMARTSCHED_SNAPSHOT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "smartsched_abi.h"
+
+#define SS_SNAPSHOT_RETRIES 64
+
+typedef struct {
+    int fd;
+    size_t size;
+    const volatile struct smartsched_snapshot_header *hdr;
+    const void *col[SMARTSCHED_NR_COLUMNS];
+} ss_snapshot_t;
+
+/* Element size of each column, checked against the header at open */
+static const unsigned int ss_col_size[SMARTSCHED_NR_COLUMNS] = {
+    [SMARTSCHED_COL_PID] = sizeof(__s32),
+    [SMARTSCHED_COL_FLAGS] = sizeof(__u32),
+    [SMARTSCHED_COL_CPU_EMA ... SMARTSCHED_COL_HOT_TID] = sizeof(__s32),
+    [SMARTSCHED_COL_CPU_ETA ... SMARTSCHED_COL_IO_ETA] = sizeof(__u8),
+    [SMARTSCHED_COL_START_TIME ... SMARTSCHED_COL_IO_SINCE] = sizeof(__u64),
+    [SMARTSCHED_COL_COMM] = SMARTSCHED_COMM_LEN,
+};
+
+/* Column id of the mapping as an array of type, e.g. SS_COL(ss, PID, __s32)[i] */
+#define SS_COL(ss, id, type) ((const type *)(ss)->col[SMARTSCHED_COL_##id])
+
+/* Row i holds a process signature (not a free slot or a thread) */
+static inline int ss_snapshot_is_process(const ss_snapshot_t *ss, unsigned int i)
+{
+    return (SS_COL(ss, FLAGS, __u32)[i] &
+            (SMARTSCHED_FLAG_ACTIVE | SMARTSCHED_FLAG_THREAD)) == SMARTSCHED_FLAG_ACTIVE;
+}
+
+/* Map the snapshot; returns 0 or -errno (-EPROTO on ABI mismatch) */
+static inline int ss_snapshot_open(ss_snapshot_t *ss)
+{
+    const struct smartsched_snapshot_header *hdr;
+    void *map;
+
+    memset(ss, 0, sizeof(*ss));
+    ss->fd = open(SMARTSCHED_DEV_PATH, O_RDONLY | O_CLOEXEC);
+    if (ss->fd < 0)
+        return -errno;
+
+    /* Character devices report no size: map the header, then the rest */
+    map = mmap(NULL, sizeof(*hdr), PROT_READ, MAP_SHARED, ss->fd, 0);
+    if (map == MAP_FAILED)
+        goto fail;
+
+    hdr = map;
+    int ok = hdr->magic == SMARTSCHED_SNAPSHOT_MAGIC &&
+             hdr->version == SMARTSCHED_ABI_VERSION &&
+             hdr->nr_columns == SMARTSCHED_NR_COLUMNS;
+    for (int c = 0; ok && c < SMARTSCHED_NR_COLUMNS; c++)
+        ok = hdr->columns[c].size == ss_col_size[c];
+    if (!ok) {
+        munmap(map, sizeof(*hdr));
+        close(ss->fd);
+        ss->fd = -1;
+        return -EPROTO;
+    }
+
+    ss->size = hdr->map_size;
+    munmap(map, sizeof(*hdr));
+
+    map = mmap(NULL, ss->size, PROT_READ, MAP_SHARED, ss->fd, 0);
+    if (map == MAP_FAILED)
+        goto fail;
+
+    ss->hdr = map;
+    for (int c = 0; c < SMARTSCHED_NR_COLUMNS; c++)
+        ss->col[c] = (const char *)map + ss->hdr->columns[c].offset;
+    return 0;
+
+fail:
+    {
+        int err = -errno;
+        close(ss->fd);
+        ss->fd = -1;
+        return err;
+    }
+}
+
+static inline void ss_snapshot_close(ss_snapshot_t *ss)
+{
+    if (ss->hdr)
+        munmap((void *)ss->hdr, ss->size);
+    if (ss->fd >= 0)
+        close(ss->fd);
+    ss->hdr = NULL;
+    ss->fd = -1;
+}
+
+/*
+ * Start a zero-copy read; returns the sequence to pass to
+ * ss_snapshot_read_retry(). Spins while a publish is in progress.
+ */
+static inline unsigned int ss_snapshot_read_begin(const ss_snapshot_t *ss)
+{
+    unsigned int seq;
+
+    while ((seq = ss->hdr->seq) & 1)
+        ;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return seq;
+}
+
+/* Non-zero if the records read since begin may be torn */
+static inline int ss_snapshot_read_retry(const ss_snapshot_t *ss, unsigned int seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ss->hdr->seq != seq;
+}
+
+/* Gather row i of the columns into one record */
+static inline void ss_snapshot_row(const ss_snapshot_t *ss, unsigned int i,
+                                   struct smartsched_record *r)
+{
+    r->pid = SS_COL(ss, PID, __s32)[i];
+    r->flags = SS_COL(ss, FLAGS, __u32)[i];
+    r->cpu_ema = SS_COL(ss, CPU_EMA, __s32)[i];
+    r->mem_ema = SS_COL(ss, MEM_EMA, __s32)[i];
+    r->io_ema = SS_COL(ss, IO_EMA, __s32)[i];
+    r->cpu_roc = SS_COL(ss, CPU_ROC, __s32)[i];
+    r->mem_roc = SS_COL(ss, MEM_ROC, __s32)[i];
+    r->io_roc = SS_COL(ss, IO_ROC, __s32)[i];
+    r->cpu_sample = SS_COL(ss, CPU_SAMPLE, __s32)[i];
+    r->mem_sample = SS_COL(ss, MEM_SAMPLE, __s32)[i];
+    r->io_sample = SS_COL(ss, IO_SAMPLE, __s32)[i];
+    r->hot_tid = SS_COL(ss, HOT_TID, __s32)[i];
+    r->forecast_eta[SMARTSCHED_RES_CPU] = SS_COL(ss, CPU_ETA, __u8)[i];
+    r->forecast_eta[SMARTSCHED_RES_MEM] = SS_COL(ss, MEM_ETA, __u8)[i];
+    r->forecast_eta[SMARTSCHED_RES_IO] = SS_COL(ss, IO_ETA, __u8)[i];
+    r->forecast_eta[3] = 0;
+    r->reserved = 0;
+    r->start_time_ns = SS_COL(ss, START_TIME, __u64)[i];
+    r->total_samples = SS_COL(ss, TOTAL_SAMPLES, __u64)[i];
+    r->cpu_spikes = SS_COL(ss, CPU_SPIKES, __u64)[i];
+    r->mem_spikes = SS_COL(ss, MEM_SPIKES, __u64)[i];
+    r->io_spikes = SS_COL(ss, IO_SPIKES, __u64)[i];
+    for (int res = SMARTSCHED_RES_CPU; res <= SMARTSCHED_RES_IO; res++) {
+        r->spike_history[res] = ((const __u64 *)ss->col[SMARTSCHED_COL_HISTORY(res)])[i];
+        r->spike_since_ns[res] = ((const __u64 *)ss->col[SMARTSCHED_COL_SINCE(res)])[i];
+    }
+    memcpy(r->comm, SS_COL(ss, COMM, char) + (size_t)i * SMARTSCHED_COMM_LEN,
+           SMARTSCHED_COMM_LEN);
+}
+
+/*
+ * Copy up to max process rows into out; returns the number copied,
+ * or -EAGAIN if the writer kept getting in the way. Free slots and
+ * thread signatures are skipped.
+ * gen, if given, receives the sampler tick that produced them.
+ */
+static inline int ss_snapshot_read(const ss_snapshot_t *ss,
+                                   struct smartsched_record *out, int max,
+                                   unsigned long long *gen)
+{
+    for (int tries = 0; tries < SS_SNAPSHOT_RETRIES; tries++) {
+        unsigned int seq = ss_snapshot_read_begin(ss);
+        unsigned int rows = ss->hdr->nr_records;
+        int n = 0;
+
+        if (rows > ss->hdr->capacity)
+            rows = ss->hdr->capacity;
+        for (unsigned int i = 0; i < rows && n < max; i++) {
+            if (ss_snapshot_is_process(ss, i))
+                ss_snapshot_row(ss, i, &out[n++]);
+        }
+        if (gen)
+            *gen = ss->hdr->generation;
+
+        if (!ss_snapshot_read_retry(ss, seq))
+            return n;
+    }
+    return -EAGAIN;
+}
+
+#endif /* SMARTSCHED_SNAPSHOT_H */
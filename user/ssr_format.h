@@ -0,0 +1,397 @@
+/*
+ * SmartScheduler Recording Format (.ssr)
+ *
+ * Header-only codec shared by data_exporter (which writes and converts
+ * recordings) and replay (which feeds them back through the model).
+ *
+ *   file    := file_header chunk*
+ *   chunk   := chunk_header bytes[stored_len]    (zstd if SSR_CHUNK_ZSTD)
+ *   payload := block*                             (raw_len bytes)
+ *   block   := block_header pid[n] column[0][n] ... column[columns-1][n]
+ *
+ * Rows are sorted by PID. The pid column is the varint gap to the
+ * previous PID in the block; every value column is the zigzag varint
+ * difference from the same PID in the previous block (0 if it was not
+ * there), so a steady process costs about one byte per value. Blocks
+ * flagged SSR_BLOCK_KEY are coded against nothing and let a reader
+ * resync. Blocks flagged SSR_BLOCK_TRUNCATED lost the processes past
+ * the writer's row limit. Chunks are the writer's flush unit.
+ *
+ * Version 1 stored the first SSR_COL_TOTAL_SAMPLES + 1 columns only;
+ * version 2 adds the raw model inputs, present in blocks flagged
+ * SSR_BLOCK_SAMPLES.
+ */
+
+#ifndef SMARTSCHED_SSR_FORMAT_H
+#define SMARTSCHED_SSR_FORMAT_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define SSR_MAGIC           0x31525353   /* "SSR1" */
+#define SSR_CHUNK_MAGIC     0x43525353   /* "SSRC" */
+#define SSR_VERSION         2
+#define SSR_CHUNK_ZSTD      (1 << 0)
+#define SSR_BLOCK_KEY       (1 << 0)     /* Coded against nothing */
+#define SSR_BLOCK_SAMPLES   (1 << 1)     /* Raw sample columns are valid */
+#define SSR_BLOCK_TRUNCATED (1 << 2)     /* More processes than rows stored */
+#define SSR_MAX_ROWS        8192         /* Writer's limit without a snapshot; readers grow */
+
+/* Value columns, in stored order */
+enum {
+    SSR_COL_CPU_EMA,
+    SSR_COL_MEM_EMA,
+    SSR_COL_IO_EMA,
+    SSR_COL_CPU_ROC,
+    SSR_COL_MEM_ROC,
+    SSR_COL_IO_ROC,
+    SSR_COL_TOTAL_SAMPLES,
+    SSR_COL_CPU_SAMPLE,          /* Version 2 onwards */
+    SSR_COL_MEM_SAMPLE,
+    SSR_COL_IO_SAMPLE,
+    SSR_COLUMNS
+};
+
+#define SSR_V1_COLUMNS      (SSR_COL_TOTAL_SAMPLES + 1)
+#define SSR_MAX_ROW_BYTES   (5 + SSR_COLUMNS * 10)
+
+struct ssr_file_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;
+    uint32_t interval_ms;
+    uint32_t reserved;
+    uint64_t start_ns;          /* CLOCK_REALTIME at start */
+};
+
+struct ssr_chunk_header {
+    uint32_t magic;
+    uint32_t flags;             /* SSR_CHUNK_* */
+    uint32_t stored_len;        /* Bytes following on disk */
+    uint32_t raw_len;           /* Bytes once decompressed */
+};
+
+struct ssr_block_header {
+    uint32_t sample;
+    uint32_t nr_rows;
+    uint64_t offset_ns;         /* Since ssr_file_header.start_ns */
+    uint32_t payload_len;
+    uint32_t flags;             /* SSR_BLOCK_* */
+};
+
+/* One sampled process; v[] is indexed by SSR_COL_* */
+typedef struct {
+    int pid;
+    int64_t v[SSR_COLUMNS];
+} ssr_row_t;
+
+/* ---- Column coding ---- */
+
+static inline uint64_t ssr_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t ssr_unzigzag(uint64_t u)
+{
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static inline uint8_t *ssr_put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+/* Returns the byte after the varint, or NULL if it runs past end */
+static inline const uint8_t *ssr_get_varint(const uint8_t *p, const uint8_t *end,
+                                            uint64_t *v)
+{
+    uint64_t r = 0;
+
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline int ssr_compare_rows(const void *a, const void *b)
+{
+    const ssr_row_t *ra = a, *rb = b;
+    return (ra->pid > rb->pid) - (ra->pid < rb->pid);
+}
+
+/*
+ * For each row, point base[i] at the same PID in prev (or NULL).
+ * Both arrays are PID-sorted, so this is a single merge pass.
+ */
+static inline void ssr_match_previous(const ssr_row_t *rows, int n,
+                                      const ssr_row_t *prev, int nprev,
+                                      const ssr_row_t **base)
+{
+    int j = 0;
+
+    for (int i = 0; i < n; i++) {
+        while (j < nprev && prev[j].pid < rows[i].pid)
+            j++;
+        base[i] = (j < nprev && prev[j].pid == rows[i].pid) ? &prev[j] : NULL;
+    }
+}
+
+/*
+ * Encode n PID-sorted rows against prev into out, which must hold
+ * n * SSR_MAX_ROW_BYTES; returns the end pointer. base is scratch
+ * space for n pointers.
+ */
+static inline uint8_t *ssr_encode_block(uint8_t *out, const ssr_row_t *rows, int n,
+                                        const ssr_row_t *prev, int nprev,
+                                        int columns, const ssr_row_t **base)
+{
+    int last = 0;
+
+    ssr_match_previous(rows, n, prev, nprev, base);
+
+    for (int i = 0; i < n; i++) {
+        out = ssr_put_varint(out, (uint64_t)(rows[i].pid - last));
+        last = rows[i].pid;
+    }
+    for (int c = 0; c < columns; c++) {
+        for (int i = 0; i < n; i++) {
+            int64_t ref = base[i] ? base[i]->v[c] : 0;
+            out = ssr_put_varint(out, ssr_zigzag(rows[i].v[c] - ref));
+        }
+    }
+    return out;
+}
+
+/* Inverse of ssr_encode_block(); returns 0 or -1 on a malformed block */
+static inline int ssr_decode_block(const uint8_t *p, const uint8_t *end,
+                                   ssr_row_t *rows, int n,
+                                   const ssr_row_t *prev, int nprev,
+                                   int columns, const ssr_row_t **base)
+{
+    uint64_t u;
+    int last = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!(p = ssr_get_varint(p, end, &u))) return -1;
+        last += (int)u;
+        rows[i].pid = last;
+    }
+    ssr_match_previous(rows, n, prev, nprev, base);
+    for (int c = 0; c < columns; c++) {
+        for (int i = 0; i < n; i++) {
+            if (!(p = ssr_get_varint(p, end, &u))) return -1;
+            rows[i].v[c] = (base[i] ? base[i]->v[c] : 0) + ssr_unzigzag(u);
+        }
+    }
+    for (int c = columns; c < SSR_COLUMNS; c++) {
+        for (int i = 0; i < n; i++)
+            rows[i].v[c] = 0;
+    }
+    return p == end ? 0 : -1;
+}
+
+/* ---- Sequential reader ---- */
+
+typedef struct {
+    FILE *f;
+    struct ssr_file_header fh;
+    struct ssr_block_header bh;     /* Header of the block just returned */
+    ssr_row_t *rows;                /* Decode target */
+    ssr_row_t *prev;                /* Block just returned, next reference */
+    int nprev;
+    int rows_cap;                   /* Of rows, prev and base */
+    int have_key;
+    unsigned long skipped;          /* Blocks lost to corruption */
+    unsigned long truncated;        /* Blocks flagged SSR_BLOCK_TRUNCATED */
+
+    uint8_t *stored, *raw;
+    size_t stored_cap, raw_cap;
+    const uint8_t *p, *end;         /* Unread part of the current chunk */
+    const ssr_row_t **base;
+} ssr_reader_t;
+
+/* Returns 0, -errno, or -EPROTO if the file is not a known version */
+static inline int ssr_reader_open(ssr_reader_t *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f)
+        return -errno;
+
+    if (fread(&r->fh, sizeof(r->fh), 1, r->f) != 1 || r->fh.magic != SSR_MAGIC ||
+        r->fh.version < 1 || r->fh.version > SSR_VERSION ||
+        r->fh.columns < SSR_V1_COLUMNS || r->fh.columns > SSR_COLUMNS) {
+        fclose(r->f);
+        r->f = NULL;
+        return -EPROTO;
+    }
+
+    r->rows = malloc(SSR_MAX_ROWS * sizeof(ssr_row_t));
+    r->prev = malloc(SSR_MAX_ROWS * sizeof(ssr_row_t));
+    r->base = malloc(SSR_MAX_ROWS * sizeof(*r->base));
+    if (!r->rows || !r->prev || !r->base) {
+        free(r->rows);
+        free(r->prev);
+        free(r->base);
+        fclose(r->f);
+        r->f = NULL;
+        return -ENOMEM;
+    }
+    r->rows_cap = SSR_MAX_ROWS;
+    return 0;
+}
+
+static inline void ssr_reader_close(ssr_reader_t *r)
+{
+    if (r->f)
+        fclose(r->f);
+    free(r->rows);
+    free(r->prev);
+    free(r->base);
+    free(r->stored);
+    free(r->raw);
+    memset(r, 0, sizeof(*r));
+}
+
+/* Load the next chunk; returns 1, 0 at end of file, or -errno */
+static inline int ssr_reader_load_chunk(ssr_reader_t *r)
+{
+    struct ssr_chunk_header ch;
+
+    if (fread(&ch, sizeof(ch), 1, r->f) != 1)
+        return 0;
+    if (ch.magic != SSR_CHUNK_MAGIC)
+        return -EBADMSG;
+
+    if (ch.stored_len > r->stored_cap) {
+        uint8_t *nb = realloc(r->stored, ch.stored_len);
+        if (!nb) return -ENOMEM;
+        r->stored = nb;
+        r->stored_cap = ch.stored_len;
+    }
+    /* A short final chunk means the writer was killed; treat as end */
+    if (fread(r->stored, 1, ch.stored_len, r->f) != ch.stored_len)
+        return 0;
+
+    r->p = r->stored;
+    r->end = r->stored + ch.stored_len;
+
+    if (ch.flags & SSR_CHUNK_ZSTD) {
+#ifdef HAVE_ZSTD
+        if (ch.raw_len > r->raw_cap) {
+            uint8_t *nb = realloc(r->raw, ch.raw_len);
+            if (!nb) return -ENOMEM;
+            r->raw = nb;
+            r->raw_cap = ch.raw_len;
+        }
+        size_t z = ZSTD_decompress(r->raw, r->raw_cap, r->stored, ch.stored_len);
+        if (ZSTD_isError(z) || z != ch.raw_len)
+            return -EBADMSG;
+        r->p = r->raw;
+        r->end = r->raw + z;
+#else
+        return -ENOTSUP;
+#endif
+    }
+    return 1;
+}
+
+/* Make room for blocks of n rows; prev keeps its rows */
+static inline int ssr_reader_reserve(ssr_reader_t *r, int n)
+{
+    void *nb;
+
+    if (n <= r->rows_cap)
+        return 0;
+    if (!(nb = realloc(r->rows, n * sizeof(ssr_row_t))))
+        return -ENOMEM;
+    r->rows = nb;
+    if (!(nb = realloc(r->prev, n * sizeof(ssr_row_t))))
+        return -ENOMEM;
+    r->prev = nb;
+    if (!(nb = realloc(r->base, n * sizeof(*r->base))))
+        return -ENOMEM;
+    r->base = nb;
+    r->rows_cap = n;
+    return 0;
+}
+
+/*
+ * Decode the next block into r->rows / r->bh; returns its row count,
+ * -1 at end of file, or -errno on a fatal error (-ENOTSUP: compressed
+ * without HAVE_ZSTD). Undecodable blocks are skipped up to the next
+ * keyframe and counted in r->skipped.
+ */
+static inline int ssr_reader_next(ssr_reader_t *r)
+{
+    for (;;) {
+        if (r->p + sizeof(struct ssr_block_header) > r->end) {
+            int ret = ssr_reader_load_chunk(r);
+            if (ret <= 0)
+                return ret == 0 ? -1 : ret;
+            continue;
+        }
+
+        memcpy(&r->bh, r->p, sizeof(r->bh));
+        r->p += sizeof(r->bh);
+        /* Every row costs at least one byte per column */
+        if (r->bh.payload_len > (size_t)(r->end - r->p) ||
+            r->bh.nr_rows > r->bh.payload_len / (1 + r->fh.columns))
+            return -EBADMSG;
+        if (ssr_reader_reserve(r, (int)r->bh.nr_rows) < 0)
+            return -ENOMEM;
+
+        const uint8_t *payload = r->p;
+        int key = r->bh.flags & SSR_BLOCK_KEY;
+        r->p += r->bh.payload_len;
+
+        /* Delta blocks need their predecessor; wait for a keyframe */
+        if (key)
+            r->have_key = 1;
+        if (!r->have_key ||
+            ssr_decode_block(payload, payload + r->bh.payload_len, r->rows,
+                             r->bh.nr_rows, r->prev, key ? 0 : r->nprev,
+                             r->fh.columns, r->base) < 0) {
+            r->have_key = 0;
+            r->skipped++;
+            continue;
+        }
+        if (r->fh.version < 2)
+            r->bh.flags &= ~SSR_BLOCK_SAMPLES;
+        if (r->bh.flags & SSR_BLOCK_TRUNCATED)
+            r->truncated++;
+
+        /* Returned rows become the reference for the next block */
+        ssr_row_t *t = r->prev;
+        r->prev = r->rows;
+        r->rows = t;
+        r->nprev = r->bh.nr_rows;
+        return r->bh.nr_rows;
+    }
+}
+
+/* Rows of the block ssr_reader_next() just returned */
+static inline const ssr_row_t *ssr_reader_rows(const ssr_reader_t *r)
+{
+    return r->prev;
+}
+
+#endif /* SMARTSCHED_SSR_FORMAT_H */
@@ -1,7 +1,9 @@
 /*
  * SmartScheduler Top Spikes Tool
  *
- * Shows top N processes by spike severity
+ * Shows top N processes by spike severity, from the kernel's
+ * incrementally maintained top view when available, else the binary
+ * snapshot or the stats file
  *
  * Compile: gcc -o top_spikes top_spikes.c -Wall -O2
  * Run: ./top_spikes [-n COUNT] [-c] [-m] [-i]
@@ -12,6 +14,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "snapshot.h"
+
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
 #define COLOR_GREEN   "\033[32m"
@@ -20,7 +24,8 @@
 #define COLOR_BOLD    "\033[1m"
 
 #define PROC_STATS "/proc/smartscheduler/stats"
-#define MAX_PROCS 512
+#define PROC_TOP   "/proc/smartscheduler/top"
+#define MAX_PROCS 4096
 
 typedef struct {
     int pid;
@@ -52,7 +57,72 @@ int compare_by_io(const void *a, const void *b) {
     return ((Process*)b)->io_roc - ((Process*)a)->io_roc;
 }
 
-void read_stats(void) {
+/*
+ * Load the kernel's ranking for one order from the top view, which
+ * holds at most 100 rows per order however many processes are
+ * tracked; returns 0 if unavailable
+ */
+int read_top(const char *order) {
+    FILE *f = fopen(PROC_TOP, "r");
+    if (!f)
+        return 0;
+    
+    char line[256];
+    
+    /* Skip headers */
+    for (int i = 0; i < 4 && fgets(line, sizeof(line), f); i++);
+    
+    while (fgets(line, sizeof(line), f) && proc_count < MAX_PROCS) {
+        Process *p = &procs[proc_count];
+        char name[8];
+        int rank, key;
+        
+        if (sscanf(line, "%7s %d %d %d %d %d %d %d %d %d",
+                   name, &rank, &p->pid, &key, &p->cpu_ema, &p->mem_ema, &p->io_ema,
+                   &p->cpu_roc, &p->mem_roc, &p->io_roc) < 10)
+            continue;
+        if (strcmp(name, order) != 0)
+            continue;
+        p->score = abs(p->cpu_roc) + abs(p->mem_roc) + abs(p->io_roc);
+        proc_count++;
+    }
+    fclose(f);
+    return 1;
+}
+
+/* Load signatures from the binary snapshot; returns 0 if unavailable */
+int read_snapshot(void) {
+    static struct smartsched_record recs[MAX_PROCS];
+    ss_snapshot_t ss;
+    int n;
+    
+    if (ss_snapshot_open(&ss) < 0)
+        return 0;
+    n = ss_snapshot_read(&ss, recs, MAX_PROCS, NULL);
+    ss_snapshot_close(&ss);
+    if (n < 0)
+        return 0;
+    
+    for (int i = 0; i < n; i++) {
+        Process *p = &procs[proc_count++];
+        p->pid = recs[i].pid;
+        p->cpu_ema = recs[i].cpu_ema;
+        p->mem_ema = recs[i].mem_ema;
+        p->io_ema = recs[i].io_ema;
+        p->cpu_roc = recs[i].cpu_roc;
+        p->mem_roc = recs[i].mem_roc;
+        p->io_roc = recs[i].io_roc;
+        p->score = abs(p->cpu_roc) + abs(p->mem_roc) + abs(p->io_roc);
+    }
+    return 1;
+}
+
+void read_stats(const char *order) {
+    if (read_top(order))
+        return;
+    if (read_snapshot())
+        return;
+    
     FILE *f = fopen(PROC_STATS, "r");
     if (!f) {
         fprintf(stderr, "Error: Cannot open %s\n", PROC_STATS);
@@ -141,7 +211,8 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    read_stats();
+    static const char *orders[] = { "score", "cpu", "mem", "io" };
+    read_stats(orders[sort_mode]);
     
     char title[64];
     switch (sort_mode) {